@@ -0,0 +1,84 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+// Minimal set of atomic operations on 32-bit integers.
+// atomicLoad has acquire semantics, atomicStore has release semantics.
+// All other operations are full memory barriers.
+
+#if defined (WIN32) || defined(_WIN32_WCE)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+inline void atomicMemoryBarrier() {
+	LONG dummy = 0;
+	InterlockedExchange(&dummy, 0);
+}
+
+// Returns the value *p had before the operation.
+inline int atomicCompareAndSwap(volatile int* p, int oldValue, int newValue) {
+	return (int)InterlockedCompareExchange((volatile LONG*)p, newValue, oldValue);
+}
+
+// Returns the new value.
+inline int atomicIncrement(volatile int* p) {
+	return (int)InterlockedIncrement((volatile LONG*)p);
+}
+
+inline int atomicLoad(volatile int* p) {
+	return (int)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+
+inline void atomicStore(volatile int* p, int value) {
+	InterlockedExchange((volatile LONG*)p, value);
+}
+
+#elif defined(__GNUC__)
+
+inline void atomicMemoryBarrier() {
+	__sync_synchronize();
+}
+
+// Returns the value *p had before the operation.
+inline int atomicCompareAndSwap(volatile int* p, int oldValue, int newValue) {
+	return __sync_val_compare_and_swap(p, oldValue, newValue);
+}
+
+// Returns the new value.
+inline int atomicIncrement(volatile int* p) {
+	return __sync_add_and_fetch(p, 1);
+}
+
+inline int atomicLoad(volatile int* p) {
+	int value = *p;
+	__sync_synchronize();
+	return value;
+}
+
+inline void atomicStore(volatile int* p, int value) {
+	__sync_synchronize();
+	*p = value;
+}
+
+#else
+#error Unsupported platform!
+#endif
+
+#endif	//ATOMIC_H
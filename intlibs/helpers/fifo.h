@@ -19,54 +19,118 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #define _FIFO_H_
 
 #include <helpers/helpers.h>
-#include <helpers/CriticalSection.h>
+#include <helpers/atomic.h>
 
 using namespace MoSyncError;
 
-//A FIFO Queue implemented using a non-resizable circular buffer
+#define FIFO_CACHE_LINE_SIZE 64
+
+struct FifoStats {
+	int puts;	//elements accepted
+	int overflows;	//elements rejected because the FIFO was full
+	int maxCount;	//highest number of queued elements seen
+};
+
+//A FIFO Queue implemented using a non-resizable circular buffer.
+//It is lock-free: any number of threads may put(), but only one thread,
+//the consumer, may get() or clear(). size must be a power of two.
+//Each slot carries a sequence number that tells whether it is free,
+//being written or ready to be read, so producers never block each other
+//and the consumer never blocks producers.
 template<class T, int size> class CircularFifo {
 public:
-	CircularFifo() : mReadPos(0), mWritePos(0) { InitializeCriticalSection(&criticalSection); }
+	CircularFifo() : mWritePos(0), mReadPos(0) {
+		for(int i=0; i<size; i++) {
+			mCells[i].seq = i;
+		}
+		resetStats();
+	}
 
+	//Returns false if the FIFO is full. The element is then lost,
+	//but not the rest, and the overflow is counted in stats().
+	bool tryPut(const T& t) {
+		Cell* cell;
+		int pos = atomicLoad(&mWritePos);
+		while(true) {
+			cell = &mCells[pos & (size - 1)];
+			int dif = diff(atomicLoad(&cell->seq), pos);
+			if(dif == 0) {
+				if(atomicCompareAndSwap(&mWritePos, pos, add(pos, 1)) == pos)
+					break;
+			} else if(dif < 0) {
+				atomicIncrement(&mStats.overflows);
+				return false;
+			}
+			pos = atomicLoad(&mWritePos);
+		}
+		cell->value = t;
+		atomicStore(&cell->seq, add(pos, 1));
+
+		atomicIncrement(&mStats.puts);
+		int c = diff(add(pos, 1), atomicLoad(&mReadPos));
+		if(c > mStats.maxCount)	//racy, but it's only statistics.
+			mStats.maxCount = c;
+		return true;
+	}
 	void put(const T& t) {
-		CriticalSectionHandler ccect(&criticalSection);
-		mWritePos++;
-		if(mWritePos == size)
-			mWritePos = 0;
-		//prevent overruns; lose the data being put, but not the rest.
-		//max count becomes capacity - 1.
-		if(mWritePos == mReadPos) {
-			//mWritePos--;
+		if(!tryPut(t)) {
 			BIG_PHAT_ERROR(ERR_FIFO_OVERRUN);
-		} else {
-			mBuf[mWritePos] = t;
 		}
 	}
-	const T& get() {
-		CriticalSectionHandler ccect(&criticalSection);
-		DEBUG_ASSERT(count() != 0);
-		mReadPos++;
-		if(mReadPos == size)
-			mReadPos = 0;
-		const T& t = mBuf[mReadPos];
+
+	//Consumer thread only. count() must be non-zero.
+	T get() {
+		Cell& cell(mCells[mReadPos & (size - 1)]);
+		DEBUG_ASSERT(atomicLoad(&cell.seq) == add(mReadPos, 1));
+		T t = cell.value;
+		atomicStore(&cell.seq, add(mReadPos, size));
+		atomicStore(&mReadPos, add(mReadPos, 1));
 		return t;
 	}
+
+	//Exact on the consumer thread, except that elements still being put
+	//by other threads are not counted until the oldest of them is complete.
 	size_t count() {
-		CriticalSectionHandler ccect(&criticalSection);
-		if(mWritePos >= mReadPos)
-			return mWritePos - mReadPos;
-		else	//(mWritePos < mReadPos)
-			return size - mReadPos + mWritePos;
+		int readPos = atomicLoad(&mReadPos);
+		if(atomicLoad(&mCells[readPos & (size - 1)].seq) != add(readPos, 1))
+			return 0;
+		return diff(atomicLoad(&mWritePos), readPos);
 	}
+
+	//Consumer thread only.
 	void clear() {
-		CriticalSectionHandler ccect(&criticalSection);
-		mReadPos = mWritePos = 0;
+		while(count() != 0) {
+			get();
+		}
+	}
+
+	FifoStats stats() const { return mStats; }
+	void resetStats() {
+		mStats.puts = 0;
+		mStats.overflows = 0;
+		mStats.maxCount = 0;
 	}
+
 private:
-	CRITICAL_SECTION criticalSection;
+	typedef char SizeMustBePowerOfTwo[(size & (size - 1)) == 0 ? 1 : -1];
+
+	struct Cell {
+		volatile int seq;
+		T value;
+	};
+
+	//positions wrap around; avoid signed overflow.
+	static int add(int pos, int n) { return (int)((unsigned)pos + (unsigned)n); }
+	static int diff(int a, int b) { return (int)((unsigned)a - (unsigned)b); }
+
+	//producers and the consumer write to different cache lines.
+	volatile int mWritePos;
+	FifoStats mStats;
+	char mPad1[FIFO_CACHE_LINE_SIZE - sizeof(int) - sizeof(FifoStats)];
+	volatile int mReadPos;
+	char mPad2[FIFO_CACHE_LINE_SIZE - sizeof(int)];
 
-	T mBuf[size];
-	size_t mReadPos, mWritePos;
+	Cell mCells[size];
 };
 
 #endif
@@ -85,6 +85,9 @@ struct MA_FILE_t {
 
 	// when (mode&MODE_WRITE)!=0
 	MAHandle store;
+	// Size of the store when it was opened for appending only, in which
+	// case the buffer holds just the appended data. Otherwise 0.
+	int appendOffset;
 
 	int resultFlags;
 };
@@ -112,95 +115,159 @@ static BundleHeader sHeader;
 
 static int sCaseSensitive = 0;
 
-static int readString(MAHandle fileSystem, int *offset, char **outString) {
-	char tempString[255];
-	char *c = tempString;
-	char lastByte;
-	int i = 0;
-	do {
-		maReadData(fileSystem, c, (*offset)++, 1);
-		lastByte = *c;
-		c++;
-		i++;
-	} while(lastByte);
-
-	*outString = (char*)malloc(i);
-	memcpy(*outString, tempString, i);
-	return i;
-}
+// The volume entries, read in one piece. Names point into it.
+static char* sVolumeData = NULL;
+static int sVolumeDataSize = 0;
 
-static VolumeEntry *findFileRecursively(const char *filename, VolumeEntry *root) {
-	int endOfChild = 0;
-	VolumeEntry *findFile = NULL;
+// ---------------------------------------------------------------------------------------
+// Path index
+// Every file in the volume, by its normalised full path, in an open
+// addressing hash table. Opening a file costs one hash and one compare,
+// whatever the size of the volume.
+// ---------------------------------------------------------------------------------------
+
+#define MAX_PATH_LENGTH 1024
+
+typedef struct {
+	unsigned int hash;
+	int path;	// offset in sIndexPaths
+	VolumeEntry* entry;	// NULL if the slot is free
+} PathIndexSlot;
+
+static PathIndexSlot* sIndex = NULL;
+static int sIndexMask = 0;
+static char* sIndexPaths = NULL;
+static int sIndexPathsSize = 0;
+
+static unsigned int hashPath(const char* path, int len) {
+	unsigned int hash = 2166136261u;	// FNV-1a
 	int i;
-	const char *c = filename;
-	if(filename[0]=='.' && (filename[1]=='\\' || filename[1]=='/')) {
-		filename+=2;
-		c+=2;
+	for(i = 0; i < len; i++) {
+		hash ^= (unsigned char)path[i];
+		hash *= 16777619;
 	}
+	return hash;
+}
 
-	LOG("fFR filename: '%s', type: %i", root->name, root->type);
-	if(root->type == VOL_TYPE_FILE) {
-		if(sCaseSensitive) {
-			if(strcmp(filename, root->name)==0)
-				return root;
-		} else {
-			const char *a = filename;
-			const char *b = root->name;
-			while(*a && *b) {
-				if(toupper((int)*a)!=toupper((int)*b)) return NULL;
-				a++;
-				b++;
+/**
+ * Appends a path to dst, normalised: separators become '/', empty and "."
+ * components are dropped, and in case insensitive mode letters are upper case.
+ * @return The new length of dst, or -1 if it would not fit.
+ */
+static int appendNormalisedPath(char* dst, int len, const char* src) {
+	while(*src) {
+		const char* end = src;
+		int n;
+		while(*end && *end != '/' && *end != '\\')
+			end++;
+		n = end - src;
+		if(n > 0 && !(n == 1 && src[0] == '.')) {
+			if(len + n + 2 > MAX_PATH_LENGTH)
+				return -1;
+			if(len > 0)
+				dst[len++] = '/';
+			while(src < end) {
+				dst[len++] = sCaseSensitive ? *src : (char)toupper((int)*src);
+				src++;
 			}
-			if(*a=='\0' && *b=='\0')
-				return root;
-			return NULL;
 		}
+		src = *end ? end + 1 : end;
 	}
+	dst[len] = 0;
+	return len;
+}
 
-	while(1) {
-		if((*c)=='\\' || (*c)=='/') break;
-		else if((*c)==0) break;
-		endOfChild++;
-		c++;
+static void countFilesRecursively(VolumeEntry* vol, int pathLength, int* numFiles, int* pathsSize) {
+	int i;
+	pathLength += strlen(vol->name) + 1;
+	if(vol->type == VOL_TYPE_FILE) {
+		(*numFiles)++;
+		*pathsSize += pathLength;
+		return;
 	}
-	c++;
-	if((*c)==0) {
-		if(strncmp(root->name, filename, endOfChild)==0)
-			return root;
-		else
-			return NULL;
+	for(i = 0; i < vol->numChildren; i++) {
+		countFilesRecursively(&vol->children[i], pathLength, numFiles, pathsSize);
 	}
-	else if(strncmp(root->name, filename, endOfChild)==0) {
-		for(i = 0; i < root->numChildren; i++) {
-			findFile = findFileRecursively(c, &root->children[i]);
-			if(findFile) {
-				return findFile;
-			}
+}
+
+static void indexFilesRecursively(VolumeEntry* vol, char* path, int len) {
+	int i;
+	len = appendNormalisedPath(path, len, vol->name);
+	if(len < 0)
+		return;
+	if(vol->type == VOL_TYPE_FILE) {
+		unsigned int hash = hashPath(path, len);
+		int slot = hash & sIndexMask;
+		while(sIndex[slot].entry) {
+			// the first of two equal paths wins, like with the old search.
+			if(sIndex[slot].hash == hash && strcmp(sIndexPaths + sIndex[slot].path, path) == 0)
+				return;
+			slot = (slot + 1) & sIndexMask;
 		}
-		return NULL;
+		sIndex[slot].hash = hash;
+		sIndex[slot].path = sIndexPathsSize;
+		sIndex[slot].entry = vol;
+		memcpy(sIndexPaths + sIndexPathsSize, path, len + 1);
+		sIndexPathsSize += len + 1;
+		return;
+	}
+	for(i = 0; i < vol->numChildren; i++) {
+		indexFilesRecursively(&vol->children[i], path, len);
 	}
-	else
-		return NULL;
 }
 
-static VolumeEntry* findFile(const char *filename, VolumeEntry *root) {
+static void buildPathIndex(VolumeEntry* root) {
+	char path[MAX_PATH_LENGTH];
+	int numFiles = 0;
+	int pathsSize = 0;
+	int size = 1;
 	int i;
 
-	LOG("%i children", root->numChildren);
+	for(i = 0; i < root->numChildren; i++) {
+		countFilesRecursively(&root->children[i], 0, &numFiles, &pathsSize);
+	}
 
-//	if(root->numChildren != 1) maPanic(0, "Invalid file system root");
-//	root = &root->children[0];
+	// at most half full, so probe sequences stay short.
+	while(size < numFiles * 2)
+		size <<= 1;
+	sIndexMask = size - 1;
+	sIndex = (PathIndexSlot*)malloc(sizeof(PathIndexSlot) * size);
+	memset(sIndex, 0, sizeof(PathIndexSlot) * size);
+	sIndexPaths = (char*)malloc(pathsSize + 1);
+	sIndexPathsSize = 0;
 
+	// the root's name is not part of the paths.
 	for(i = 0; i < root->numChildren; i++) {
-		VolumeEntry *ve = NULL;
-		LOG("fFR %i", i);
-		ve = findFileRecursively(filename, &root->children[i]);
+		indexFilesRecursively(&root->children[i], path, 0);
+	}
+}
 
-		if(ve) {
-			return ve;
-		}
+static void freePathIndex(void) {
+	if(sIndex) free(sIndex);
+	if(sIndexPaths) free(sIndexPaths);
+	sIndex = NULL;
+	sIndexPaths = NULL;
+	sIndexMask = 0;
+	sIndexPathsSize = 0;
+}
+
+static VolumeEntry* findFile(const char *filename) {
+	char path[MAX_PATH_LENGTH];
+	unsigned int hash;
+	int len, slot;
+
+	len = appendNormalisedPath(path, 0, filename);
+	if(len <= 0)
+		return NULL;
+
+	hash = hashPath(path, len);
+	slot = hash & sIndexMask;
+	while(sIndex[slot].entry) {
+		if(sIndex[slot].hash == hash && strcmp(sIndexPaths + sIndex[slot].path, path) == 0)
+			return sIndex[slot].entry;
+		slot = (slot + 1) & sIndexMask;
 	}
+	LOG("fF '%s' not found", path);
 	return NULL;
 }
 
@@ -230,37 +297,38 @@ static void freeVolumeEntriesRecursively(VolumeEntry *vol) {
 	if(vol->children) free(vol->children);
 }
 
-static void readVolumeEntriesRecursively(MAHandle fileSystem, int *offset, VolumeEntry *vol) {
+static int readInt(int *offset) {
+	int i;
+	memcpy(&i, sVolumeData + *offset, 4);
+	(*offset)+=4;
+	FLIP_TO_ENDIAN_INT(i);
+	return i;
+}
+
+static void readVolumeEntriesRecursively(int *offset, VolumeEntry *vol) {
 	int child;
 
 	// read type
-	maReadData(fileSystem, &vol->type, *offset, 1);
+	vol->type = sVolumeData[*offset];
 	(*offset)++;
 
 	// read name
-	readString(fileSystem, offset, &vol->name);
+	vol->name = sVolumeData + *offset;
+	(*offset) += strlen(vol->name) + 1;
 
 	switch(vol->type) {
 		case VOL_TYPE_DIRECTORY: // directory
-			maReadData(fileSystem, &vol->numChildren, *offset, 4);
-			(*offset)+=4;
-			FLIP_TO_ENDIAN_INT(vol->numChildren);
+			vol->numChildren = readInt(offset);
 
 			vol->children = (VolumeEntry*)malloc(sizeof(VolumeEntry)*vol->numChildren);
 			for(child = 0; child < vol->numChildren; child++) {
-				readVolumeEntriesRecursively(fileSystem, offset, &vol->children[child]);
+				readVolumeEntriesRecursively(offset, &vol->children[child]);
 			}
 
 			break;
 		case VOL_TYPE_FILE: // file
-			maReadData(fileSystem, &vol->dataOffset, *offset, 4);
-			(*offset)+=4;
-			FLIP_TO_ENDIAN_INT(vol->dataOffset);
-			vol->dataOffset += sHeader.startOfData;
-
-			maReadData(fileSystem, &vol->dataLength, *offset, 4);
-			(*offset)+=4;
-			FLIP_TO_ENDIAN_INT(vol->dataLength);
+			vol->dataOffset = readInt(offset) + sHeader.startOfData;
+			vol->dataLength = readInt(offset);
 
 			vol->children = 0;
 			vol->numChildren = 0;
@@ -307,9 +375,18 @@ static void buildDirectoryTree(MAHandle fileSystem) {
 	// Read the header into sHeader.
 	readHeader(fileSystem);
 
-	offset = sHeader.startOfVolumes;
+	// The volume entries lie between the header and the file data.
+	// Read them all at once, rather than a byte at a time.
+	sVolumeDataSize = sHeader.startOfData - sHeader.startOfVolumes;
+	sVolumeData = (char*)malloc(sVolumeDataSize + 1);
+	maReadData(fileSystem, sVolumeData, sHeader.startOfVolumes, sVolumeDataSize);
+	sVolumeData[sVolumeDataSize] = 0;
+
+	offset = 0;
 	sRoot = (VolumeEntry*)malloc(sizeof(VolumeEntry));
-	readVolumeEntriesRecursively(fileSystem, &offset, sRoot);
+	readVolumeEntriesRecursively(&offset, sRoot);
+
+	buildPathIndex(sRoot);
 
 //	printVolumeEntriesRecursively(sRoot, 0);
 }
@@ -317,15 +394,22 @@ static void buildDirectoryTree(MAHandle fileSystem) {
 void freeCurrentFileSystem(void) {
 	if(sRoot) {
 		freeVolumeEntriesRecursively(sRoot);
+		free(sRoot);
 		sRoot = NULL;
 	}
+	if(sVolumeData) {
+		free(sVolumeData);
+		sVolumeData = NULL;
+	}
+	freePathIndex();
 }
 
 void setCurrentFileSystem(MAHandle fileSystem, int caseSensitive) {
 	freeCurrentFileSystem();
+	// the index depends on it.
+	sCaseSensitive = caseSensitive;
 	buildDirectoryTree(fileSystem);
 	sCurrentFileSystem = fileSystem;
-	sCaseSensitive = caseSensitive;
 }
 
 int MAFS_getFileSystemChecksum(MAHandle fileSystem)
@@ -561,6 +645,16 @@ static MA_FILE* openReadWrite(const char *filename, int modeFlags) {
 	else
 		file->type = TYPE_WRITEONLY;
 	file->modeFlags = modeFlags;
+	file->appendOffset = 0;
+
+	// Appending doesn't need the old contents, if they can be kept in place.
+	if((modeFlags&(MODE_READ|MODE_APPEND)) == MODE_APPEND) {
+		int storeSize = maGetStoreSize(store);
+		if(storeSize >= 0) {
+			file->appendOffset = storeSize;
+			modeFlags &= ~MODE_APPEND;
+		}
+	}
 
 	if(modeFlags&(MODE_READ|MODE_APPEND)) {
 		data = maCreatePlaceholder();
@@ -606,7 +700,7 @@ static MA_FILE* openRead(const char *filename, int modeFlags) {
 		return NULL;
 	}
 
-	volEntry = findFile(filename, sRoot);
+	volEntry = findFile(filename);
 	if(!volEntry) {
 		LOG("couldn't find file");
 		return NULL;
@@ -791,7 +885,12 @@ int MA_ferror ( MA_FILE * stream ) {
 int MA_fclose ( MA_FILE * stream ) {
 	LOG("fclose(%x)", (int)stream);
 	if(stream) {
-		if(stream->modeFlags&MODE_WRITE) {
+		if((stream->modeFlags&MODE_WRITE) && stream->appendOffset > 0) {
+			maWriteStoreRange(stream->store, stream->buffer, stream->appendOffset,
+				stream->volEntry->dataLength);
+			maCloseStore(stream->store, 0);
+			free(stream->volEntry);
+		} else if(stream->modeFlags&MODE_WRITE) {
 			MAHandle data = maCreatePlaceholder();
 			maCreateData(data, stream->volEntry->dataLength);
 			maWriteData(data, stream->buffer, 0, stream->volEntry->dataLength);
@@ -819,7 +918,7 @@ int MA_fseek ( MA_FILE * stream, long int offset, int origin ) {
 	stream->resultFlags&=~RES_EOF;
 	switch(origin) {
 		case SEEK_SET:
-			newOffset = dataOffset+offset;
+			newOffset = dataOffset+offset-stream->appendOffset;
 			break;
 		case SEEK_CUR:
 			newOffset = stream->filePtr+offset;
@@ -911,17 +1010,17 @@ int MA_putc ( int character, MA_FILE * stream ) {
 
 long int MA_ftell ( MA_FILE * stream ) {
 	LOG("fputc(%x)", (int)stream);
-	return (stream->filePtr-stream->volEntry->dataOffset);
+	return (stream->filePtr-stream->volEntry->dataOffset+stream->appendOffset);
 }
 
 int MA_fgetpos ( MA_FILE * stream, fpos_t * position ) {
 	LOG("fgetpos(%x, %x)", (int)stream, (int)position);
-	*position = (fpos_t)(stream->filePtr-stream->volEntry->dataOffset);
+	*position = (fpos_t)(stream->filePtr-stream->volEntry->dataOffset+stream->appendOffset);
 	return 0;
 }
 
 int MA_fsetpos ( MA_FILE * stream, const fpos_t * pos ) {
-	int newOffset = (int) *pos;
+	int newOffset = (int) *pos - stream->appendOffset;
 	//eofReached = 0;
 	LOG("fsetpos(%x, %x)", (int)stream, (int)pos);
 	stream->resultFlags&=~RES_EOF;
@@ -107,6 +107,9 @@ void default_malloc_handler(int size) {
 	lprintfln("um %i", gUsedMem);
 	lprintfln("wm %i", gWastedMem);
 	lprintfln("nm %i, nf %i", gNumMallocs, gNumFrees);
+#ifdef MAPIP
+	heapReport();
+#endif
 	dumpStack(size, 0, 0);
 #endif
 	maPanic(size, "Malloc failed. You most likely ran out of heap memory. Try to increase the heap size.");
@@ -155,13 +158,319 @@ block_size_hook set_block_size_hook(block_size_hook new) {
 #define MASTD_HEAP_LOG(...)
 #endif
 
+//****************************************
+//			Small-block slabs
+//****************************************
+
+// Small blocks are allocated from pages of equal-sized blocks,
+// which need neither headers nor searching. The pages are taken from
+// an arena at the end of the heap, which TLSF doesn't manage.
+// When the arena is full, small blocks come from TLSF as well.
+
+#define SLAB_PAGE_SHIFT 12
+#define SLAB_PAGE_SIZE (1 << SLAB_PAGE_SHIFT)
+#define SLAB_MAX_SIZE 128
+
+// The arena takes this part of the heap, but at most SLAB_MAX_ARENA bytes.
+// Heaps smaller than SLAB_MIN_HEAP get no arena.
+#define SLAB_ARENA_DIVISOR 16
+#define SLAB_MAX_ARENA (512*1024)
+#define SLAB_MIN_HEAP (64*1024)
+
+static const int sSlabSizes[HEAP_SLAB_CLASSES] = { 8, 16, 24, 32, 48, 64, 96, 128 };
+
+// The class of each size, in steps of 8 bytes.
+static byte sSlabClassOfSize[SLAB_MAX_SIZE / 8 + 1];
+
+typedef struct SlabPage {
+	void* freeList;		// Freed blocks
+	char* unused;		// Blocks from here on have never been allocated. NULL if none.
+	int used;
+	int cls;			// -1 if the page is in the free page list
+	// Links in the class's list of pages with free blocks, or in the free page list.
+	struct SlabPage* next;
+	struct SlabPage* prev;
+} SlabPage;
+
+typedef struct SlabClass {
+	SlabPage* partial;
+	HeapSlabStats stats;
+} SlabClass;
+
+static char* sSlabStart;
+static char* sSlabBreak;	// Pages below this have been used.
+static char* sSlabEnd;
+static SlabPage* sSlabPages;
+static SlabPage* sFreeSlabPages;
+static SlabClass sSlabClasses[HEAP_SLAB_CLASSES];
+static int sSlabUsedBytes;
+
+// TLSF counts memory added by add_new_area() as freed.
+static size_t sTlsfUsedBias;
+
+#define IS_SLAB(p) ((char*)(p) >= sSlabStart && (char*)(p) < sSlabBreak)
+#define SLAB_PAGE_OF(p) (&sSlabPages[((char*)(p) - sSlabStart) >> SLAB_PAGE_SHIFT])
+#define SLAB_PAGE_BASE(page) (sSlabStart + (((page) - sSlabPages) << SLAB_PAGE_SHIFT))
+
+static void slabUnlink(SlabPage** list, SlabPage* page) {
+	if(page->prev)
+		page->prev->next = page->next;
+	else
+		*list = page->next;
+	if(page->next)
+		page->next->prev = page->prev;
+}
+
+static void slabPush(SlabPage** list, SlabPage* page) {
+	page->prev = NULL;
+	page->next = *list;
+	if(*list)
+		(*list)->prev = page;
+	*list = page;
+}
+
+static SlabPage* newSlabPage(int cls) {
+	SlabPage* page = sFreeSlabPages;
+	if(page) {
+		slabUnlink(&sFreeSlabPages, page);
+	} else {
+		if(sSlabEnd - sSlabBreak < SLAB_PAGE_SIZE)
+			return NULL;
+		sSlabBreak += SLAB_PAGE_SIZE;
+		page = SLAB_PAGE_OF(sSlabBreak - 1);
+	}
+	page->freeList = NULL;
+	page->unused = SLAB_PAGE_BASE(page);
+	page->used = 0;
+	page->cls = cls;
+	slabPush(&sSlabClasses[cls].partial, page);
+	sSlabClasses[cls].stats.pages++;
+	return page;
+}
+
+static void* slabAlloc(int cls) {
+	SlabClass* c = &sSlabClasses[cls];
+	SlabPage* page = c->partial;
+	int size = sSlabSizes[cls];
+	void* p;
+
+	if(!page) {
+		page = newSlabPage(cls);
+		if(!page)
+			return NULL;
+	}
+	if(page->freeList) {
+		p = page->freeList;
+		page->freeList = *(void**)p;
+	} else {
+		p = page->unused;
+		page->unused += size;
+		if(page->unused + size > SLAB_PAGE_BASE(page) + SLAB_PAGE_SIZE)
+			page->unused = NULL;
+	}
+	page->used++;
+
+	// Full pages are in no list until a block is freed.
+	if(!page->freeList && !page->unused)
+		slabUnlink(&c->partial, page);
+
+	c->stats.mallocs++;
+	c->stats.usedObjects++;
+	if(c->stats.usedObjects > c->stats.peakUsedObjects)
+		c->stats.peakUsedObjects = c->stats.usedObjects;
+	sSlabUsedBytes += size;
+	return p;
+}
+
+static void slabFree(void* p) {
+	SlabPage* page = SLAB_PAGE_OF(p);
+	SlabClass* c = &sSlabClasses[page->cls];
+
+	if(!page->freeList && !page->unused)
+		slabPush(&c->partial, page);
+	*(void**)p = page->freeList;
+	page->freeList = p;
+	page->used--;
+
+	c->stats.frees++;
+	c->stats.usedObjects--;
+	sSlabUsedBytes -= sSlabSizes[page->cls];
+
+	// Empty pages can be reused by any class,
+	// but each class keeps one, so that a single block can't make pages thrash.
+	if(page->used == 0 && (c->partial != page || page->next)) {
+		slabUnlink(&c->partial, page);
+		c->stats.pages--;
+		page->cls = -1;
+		slabPush(&sFreeSlabPages, page);
+	}
+}
+
+// Gives the never-used end of the arena to TLSF.
+// Returns TRUE if there was anything to give.
+static int donateSlabTail(void) {
+	int len = sSlabEnd - sSlabBreak;
+	size_t before;
+	if(len < SLAB_PAGE_SIZE)
+		return FALSE;
+	before = get_used_size(sHeapBase);
+	add_new_area(sSlabBreak, len, sHeapBase);
+	sTlsfUsedBias += before - get_used_size(sHeapBase);
+	sSlabEnd = sSlabBreak;
+	MASTD_HEAP_LOG("heap: slab arena shrunk by %i", len);
+	return TRUE;
+}
+
+static void* slab_malloc(int size) {
+	void* p;
+	if(size > 0 && size <= SLAB_MAX_SIZE) {
+		p = slabAlloc(sSlabClassOfSize[(size + 7) >> 3]);
+		if(p)
+			return p;
+	}
+	p = tlsf_malloc(size);
+	if(!p && donateSlabTail())
+		p = tlsf_malloc(size);
+	return p;
+}
+
+static void slab_free(void* p) {
+	if(IS_SLAB(p))
+		slabFree(p);
+	else
+		tlsf_free(p);
+}
+
+static void* slab_realloc(void* old, int size) {
+	void* p;
+	if(!old)
+		return slab_malloc(size);
+	if(IS_SLAB(old)) {
+		int oldSize = sSlabSizes[SLAB_PAGE_OF(old)->cls];
+		if(size <= 0) {
+			slabFree(old);
+			return NULL;
+		}
+		if(size <= oldSize)
+			return old;
+		p = slab_malloc(size);
+		if(!p)
+			return NULL;
+		memcpy(p, old, oldSize);
+		slabFree(old);
+		return p;
+	}
+	p = tlsf_realloc(old, size);
+	if(!p && size > 0 && donateSlabTail())
+		p = tlsf_realloc(old, size);
+	return p;
+}
+
+static int slab_block_size(void* p) {
+	if(IS_SLAB(p))
+		return sSlabSizes[SLAB_PAGE_OF(p)->cls];
+	return tlsf_block_size(p);
+}
+
+// Takes the arena from the end of the heap. Returns the length left for TLSF.
+static int initSlabs(char* start, int length) {
+	int arenaLength, nPages, i, cls;
+
+	if(length < SLAB_MIN_HEAP)
+		return length;
+	arenaLength = length / SLAB_ARENA_DIVISOR;
+	if(arenaLength > SLAB_MAX_ARENA)
+		arenaLength = SLAB_MAX_ARENA;
+	nPages = arenaLength >> SLAB_PAGE_SHIFT;
+	arenaLength = nPages << SLAB_PAGE_SHIFT;
+
+	// Keep the arena aligned like TLSF blocks.
+	sSlabStart = (char*)(((int)(start + length - arenaLength)) & ~15);
+	sSlabBreak = sSlabStart;
+	sSlabEnd = sSlabStart + arenaLength;
+
+	cls = 0;
+	for(i=0; i<=SLAB_MAX_SIZE / 8; i++) {
+		while(sSlabSizes[cls] < i * 8)
+			cls++;
+		sSlabClassOfSize[i] = cls;
+	}
+	for(i=0; i<HEAP_SLAB_CLASSES; i++) {
+		sSlabClasses[i].stats.objectSize = sSlabSizes[i];
+	}
+	return sSlabStart - start;
+}
+
+// Called after TLSF is up, since the page table is allocated from it.
+static void initSlabPages(void) {
+	int nPages = (sSlabEnd - sSlabStart) >> SLAB_PAGE_SHIFT;
+	if(nPages == 0)
+		return;
+	sSlabPages = (SlabPage*)tlsf_malloc(nPages * sizeof(SlabPage));
+	if(!sSlabPages) {
+		sSlabEnd = sSlabBreak;
+		return;
+	}
+	set_malloc_hook((malloc_hook)slab_malloc);
+	set_free_hook(slab_free);
+	set_realloc_hook((realloc_hook)slab_realloc);
+	set_block_size_hook((block_size_hook)slab_block_size);
+	MASTD_HEAP_LOG("heap: slab arena 0x%p, %i pages", sSlabStart, nPages);
+}
+
+int heapGetSlabStats(int cls, HeapSlabStats* stats) {
+	if(cls < 0 || cls >= HEAP_SLAB_CLASSES)
+		return FALSE;
+	*stats = sSlabClasses[cls].stats;
+	return TRUE;
+}
+
+size_t heapLargestFreeBlock(void) {
+	int arenaFree = sSlabEnd - sSlabBreak;
+	size_t largest = get_largest_free_size(sHeapBase);
+	return (size_t)arenaFree > largest ? (size_t)arenaFree : largest;
+}
+
+void heapReport(void) {
+	int i, slabPages = 0, slabSlack = 0, emptyPages = 0;
+	size_t freeMem = heapFreeMemory();
+	size_t largest = heapLargestFreeBlock();
+	SlabPage* page;
+
+	lprintfln("heap: total %i, free %i, largest free block %i",
+		(int)heapTotalMemory(), (int)freeMem, (int)largest);
+	// 0% means that all free memory is in one block.
+	if(freeMem >= 100) {
+		int inLargest = (int)(largest / (freeMem / 100));
+		if(inLargest > 100)
+			inLargest = 100;
+		lprintfln("heap: fragmentation %i%%", 100 - inLargest);
+	}
+	for(page = sFreeSlabPages; page; page = page->next)
+		emptyPages++;
+	lprintfln("heap: slab arena %i, never used %i, %i empty pages",
+		sSlabEnd - sSlabStart, sSlabEnd - sSlabBreak, emptyPages);
+	for(i=0; i<HEAP_SLAB_CLASSES; i++) {
+		const HeapSlabStats* s = &sSlabClasses[i].stats;
+		int slack = s->pages * SLAB_PAGE_SIZE - s->usedObjects * s->objectSize;
+		if(s->mallocs == 0)
+			continue;
+		lprintfln("heap: %3i bytes: %i pages, %i used (peak %i), %i mallocs, %i frees, %i slack",
+			s->objectSize, s->pages, s->usedObjects, s->peakUsedObjects,
+			s->mallocs, s->frees, slack);
+		slabPages += s->pages;
+		slabSlack += slack;
+	}
+	lprintfln("heap: %i slab pages, %i bytes slack", slabPages, slabSlack);
+}
+
 //****************************************
 //				NewPtr
 //****************************************
 
 void ansi_heap_init_crt0(char *start, int length)
 {
-	int res;
+	int res, tlsfLength;
 	if(maCheckInterfaceVersion(MAIDL_HASH) != (int)MAIDL_HASH) {
 		maPanic(1, "Interface version mismatch!");
 	}
@@ -173,7 +482,8 @@ void ansi_heap_init_crt0(char *start, int length)
 
 	if(length <= 0)
 		return;
-	res = init_memory_pool(length, start);
+	tlsfLength = initSlabs(start, length);
+	res = init_memory_pool(tlsfLength, start);
 	if(res < 0) {
 		maPanic(1, "init_memory_pool failed!");
 	}
@@ -183,13 +493,15 @@ void ansi_heap_init_crt0(char *start, int length)
 	set_block_size_hook((block_size_hook)tlsf_block_size);
 
 	MASTD_HEAP_LOG("TLSF initialized!");
+
+	initSlabPages();
 }
 
 size_t heapTotalMemory(void) {
 	return sHeapLength;
 }
 size_t heapFreeMemory(void) {
-	return heapTotalMemory() - get_used_size(sHeapBase);
+	return heapTotalMemory() - (get_used_size(sHeapBase) + sTlsfUsedBias) - sSlabUsedBytes;
 }
 
 //****************************************
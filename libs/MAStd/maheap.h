@@ -103,6 +103,55 @@ size_t heapTotalMemory(void);
 */
 size_t heapFreeMemory(void);
 
+/**
+* The number of size classes of small blocks.
+* \see heapGetSlabStats()
+*/
+#define HEAP_SLAB_CLASSES 8
+
+/**
+* Statistics of one size class of small blocks.
+*
+* Blocks of up to 128 bytes are allocated from pages that only hold blocks
+* of the same size, which saves the header and search time of the general
+* allocator. The pages come from a part of the heap that is reserved for them.
+*/
+typedef struct HeapSlabStats {
+	/** The size of the blocks, in bytes. */
+	int objectSize;
+	/** The number of pages that hold blocks of this size. */
+	int pages;
+	/** The number of blocks that are currently allocated. */
+	int usedObjects;
+	/** The highest value of \a usedObjects so far. */
+	int peakUsedObjects;
+	/** The total number of blocks allocated. */
+	int mallocs;
+	/** The total number of blocks freed. */
+	int frees;
+} HeapSlabStats;
+
+/**
+* Gets the statistics of a size class of small blocks.
+* \param cls The class, from 0 to #HEAP_SLAB_CLASSES - 1, smallest size first.
+* \param stats Receives the statistics.
+* \return FALSE if \a cls is out of range.
+* \note The statistics are all zero if the heap is too small to use slabs,
+* or if the heap was set up by override_heap_init_crt0().
+*/
+int heapGetSlabStats(int cls, HeapSlabStats* stats);
+
+/**
+* Returns the approximate size of the largest block that can be allocated, in bytes.
+*/
+size_t heapLargestFreeBlock(void);
+
+/**
+* Writes a report of heap usage and fragmentation to the log, with lprintfln().
+* The report has one line for each size class of small blocks that has been used.
+*/
+void heapReport(void);
+
 #endif	//MAPIP
 
 typedef void (*malloc_handler)(int size);
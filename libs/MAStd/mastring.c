@@ -76,12 +76,39 @@ int ConvertLatin1ToUtf8(char* dst, int src) {
 
 #ifdef MAPIP
 
+// Set when the runtime turns out to have native string functions.
+// See maStrlen(). Unknown until the first call.
+static int sNativeStrings = -1;
+
+BOOL mastdNativeStrings(void) {
+	if(sNativeStrings < 0)
+		sNativeStrings = maStrlen((MAAddress)"") == 0;
+	return sNativeStrings;
+}
+
+// Shorter blocks are faster to handle in bytecode than with a syscall.
+#define NATIVE_MEM_MIN 16
+
+// Returns the length of s if it is shorter than NATIVE_MEM_MIN,
+// otherwise NATIVE_MEM_MIN.
+static size_t shortStrlen(const char *s)
+{
+	size_t n = 0;
+	while (n < NATIVE_MEM_MIN && s[n]) n++;
+	return n;
+}
+
 #ifndef NO_BUILTINS
 
 char *strncpy(char *dest, const char *source, size_t count)
 {
 	char *start = dest;
 
+	if(count >= NATIVE_MEM_MIN && mastdNativeStrings()) {
+		maStrncpy(dest, (MAAddress)source, count);
+		return dest;
+	}
+
 	while (count && (*dest++ = *source++)) count--;
 	if (count) while (--count) *dest++ = '\0';
 	return start;
@@ -94,6 +121,9 @@ char *strncpy(char *dest, const char *source, size_t count)
 int strncmp(const char *s1, const char *s2, size_t count)
 {
 	if (!count) return 0;
+	if(count >= NATIVE_MEM_MIN && mastdNativeStrings() &&
+		shortStrlen(s1) == NATIVE_MEM_MIN)
+		return maStrncmp((MAAddress)s1, (MAAddress)s2, count);
 
 	while (--count && *s1 && *s1 == *s2)
 	{
@@ -129,6 +159,8 @@ char *strncat(char *s1, const char *s2, size_t count)
 int memcmp(const void *dst, const void *src, size_t n)
 {
 	if (!n) return 0;
+	if(n >= NATIVE_MEM_MIN && mastdNativeStrings())
+		return maMemcmp((MAAddress)dst, (MAAddress)src, n);
 
 	while (--n && *(char *) dst == *(char *) src)
 	{
@@ -169,6 +201,8 @@ int strnicmp(const char *s1, const char *s2, size_t count)
 
 char *strchr(const char *s, int ch)
 {
+	if(mastdNativeStrings() && shortStrlen(s) == NATIVE_MEM_MIN)
+		return (char*)maStrchr((MAAddress)s, ch);
 	while (*s && *s != (char) ch) s++;
 	if (*s == (char) ch) return (char *) s;
 	return NULL;
@@ -178,6 +212,9 @@ char *strrchr(const char *s, int ch)
 {
 	char *start = (char *) s;
 
+	if(mastdNativeStrings() && shortStrlen(s) == NATIVE_MEM_MIN)
+		return (char*)maStrrchr((MAAddress)s, ch);
+
 	while (*s++);
 	while (--s != start && *s != (char) ch);
 	if (*s == (char) ch) return (char *) s;
@@ -300,6 +337,11 @@ void *memmove(void *dst, const void *src, size_t count)
 {
 	void * ret = dst;
 
+	if(count >= NATIVE_MEM_MIN && mastdNativeStrings()) {
+		maMemmove(dst, (MAAddress)src, count);
+		return dst;
+	}
+
 	if (dst <= src || (char *) dst >= ((char *) src + count))
 	{
 		//
@@ -330,6 +372,9 @@ void *memmove(void *dst, const void *src, size_t count)
 
 void *memchr(const void *buf, int ch, size_t count)
 {
+	if(count >= NATIVE_MEM_MIN && mastdNativeStrings())
+		return (void*)maMemchr((MAAddress)buf, ch, count);
+
 	while (count && (*(unsigned char *) buf != (unsigned char) ch))
 	{
 		buf = (unsigned char *) buf + 1;
@@ -536,6 +581,12 @@ return dst;
 size_t strlen(const char *s)
 {
 	const char *eos = s;
+	if(mastdNativeStrings()) {
+		size_t n = shortStrlen(s);
+		if(n < NATIVE_MEM_MIN)
+			return n;
+		return n + maStrlen((MAAddress)(s + n));
+	}
 	while (*eos++);
 	return (int) (eos - s - 1);
 }
@@ -556,6 +607,14 @@ int strcmp(const char *s1, const char *s2)
 char *strcat(char *dst, const char *src)
 {
 	char *cp = dst;
+	if(mastdNativeStrings()) {
+		size_t n = shortStrlen(dst);
+		if(n == NATIVE_MEM_MIN || shortStrlen(src) == NATIVE_MEM_MIN) {
+			// dst + n has the same end as dst.
+			maStrcat(dst + n, (MAAddress)src);
+			return dst;
+		}
+	}
 	while (*cp) cp++;
 	while ((*cp++ = *src++));
 	return dst;
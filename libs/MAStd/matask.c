@@ -19,11 +19,12 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 //							   MoSync Task Control System
 //*********************************************************************************************
 
+#include "ma.h"
 #include "matask.h"
 #include "maheap.h"
 
 char *MainSP;
-int CurrentRunningTask = 0;
+int CurrentRunningTask = -1;
 
 #define ThisTask()	CurrentRunningTask;
 #define task_t		char *
@@ -260,15 +261,26 @@ void maKillTask(void)
 
 
 //***************************************
-//
+//			  Task table
 //***************************************
 
-#define MAXTASK			4		// Maximum allowed tasks
+#define TASK_FREE		0
+#define TASK_READY		1		// In the ready queue
+#define TASK_RUNNING	2
+#define TASK_SLEEPING	3		// In the sleep heap
+#define TASK_BLOCKED	4		// Waiting for WakeTask()
 
 typedef struct
 {
 	int		SP;
 	int		StackBase;		// Stack Base
+	int		State;
+	int		Started;		// False until maRunTaskInit() has been called
+	int		P0, P1;			// Parameters for maRunTaskInit()
+	int		Next, Prev;		// Links in the ready queue or the free list
+	int		WakeTime;		// maGetMilliSecondCount() to wake at
+	int		HeapPos;		// Index in SleepHeap
+	void	*Local[TASK_LOCAL_SLOTS];
 } TaskEntry;
 
 //***************************************
@@ -278,30 +290,183 @@ typedef struct
 TaskEntry*	TaskData;			// Main task table
 int		TaskCount;			// Global task count
 
+static int MaxTasks;
+static int FreeHead = -1;
+
+// Tasks run in the order they became ready.
+static int ReadyHead = -1, ReadyTail = -1;
+static int ReadyCount;
+
+// Binary min-heap of sleeping tasks, by wake time.
+static int *SleepHeap;
+static int SleepCount;
+
+// Task-local storage of code that isn't running in a task.
+static void *MainLocal[TASK_LOCAL_SLOTS];
+
+//***************************************
+//			  Ready queue
+//***************************************
+
+static void ReadyPush(int n)
+{
+	TaskEntry *Task = &TaskData[n];
+
+	Task->State = TASK_READY;
+	Task->Next = -1;
+	Task->Prev = ReadyTail;
+
+	if (ReadyTail >= 0)
+		TaskData[ReadyTail].Next = n;
+	else
+		ReadyHead = n;
+
+	ReadyTail = n;
+	ReadyCount++;
+}
+
+static void ReadyRemove(int n)
+{
+	TaskEntry *Task = &TaskData[n];
+
+	if (Task->Prev >= 0)
+		TaskData[Task->Prev].Next = Task->Next;
+	else
+		ReadyHead = Task->Next;
+
+	if (Task->Next >= 0)
+		TaskData[Task->Next].Prev = Task->Prev;
+	else
+		ReadyTail = Task->Prev;
+
+	ReadyCount--;
+}
+
+//***************************************
+//			  Sleep heap
+//***************************************
+
+// Wake times wrap around, so they're compared by difference.
+#define WakesBefore(a, b)	(TaskData[a].WakeTime - TaskData[b].WakeTime < 0)
+
+static void HeapSet(int pos, int n)
+{
+	SleepHeap[pos] = n;
+	TaskData[n].HeapPos = pos;
+}
+
+static void HeapUp(int pos)
+{
+	int n = SleepHeap[pos];
+
+	while (pos > 0)
+	{
+		int parent = (pos - 1) / 2;
+
+		if (!WakesBefore(n, SleepHeap[parent]))
+			break;
+
+		HeapSet(pos, SleepHeap[parent]);
+		pos = parent;
+	}
+
+	HeapSet(pos, n);
+}
+
+static void HeapDown(int pos)
+{
+	int n = SleepHeap[pos];
+
+	for(;;)
+	{
+		int child = pos * 2 + 1;
+
+		if (child >= SleepCount)
+			break;
+
+		if (child + 1 < SleepCount && WakesBefore(SleepHeap[child + 1], SleepHeap[child]))
+			child++;
+
+		if (!WakesBefore(SleepHeap[child], n))
+			break;
+
+		HeapSet(pos, SleepHeap[child]);
+		pos = child;
+	}
+
+	HeapSet(pos, n);
+}
+
+static void HeapPush(int n)
+{
+	TaskData[n].State = TASK_SLEEPING;
+	HeapSet(SleepCount++, n);
+	HeapUp(SleepCount - 1);
+}
+
+static void HeapRemove(int n)
+{
+	int pos = TaskData[n].HeapPos;
+
+	SleepCount--;
+
+	if (pos == SleepCount)
+		return;
+
+	HeapSet(pos, SleepHeap[SleepCount]);
+	HeapUp(pos);
+	HeapDown(TaskData[SleepHeap[pos]].HeapPos);
+}
+
+static void WakeSleepingTasks(int now)
+{
+	while (SleepCount > 0 && TaskData[SleepHeap[0]].WakeTime - now <= 0)
+	{
+		int n = SleepHeap[0];
+
+		HeapRemove(n);
+		ReadyPush(n);
+	}
+}
+
 //***************************************
 //		Initialise task entrys
 //***************************************
 
 int InitTasks(int max_tasks)
 {
-	TaskEntry	*Task;
 	long n;
 
 	TaskData = (TaskEntry *) malloc(max_tasks * sizeof(TaskEntry));
+	SleepHeap = (int *) malloc(max_tasks * sizeof(int));
 
-	if (!TaskData)
+	if (!TaskData || !SleepHeap)
+	{
+		free(TaskData);
+		free(SleepHeap);
+		TaskData = 0;
+		SleepHeap = 0;
 		return 0;
+	}
 
-	Task = TaskData;
+	// All entries start out in the free list.
 
-	for(n=0;n<MAXTASK;n++)
+	for(n=0;n<max_tasks;n++)
 	{
-		Task->SP		= 0;
-		Task->StackBase	= 0;
-		Task++;
+		TaskData[n].SP			= 0;
+		TaskData[n].StackBase	= 0;
+		TaskData[n].State		= TASK_FREE;
+		TaskData[n].Next		= (n + 1 < max_tasks) ? n + 1 : -1;
 	}
 
+	MaxTasks = max_tasks;
+	FreeHead = max_tasks > 0 ? 0 : -1;
+	ReadyHead = ReadyTail = -1;
+	ReadyCount = 0;
+	SleepCount = 0;
+
 	TaskCount = 0;
+	CurrentRunningTask = -1;
 	DefaultStackSize = DEFAULT_STACK_SIZE;
 	return 1;
 }
@@ -312,15 +477,21 @@ int InitTasks(int max_tasks)
 
 void DisposeTasks(void)
 {
-	short	n;
+	int	n;
 
-	for(n=0;n<MAXTASK;n++)
+	for(n=0;n<MaxTasks;n++)
 		DisposeTask(n);
 
 	if (TaskData)
 		free((char *) TaskData);
 
+	if (SleepHeap)
+		free((char *) SleepHeap);
+
 	TaskData = 0;
+	SleepHeap = 0;
+	MaxTasks = 0;
+	FreeHead = -1;
 
 	TaskCount = 0;
 }
@@ -335,11 +506,27 @@ void DisposeTask(short task)
 
 	Task = &TaskData[task];
 
-	if (Task->SP)
-		free((char *)Task->StackBase);
+	switch (Task->State)
+	{
+	case TASK_FREE:
+		return;
+	case TASK_READY:
+		ReadyRemove(task);
+		break;
+	case TASK_SLEEPING:
+		HeapRemove(task);
+		break;
+	}
+
+	free((char *)Task->StackBase);
 
 	Task->SP		= 0;
 	Task->StackBase = 0;
+	Task->State		= TASK_FREE;
+	Task->Next		= FreeHead;
+	FreeHead		= task;
+
+	TaskCount--;
 }
 
 //***************************************
@@ -352,6 +539,45 @@ void SetTaskStackSize(int size)
 		DefaultStackSize = size;
 }
 
+//***************************************
+//	   Switch to a task and back
+//***************************************
+
+static void RunTask(int n)
+{
+	TaskEntry	*Task = &TaskData[n];
+	int			sp;
+
+	Task->State = TASK_RUNNING;
+	CurrentRunningTask = n;
+
+	if (Task->Started)
+	{
+		sp = maRunTask(Task->SP);
+	}
+	else
+	{
+		Task->Started = 1;
+		sp = maRunTaskInit(Task->SP, Task->P0, Task->P1);
+	}
+
+	CurrentRunningTask = -1;
+
+	if (!sp)						// Check if Task killed
+	{
+		DisposeTask(n);
+		return;
+	}
+
+	Task->SP = sp;
+
+	// A task that called maYield() runs again after the other ready tasks.
+	// SleepTask() and BlockTask() have already changed the state.
+
+	if (Task->State == TASK_RUNNING)
+		ReadyPush(n);
+}
+
 //***************************************
 //		  Create a new task
 //***************************************
@@ -361,23 +587,17 @@ long CreateTask(char *TaskAddr, int p0, int p1)
 	TaskEntry	*Task;
 	TaskStack	*NewStack;
 	char		*mem;
-	int			n,Old;
+	int			n;
 
-	// Search for free task buffer
+	// Take a free task buffer
 
-	Task = TaskData;
+	n = FreeHead;
 
-	for(n=0;n<MAXTASK;n++)
-	{
-		if (Task->SP == 0)
-			break;
-
-		Task++;
-	}
-
-	if (n == MAXTASK)
+	if (n < 0)
 		return -1;
 
+	Task = &TaskData[n];
+
 	// Set start of execution and clear backchannel
 
 	mem = (char *) malloc(DefaultStackSize);
@@ -385,25 +605,28 @@ long CreateTask(char *TaskAddr, int p0, int p1)
 	if (!mem)
 		return -1;
 
-	NewStack = (TaskStack *) (mem + DefaultStackSize - sizeof(TaskStack) - 16);
+	FreeHead = Task->Next;
 
-//	NewStack = (TaskStack *) (mem + (DefaultStackSize / 2));
+	NewStack = (TaskStack *) (mem + DefaultStackSize - sizeof(TaskStack) - 16);
 
 	Task->StackBase	= (int)	mem;
 	Task->SP		= (int) NewStack ;
+	Task->Started	= 0;
+	Task->P0		= p0;
+	Task->P1		= p1;
 	NewStack->rt	= (int) TaskAddr;
+	memset(Task->Local, 0, sizeof(Task->Local));
 
 	TaskCount++;									// Add new task to count
 
-	Old = CurrentRunningTask;						// Save the current task num
-
-	CurrentRunningTask = n;							// Set the new task num
+	// A task started from another task would overwrite the main context,
+	// so it waits for RunAllTasks() instead.
 
-	// Run the task
+	if (CurrentRunningTask >= 0)
+		ReadyPush(n);
+	else
+		RunTask(n);
 
-	Task->SP = (int) maRunTaskInit(Task->SP, p0, p1);
-
-	CurrentRunningTask = Old;						// Restore our task num
 	return n;
 }
 
@@ -413,26 +636,121 @@ long CreateTask(char *TaskAddr, int p0, int p1)
 
 void RunAllTasks(void)
 {
-	TaskEntry	*Task;
-	short	n;
+	int	count;
 
-	Task = &TaskData[0];
+	WakeSleepingTasks(maGetMilliSecondCount());
 
-	for(n=0;n<MAXTASK;n++)
+	// Tasks that become ready while this runs wait for the next call.
+
+	count = ReadyCount;
+
+	while (count-- > 0 && ReadyHead >= 0)
+	{
+		int n = ReadyHead;
+
+		ReadyRemove(n);
+		RunTask(n);
+	}
+}
+
+//***************************************
+//	   Wait for the next task to run
+//***************************************
+
+void WaitForTasks(void)
+{
+	int timeout = 0;
+
+	if (ReadyHead >= 0)
+		return;
+
+	if (SleepCount > 0)
 	{
-		if (Task->SP)
-		{
-			CurrentRunningTask = n;
-			Task->SP = (int) maRunTask(Task->SP);
-
-			if (!Task->SP)			// Check if Task killed
-			{
-				TaskCount--;										// One less task active
-				DisposeTask(CurrentRunningTask);
-			}
-		}
-
-		Task++;
+		timeout = TaskData[SleepHeap[0]].WakeTime - maGetMilliSecondCount();
+
+		if (timeout <= 0)
+			return;
 	}
+
+	maWait(timeout);
+}
+
+//***************************************
+//	  Sleeping and blocking tasks
+//***************************************
+
+int SleepTask(int ms)
+{
+	TaskEntry *Task;
+
+	// The main context has no task entry and can't yield.
+
+	if (CurrentRunningTask < 0)
+		return 0;
+
+	Task = &TaskData[CurrentRunningTask];
+	Task->WakeTime = maGetMilliSecondCount() + ms;
+	HeapPush(CurrentRunningTask);
+	maYield();
+	return 1;
 }
 
+int BlockTask(void)
+{
+	if (CurrentRunningTask < 0)
+		return 0;
+
+	TaskData[CurrentRunningTask].State = TASK_BLOCKED;
+	maYield();
+	return 1;
+}
+
+int WakeTask(int task)
+{
+	TaskEntry *Task;
+
+	if (task < 0 || task >= MaxTasks)
+		return 0;
+
+	Task = &TaskData[task];
+
+	if (Task->State == TASK_SLEEPING)
+		HeapRemove(task);
+	else if (Task->State != TASK_BLOCKED)
+		return 0;
+
+	ReadyPush(task);
+	return 1;
+}
+
+int GetTaskCount(void)
+{
+	return TaskCount;
+}
+
+int GetCurrentTask(void)
+{
+	return CurrentRunningTask;
+}
+
+//***************************************
+//		  Task-local storage
+//***************************************
+
+static void **LocalSlots(void)
+{
+	if (CurrentRunningTask >= 0)
+		return TaskData[CurrentRunningTask].Local;
+
+	return MainLocal;
+}
+
+void SetTaskLocal(int slot, void *value)
+{
+	LocalSlots()[slot] = value;
+}
+
+void *GetTaskLocal(int slot)
+{
+	return LocalSlots()[slot];
+}
@@ -31,6 +31,10 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 extern "C" {
 #endif
 
+/** \brief The number of task-local storage slots of each task.
+*/
+
+#define TASK_LOCAL_SLOTS 4
 
 // ASM function proto's
 
@@ -69,16 +73,81 @@ void SetTaskStackSize(int size);
 * \param TaskAddr The address of the new task
 * \param p0 The first parameter to be passed to the new task
 * \param p1 The second parameter to be passed to the new task
-* \return Returns a positive taskid if all was well, null on error.
+* \return Returns a positive taskid if all was well, -1 on error.
+*
+* Called from outside of tasks, the new task runs at once until it first yields.
+* Called from a task, the new task is started by the next RunAllTasks().
 */
 
 long CreateTask(char *TaskAddr, int p0, int p1);
 
 /** \brief Execute all cooperative tasks
+*
+* Wakes the sleeping tasks that are due, then runs each ready task once,
+* in the order they became ready. Blocked tasks are skipped.
 */
 
 void RunAllTasks(void);
 
+/** \brief Waits until a task is ready to run
+*
+* Returns at once if a task is ready. Otherwise calls maWait() with the time
+* until the next sleeping task is due, or without a timeout if no task is
+* sleeping, so that a program can do
+* \code
+* for(;;) { WaitForTasks(); RunAllTasks(); <handle events> }
+* \endcode
+* without busy-waiting.
+*/
+
+void WaitForTasks(void);
+
+/** \brief Suspends the current task for at least \a ms milliseconds
+* \param ms The time to sleep.
+* \return Returns FALSE, without sleeping, if not called from a task.
+*/
+
+int SleepTask(int ms);
+
+/** \brief Suspends the current task until WakeTask() is called on it
+* \return Returns FALSE, without blocking, if not called from a task.
+*/
+
+int BlockTask(void);
+
+/** \brief Makes a sleeping or blocked task ready to run
+* \param task The task to wake.
+* \return Returns TRUE if the task was sleeping or blocked,
+* FALSE if it wasn't or if \a task is not a valid task number.
+*/
+
+int WakeTask(int task);
+
+/** \brief Returns the number of tasks that haven't ended
+*/
+
+int GetTaskCount(void);
+
+/** \brief Returns the id of the running task, or -1 outside of tasks
+*/
+
+int GetCurrentTask(void);
+
+/** \brief Sets a task-local value of the current task
+* \param slot The slot to set, 0 to TASK_LOCAL_SLOTS - 1.
+* \param value The new value. The slots of a new task are NULL.
+*
+* Outside of tasks, a separate set of slots is used.
+*/
+
+void SetTaskLocal(int slot, void *value);
+
+/** \brief Returns a task-local value of the current task
+* \param slot The slot to get, 0 to TASK_LOCAL_SLOTS - 1.
+*/
+
+void *GetTaskLocal(int slot);
+
 #ifdef __cplusplus
 }	//extern "C"
 #endif
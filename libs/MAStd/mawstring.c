@@ -21,6 +21,21 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #ifdef MAPIP
 
+// Defined in mastring.c.
+BOOL mastdNativeStrings(void);
+
+// Shorter strings are faster to handle in bytecode, as in mastring.c.
+#define NATIVE_MEM_MIN 16
+
+// Returns the length of s if it is shorter than NATIVE_MEM_MIN,
+// otherwise NATIVE_MEM_MIN.
+static size_t shortWcslen(const wchar *s)
+{
+	size_t n = 0;
+	while (n < NATIVE_MEM_MIN && s[n]) n++;
+	return n;
+}
+
 #ifndef NO_BUILTINS
 
 wchar *wcsncpy(wchar *dest, const wchar *source, size_t count)
@@ -305,6 +320,12 @@ wchar *wcsrev(wchar *s)
 size_t wcslen(const wchar *s)
 {
 	const wchar *eos = s;
+	if(mastdNativeStrings()) {
+		size_t n = shortWcslen(s);
+		if(n < NATIVE_MEM_MIN)
+			return n;
+		return n + maWcslen((MAAddress)(s + n));
+	}
 	while (*eos++);
 	return (int) (eos - s - 1);
 }
@@ -312,6 +333,8 @@ size_t wcslen(const wchar *s)
 int wcscmp(const wchar *s1, const wchar *s2)
 {
 	int ret = 0;
+	if(mastdNativeStrings() && shortWcslen(s1) == NATIVE_MEM_MIN)
+		return maWcscmp((MAAddress)s1, (MAAddress)s2);
 	while (!(ret = *(wchar *) s1 - *(wchar *) s2) && *s2) ++s1, ++s2;
 
 	if (ret < 0)
@@ -325,6 +348,12 @@ int wcscmp(const wchar *s1, const wchar *s2)
 wchar *wcscat(wchar *dst, const wchar *src)
 {
 	wchar *cp = dst;
+	if(mastdNativeStrings() && (shortWcslen(dst) == NATIVE_MEM_MIN ||
+		shortWcslen(src) == NATIVE_MEM_MIN))
+	{
+		maWcscpy(dst + wcslen(dst), (MAAddress)src);
+		return dst;
+	}
 	while (*cp) cp++;
 	while ((*cp++ = *src++));
 	return dst;
@@ -583,6 +583,29 @@ size_t get_max_size(void *mem_pool)
 #endif
 }
 
+/******************************************************************/
+size_t get_largest_free_size(void *mem_pool)
+{
+/******************************************************************/
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    bhdr_t *b;
+    size_t size, largest = 0;
+    int fl, sl;
+
+    if (!tlsf->fl_bitmap)
+        return 0;
+
+    /* The largest free block is in the highest non-empty list */
+    fl = ms_bit(tlsf->fl_bitmap);
+    sl = ms_bit(tlsf->sl_bitmap[fl]);
+    for (b = tlsf->matrix[fl][sl]; b; b = b->ptr.free_ptr.next) {
+        size = b->size & BLOCK_SIZE;
+        if (size > largest)
+            largest = size;
+    }
+    return largest;
+}
+
 /******************************************************************/
 void destroy_memory_pool(void *mem_pool)
 {
@@ -858,6 +881,8 @@ void *realloc_ex(void *ptr, size_t new_size, void *mem_pool)
     }
 
     ptr_aux = malloc_ex(new_size, mem_pool);
+    if (!ptr_aux)
+        return NULL;
 
     cpsize = ((b->size & BLOCK_SIZE) > new_size) ? new_size : (b->size & BLOCK_SIZE);
 
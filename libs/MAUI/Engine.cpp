@@ -26,6 +26,8 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 //#define PUSH_EMPTY_CLIPRECT pushClipRect(0,0,0,0)
 
 #define EXTENT(x, y) ((MAExtent)((((int)(x)) << 16) | ((y) & 0xFFFF)))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
 
 namespace MAUI {
 	Engine* Engine::singletonPtr = 0;
@@ -36,6 +38,8 @@ namespace MAUI {
 		defaultFont = NULL;
 		defaultSkin = NULL;
 		overlay = NULL;
+		numDamageRects = 0;
+		partialRepaint = true;
 		singletonPtr = this;
 		//clipStackPtr = -1;
 		Environment::getEnvironment().addFocusListener(this);
@@ -44,6 +48,7 @@ namespace MAUI {
 	void Engine::setMain(Widget* main) {
 		main->setPosition(main->getPosition().x, main->getPosition().y);
 		this->main = main;
+		invalidateAll();
 	}
 
 	Engine::~Engine()
@@ -172,42 +177,129 @@ namespace MAUI {
 	}
 
 	void Engine::focusGained() {
-		requestUIUpdate();
+		invalidateAll();
 	}
 
 	void Engine::requestUIUpdate() {
 		Environment::getEnvironment().addIdleListener(this);
 	}
+
+	static int area(const Rect& r) {
+		return r.width * r.height;
+	}
+
+	static Rect unite(const Rect& a, const Rect& b) {
+		int left = MIN(a.x, b.x);
+		int top = MIN(a.y, b.y);
+		int right = MAX(a.x + a.width, b.x + b.width);
+		int bottom = MAX(a.y + a.height, b.y + b.height);
+		return Rect(left, top, right - left, bottom - top);
+	}
+
+	void Engine::invalidate(const Rect& rect) {
+		requestUIUpdate();
+
+		MAExtent scrSize = maGetScrSize();
+		int left = MAX(rect.x, 0);
+		int top = MAX(rect.y, 0);
+		int right = MIN(rect.x + rect.width, EXTENT_X(scrSize));
+		int bottom = MIN(rect.y + rect.height, EXTENT_Y(scrSize));
+		if(left >= right || top >= bottom)
+			return;
+		Rect r(left, top, right - left, bottom - top);
+
+		// Absorb every rect that the union would not waste area on,
+		// which includes all rects that touch or contain each other.
+		for(int i = 0; i < numDamageRects; ) {
+			Rect u = unite(damage[i], r);
+			if(area(u) <= area(damage[i]) + area(r)) {
+				r = u;
+				damage[i] = damage[--numDamageRects];
+				i = 0;
+			} else {
+				i++;
+			}
+		}
+
+		if(numDamageRects == MAX_DAMAGE_RECTS) {
+			int best = 0;
+			int bestGrowth = 0x7fffffff;
+			for(int i = 0; i < numDamageRects; i++) {
+				int growth = area(unite(damage[i], r)) - area(damage[i]);
+				if(growth < bestGrowth) {
+					bestGrowth = growth;
+					best = i;
+				}
+			}
+			Rect u = unite(damage[best], r);
+			damage[best] = damage[--numDamageRects];
+			invalidate(u);
+			return;
+		}
+
+		damage[numDamageRects++] = r;
+	}
+
+	void Engine::invalidate(const Widget* root, const Rect& rect) {
+		if(root == main) {
+			invalidate(rect);
+		} else if(overlay && root == overlay) {
+			invalidate(Rect(rect.x + overlayPosition.x, rect.y + overlayPosition.y,
+				rect.width, rect.height));
+		} else {
+			requestUIUpdate();
+		}
+	}
+
+	void Engine::invalidateAll() {
+		MAExtent scrSize = maGetScrSize();
+		numDamageRects = 0;
+		invalidate(Rect(0, 0, EXTENT_X(scrSize), EXTENT_Y(scrSize)));
+	}
+
+	void Engine::setPartialRepaintEnabled(bool enabled) {
+		partialRepaint = enabled;
+		invalidateAll();
+	}
 	
 	void Engine::repaint() {
 		//lprintfln("repaint @ (%i ms)", maGetMilliSecondCount());
 		if(!main) return;
 		//printf("doing repaint!");
-		
-		Gfx_beginRendering();
-		
-		//clearClipRect();
-		Gfx_clearClipRect();
-		Gfx_clearMatrix();
 
-		
-		int scrW = EXTENT_X(maGetScrSize());
-		int scrH = EXTENT_Y(maGetScrSize());
-		//printf("screenSize: (%d, %d)\n", scrW, scrH);
-		Gfx_pushClipRect(0, 0, scrW, scrH);
+		// update() may move widgets around, which adds damage.
 		main->update();
-		main->draw();
-		Gfx_popClipRect();
+		if(overlay)
+			overlay->update();
 
-		if(overlay) {
+		if(!partialRepaint)
+			invalidateAll();
+		if(numDamageRects == 0)
+			return;
+
+		// Widgets that request a repaint while drawing get it in the next frame.
+		Rect rects[MAX_DAMAGE_RECTS];
+		int numRects = numDamageRects;
+		for(int i = 0; i < numRects; i++)
+			rects[i] = damage[i];
+		numDamageRects = 0;
+
+		Gfx_beginRendering();
+
+		for(int i = 0; i < numRects; i++) {
+			//clearClipRect();
 			Gfx_clearClipRect();
 			Gfx_clearMatrix();
-			Gfx_pushClipRect(0, 0, scrW, scrH);
 
-			overlay->requestRepaint();
-			Gfx_translate(overlayPosition.x, overlayPosition.y);
-			overlay->update();
-			overlay->draw();
+			Gfx_pushClipRect(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+			main->draw();
+
+			if(overlay) {
+				Gfx_translate(overlayPosition.x, overlayPosition.y);
+				overlay->draw();
+				Gfx_clearMatrix();
+			}
+			Gfx_popClipRect();
 		}
 
 		//maUpdateScreen();
@@ -236,17 +328,21 @@ namespace MAUI {
 	/* shows the overlay widget (passed as an argument). Put the top left
 	corner at position x and y. */
 	void Engine::showOverlay(int x, int y, Widget *overlay) {
+		if(this->overlay)
+			hideOverlay();
 		overlayPosition.x = x; 
 		overlayPosition.y = y;
 		this->overlay = overlay;
 		overlay->requestRepaint();
-		main->requestRepaint();
 	}
 		
 	/* hide the currently shown overlay. */
 	void Engine::hideOverlay() {
+		if(!overlay)
+			return;
+		// the area under the overlay
+		overlay->requestRepaint();
 		overlay = NULL;
-		main->requestRepaint();
 	}
 
 }
@@ -41,7 +41,8 @@ namespace MAUI {
 	class Engine : public IdleListener, public FocusListener {
 	public:
 		enum {
-			MAX_WIDGET_DEPTH = 16
+			MAX_WIDGET_DEPTH = 16,
+			MAX_DAMAGE_RECTS = 8
 		};
 
 		/** Sets the widget that is main to the application, constituting the root of the UI tree **/
@@ -68,9 +69,31 @@ namespace MAUI {
 		void idle();
 		
 		/** Widgets call this function when they require repainting. It will cause 
-		  * any dirty widgets to be redrawn in the next iteration of the event loop.
+		  * any damaged areas to be redrawn in the next iteration of the event loop.
 		  **/
 		void requestUIUpdate();
+
+		/** Marks a rectangle of the screen as damaged and requests a UI update.
+		  * repaint() only redraws the widgets that intersect a damaged rectangle,
+		  * clipped to it. Overlapping rectangles are merged, and when there are
+		  * too many the two closest are merged.
+		  **/
+		void invalidate(const Rect& rect);
+
+		/** Marks \a rect, in the absolute coordinates of the widget tree
+		  * rooted at \a root, as damaged. Nothing happens if the tree is not
+		  * shown. Called by Widget::requestRepaint().
+		  **/
+		void invalidate(const Widget* root, const Rect& rect);
+
+		/** Marks the whole screen as damaged. **/
+		void invalidateAll();
+
+		/** Enables or disables partial repaint. It is enabled by default.
+		  * Disable it if the graphics driver does not keep the contents of the
+		  * screen between frames, which makes every repaint redraw the whole screen.
+		  **/
+		void setPartialRepaintEnabled(bool enabled=true);
 		
 		// added this because graphics can be invalidated on some devices when the focus is lost...
 		void focusLost();
@@ -106,6 +129,10 @@ namespace MAUI {
 
 		bool characterInputActive;
 
+		Rect damage[MAX_DAMAGE_RECTS];
+		int numDamageRects;
+		bool partialRepaint;
+
 	private:
 		Engine();
 	};
@@ -16,6 +16,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 */
 
 #include <ma.h>
+#include <mastring.h>
 
 #include "Font.h"
 #include <MAUtil/Graphics.h>
@@ -259,11 +260,49 @@ namespace MAUI {
 		return 1;
 	}
 
+	// Glyphs are collected here and drawn with one Gfx_drawImageRegions() call
+	// per batch, instead of one Gfx_drawImageRegion() call per character.
+	#define GLYPH_BATCH_SIZE 128
+	static MAImageRegion sGlyphs[GLYPH_BATCH_SIZE];
+	static int sNumGlyphs = 0;
+
+	static void flushGlyphs(MAHandle image) {
+		if(sNumGlyphs > 0) {
+			Gfx_drawImageRegions(image, sGlyphs, sNumGlyphs);
+			sNumGlyphs = 0;
+		}
+	}
+
+	static void addGlyph(MAHandle image, const CharDescriptor& c, int x, int y) {
+		// Glyphs without pixels, like space, need not be drawn.
+		if(c.width == 0 || c.height == 0)
+			return;
+		if(sNumGlyphs == GLYPH_BATCH_SIZE)
+			flushGlyphs(image);
+		MAImageRegion& r(sGlyphs[sNumGlyphs++]);
+		r.srcRect.left = c.x;
+		r.srcRect.top = c.y;
+		r.srcRect.width = c.width;
+		r.srcRect.height = c.height;
+		r.dstPoint.x = x + c.xOffset;
+		r.dstPoint.y = y + c.yOffset;
+	}
+
+	// The input of the last calcLineBreaks() call. lineBreaks only depend on
+	// the font, the text, the start x and the right edge of the bound, and
+	// widgets usually measure and draw the same text several times per frame.
+	static const Font* sLayoutFont = NULL;
+	static int sLayoutX, sLayoutRight;
+	static char* sLayoutText = NULL;
+	static int sLayoutTextSize = 0;
+
 	Font::Font(MAHandle font) : mFontImage(0), mCharset(NULL), mLineSpacing(0) {
 		setResource(font);
 	}
 
 	Font::~Font() {
+		if(sLayoutFont == this)
+			sLayoutFont = NULL;
 		if(mFontImage) {
 			maDestroyPlaceholder(mFontImage);
 		}
@@ -288,6 +327,8 @@ namespace MAUI {
 
 	void Font::setResource(MAHandle font) {
 		//printf("Font is using resource: %d\n", font);
+		if(sLayoutFont == this)
+			sLayoutFont = NULL;
 		if(font == 0) {
 			mFontImage = 0;
 			return;
@@ -349,7 +390,6 @@ namespace MAUI {
 	void Font::drawString(const char* strS, int x, int y) {
 		if(!mFontImage) return;
 		const unsigned char* str = (const unsigned char*)strS;
-		MARect srcRect = {0, 0, 0, 0};
 		MAPoint2d cursor = {x,y};
 
 		CharDescriptor *chars = mCharset->chars;
@@ -362,26 +402,25 @@ namespace MAUI {
 				continue;
 			}
 
-			srcRect.left = chars[*str].x;
-			srcRect.top = chars[*str].y;
-			srcRect.width = chars[*str].width;
-			srcRect.height = chars[*str].height;
-
-			MAPoint2d destPoint = {cursor.x + chars[*str].xOffset,
-				cursor.y + chars[*str].yOffset};
-
-			//maDrawImageRegion(this->mFontImage, &srcRect, &destPoint, 0);
-			Gfx_drawImageRegion(this->mFontImage, &srcRect, &destPoint, 0);
+			addGlyph(mFontImage, chars[*str], cursor.x, cursor.y);
 
 			cursor.x += chars[*str].xAdvance;
 			str++;
 		}
+		flushGlyphs(mFontImage);
 	}
 
 	short lineBreaks[2048]; // TODO: should probably change this to a vector (no good with limitations)
 	int numLineBreaks;
 
 	void Font::calcLineBreaks(const char* strS, int x, int y, const Rect& bound) const {
+		int right = bound.x + bound.width;
+		if(sLayoutFont == this && sLayoutX == x && sLayoutRight == right &&
+			strcmp(sLayoutText, strS) == 0)
+		{
+			return;
+		}
+
 		int i = 0;
 		int j = 0;
 		int lastSpace = -1;
@@ -418,6 +457,16 @@ namespace MAUI {
 		}
 		numLineBreaks = j;
 		lineBreaks[j] = -1;
+
+		if(i >= sLayoutTextSize) {
+			delete[] sLayoutText;
+			sLayoutTextSize = i + 1 > 64 ? i + 1 : 64;
+			sLayoutText = new char[sLayoutTextSize];
+		}
+		memcpy(sLayoutText, strS, i + 1);
+		sLayoutFont = this;
+		sLayoutX = x;
+		sLayoutRight = right;
 	}
 
 	void Font::drawBoundedString(const char* strS, int x, int y, const Rect& bound) {
@@ -426,7 +475,6 @@ namespace MAUI {
 		if(!mFontImage) return;
 		const unsigned char* str = (const unsigned char*)strS;
 		calcLineBreaks(strS, x, y, bound);
-		MARect srcRect = {0, 0, 0, 0};
 		MAPoint2d cursor = {x, y};
 		CharDescriptor *chars = mCharset->chars;
 		while(str[i]) {
@@ -440,20 +488,12 @@ namespace MAUI {
 				}
 			}
 
-			srcRect.left = chars[str[i]].x;
-			srcRect.top = chars[str[i]].y;
-			srcRect.width = chars[str[i]].width;
-			srcRect.height = chars[str[i]].height;
-
-			MAPoint2d destPoint = {cursor.x + chars[str[i]].xOffset,
-				cursor.y + chars[str[i]].yOffset};
-
-			//maDrawImageRegion(this->mFontImage, &srcRect, &destPoint, 0);
-			Gfx_drawImageRegion(this->mFontImage, &srcRect, &destPoint, 0);
+			addGlyph(mFontImage, chars[str[i]], cursor.x, cursor.y);
 
 			cursor.x += chars[str[i]].xAdvance;
 			i++;
 		}
+		flushGlyphs(mFontImage);
 	}
 
 	MAExtent Font::getStringDimensions(const char *strS, int length) const {
@@ -224,6 +224,13 @@ namespace MAUI {
 		return yOffset>>16;
 	}
 
+	Point ListBox::getChildrenOffset() const {
+		if(orientation == LBO_VERTICAL)
+			return Point(0, yOffset>>16);
+		else
+			return Point(yOffset>>16, 0);
+	}
+
 	void ListBox::update() {
 		Widget::update();	
 		if(mustRebuild) rebuild();
@@ -262,7 +269,9 @@ namespace MAUI {
 			BOOL res = Gfx_intersectClipRect(0, 0, bounds.width, bounds.height);
 
 			if(res) {
-				if((isDirty() || forceDraw) && shouldDrawBackground) {
+				// Items hidden behind an opaque item are not drawn.
+				int first = findCoveringChild(paddingLeft, paddingTop);
+				if(first < 0 && shouldDrawBackground) {
 					drawBackground();
 				}
 
@@ -278,7 +287,7 @@ namespace MAUI {
 				if(res) 
 				{	
 					srand(1);
-					for(i = 0; i < children.size(); i++)
+					for(i = (first < 0 ? 0 : first); i < children.size(); i++)
 					{
 						/**
 						 * The check wether the child should be drawn or
@@ -318,7 +327,9 @@ namespace MAUI {
 
 			if(res) 
 			{
-				if((isDirty() || forceDraw) && shouldDrawBackground) {
+				// Items hidden behind an opaque item are not drawn.
+				int first = findCoveringChild(paddingLeft, paddingTop);
+				if(first < 0 && shouldDrawBackground) {
 					drawBackground();
 				}
 	
@@ -332,7 +343,7 @@ namespace MAUI {
 				MAPoint2d translation = Gfx_getTranslation();
 				if(res) 
 				{
-					for(i = 0; i < children.size(); i++)
+					for(i = (first < 0 ? 0 : first); i < children.size(); i++)
 					{
 						/**
 						 * The check wether the child should be drawn or
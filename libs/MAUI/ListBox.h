@@ -156,6 +156,9 @@ namespace MAUI {
 
 		void drawWidget();
 
+		/** Returns the scroll offset, which moves the children when they are drawn. **/
+		Point getChildrenOffset() const;
+
 		bool mustRebuild;
 		void rebuild();
 
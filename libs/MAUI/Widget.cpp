@@ -152,7 +152,10 @@ namespace MAUI {
 		
 		if(res) 
 		{
-			if(isDirty() || forceDraw) 
+			// The Engine clips to the damaged area, so everything inside the
+			// clip rect must be redrawn, even if this widget is not dirty.
+			int first = findCoveringChild(paddingLeft, paddingTop);
+			if(first < 0) 
 			{
 				if(shouldDrawBackground) 
 				{
@@ -166,10 +169,12 @@ namespace MAUI {
 
 			if(res) {
 
-				if(isDirty() || forceDraw) 
+				if(first < 0) {
 					drawWidget();
-				Vector_each(Widget*, it, children)
-					(*it)->draw();	
+					first = 0;
+				}
+				for(int i = first; i < children.size(); i++)
+					children[i]->draw();
 
 			}
 
@@ -184,6 +189,9 @@ namespace MAUI {
 
 	void Widget::setPosition(int x, int y) {
 		bool changed = relX != x || relY != y;
+		// the area the widget moves away from
+		if(changed)
+			requestRepaint();
 		relX = x;
 		relY = y;
 		updateAbsolutePosition();
@@ -208,6 +216,8 @@ namespace MAUI {
 
 	void Widget::setWidth(int width) {
 		bool changed = width != bounds.width;
+		if(changed)
+			requestRepaint();
 		bounds.width = width;
 		updatePaddedBounds();
 		requestRepaint();
@@ -222,6 +232,8 @@ namespace MAUI {
 
 	void Widget::setHeight(int height) {
 		bool changed = height != bounds.height;
+		if(changed)
+			requestRepaint();
 		bounds.height = height;
 		updatePaddedBounds();
 		requestRepaint();
@@ -267,14 +279,68 @@ namespace MAUI {
 	}
 
 	void Widget::requestRepaint() {
-		Engine::getSingleton().requestUIUpdate();
 		setDirty();
 
-		if(isTransparent()) {
-			if(parent) {
-				parent->requestRepaint();
+		// Clip the bounds to the padded bounds of all ancestors, moving
+		// them by the children offset of each, to get the visible area.
+		int left = bounds.x, top = bounds.y;
+		int right = left + bounds.width, bottom = top + bounds.height;
+		const Widget* root = this;
+		for(const Widget* p = parent; p; p = p->parent) {
+			Point offset = p->getChildrenOffset();
+			left += offset.x;
+			right += offset.x;
+			top += offset.y;
+			bottom += offset.y;
+
+			const Rect& pb = p->paddedBounds;
+			if(left < pb.x) left = pb.x;
+			if(top < pb.y) top = pb.y;
+			if(right > pb.x + pb.width) right = pb.x + pb.width;
+			if(bottom > pb.y + pb.height) bottom = pb.y + pb.height;
+			root = p;
+		}
+
+		Engine::getSingleton().invalidate(root, Rect(left, top, right - left, bottom - top));
+	}
+
+	Point Widget::getChildrenOffset() const {
+		return Point(0, 0);
+	}
+
+	int Widget::findCoveringChild(int x, int y) const {
+		MARect clip;
+		if(!Gfx_getClipRect(&clip))
+			return -1;
+
+		// Children are also clipped to the padded bounds.
+		MAPoint2d t = Gfx_getTranslation();
+		x += t.x;
+		y += t.y;
+		if(clip.left < x || clip.top < y ||
+			clip.left + clip.width > x + paddedBounds.width ||
+			clip.top + clip.height > y + paddedBounds.height)
+		{
+			return -1;
+		}
+
+		Point offset = getChildrenOffset();
+		x += offset.x;
+		y += offset.y;
+		for(int i = children.size() - 1; i >= 0; i--) {
+			const Widget* c = children[i];
+			if(!c->enabled || c->isTransparent())
+				continue;
+			int cx = x + c->relX;
+			int cy = y + c->relY;
+			if(cx <= clip.left && cy <= clip.top &&
+				cx + c->bounds.width >= clip.left + clip.width &&
+				cy + c->bounds.height >= clip.top + clip.height)
+			{
+				return i;
 			}
 		}
+		return -1;
 	}
 
 	bool Widget::isDirty() const {
@@ -161,6 +161,8 @@ namespace MAUI {
 
 		/** 
 		 * Renders the Widget and all its children recursively.
+		 * Everything inside the current clip rect is drawn, except what
+		 * is hidden behind an opaque child.
 		 */
 		virtual void draw(bool forceDraw=false);
 
@@ -172,10 +174,10 @@ namespace MAUI {
 		virtual void update();
 
 		/** 
-		 * Registers an idle listener with the current environment that will
-		 * redraw the widget and anything else that may be made dirty by
-		 * doing so. For instance, if the widget is transparent its parent
-		 * also has to be repainted, and so on recursively.
+		 * Marks the visible part of the widget as damaged in the Engine and
+		 * registers an idle listener with the current environment that will
+		 * redraw it. Only the widgets that intersect the damaged area are
+		 * drawn, so a transparent widget does not repaint all of its parent.
 		 */
 		void requestRepaint();
 
@@ -358,6 +360,21 @@ namespace MAUI {
 		 **/
 		virtual void drawWidget() = 0;
 		void drawBackground();
+
+		/**
+		 * Returns the offset that is added to the positions of the children
+		 * when they are drawn, like the scroll offset of a ListBox.
+		 * The default implementation returns (0, 0).
+		 */
+		virtual Point getChildrenOffset() const;
+
+		/**
+		 * Returns the index of the last enabled, opaque child that covers
+		 * the whole current clip rect, or -1 if there is none. Nothing drawn
+		 * before that child would be visible. \a x and \a y are added to the
+		 * current translation to get the position of the children.
+		 */
+		int findCoveringChild(int x, int y) const;
 		/**
 		 * This function is used to regenerate the absolute positions of each widget
 		 * in the tree. This is done in a depth first manner where each widget takes the
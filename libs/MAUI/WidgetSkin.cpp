@@ -194,9 +194,9 @@ namespace MAUI {
 				iter++;
 			}
 			if(best == sCache.end()) break;
+			totalPixelsInCache-=best->first.w*best->first.h;
 			maDestroyPlaceholder(best->second.image);
 			sCache.erase(best);
-			totalPixelsInCache-=iter->first.w*iter->first.h;
 		}
 	}
 
@@ -216,7 +216,9 @@ namespace MAUI {
 	MAHandle WidgetSkin::getFromCache(const CacheKey& key) {
 		HashMap<CacheKey, CacheElement>::Iterator s = sCache.find(key);
 		if(s == sCache.end()) return 0;
-		else return s->second.image;
+		// keep skins that are drawn every frame from being flushed
+		s->second.lastUsed = maGetMilliSecondCount();
+		return s->second.image;
 
 	}
 
@@ -238,11 +240,11 @@ namespace MAUI {
 			// set malloc handler to null so that we can catch if we're out of heap and write directly to the screen then.
 			malloc_handler mh = set_malloc_handler(NULL);
 			int *data = new int[width*height];
+			set_malloc_handler(mh);
 			if(!data) {
 				drawDirect(x, y, width, height, type);
 				return;
 			}
-			set_malloc_handler(mh);
 			drawToData(data, 0, 0, width, height, type);
 			CacheElement cacheElem;
 
@@ -253,7 +255,7 @@ namespace MAUI {
 				maPanic(1, "Could not create raw image");
 			}
 
-			delete data;
+			delete[] data;
 			cacheElem.lastUsed = maGetMilliSecondCount();
 			cached = cacheElem.image;
 			addToCache(newKey, cacheElem);
@@ -24,7 +24,6 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #include <ma.h>
 #include <maassert.h>
-#include <kazlib/dict.h>
 #include "collection_common.h"
 
 namespace MAUtil {
@@ -40,8 +39,16 @@ namespace MAUtil {
 * It has fairly fast insert, erase and lookup operations. (O(log n), specifically.)
 * It has an Iterator, which allows you to access all elements in order.
 *
-* This particular implementation is built on top of kazlib's dictionary system,
-* which makes it quite small, even when used with multiple data types.
+* This particular implementation is a B-tree. The elements are stored in
+* arrays inside the tree's nodes, rather than in one heap block each,
+* so lookups and iteration touch few cache lines. A small Dictionary is
+* a single node, which is simply a sorted array.
+*
+* \note Because elements are kept in arrays, insert and erase can move
+* other elements. They invalidate all Iterators and all references to
+* elements of the Dictionary, except the Iterator that they return.
+* To erase elements while iterating, continue from the Iterator returned
+* by erase(Iterator), rather than from a copy made before the erase.
 *
 * This class is not meant to be instantiated directly.
 * It is the base class for Set and Map.
@@ -56,9 +63,42 @@ namespace MAUtil {
 template<class Key, class Storage>
 class Dictionary {
 protected:
-	/** \brief Internal storage. */
-	struct DictNode : dnode_t {
-		DictNode(Storage s);
+	enum {
+		/** The maximum number of elements in a node. Must be odd. */
+		NODE_MAX = sizeof(Storage) > 32 ? 7 : 15,
+		/** The minimum number of elements in a node other than the root. */
+		NODE_MIN = NODE_MAX / 2
+	};
+
+	/** \brief Internal storage. A leaf node of the B-tree. */
+	struct DictNode {
+		DictNode(bool isLeaf);
+		Storage* data() { return (Storage*)elements.bytes; }
+		const Storage* data() const { return (const Storage*)elements.bytes; }
+
+		DictNode* parent;
+		/** The index of this node among its parent's children. */
+		int position;
+		int count;
+		bool leaf;
+		union {
+			char bytes[NODE_MAX * sizeof(Storage)];
+			double alignment;
+		} elements;
+	};
+
+	/** \brief Internal storage. A node of the B-tree that has children. */
+	struct DictBranch : DictNode {
+		DictBranch();
+		/** The children on either side of each element. */
+		DictNode* children[NODE_MAX + 1];
+	};
+
+	/** \brief Constructs an element in a node's array. */
+	struct Slot {
+		Slot(const Storage& s) : data(s) {}
+		static void* operator new(size_t, void* p) { return p; }
+		static void operator delete(void*, void*) {}
 		Storage data;
 	};
 public:
@@ -100,8 +140,9 @@ public:
 		Iterator(const Iterator&);
 	protected:
 		DictNode* mNode;
-		dict_t* mDict;
-		Iterator(dict_t*);
+		int mIndex;
+		Dictionary* mDict;
+		Iterator(Dictionary*);
 		friend class Dictionary;
 		friend class ConstIterator;
 	};
@@ -129,8 +170,9 @@ public:
 		ConstIterator(const Iterator&);
 	protected:
 		const DictNode* mNode;
-		const dict_t* mDict;
-		ConstIterator(const dict_t*);
+		int mIndex;
+		const Dictionary* mDict;
+		ConstIterator(const Dictionary*);
 		friend class Dictionary;
 	};
 
@@ -158,12 +200,13 @@ public:
 	bool erase(const Key&);
 	/**
 	* Deletes an element, pointed to by the specified Iterator.
-	* The Iterator is invalidated, so if you want to continue iterating through the Dictionary,
-	* you must use a different Iterator instance.
+	* Returns an Iterator pointing to the element that followed it, or to Dictionary::end().
+	* All other Iterators are invalidated, so if you want to continue iterating through
+	* the Dictionary, you must use the returned Iterator.
 	* \warning If the Iterator is bound to a different Dictionary, or if it
 	* points to end(), the system will crash.
 	*/
-	void erase(Iterator);
+	Iterator erase(Iterator);
 	/**
 	* Returns an Iterator pointing to the first element in the Dictionary.
 	*/
@@ -185,18 +228,52 @@ public:
 	void clear();
 
 protected:
-	dict_t mDict;
+	/** The root node, or NULL if the Dictionary is empty. */
+	DictNode* mRoot;
+	size_t mSize;
+	CompareFunction mCompare;
 	int mKeyOffset;
 
-	//******************************************************************************
-	// DictAllocator
-	//******************************************************************************
+	const Key& keyOf(const Storage& s) const {
+		return *(const Key*)((const char*)&s + mKeyOffset);
+	}
+	static DictNode** children(DictNode* node) { return ((DictBranch*)node)->children; }
+	static const DictNode* const* children(const DictNode* node) {
+		return ((const DictBranch*)node)->children;
+	}
+
+	/**
+	* Searches for \a key. If it's found, returns true, and sets \a node and \a index
+	* to its position. Otherwise, returns false, and sets them to the position in
+	* a leaf where the key would be inserted.
+	*/
+	bool search(const Key& key, DictNode*& node, int& index) const;
+
+	static void construct(Storage* dst, const Storage& src);
+	static void destroy(Storage* s);
+	/** Moves an element to uninitialized memory. */
+	static void move(Storage* dst, Storage* src);
+	static void deleteNode(DictNode* node);
+	void freeTree(DictNode* node);
+	DictNode* cloneTree(const DictNode* src, DictNode* parent, int position);
+
+	void insertAt(DictNode* node, int index, const Storage& data);
+	/** Splits a full node in two, moving its middle element into the parent. */
+	void split(DictNode* node);
+	void eraseAt(DictNode* node, int index);
+	/** Restores the minimum size of \a node after an erase. */
+	void rebalance(DictNode* node);
+	void rotateLeft(DictNode* parent, int index);
+	void rotateRight(DictNode* parent, int index);
+	void merge(DictNode* parent, int index);
 
-#ifdef KAZLIB_OPAQUE_DEBUG
-#error Need full definition of dnode_t
-#endif
+	static void first(const DictNode*& node, int& index);
+	static void last(const DictNode*& node, int& index);
+	static void next(const DictNode*& node, int& index);
+	static void prev(const DictNode*& node, int& index);
 
-	void init(CompareFunction);
+	friend class Iterator;
+	friend class ConstIterator;
 
 	/// Constructs an empty Dictionary.
 	Dictionary(CompareFunction cf, int keyOffset);
@@ -28,44 +28,39 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 //******************************************************************************
 
 template<class Key, class Storage>
-MAUtil::Dictionary<Key, Storage>::DictNode::DictNode(Storage s)
-: data(s)
+MAUtil::Dictionary<Key, Storage>::DictNode::DictNode(bool isLeaf)
+: parent(NULL), position(0), count(0), leaf(isLeaf)
 {
-	memset((dnode_t*)this, 0, sizeof(dnode_t));
 }
 
 template<class Key, class Storage>
-void MAUtil::Dictionary<Key, Storage>::init(CompareFunction cf) {
-	dict_init(&mDict, DICTCOUNT_T_MAX, (dict_comp_t)cf);
+MAUtil::Dictionary<Key, Storage>::DictBranch::DictBranch()
+: DictNode(false)
+{
 }
 
 template<class Key, class Storage>
-MAUtil::Dictionary<Key, Storage>::Dictionary(CompareFunction cf, int keyOffset) {
-	mKeyOffset = keyOffset;
-	init(cf);
+MAUtil::Dictionary<Key, Storage>::Dictionary(CompareFunction cf, int keyOffset)
+: mRoot(NULL), mSize(0), mCompare(cf), mKeyOffset(keyOffset)
+{
 }
 
 template<class Key, class Storage>
-MAUtil::Dictionary<Key, Storage>::Dictionary(const Dictionary& o) {
-	mKeyOffset = o.mKeyOffset;
-	init((CompareFunction)o.mDict.dict_compare);
+MAUtil::Dictionary<Key, Storage>::Dictionary(const Dictionary& o)
+: mRoot(NULL), mSize(0), mCompare(o.mCompare), mKeyOffset(o.mKeyOffset)
+{
 	operator=(o);
 }
 
 template<class Key, class Storage>
 MAUtil::Dictionary<Key, Storage>&
 MAUtil::Dictionary<Key, Storage>::operator=(const Dictionary& o) {
+	if(this == &o)
+		return *this;
 	clear();
-	dict_load_t load;
-	dict_load_begin(&load, &mDict);
-	ConstIterator itr = o.begin();
-	while(itr != o.end()) {
-		DictNode* newNode = new DictNode(*itr);
-		char* ptr = (char*)&newNode->data;
-		dict_load_next(&load, newNode, ptr + mKeyOffset);
-		++itr;
-	}
-	dict_load_end(&load);
+	if(o.mRoot != NULL)
+		mRoot = cloneTree(o.mRoot, NULL, 0);
+	mSize = o.mSize;
 	return *this;
 }
 
@@ -76,112 +71,496 @@ MAUtil::Dictionary<Key, Storage>::~Dictionary() {
 
 template<class Key, class Storage>
 void MAUtil::Dictionary<Key, Storage>::clear() {
-	dict_free_nodes(&mDict);
+	if(mRoot != NULL)
+		freeTree(mRoot);
+	mRoot = NULL;
+	mSize = 0;
 }
 
 template<class Key, class Storage>
 MAUtil::Pair<class MAUtil::Dictionary<Key, Storage>::Iterator, bool>
 MAUtil::Dictionary<Key, Storage>::insert(const Storage& data) {
-	Pair<Iterator, bool> pair(Iterator(&mDict), false);
-	DictNode* newNode = new DictNode(data);
-	dnode_init(newNode, NULL);
-	char* ptr = (char*)&newNode->data;
-	Key* kp = (Key*)(ptr + mKeyOffset);
-	DictNode* res = (DictNode*)dict_insert(&mDict, newNode, kp);
-	if(res != NULL) {	//insert->dupe
-		delete newNode;
-		pair.first.mNode = res;
-		pair.second = false;
-	} else {	//insert successful
-		pair.first.mNode = newNode;
-		pair.second = true;
+	Pair<Iterator, bool> pair(Iterator(this), false);
+	DictNode* node;
+	int index;
+	if(search(keyOf(data), node, index)) {	//insert->dupe
+		pair.first.mNode = node;
+		pair.first.mIndex = index;
+		return pair;
 	}
+	if(node == NULL) {
+		mRoot = node = new DictNode(true);
+		MAASSERT(node);
+	} else if(node->count == NODE_MAX) {
+		split(node);
+		if(index > NODE_MIN) {
+			node = children(node->parent)[node->position + 1];
+			index -= NODE_MIN + 1;
+		}
+	}
+	insertAt(node, index, data);
+	mSize++;
+	pair.first.mNode = node;
+	pair.first.mIndex = index;
+	pair.second = true;
 	return pair;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator
 MAUtil::Dictionary<Key, Storage>::begin() {
-	Iterator itr(&mDict);
-	itr.mNode = (DictNode*)dict_first(&mDict);
+	Iterator itr(this);
+	const DictNode* node = mRoot;
+	first(node, itr.mIndex);
+	itr.mNode = (DictNode*)node;
 	return itr;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator
 MAUtil::Dictionary<Key, Storage>::begin() const {
-	ConstIterator itr(&mDict);
-	itr.mNode = (DictNode*)dict_first((dict_t*)&mDict);
+	ConstIterator itr(this);
+	itr.mNode = mRoot;
+	first(itr.mNode, itr.mIndex);
 	return itr;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator
 MAUtil::Dictionary<Key, Storage>::end() {
-	Iterator itr(&mDict);
-	itr.mNode = NULL;
-	return itr;
+	return Iterator(this);
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator
 MAUtil::Dictionary<Key, Storage>::end() const {
-	ConstIterator itr(&mDict);
-	itr.mNode = NULL;
-	return itr;
+	return ConstIterator(this);
 }
 
 template<class Key, class Storage>
 size_t MAUtil::Dictionary<Key, Storage>::size() const {
-	return dict_count((dict_t*)&mDict);
+	return mSize;
 }
 
 template<class Key, class Storage>
 bool MAUtil::Dictionary<Key, Storage>::erase(const Key& key) {
-	dnode_t* node = dict_lookup(&mDict, &key);
-	if(node == NULL)
+	DictNode* node;
+	int index;
+	if(!search(key, node, index))
 		return false;
-	dict_delete_free(&mDict, node);
+	eraseAt(node, index);
 	return true;
 }
 
 template<class Key, class Storage>
-void MAUtil::Dictionary<Key, Storage>::erase(Iterator itr) {
-	dict_delete_free(&mDict, itr.mNode);
+typename MAUtil::Dictionary<Key, Storage>::Iterator
+MAUtil::Dictionary<Key, Storage>::erase(Iterator itr) {
+	MAASSERT(itr.mNode != NULL);
+	DictNode* node = itr.mNode;
+	int index = itr.mIndex;
+	++itr;
+	if(itr.mNode == NULL) {
+		eraseAt(node, index);
+		return end();
+	}
+
+	// the element is taken out of this leaf, or its predecessor's leaf.
+	DictNode* leaf = node;
+	if(!leaf->leaf) {
+		leaf = children(leaf)[index];
+		while(!leaf->leaf) {
+			leaf = children(leaf)[leaf->count];
+		}
+	}
+	if(leaf != mRoot && leaf->count == NODE_MIN) {
+		// the tree will be rebalanced, which can move the next element anywhere.
+		const Key key(keyOf(*itr));
+		eraseAt(node, index);
+		return find(key);
+	}
+
+	// only the elements after it in a leaf move down.
+	eraseAt(node, index);
+	if(itr.mNode == node)
+		itr.mIndex--;
+	return itr;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator
 MAUtil::Dictionary<Key, Storage>::find(const Key& key) {
-	Iterator itr(&mDict);
-	itr.mNode = (DictNode*)dict_lookup(&mDict, &key);
+	Iterator itr(this);
+	DictNode* node;
+	if(search(key, node, itr.mIndex))
+		itr.mNode = node;
+	else
+		itr.mIndex = 0;
 	return itr;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator
 MAUtil::Dictionary<Key, Storage>::find(const Key& key) const {
-	ConstIterator itr(&mDict);
-	itr.mNode = (DictNode*)dict_lookup((dict_t*)&mDict, &key);
+	ConstIterator itr(this);
+	DictNode* node;
+	if(search(key, node, itr.mIndex))
+		itr.mNode = node;
+	else
+		itr.mIndex = 0;
 	return itr;
 }
 
+//******************************************************************************
+// B-tree
+//******************************************************************************
+
+template<class Key, class Storage>
+bool MAUtil::Dictionary<Key, Storage>::search(const Key& key, DictNode*& node, int& index) const {
+	node = mRoot;
+	index = 0;
+	if(node == NULL)
+		return false;
+	while(true) {
+		int lo = 0, hi = node->count;
+		const Storage* data = node->data();
+		while(lo < hi) {
+			int mid = (lo + hi) >> 1;
+			int c = mCompare(key, keyOf(data[mid]));
+			if(c == 0) {
+				index = mid;
+				return true;
+			}
+			if(c < 0)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		index = lo;
+		if(node->leaf)
+			return false;
+		node = children(node)[lo];
+	}
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::construct(Storage* dst, const Storage& src) {
+	new((void*)dst) Slot(src);
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::destroy(Storage* s) {
+	((Slot*)(void*)s)->~Slot();
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::move(Storage* dst, Storage* src) {
+	construct(dst, *src);
+	destroy(src);
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::deleteNode(DictNode* node) {
+	if(node->leaf)
+		delete node;
+	else
+		delete (DictBranch*)node;
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::freeTree(DictNode* node) {
+	for(int i=0; i<node->count; i++) {
+		destroy(node->data() + i);
+	}
+	if(!node->leaf) {
+		for(int i=0; i<=node->count; i++) {
+			freeTree(children(node)[i]);
+		}
+	}
+	deleteNode(node);
+}
+
+template<class Key, class Storage>
+typename MAUtil::Dictionary<Key, Storage>::DictNode*
+MAUtil::Dictionary<Key, Storage>::cloneTree(const DictNode* src, DictNode* parent, int position) {
+	DictNode* node = src->leaf ? new DictNode(true) : new DictBranch();
+	MAASSERT(node);
+	node->parent = parent;
+	node->position = position;
+	node->count = src->count;
+	for(int i=0; i<src->count; i++) {
+		construct(node->data() + i, src->data()[i]);
+	}
+	if(!src->leaf) {
+		for(int i=0; i<=src->count; i++) {
+			children(node)[i] = cloneTree(children(src)[i], node, i);
+		}
+	}
+	return node;
+}
+
+// Inserts an element at \a index. The node must not be full.
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::insertAt(DictNode* node, int index, const Storage& data) {
+	Storage* d = node->data();
+	for(int i=node->count; i>index; i--) {
+		move(d + i, d + i - 1);
+	}
+	construct(d + index, data);
+	node->count++;
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::split(DictNode* node) {
+	DictNode* parent = node->parent;
+	if(parent == NULL) {
+		parent = new DictBranch();
+		MAASSERT(parent);
+		children(parent)[0] = node;
+		node->parent = parent;
+		node->position = 0;
+		mRoot = parent;
+	} else if(parent->count == NODE_MAX) {
+		split(parent);
+		parent = node->parent;
+	}
+
+	// the upper half goes to a new node to the right.
+	DictNode* right = node->leaf ? new DictNode(true) : new DictBranch();
+	MAASSERT(right);
+	for(int i=0; i<NODE_MIN; i++) {
+		move(right->data() + i, node->data() + NODE_MIN + 1 + i);
+	}
+	if(!node->leaf) {
+		for(int i=0; i<=NODE_MIN; i++) {
+			DictNode* child = children(node)[NODE_MIN + 1 + i];
+			children(right)[i] = child;
+			child->parent = right;
+			child->position = i;
+		}
+	}
+	right->count = NODE_MIN;
+
+	// the middle element goes to the parent, with the new node to its right.
+	int pos = node->position;
+	DictNode** pc = children(parent);
+	for(int i=parent->count; i>pos; i--) {
+		pc[i + 1] = pc[i];
+		pc[i + 1]->position = i + 1;
+	}
+	insertAt(parent, pos, node->data()[NODE_MIN]);
+	destroy(node->data() + NODE_MIN);
+	node->count = NODE_MIN;
+	pc[pos + 1] = right;
+	right->parent = parent;
+	right->position = pos + 1;
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::eraseAt(DictNode* node, int index) {
+	Storage* d = node->data();
+	destroy(d + index);
+	if(!node->leaf) {
+		// replace the element with its predecessor, which is in a leaf.
+		DictNode* leaf = children(node)[index];
+		while(!leaf->leaf) {
+			leaf = children(leaf)[leaf->count];
+		}
+		leaf->count--;
+		move(d + index, leaf->data() + leaf->count);
+		node = leaf;
+	} else {
+		node->count--;
+		for(int i=index; i<node->count; i++) {
+			move(d + i, d + i + 1);
+		}
+	}
+	mSize--;
+	rebalance(node);
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::rebalance(DictNode* node) {
+	while(node != mRoot && node->count < NODE_MIN) {
+		DictNode* parent = node->parent;
+		int pos = node->position;
+		DictNode* left = pos > 0 ? children(parent)[pos - 1] : NULL;
+		DictNode* right = pos < parent->count ? children(parent)[pos + 1] : NULL;
+		if(left != NULL && left->count > NODE_MIN) {
+			rotateRight(parent, pos - 1);
+			return;
+		}
+		if(right != NULL && right->count > NODE_MIN) {
+			rotateLeft(parent, pos);
+			return;
+		}
+		merge(parent, left != NULL ? pos - 1 : pos);
+		node = parent;
+	}
+	if(mRoot->count == 0) {
+		DictNode* old = mRoot;
+		if(old->leaf) {
+			mRoot = NULL;
+		} else {
+			mRoot = children(old)[0];
+			mRoot->parent = NULL;
+			mRoot->position = 0;
+		}
+		deleteNode(old);
+	}
+}
+
+// Moves an element from the right child of element \a index, through the parent,
+// to the left child.
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::rotateLeft(DictNode* parent, int index) {
+	DictNode* left = children(parent)[index];
+	DictNode* right = children(parent)[index + 1];
+	move(left->data() + left->count, parent->data() + index);
+	move(parent->data() + index, right->data());
+	for(int i=1; i<right->count; i++) {
+		move(right->data() + i - 1, right->data() + i);
+	}
+	if(!left->leaf) {
+		DictNode* child = children(right)[0];
+		children(left)[left->count + 1] = child;
+		child->parent = left;
+		child->position = left->count + 1;
+		for(int i=0; i<right->count; i++) {
+			children(right)[i] = children(right)[i + 1];
+			children(right)[i]->position = i;
+		}
+	}
+	left->count++;
+	right->count--;
+}
+
+// Moves an element from the left child of element \a index, through the parent,
+// to the right child.
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::rotateRight(DictNode* parent, int index) {
+	DictNode* left = children(parent)[index];
+	DictNode* right = children(parent)[index + 1];
+	for(int i=right->count; i>0; i--) {
+		move(right->data() + i, right->data() + i - 1);
+	}
+	move(right->data(), parent->data() + index);
+	move(parent->data() + index, left->data() + left->count - 1);
+	if(!right->leaf) {
+		for(int i=right->count + 1; i>0; i--) {
+			children(right)[i] = children(right)[i - 1];
+			children(right)[i]->position = i;
+		}
+		DictNode* child = children(left)[left->count];
+		children(right)[0] = child;
+		child->parent = right;
+		child->position = 0;
+	}
+	left->count--;
+	right->count++;
+}
+
+// Merges the children on either side of element \a index, and that element,
+// into the left child.
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::merge(DictNode* parent, int index) {
+	DictNode* left = children(parent)[index];
+	DictNode* right = children(parent)[index + 1];
+	int base = left->count + 1;
+	move(left->data() + left->count, parent->data() + index);
+	for(int i=0; i<right->count; i++) {
+		move(left->data() + base + i, right->data() + i);
+	}
+	if(!left->leaf) {
+		for(int i=0; i<=right->count; i++) {
+			DictNode* child = children(right)[i];
+			children(left)[base + i] = child;
+			child->parent = left;
+			child->position = base + i;
+		}
+	}
+	left->count = base + right->count;
+	deleteNode(right);
+
+	parent->count--;
+	for(int i=index; i<parent->count; i++) {
+		move(parent->data() + i, parent->data() + i + 1);
+		children(parent)[i + 1] = children(parent)[i + 2];
+		children(parent)[i + 1]->position = i + 1;
+	}
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::first(const DictNode*& node, int& index) {
+	index = 0;
+	if(node == NULL)
+		return;
+	while(!node->leaf) {
+		node = children(node)[0];
+	}
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::last(const DictNode*& node, int& index) {
+	while(!node->leaf) {
+		node = children(node)[node->count];
+	}
+	index = node->count - 1;
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::next(const DictNode*& node, int& index) {
+	if(!node->leaf) {
+		node = children(node)[index + 1];
+		first(node, index);
+		return;
+	}
+	if(++index < node->count)
+		return;
+	// climb until we come from a child that has an element to its right.
+	while(node->parent != NULL && node->position == node->parent->count) {
+		node = node->parent;
+	}
+	index = node->position;
+	node = node->parent;
+	if(node == NULL)
+		index = 0;
+}
+
+template<class Key, class Storage>
+void MAUtil::Dictionary<Key, Storage>::prev(const DictNode*& node, int& index) {
+	if(!node->leaf) {
+		node = children(node)[index];
+		last(node, index);
+		return;
+	}
+	if(--index >= 0)
+		return;
+	while(node->parent != NULL && node->position == 0) {
+		node = node->parent;
+	}
+	index = node->position - 1;
+	node = node->parent;
+	if(node == NULL)
+		index = 0;
+}
+
 //******************************************************************************
 // Iterator
 //******************************************************************************
 
 template<class Key, class Storage>
-MAUtil::Dictionary<Key, Storage>::Iterator::Iterator(dict_t* dict) :
-mNode(NULL), mDict(dict) {}
+MAUtil::Dictionary<Key, Storage>::Iterator::Iterator(Dictionary* dict) :
+mNode(NULL), mIndex(0), mDict(dict) {}
 
 template<class Key, class Storage>
 MAUtil::Dictionary<Key, Storage>::Iterator::Iterator(const Iterator& o) :
-mNode(o.mNode), mDict(o.mDict) {}
+mNode(o.mNode), mIndex(o.mIndex), mDict(o.mDict) {}
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator&
 MAUtil::Dictionary<Key, Storage>::Iterator::operator=(const Iterator& o) {
 	mNode = o.mNode;
+	mIndex = o.mIndex;
 	mDict = o.mDict;
 	return *this;
 }
@@ -189,20 +568,22 @@ MAUtil::Dictionary<Key, Storage>::Iterator::operator=(const Iterator& o) {
 template<class Key, class Storage>
 Storage& MAUtil::Dictionary<Key, Storage>::Iterator::operator*() {
 	MAASSERT(mNode != NULL);
-	return mNode->data;
+	return mNode->data()[mIndex];
 }
 
 template<class Key, class Storage>
 Storage* MAUtil::Dictionary<Key, Storage>::Iterator::operator->() {
 	MAASSERT(mNode != NULL);
-	return &mNode->data;
+	return mNode->data() + mIndex;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator&
 MAUtil::Dictionary<Key, Storage>::Iterator::operator++() {
 	MAASSERT(mNode != NULL);
-	mNode = (DictNode*)dict_next(mDict, mNode);
+	const DictNode* node = mNode;
+	next(node, mIndex);
+	mNode = (DictNode*)node;
 	return *this;
 }
 
@@ -217,12 +598,15 @@ MAUtil::Dictionary<Key, Storage>::Iterator::operator++(int) {
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::Iterator&
 MAUtil::Dictionary<Key, Storage>::Iterator::operator--() {
-	if(mNode == NULL) {
-		mNode = (DictNode*)dict_last(mDict);
-		MAASSERT(mNode != NULL);
-		return *this;
+	const DictNode* node = mNode;
+	if(node == NULL) {
+		node = mDict->mRoot;
+		MAASSERT(node != NULL);
+		last(node, mIndex);
+	} else {
+		prev(node, mIndex);
 	}
-	mNode = (DictNode*)dict_prev(mDict, mNode);
+	mNode = (DictNode*)node;
 	return *this;
 }
 
@@ -236,12 +620,12 @@ MAUtil::Dictionary<Key, Storage>::Iterator::operator--(int) {
 
 template<class Key, class Storage>
 bool MAUtil::Dictionary<Key, Storage>::Iterator::operator==(const Iterator& o) const {
-	return mNode == o.mNode;
+	return mNode == o.mNode && mIndex == o.mIndex;
 }
 
 template<class Key, class Storage>
 bool MAUtil::Dictionary<Key, Storage>::Iterator::operator!=(const Iterator& o) const {
-	return mNode != o.mNode;
+	return !(*this == o);
 }
 
 //******************************************************************************
@@ -249,21 +633,22 @@ bool MAUtil::Dictionary<Key, Storage>::Iterator::operator!=(const Iterator& o) c
 //******************************************************************************
 
 template<class Key, class Storage>
-MAUtil::Dictionary<Key, Storage>::ConstIterator::ConstIterator(const dict_t* dict) :
-mNode(NULL), mDict(dict) {}
+MAUtil::Dictionary<Key, Storage>::ConstIterator::ConstIterator(const Dictionary* dict) :
+mNode(NULL), mIndex(0), mDict(dict) {}
 
 template<class Key, class Storage>
 MAUtil::Dictionary<Key, Storage>::ConstIterator::ConstIterator(const ConstIterator& o) :
-mNode(o.mNode), mDict(o.mDict) {}
+mNode(o.mNode), mIndex(o.mIndex), mDict(o.mDict) {}
 
 template<class Key, class Storage>
 MAUtil::Dictionary<Key, Storage>::ConstIterator::ConstIterator(const Iterator& o) :
-mNode(o.mNode), mDict(o.mDict) {}
+mNode(o.mNode), mIndex(o.mIndex), mDict(o.mDict) {}
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator&
 MAUtil::Dictionary<Key, Storage>::ConstIterator::operator=(const ConstIterator& o) {
 	mNode = o.mNode;
+	mIndex = o.mIndex;
 	mDict = o.mDict;
 	return *this;
 }
@@ -271,20 +656,20 @@ MAUtil::Dictionary<Key, Storage>::ConstIterator::operator=(const ConstIterator&
 template<class Key, class Storage>
 const Storage& MAUtil::Dictionary<Key, Storage>::ConstIterator::operator*() const {
 	MAASSERT(mNode != NULL);
-	return mNode->data;
+	return mNode->data()[mIndex];
 }
 
 template<class Key, class Storage>
 const Storage* MAUtil::Dictionary<Key, Storage>::ConstIterator::operator->() const {
 	MAASSERT(mNode != NULL);
-	return &mNode->data;
+	return mNode->data() + mIndex;
 }
 
 template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator&
 MAUtil::Dictionary<Key, Storage>::ConstIterator::operator++() {
 	MAASSERT(mNode != NULL);
-	mNode = (DictNode*)dict_next((dict_t*)mDict, (DictNode*)mNode);
+	next(mNode, mIndex);
 	return *this;
 }
 
@@ -300,11 +685,12 @@ template<class Key, class Storage>
 typename MAUtil::Dictionary<Key, Storage>::ConstIterator&
 MAUtil::Dictionary<Key, Storage>::ConstIterator::operator--() {
 	if(mNode == NULL) {
-		mNode = (DictNode*)dict_last((dict_t*)mDict);
+		mNode = mDict->mRoot;
 		MAASSERT(mNode != NULL);
+		last(mNode, mIndex);
 		return *this;
 	}
-	mNode = (DictNode*)dict_prev((dict_t*)mDict, (DictNode*)mNode);
+	prev(mNode, mIndex);
 	return *this;
 }
 
@@ -318,10 +704,10 @@ MAUtil::Dictionary<Key, Storage>::ConstIterator::operator--(int) {
 
 template<class Key, class Storage>
 bool MAUtil::Dictionary<Key, Storage>::ConstIterator::operator==(const ConstIterator& o) const {
-	return mNode == o.mNode;
+	return mNode == o.mNode && mIndex == o.mIndex;
 }
 
 template<class Key, class Storage>
 bool MAUtil::Dictionary<Key, Storage>::ConstIterator::operator!=(const ConstIterator& o) const {
-	return mNode != o.mNode;
+	return !(*this == o);
 }
@@ -16,6 +16,8 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 */
 #include <conprint.h>
 #include <maassert.h>
+#include <mastdlib.h>
+#include <mastring.h>
 #include "Downloader.h"
 
 
@@ -29,6 +31,11 @@ using namespace MAUtil;
 // Downloaded data is now owned by the user.
 #define NO_CLEANUP 0
 
+// Size of the first data chunk when content length is unknown.
+// Each following chunk is twice as large, up to the max size.
+#define CHUNK_SIZE_MIN 2048
+#define CHUNK_SIZE_MAX (64 * 1024)
+
 // *************** Class DownloadListener *************** //
 
 void DownloadListener::notifyProgress(Downloader* dl, int downloadedBytes, int totalBytes)
@@ -46,6 +53,13 @@ Downloader::Downloader()
 : mIsDownloading(false),
   mIsDataPlaceholderSystemAllocated(false),
   mDataPlaceholder(NULL),
+  mMaxRetries(0),
+  mParallelRanges(1),
+  mMinRangeSize(64 * 1024),
+  mRetryCount(0),
+  mReceivedBytes(0),
+  mStartTime(0),
+  mLastReceiveTime(0),
   mReader(NULL)
 {
 	mConn = new HttpConnection(this);
@@ -90,6 +104,14 @@ int Downloader::beginDownloading(const char *url, MAHandle placeholder)
 
 	mIsDownloading = true;
 
+	// The url is needed for range requests.
+	mUrl = url;
+
+	// Reset statistics.
+	mRetryCount = 0;
+	mReceivedBytes = 0;
+	mStartTime = mLastReceiveTime = maGetMilliSecondCount();
+
 	// If the supplied placeholder is zero, we will use a
 	// system allocated placeholder.
 	mIsDataPlaceholderSystemAllocated = (0 == placeholder);
@@ -102,6 +124,27 @@ int Downloader::beginDownloading(const char *url, MAHandle placeholder)
 	return 1;
 }
 
+void Downloader::setMaxRetries(int maxRetries)
+{
+	mMaxRetries = maxRetries;
+}
+
+void Downloader::setParallelRanges(int count, int minRangeSize)
+{
+	mParallelRanges = (count < 1) ? 1 : count;
+	mMinRangeSize = (minRangeSize < 1) ? 1 : minRangeSize;
+}
+
+int Downloader::getBytesPerSecond() const
+{
+	int elapsed = getElapsedTime();
+	if (elapsed <= 0)
+	{
+		return 0;
+	}
+	return (int)(mReceivedBytes * 1000.0 / elapsed);
+}
+
 void Downloader::cancelDownloading()
 {
 	ASSERT_MSG(mIsDownloading, "Inactive download cancelled.");
@@ -128,20 +171,16 @@ void Downloader::fireFinishedDownloading(MAHandle handle)
 
 void Downloader::fireError(int code)
 {
-	mIsDownloading = false;
+	// Clean up first, so that listeners may start a new download.
+	// This must be done while the download is still active,
+	// or the data placeholder is not returned.
+	closeConnection(CLEANUP);
 
 	// Broadcast error to listeners.
 	for (int i = 0; i < mDownloadListeners.size(); ++i)
 	{
 		mDownloadListeners[i]->error(this, code);
 	}
-
-	// A new download might be started, in that case we do not
-	// close the connection.
-	if (!mIsDownloading)
-	{
-		closeConnection(CLEANUP);
-	}
 }
 
 void Downloader::closeConnection(int cleanup)
@@ -203,14 +242,8 @@ void Downloader::httpFinished(HttpConnection* http, int result)
 			return;
 		}
 
-		// Delete old reader and create new one and start receiving
-		// data via the reader.
-		deleteReader();
-		mReader = new DownloaderReaderWithKnownContentLength(
-			this,
-			0, // data offset
-			contentLength);
-		mReader->startRecvToData(http);
+		// Start receiving data via a new reader.
+		startRecvToData(http, 0, contentLength);
 	}
 	else
 	{
@@ -224,6 +257,44 @@ void Downloader::httpFinished(HttpConnection* http, int result)
 	}
 }
 
+void Downloader::startRecvToData(
+	HttpConnection* http,
+	int dataOffset,
+	int contentLength)
+{
+	// Delete old reader and create new one.
+	deleteReader();
+
+	// Use range requests if they are wanted and the server supports them.
+	String str;
+	if ((mMaxRetries > 0 || mParallelRanges > 1)
+		&& contentLength > dataOffset
+		&& http->getResponseHeader("accept-ranges", &str) >= 0
+		&& str == "bytes")
+	{
+		mReader = new DownloaderReaderWithRanges(
+			this,
+			dataOffset,
+			contentLength);
+	}
+	else
+	{
+		mReader = new DownloaderReaderWithKnownContentLength(
+			this,
+			dataOffset,
+			contentLength);
+	}
+
+	// Start receiving data via the reader.
+	mReader->startRecvToData(http);
+}
+
+void Downloader::addReceivedBytes(int bytes)
+{
+	mReceivedBytes += bytes;
+	mLastReceiveTime = maGetMilliSecondCount();
+}
+
 void Downloader::fireNotifyProgress(int dataOffset, int contentLength)
 {
 	for (int i = 0; i < mDownloadListeners.size(); ++i)
@@ -416,13 +487,8 @@ void AudioDownloader::httpFinished(HttpConnection* http, int result)
 	maWriteData(mDataPlaceholder, mMimeType.c_str(), 0, mMimeType.length() + 1);
 	int dataOffset = mMimeType.length() + 1;
 
-	// Delete old reader and create new one and start receiving data.
-	deleteReader();
-	mReader = new DownloaderReaderWithKnownContentLength(
-		this,
-		dataOffset,
-		contentLength);
-	mReader->startRecvToData(http);
+	// Start receiving data via a new reader.
+	startRecvToData(http, dataOffset, contentLength);
 }
 
 
@@ -482,6 +548,7 @@ void DownloaderReaderWithKnownContentLength::connRecvFinished(
 	}
 	// Update number of bytes read with the result.
 	mDataOffset += result;
+	mDownloader->addReceivedBytes(result);
 
 	// Broadcast progress status to listeners.
 	mDownloader->fireNotifyProgress(mDataOffset, mContentLength);
@@ -514,7 +581,7 @@ void DownloaderReaderWithKnownContentLength::connRecvFinished(
 
 DownloaderReaderThatReadsChunks::DownloaderReaderThatReadsChunks(Downloader* downloader)
 : DownloaderReader(downloader),
-  mDataChunkSize(2048),
+  mDataChunkSize(CHUNK_SIZE_MIN),
   mDataChunkOffset(0)
 {
 }
@@ -563,6 +630,7 @@ void DownloaderReaderThatReadsChunks::connRecvFinished(Connection* conn, int res
 	// We have new data.
 	mDataChunkOffset += result;
 	mContentLength += result;
+	mDownloader->addReceivedBytes(result);
 	int leftToRead = mDataChunkSize - mDataChunkOffset;
 
 	// Broadcast progress status to listeners.
@@ -590,17 +658,26 @@ void DownloaderReaderThatReadsChunks::connRecvFinished(Connection* conn, int res
 
 bool DownloaderReaderThatReadsChunks::readNextChunk(Connection* conn)
 {
+	// Grow the chunks, so that a large download
+	// doesn't need a large number of them.
+	if (0 < mDataChunks.size() && mDataChunkSize < CHUNK_SIZE_MAX)
+	{
+		mDataChunkSize *= 2;
+	}
+
 	// Allocate new a chunk of data.
 	MAHandle chunk = maCreatePlaceholder();
 	int result = maCreateData(chunk, mDataChunkSize);
 	if (RES_OUT_OF_MEMORY == result)
 	{
+		maDestroyPlaceholder(chunk);
 		return false;
 	}
 	else
 	{
 		// Start reading into the new chunk.
 		mDataChunks.add(chunk);
+		mDataChunkSizes.add(mDataChunkSize);
 		mDataChunkOffset = 0;
 		conn->recvToData(chunk, mDataChunkOffset, mDataChunkSize);
 		return true;
@@ -623,30 +700,31 @@ void DownloaderReaderThatReadsChunks::finishedDownloadingChunkedData()
 
 	// Copy the chunks to the data object.
 	int offset = 0;
-	char *buf = new char[mDataChunkSize];
-	while (0 < mDataChunks.size())
+	for (int i = 0; i < mDataChunks.size(); ++i)
 	{
 		// Last chunk should only be partially written.
 		int dataLeftToWrite = mContentLength - offset;
-		// Set size to min(dataLeftToWrite, mDataChunkSize)
-		int size = (dataLeftToWrite < mDataChunkSize
-			? dataLeftToWrite : mDataChunkSize);
-
-		// Copy first remaining chunk.
-		MAHandle chunk = mDataChunks[0];
-		maReadData(chunk, buf, 0, size);
-		maWriteData(mDownloader->getDataPlaceholder(), buf, offset, size);
+		// Set size to min(dataLeftToWrite, chunk size)
+		int size = (dataLeftToWrite < mDataChunkSizes[i]
+			? dataLeftToWrite : mDataChunkSizes[i]);
+
+		// Copy the chunk without going through a buffer.
+		MACopyData copy;
+		copy.dst = mDownloader->getDataPlaceholder();
+		copy.dstOffset = offset;
+		copy.src = mDataChunks[i];
+		copy.srcOffset = 0;
+		copy.size = size;
+		maCopyData(&copy);
 
 		// Return chunk to pool.
-		maDestroyPlaceholder(chunk);
-
-		// Remove chunk from list.
-		mDataChunks.remove(0);
+		maDestroyPlaceholder(mDataChunks[i]);
 
 		// Increment offset.
-		offset += mDataChunkSize;
+		offset += size;
 	}
-	delete[] buf;
+	mDataChunks.clear();
+	mDataChunkSizes.clear();
 
 	MAHandle handle = mDownloader->getHandle();
 	if (handle)
@@ -658,3 +736,272 @@ void DownloaderReaderThatReadsChunks::finishedDownloadingChunkedData()
 		mDownloader->fireError(CONNERR_DOWNLOADER_OOM);
 	}
 }
+
+// *************** Class DownloaderRange *************** //
+
+DownloaderRange::DownloaderRange(
+	DownloaderReaderWithRanges* reader,
+	int start,
+	int end)
+: mReader(reader),
+  mHttp(this),
+  mConn(NULL),
+  mPosition(start),
+  mEnd(end)
+{
+}
+
+DownloaderRange::~DownloaderRange()
+{
+	mHttp.close();
+}
+
+void DownloaderRange::recvFrom(Connection* conn)
+{
+	mConn = conn;
+	recvNext();
+}
+
+int DownloaderRange::request(const char* url)
+{
+	// Close the connection of an earlier attempt.
+	mHttp.close();
+
+	int result = mHttp.create(url, HTTP_GET);
+	if (result <= 0)
+	{
+		return result;
+	}
+
+	// The last byte of a range is inclusive.
+	String range = "bytes=" + integerToString(mPosition) +
+		"-" + integerToString(mEnd - 1);
+	mHttp.setRequestHeader("Range", range.c_str());
+
+	mConn = &mHttp;
+	mHttp.finish();
+
+	return 1;
+}
+
+void DownloaderRange::recvNext()
+{
+	Downloader* downloader = mReader->mDownloader;
+	mConn->recvToData(
+		downloader->getDataPlaceholder(),
+		mReader->mDataOffset + mPosition,
+		mEnd - mPosition);
+}
+
+void DownloaderRange::httpFinished(HttpConnection* http, int result)
+{
+	// Could we not connect?
+	if (result < 0)
+	{
+		mReader->rangeFailed(this, result);
+		return;
+	}
+
+	// Did we get the range we asked for?
+	// A server may also ignore the range, which is fine
+	// if we are at the start.
+	String str;
+	bool ok;
+	if (206 == result)
+	{
+		ok = http->getResponseHeader("content-range", &str) >= 0
+			&& checkContentRange(str);
+	}
+	else
+	{
+		ok = (200 == result && 0 == mPosition);
+	}
+
+	if (!ok)
+	{
+		mReader->rangeFailed(
+			this,
+			(result >= 200 && result < 300) ? CONNERR_DOWNLOADER_RANGE : result);
+		return;
+	}
+
+	recvNext();
+}
+
+bool DownloaderRange::checkContentRange(const String& str)
+{
+	// "bytes <first>-<last>/<length>", where the length may be "*".
+	// The server may send less than we asked for, but it must start at
+	// our position and be a part of the same content.
+	const char* s = str.c_str();
+	if (strncmp(s, "bytes ", 6) != 0)
+	{
+		return false;
+	}
+	char* end;
+	long first = strtol(s + 6, &end, 10);
+	if (first != mPosition || *end != '-')
+	{
+		return false;
+	}
+	long last = strtol(end + 1, &end, 10);
+	if (last < first || *end != '/')
+	{
+		return false;
+	}
+	if (strcmp(end + 1, "*") == 0)
+	{
+		return true;
+	}
+	long length = strtol(end + 1, &end, 10);
+	return *end == 0
+		&& length == mReader->mContentLength - mReader->mDataOffset;
+}
+
+void DownloaderRange::connRecvFinished(Connection* conn, int result)
+{
+	// Was the range cut short?
+	if (result <= 0)
+	{
+		conn->close();
+		mReader->rangeFailed(this, result);
+		return;
+	}
+
+	// The listeners are told last, because they may end the download,
+	// which deletes this range.
+	mPosition += result;
+	if (mPosition < mEnd)
+	{
+		recvNext();
+		mReader->rangeReceived(result);
+	}
+	else
+	{
+		// Done. The connection may have more data,
+		// if it is one that was not made for this range.
+		conn->close();
+		mReader->rangeFinished(result);
+	}
+}
+
+// *************** Class DownloaderReaderWithRanges *************** //
+
+DownloaderReaderWithRanges::DownloaderReaderWithRanges(
+	Downloader* downloader,
+	int dataOffset,
+	int contentLength)
+: DownloaderReader(downloader),
+  mDataOffset(dataOffset),
+  mReceived(0),
+  mRangesLeft(0)
+{
+	mContentLength = contentLength;
+}
+
+DownloaderReaderWithRanges::~DownloaderReaderWithRanges()
+{
+	for (int i = 0; i < mRanges.size(); ++i)
+	{
+		delete mRanges[i];
+	}
+}
+
+void DownloaderReaderWithRanges::startRecvToData(Connection* conn)
+{
+	// Split the content into ranges of the same size,
+	// the last one taking what is left.
+	int length = mContentLength - mDataOffset;
+	int count = mDownloader->mParallelRanges;
+	if (count > length / mDownloader->mMinRangeSize)
+	{
+		count = length / mDownloader->mMinRangeSize;
+	}
+	if (count < 1)
+	{
+		count = 1;
+	}
+	int rangeSize = length / count;
+	for (int i = 0; i < count; ++i)
+	{
+		int start = i * rangeSize;
+		int end = (i == count - 1) ? length : start + rangeSize;
+		mRanges.add(new DownloaderRange(this, start, end));
+	}
+	mRangesLeft = count;
+
+	// The other ranges are requested over new connections.
+	for (int i = 1; i < count; ++i)
+	{
+		int result = mRanges[i]->request(mDownloader->mUrl.c_str());
+		if (result <= 0)
+		{
+			mDownloader->fireError(result);
+			return;
+		}
+	}
+
+	// The first range is read from the response we already have.
+	mRanges[0]->recvFrom(conn);
+
+	// Broadcast progress to listeners.
+	mDownloader->fireNotifyProgress(mDataOffset, mContentLength);
+}
+
+void DownloaderReaderWithRanges::connRecvFinished(Connection* conn, int result)
+{
+	// Only the first range reads from the connection of the downloader.
+	mRanges[0]->connRecvFinished(conn, result);
+}
+
+void DownloaderReaderWithRanges::rangeReceived(int bytes)
+{
+	mReceived += bytes;
+	mDownloader->addReceivedBytes(bytes);
+
+	// Broadcast progress status to listeners.
+	mDownloader->fireNotifyProgress(mDataOffset + mReceived, mContentLength);
+}
+
+void DownloaderReaderWithRanges::rangeFinished(int bytes)
+{
+	// The listeners may end the download in notifyProgress,
+	// which deletes this reader.
+	Downloader* downloader = mDownloader;
+	bool last = (--mRangesLeft == 0);
+	rangeReceived(bytes);
+	if (!last || downloader->mReader != this)
+	{
+		return;
+	}
+
+	// We have got all data, finish download.
+	MAHandle handle = downloader->getHandle();
+	if (handle)
+	{
+		downloader->fireFinishedDownloading(handle);
+	}
+	else
+	{
+		downloader->fireError(CONNERR_DOWNLOADER_OOM);
+	}
+}
+
+void DownloaderReaderWithRanges::rangeFailed(DownloaderRange* range, int result)
+{
+	// Continue a range that was cut short from where it stopped,
+	// unless we have run out of retries.
+	if (result <= 0
+		&& result != CONNERR_DOWNLOADER_RANGE
+		&& mDownloader->mRetryCount < mDownloader->mMaxRetries)
+	{
+		mDownloader->mRetryCount++;
+		result = range->request(mDownloader->mUrl.c_str());
+		if (result > 0)
+		{
+			return;
+		}
+	}
+
+	mDownloader->fireError(result);
+}
@@ -72,6 +72,9 @@ listener.error ->
 /// The system has run out of memory.
 #define CONNERR_DOWNLOADER_OOM (CONNERR_USER - 1)
 
+/// The server did not answer a range request with the range that was asked for.
+#define CONNERR_DOWNLOADER_RANGE (CONNERR_USER - 2)
+
 /**
  * Use values below this for your own error codes when you inherit the Downloader class.
  * \see #CONNERR_USER
@@ -83,6 +86,7 @@ namespace MAUtil {
 	// Forward declarations.
 	class Downloader;
 	class DownloaderReader;
+	class DownloaderReaderWithRanges;
 
 	/**
 	 * \brief A listener for events from the Downloader class.
@@ -150,6 +154,8 @@ namespace MAUtil {
 		friend class DownloaderReader;
 		friend class DownloaderReaderThatReadsChunks;
 		friend class DownloaderReaderWithKnownContentLength;
+		friend class DownloaderReaderWithRanges;
+		friend class DownloaderRange;
 
 	public:
 		/**
@@ -199,6 +205,53 @@ namespace MAUtil {
 		 */
 		bool isDownloading() const { return mIsDownloading; }
 
+		/**
+		 * Makes a download that is cut short continue from where it stopped,
+		 * with an HTTP range request, instead of failing.
+		 * This is only done if the server sends the content length and
+		 * "Accept-Ranges: bytes".
+		 * \param maxRetries The number of times a download may be continued.
+		 * The default is 0.
+		 */
+		void setMaxRetries(int maxRetries);
+
+		/**
+		 * Splits a large download into ranges that are downloaded in
+		 * parallel, each over its own connection, straight into the data
+		 * object. The server must support range requests, as for
+		 * setMaxRetries().
+		 * \param count The largest number of connections to use.
+		 * The default is 1, which turns this off. Values below 1 count as 1.
+		 * \param minRangeSize No range is made smaller than this many bytes,
+		 * so that small downloads use fewer connections. Values below 1
+		 * count as 1.
+		 */
+		void setParallelRanges(int count, int minRangeSize = 64 * 1024);
+
+		/**
+		 * Returns the number of bytes received by the current or last download,
+		 * over all connections.
+		 */
+		int getReceivedBytes() const { return mReceivedBytes; }
+
+		/**
+		 * Returns the time in milliseconds from the start of the current or
+		 * last download until the last data was received.
+		 */
+		int getElapsedTime() const { return mLastReceiveTime - mStartTime; }
+
+		/**
+		 * Returns the average throughput of the current or last download,
+		 * in bytes per second.
+		 */
+		int getBytesPerSecond() const;
+
+		/**
+		 * Returns the number of times the current or last download
+		 * has been continued after being cut short.
+		 */
+		int getRetryCount() const { return mRetryCount; }
+
 	protected:
 		/**
 		 * Should return a handle to the final product of the download.
@@ -228,6 +281,19 @@ namespace MAUtil {
 		 */
 		void fireError(int code);
 
+		/**
+		 * Start receiving the response body of \a http into the data object,
+		 * at \a dataOffset. Uses range requests if they are turned on
+		 * and the server supports them.
+		 * \param contentLength The size of the data object.
+		 */
+		void startRecvToData(HttpConnection* http, int dataOffset, int contentLength);
+
+		/**
+		 * Update the statistics with newly received data.
+		 */
+		void addReceivedBytes(int bytes);
+
 		/**
 		 * Close the connection used by the downloader.
 		 * This is part of the normal finishing of the download,
@@ -260,6 +326,16 @@ namespace MAUtil {
 		bool mIsDataPlaceholderSystemAllocated;
 		MAHandle mDataPlaceholder;
 		Vector<DownloadListener*> mDownloadListeners;
+		String mUrl;
+
+		int mMaxRetries;
+		int mParallelRanges;
+		int mMinRangeSize;
+
+		int mRetryCount;
+		int mReceivedBytes;
+		int mStartTime;
+		int mLastReceiveTime;
 		
 		/**
 		 * Object that performs the actual download. A downloader
@@ -340,6 +416,7 @@ namespace MAUtil {
 	{
 	public:
 		DownloaderReader(Downloader* downloader);
+		virtual ~DownloaderReader() {}
 		virtual void startRecvToData(Connection* conn) = 0;
 		virtual void connRecvFinished(Connection* conn, int result) = 0;
 		int getContentLength();
@@ -381,9 +458,81 @@ namespace MAUtil {
 		void finishedDownloadingChunkedData();
 	protected:
 		MAUtil::Vector<MAHandle> mDataChunks;
+		MAUtil::Vector<int> mDataChunkSizes;
 		int mDataChunkSize;
 		int mDataChunkOffset;
 	};
+
+	/**
+	 * \brief One range of a download by DownloaderReaderWithRanges.
+	 * Reads the range over its own connection, or continues on the
+	 * connection of the downloader.
+	 */
+	class DownloaderRange : public HttpConnectionListener
+	{
+	public:
+		DownloaderRange(DownloaderReaderWithRanges* reader, int start, int end);
+		virtual ~DownloaderRange();
+
+		/**
+		 * Receive the range from a connection whose response
+		 * starts at the current position.
+		 */
+		void recvFrom(Connection* conn);
+
+		/**
+		 * Request the rest of the range over a new connection.
+		 * \return \>0 on success, or a CONNERR code \< 0 on failure.
+		 */
+		int request(const char* url);
+
+		int getRemaining() const { return mEnd - mPosition; }
+
+		virtual void httpFinished(HttpConnection* http, int result);
+		virtual void connRecvFinished(Connection* conn, int result);
+	protected:
+		void recvNext();
+
+		/**
+		 * Checks the Content-Range header of a 206 response.
+		 */
+		bool checkContentRange(const MAUtil::String& str);
+
+		DownloaderReaderWithRanges* mReader;
+		HttpConnection mHttp;
+		Connection* mConn;
+		// Positions in the response body.
+		int mPosition;
+		int mEnd;
+	};
+
+	/**
+	 * \brief Class that handles download when the content length is known
+	 * and the server accepts range requests. The content can be split into
+	 * ranges that are downloaded in parallel, and a range that is cut
+	 * short is continued with a new range request.
+	 */
+	class DownloaderReaderWithRanges : public DownloaderReader
+	{
+		friend class DownloaderRange;
+	public:
+		DownloaderReaderWithRanges(
+			Downloader* downloader,
+			int dataOffset,
+			int contentLength);
+		virtual ~DownloaderReaderWithRanges();
+		virtual void startRecvToData(Connection* conn);
+		virtual void connRecvFinished(Connection* conn, int result);
+	protected:
+		void rangeReceived(int bytes);
+		void rangeFinished(int bytes);
+		void rangeFailed(DownloaderRange* range, int result);
+	protected:
+		int mDataOffset;
+		int mReceived;
+		int mRangesLeft;
+		MAUtil::Vector<DownloaderRange*> mRanges;
+	};
 }
 
 #endif /* _SE_MSAB_MAUTIL_DOWNLOADER_H_ */
@@ -47,6 +47,7 @@ void dummy_drawTextW(int left, int top, const wchar_t* text);
 void dummy_drawImage(MAHandle image, int left, int top);
 void dummy_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
 void dummy_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+void dummy_drawImageRegions(MAHandle image, MAImageRegion *regions, int count);
 void dummy_notifyImageUpdated(MAHandle image);
 void dummy_beginRendering(void);
 void dummy_updateScreen(void);
@@ -73,6 +74,7 @@ static MAGraphicsDriver sDummy = {
 	&dummy_drawImage,
 	&dummy_drawRGB,
 	&dummy_drawImageRegion,
+	&dummy_drawImageRegions,
 	&dummy_notifyImageUpdated,
 	&dummy_beginRendering,
 	&dummy_updateScreen,
@@ -162,6 +164,11 @@ void dummy_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2
 	graphicsDriver->drawImageRegion(image, srcRect, dstPoint, transformMode);
 }
 
+void dummy_drawImageRegions(MAHandle image, MAImageRegion *regions, int count)  {
+	Gfx_useDriverSoftware();
+	graphicsDriver->drawImageRegions(image, regions, count);
+}
+
 void dummy_notifyImageUpdated(MAHandle image)  {
 	Gfx_useDriverSoftware();
 	graphicsDriver->notifyImageUpdated(image);
@@ -198,6 +205,10 @@ void Gfx_useDriver(MAGraphicsDriver* driver) {
 	graphicsDriver = driver;
 }
 
+MAGraphicsDriver* Gfx_getDriver(void) {
+	return graphicsDriver;
+}
+
 void Gfx_setup(int x, int y, int w, int h) {
 	graphicsDriver->setup(x, y, w, h);
 
@@ -259,6 +270,16 @@ BOOL Gfx_restoreClipRect(void) {
 	else return FALSE;
 }
 
+/** Stores the current clip rect, in screen coordinates, in \a rect.
+*  Returns true if its area is > 0, otherwise false.
+**/
+BOOL Gfx_getClipRect(MARect* rect) {
+	_Gfx_init();
+	*rect = sClipStack[sClipStackPtr];
+	if(rect->width>0 && rect->height>0) return TRUE;
+	else return FALSE;
+}
+
 /** Pushes the specified clip rect on the stack and sets it as the current.
 *  Returns true if the area of the clip rect is > 0, otherwise false. 
 **/
@@ -540,6 +561,10 @@ void Gfx_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d
 	graphicsDriver->drawImageRegion(image, srcRect, dstPoint, transformMode);
 }
 
+void Gfx_drawImageRegions(MAHandle image, MAImageRegion *regions, int count) {
+	graphicsDriver->drawImageRegions(image, regions, count);
+}
+
 void Gfx_notifyImageUpdated(MAHandle image) {
 	graphicsDriver->notifyImageUpdated(image);
 }
@@ -36,6 +36,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #include "GraphicsOpenGL.h"
 #include "GraphicsSoftware.h"
+#include "GraphicsDisplayList.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +68,7 @@ typedef void (*DrawTextWFunc)(int left, int top, const wchar_t* text);
 typedef void (*DrawImageFunc)(MAHandle image, int left, int top);
 typedef void (*DrawRGBFunc)(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
 typedef void (*DrawImageRegionFunc)(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+typedef void (*DrawImageRegionsFunc)(MAHandle image, MAImageRegion *regions, int count);
 typedef void (*NotifyImageUpdated)(MAHandle image);
 typedef void (*BeginRendering)(void);
 typedef void (*UpdateScreen)(void);
@@ -94,6 +96,7 @@ typedef struct MAGraphicsDriver_t {
 	DrawImageFunc drawImage;
 	DrawRGBFunc drawRGB;
 	DrawImageRegionFunc drawImageRegion;
+	DrawImageRegionsFunc drawImageRegions;
 	NotifyImageUpdated notifyImageUpdated; // not very pretty (for opengl so that it knows that it has to update the texture again)
 	BeginRendering beginRendering;
 	UpdateScreen updateScreen;
@@ -105,6 +108,9 @@ typedef struct MAGraphicsDriver_t {
 
 void Gfx_useDriver(MAGraphicsDriver* driver);
 
+/** Returns the driver that is currently used. **/
+MAGraphicsDriver* Gfx_getDriver(void);
+
 void Gfx_setup(int x, int y, int w, int h);
 
 /** 
@@ -117,6 +123,11 @@ void Gfx_clearClipRect(void);
     **/
 BOOL Gfx_restoreClipRect(void);
 
+/** Stores the current clip rect, in screen coordinates, in \a rect.
+   *  Returns true if its area is > 0, otherwise false.
+   **/
+BOOL Gfx_getClipRect(MARect* rect);
+
 /** Pushes the specified clip rect on the stack and sets it as the current.
    *  Returns true if the area of the clip rect is > 0, otherwise false. 
    **/
@@ -169,6 +180,11 @@ void Gfx_drawTextW(int left, int top, const wchar_t* text);
 void Gfx_drawImage(MAHandle image, int left, int top);
 void Gfx_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
 void Gfx_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+/** Draws count untransformed regions of image, like calling Gfx_drawImageRegion() for each,
+  * but with a single syscall where the runtime supports it.
+  * The destination points are translated in place by the current transform.
+  **/
+void Gfx_drawImageRegions(MAHandle image, MAImageRegion *regions, int count);
 
 void Gfx_notifyImageUpdated(MAHandle image);
 
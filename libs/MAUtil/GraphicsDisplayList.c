@@ -0,0 +1,365 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#include "GraphicsDisplayList.h"
+#include <maassert.h>
+#include <maheap.h>
+#include <mastring.h>
+
+#define MA_TRANSFORM_STACK_DEPTH 128
+#define MA_DISPLAY_LIST_INITIAL_CAPACITY 256
+
+#define false 0
+#define true 1
+
+static MADisplayList* sList = NULL;
+static MAGraphicsDriver* sPreviousDriver = NULL;
+
+static MAPoint2d sTransformStack[MA_TRANSFORM_STACK_DEPTH];
+static int sTransformStackPtr = -1;
+static MAPoint2d sCurrentOffset = {0, 0};
+
+// driver setup
+static void dl_setup(int x, int y, int w, int h);
+static void dl_setClipRect(int x, int y, int w, int h);
+static void dl_clearMatrix(void);
+static void dl_pushMatrix(void);
+static void dl_popMatrix(void);
+static void dl_translate(int x, int y);
+static MAPoint2d dl_getTranslation(void);
+static void dl_scale(MAFixed x, MAFixed y);
+static void dl_plot(int x, int y);
+static void dl_line(int x1, int y1, int x2, int y2);
+static void dl_fillRect(int left, int top, int width, int height);
+static void dl_drawText(int left, int top, const char* text);
+static void dl_drawTextW(int left, int top, const wchar_t* text);
+static void dl_drawImage(MAHandle image, int left, int top);
+static void dl_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
+static void dl_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+static void dl_drawImageRegions(MAHandle image, MAImageRegion *regions, int count);
+static void dl_notifyImageUpdated(MAHandle image);
+static void dl_beginRendering(void);
+static void dl_updateScreen(void);
+static void dl_setClearColor(int r, int g, int b);
+static void dl_setColor(int r, int g, int b);
+static void dl_setAlpha(int a);
+
+static MAGraphicsDriver sDisplayListDriver = {
+	&dl_setup,
+	&dl_setClipRect,
+	&dl_clearMatrix,
+	&dl_pushMatrix,
+	&dl_popMatrix,
+	&dl_translate,
+	&dl_getTranslation,
+	&dl_scale,
+	&dl_plot,
+	&dl_line,
+	&dl_fillRect,
+	&dl_drawText,
+	&dl_drawTextW,
+	&dl_drawImage,
+	&dl_drawRGB,
+	&dl_drawImageRegion,
+	&dl_drawImageRegions,
+	&dl_notifyImageUpdated,
+	&dl_beginRendering,
+	&dl_updateScreen,
+	&dl_setClearColor,
+	&dl_setColor,
+	&dl_setAlpha
+};
+
+// Appends a command of the given length in words, header included,
+// and returns a pointer to it.
+static int* dl_addCommand(int op, int length) {
+	int* cmd;
+	if(sList->size + length > sList->capacity) {
+		int capacity = sList->capacity ? sList->capacity : MA_DISPLAY_LIST_INITIAL_CAPACITY;
+		int* commands;
+		while(capacity < sList->size + length)
+			capacity *= 2;
+		commands = (int*)realloc(sList->commands, capacity * sizeof(int));
+		if(!commands) {
+			PANIC_MESSAGE("Display list out of memory");
+		}
+		sList->commands = commands;
+		sList->capacity = capacity;
+	}
+	cmd = sList->commands + sList->size;
+	sList->size += length;
+	cmd[0] = op | (length << 8);
+	return cmd;
+}
+
+void Gfx_initDisplayList(MADisplayList* list) {
+	list->commands = NULL;
+	list->size = 0;
+	list->capacity = 0;
+}
+
+void Gfx_freeDisplayList(MADisplayList* list) {
+	if(list == sList) {
+		PANIC_MESSAGE("Display list is being recorded");
+	}
+	free(list->commands);
+	Gfx_initDisplayList(list);
+}
+
+void Gfx_beginDisplayList(MADisplayList* list) {
+	MARect clip;
+	if(sList) {
+		PANIC_MESSAGE("Display lists cannot be nested");
+	}
+	sList = list;
+	list->size = 0;
+
+	sPreviousDriver = Gfx_getDriver();
+	sCurrentOffset = sPreviousDriver->getTranslation();
+	sTransformStackPtr = 0;
+	sTransformStack[0] = sCurrentOffset;
+	Gfx_useDriver(&sDisplayListDriver);
+
+	Gfx_getClipRect(&clip);
+	dl_setClipRect(clip.left, clip.top, clip.width, clip.height);
+}
+
+void Gfx_endDisplayList(void) {
+	if(!sList) {
+		PANIC_MESSAGE("No display list is being recorded");
+	}
+	Gfx_useDriver(sPreviousDriver);
+	sList = NULL;
+}
+
+// Cleared when the runtime turns out not to support maDrawCommands.
+static BOOL sHaveDrawCommands = true;
+
+void Gfx_drawDisplayList(const MADisplayList* list) {
+	const int* cmd = list->commands;
+	const int* end = list->commands + list->size;
+
+	if(sList) {
+		PANIC_MESSAGE("Display lists cannot be drawn while recording");
+	}
+	if(list->size == 0)
+		return;
+
+	if(sHaveDrawCommands) {
+		if(maDrawCommands(list->commands, list->size) != IOCTL_UNAVAILABLE) {
+			Gfx_restoreClipRect();
+			return;
+		}
+		sHaveDrawCommands = false;
+	}
+
+	while(cmd < end) {
+		switch(cmd[0] & 0xff) {
+		case GFX_CMD_SET_CLIP_RECT:
+			maSetClipRect(cmd[1], cmd[2], cmd[3], cmd[4]);
+			break;
+		case GFX_CMD_SET_COLOR:
+			maSetColor(cmd[1]);
+			break;
+		case GFX_CMD_PLOT:
+			maPlot(cmd[1], cmd[2]);
+			break;
+		case GFX_CMD_LINE:
+			maLine(cmd[1], cmd[2], cmd[3], cmd[4]);
+			break;
+		case GFX_CMD_FILL_RECT:
+			maFillRect(cmd[1], cmd[2], cmd[3], cmd[4]);
+			break;
+		case GFX_CMD_DRAW_TEXT:
+			maDrawText(cmd[1], cmd[2], (const char*)(cmd + 3));
+			break;
+		case GFX_CMD_DRAW_TEXT_W:
+			maDrawTextW(cmd[1], cmd[2], (const wchar_t*)(cmd + 3));
+			break;
+		case GFX_CMD_DRAW_IMAGE:
+			maDrawImage(cmd[1], cmd[2], cmd[3]);
+			break;
+		case GFX_CMD_DRAW_RGB:
+			maDrawRGB((const MAPoint2d*)(cmd + 1), (const void*)cmd[3],
+				(const MARect*)(cmd + 4), cmd[8]);
+			break;
+		case GFX_CMD_DRAW_IMAGE_REGION:
+			maDrawImageRegion(cmd[1], (const MARect*)(cmd + 3),
+				(const MAPoint2d*)(cmd + 7), cmd[2]);
+			break;
+		}
+		cmd += (unsigned int)cmd[0] >> 8;
+	}
+	Gfx_restoreClipRect();
+}
+
+static void dl_setup(int x, int y, int w, int h) {
+}
+
+static void dl_setClipRect(int x, int y, int w, int h) {
+	int* cmd = dl_addCommand(GFX_CMD_SET_CLIP_RECT, 5);
+	cmd[1] = x;
+	cmd[2] = y;
+	cmd[3] = w;
+	cmd[4] = h;
+}
+
+static void dl_clearMatrix(void) {
+	sTransformStackPtr = 0;
+	sCurrentOffset.x = 0;
+	sCurrentOffset.y = 0;
+	sTransformStack[0].x = 0;
+	sTransformStack[0].y = 0;
+}
+
+static void dl_pushMatrix(void) {
+	if(sTransformStackPtr >= MA_TRANSFORM_STACK_DEPTH-1) {
+		PANIC_MESSAGE("Transform stack overflow");
+		return;
+	}
+
+	sTransformStackPtr++;
+	sTransformStack[sTransformStackPtr] = sCurrentOffset;
+}
+
+static void dl_popMatrix(void) {
+	if(sTransformStackPtr < 0) {
+		PANIC_MESSAGE("Transform stack underflow");
+		return;
+	}
+	sCurrentOffset = sTransformStack[sTransformStackPtr];
+	sTransformStackPtr--;
+}
+
+static void dl_translate(int x, int y) {
+	sCurrentOffset.x += x;
+	sCurrentOffset.y += y;
+}
+
+static MAPoint2d dl_getTranslation(void) {
+	return sCurrentOffset;
+}
+
+static void dl_scale(MAFixed x, MAFixed y) {
+}
+
+static void dl_plot(int x, int y) {
+	int* cmd = dl_addCommand(GFX_CMD_PLOT, 3);
+	cmd[1] = sCurrentOffset.x + x;
+	cmd[2] = sCurrentOffset.y + y;
+}
+
+static void dl_line(int x1, int y1, int x2, int y2) {
+	int* cmd = dl_addCommand(GFX_CMD_LINE, 5);
+	cmd[1] = sCurrentOffset.x + x1;
+	cmd[2] = sCurrentOffset.y + y1;
+	cmd[3] = sCurrentOffset.x + x2;
+	cmd[4] = sCurrentOffset.y + y2;
+}
+
+static void dl_fillRect(int left, int top, int width, int height) {
+	int* cmd = dl_addCommand(GFX_CMD_FILL_RECT, 5);
+	cmd[1] = sCurrentOffset.x + left;
+	cmd[2] = sCurrentOffset.y + top;
+	cmd[3] = width;
+	cmd[4] = height;
+}
+
+static void dl_drawText(int left, int top, const char* text) {
+	int size = strlen(text) + 1;
+	int words = (size + sizeof(int) - 1) / sizeof(int);
+	int* cmd = dl_addCommand(GFX_CMD_DRAW_TEXT, 3 + words);
+	cmd[1] = sCurrentOffset.x + left;
+	cmd[2] = sCurrentOffset.y + top;
+	cmd[2 + words] = 0;
+	memcpy(cmd + 3, text, size);
+}
+
+static void dl_drawTextW(int left, int top, const wchar_t* text) {
+	int size;
+	int words;
+	int* cmd;
+	const wchar_t* p = text;
+	while(*p)
+		p++;
+	size = (p - text + 1) * sizeof(wchar_t);
+	words = (size + sizeof(int) - 1) / sizeof(int);
+	cmd = dl_addCommand(GFX_CMD_DRAW_TEXT_W, 3 + words);
+	cmd[1] = sCurrentOffset.x + left;
+	cmd[2] = sCurrentOffset.y + top;
+	cmd[2 + words] = 0;
+	memcpy(cmd + 3, text, size);
+}
+
+static void dl_drawImage(MAHandle image, int left, int top) {
+	int* cmd = dl_addCommand(GFX_CMD_DRAW_IMAGE, 4);
+	cmd[1] = image;
+	cmd[2] = sCurrentOffset.x + left;
+	cmd[3] = sCurrentOffset.y + top;
+}
+
+static void dl_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength) {
+	int* cmd = dl_addCommand(GFX_CMD_DRAW_RGB, 9);
+	cmd[1] = sCurrentOffset.x + dstPoint->x;
+	cmd[2] = sCurrentOffset.y + dstPoint->y;
+	cmd[3] = (int)src;
+	cmd[4] = srcRect->left;
+	cmd[5] = srcRect->top;
+	cmd[6] = srcRect->width;
+	cmd[7] = srcRect->height;
+	cmd[8] = scanlength;
+}
+
+static void dl_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode) {
+	int* cmd = dl_addCommand(GFX_CMD_DRAW_IMAGE_REGION, 9);
+	cmd[1] = image;
+	cmd[2] = transformMode;
+	cmd[3] = srcRect->left;
+	cmd[4] = srcRect->top;
+	cmd[5] = srcRect->width;
+	cmd[6] = srcRect->height;
+	cmd[7] = sCurrentOffset.x + dstPoint->x;
+	cmd[8] = sCurrentOffset.y + dstPoint->y;
+}
+
+static void dl_drawImageRegions(MAHandle image, MAImageRegion *regions, int count) {
+	int i;
+	for(i = 0; i < count; i++) {
+		dl_drawImageRegion(image, &regions[i].srcRect, &regions[i].dstPoint, TRANS_NONE);
+	}
+}
+
+static void dl_notifyImageUpdated(MAHandle image) {
+	sPreviousDriver->notifyImageUpdated(image);
+}
+
+static void dl_beginRendering(void) {
+}
+
+static void dl_updateScreen(void) {
+}
+
+static void dl_setClearColor(int r, int g, int b) {
+}
+
+static void dl_setColor(int r, int g, int b) {
+	int* cmd = dl_addCommand(GFX_CMD_SET_COLOR, 2);
+	cmd[1] = r<<16 | g<<8 | b;
+}
+
+static void dl_setAlpha(int a) {
+}
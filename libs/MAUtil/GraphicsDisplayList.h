@@ -0,0 +1,85 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+/**
+ * \file GraphicsDisplayList.h
+ * \brief Recording of graphics calls into display lists.
+ *
+ * While a display list is being recorded, the Gfx_* drawing functions are
+ * stored in it as a compact command buffer instead of being drawn.
+ * The clip and transform stacks work as usual, and the commands are stored
+ * in screen coordinates. A recorded list can then be drawn any number of
+ * times with Gfx_drawDisplayList(), which makes a single syscall for the
+ * whole list if the runtime supports it.
+ *
+ * Only Gfx_* calls are recorded. Colors must be set with Gfx_setColor(),
+ * not maSetColor(). Lists are drawn with the runtime's 2D syscalls, like the
+ * software driver.
+ */
+
+#define _NO_OLDNAMES	//avoid conflicts with y1()
+#include <ma.h>
+
+#ifndef _SE_MSAB_MAUTIL_GRAPHICS_DISPLAY_LIST_H_
+#define _SE_MSAB_MAUTIL_GRAPHICS_DISPLAY_LIST_H_
+
+#include "Graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A buffer of draw commands, in the format of maDrawCommands().
+	 * Initialize it with Gfx_initDisplayList().
+	 */
+	typedef struct MADisplayList_t {
+		int* commands;
+		/// The number of words used.
+		int size;
+		/// The number of words allocated.
+		int capacity;
+	} MADisplayList;
+
+	/** Initializes an empty display list. **/
+	void Gfx_initDisplayList(MADisplayList* list);
+
+	/** Frees the memory used by a display list, leaving it empty. **/
+	void Gfx_freeDisplayList(MADisplayList* list);
+
+	/**
+	 * Starts recording into \a list, discarding what it held before.
+	 * The current clip rect and translation are kept, and the clip rect
+	 * is recorded first. Lists cannot be nested.
+	 */
+	void Gfx_beginDisplayList(MADisplayList* list);
+
+	/** Stops recording and goes back to the driver used before. **/
+	void Gfx_endDisplayList(void);
+
+	/**
+	 * Draws a recorded display list. The current clip rect is restored
+	 * afterwards. Pixel data passed to Gfx_drawRGB() while recording is
+	 * not copied, so it must still be valid.
+	 */
+	void Gfx_drawDisplayList(const MADisplayList* list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,6 +37,7 @@ static void ogl_drawTextW(int left, int top, const wchar_t* text);
 static void ogl_drawImage(MAHandle image, int left, int top);
 static void ogl_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
 static void ogl_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+static void ogl_drawImageRegions(MAHandle image, MAImageRegion *regions, int count);
 static void ogl_notifyImageUpdated(MAHandle image);
 static void ogl_beginRendering(void);
 static void ogl_updateScreen(void);
@@ -64,6 +65,7 @@ static MAGraphicsDriver sGLGraphicsDriver = {
 	&ogl_drawImage,
 	&ogl_drawRGB,
 	&ogl_drawImageRegion,
+	&ogl_drawImageRegions,
 	&ogl_notifyImageUpdated,
 	&ogl_beginRendering,
 	&ogl_updateScreen,
@@ -339,6 +341,13 @@ static void ogl_drawImageRegion(MAHandle image, const MARect *srcRect, const MAP
 	drawImage(textureCoords, vertexCoords, texture);
 }
 
+static void ogl_drawImageRegions(MAHandle image, MAImageRegion *regions, int count) {
+	int i;
+	for(i = 0; i < count; i++) {
+		ogl_drawImageRegion(image, &regions[i].srcRect, &regions[i].dstPoint, TRANS_NONE);
+	}
+}
+
 static void ogl_notifyImageUpdated(MAHandle image) {
 	int i;
 	GLuint handle;
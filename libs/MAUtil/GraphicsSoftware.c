@@ -48,6 +48,7 @@ static void soft_drawTextW(int left, int top, const wchar_t* text);
 static void soft_drawImage(MAHandle image, int left, int top);
 static void soft_drawRGB(const MAPoint2d *dstPoint, const void *src, const MARect *srcRect, int scanlength);
 static void soft_drawImageRegion(MAHandle image, const MARect *srcRect, const MAPoint2d *dstPoint, int transformMode);
+static void soft_drawImageRegions(MAHandle image, MAImageRegion *regions, int count);
 static void soft_notifyImageUpdated(MAHandle image);
 static void soft_beginRendering(void);
 static void soft_updateScreen(void);
@@ -72,6 +73,7 @@ static MAGraphicsDriver sSoftwareGraphicsDriver = {
 	&soft_drawImage,
 	&soft_drawRGB,
 	&soft_drawImageRegion,
+	&soft_drawImageRegions,
 	&soft_notifyImageUpdated,
 	&soft_beginRendering,
 	&soft_updateScreen,
@@ -186,6 +188,28 @@ static void soft_drawImageRegion(MAHandle image, const MARect *srcRect, const MA
 	maDrawImageRegion(image, srcRect, &p, transformMode);
 }
 
+// Cleared when the runtime turns out not to support maDrawImageRegions.
+static BOOL sHaveDrawImageRegions = true;
+
+static void soft_drawImageRegions(MAHandle image, MAImageRegion *regions, int count) {
+	int i;
+	if(sCurrentOffset.x != 0 || sCurrentOffset.y != 0) {
+		for(i = 0; i < count; i++) {
+			regions[i].dstPoint.x += sCurrentOffset.x;
+			regions[i].dstPoint.y += sCurrentOffset.y;
+		}
+	}
+
+	if(sHaveDrawImageRegions) {
+		if(maDrawImageRegions(image, regions, count) != IOCTL_UNAVAILABLE)
+			return;
+		sHaveDrawImageRegions = false;
+	}
+	for(i = 0; i < count; i++) {
+		maDrawImageRegion(image, &regions[i].srcRect, &regions[i].dstPoint, TRANS_NONE);
+	}
+}
+
 static void soft_notifyImageUpdated(MAHandle image) {
 }
 
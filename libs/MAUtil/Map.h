@@ -36,7 +36,6 @@ public:
 	typedef Pair<Key, Value> MutableStorage;
 protected:
 	typedef Dictionary<const Key, PairKV> D;
-	typedef typename D::DictNode DN;
 public:
 
 	Map(int (*cf)(const Key&, const Key&) = &Compare<const Key>)
@@ -49,13 +48,12 @@ public:
 		return D::insert(pkv);
 	}
 	Value& operator[](const Key& key) {
-		DN* node = (DN*)dict_lookup(&this->mDict, &key);
-		if(node == NULL) {
+		typename D::Iterator itr = this->find(key);
+		if(itr == this->end()) {
 			PairKV p(key, Value());
-			node = new DN(p);
-			dict_insert(&this->mDict, node, &(node->data.first));
+			itr = D::insert(p).first;
 		}
-		return node->data.second;
+		return itr->second;
 	}
 };
 
@@ -18,6 +18,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <ma.h>
 #include <mastring.h>
 #include <mastdlib.h>
+#include <maxtoa.h>
 #include <maassert.h>
 #include <mavsprintf.h>
 #include "String.h"
@@ -28,61 +29,80 @@ namespace MAUtil {
 	int nV = 0;
 #endif
 
-	template<class Tchar> StringData<Tchar>::StringData(const Tchar* text, int len)
-		: Vector<Tchar>(len + 1), RefCounted(1)
-	{
-		this->resize(len);
-		this->mData[len] = 0;
-		memcpy(this->mData, text, len * sizeof(Tchar));
+	template<class Tchar> void StringData<Tchar>::init(const Tchar* text, int len) {
+		mRefCount = 1;
+		mSize = len;
+		mCapacity = len;
+		mData = new Tchar[len + 1];
+		MAASSERT(mData);
+		if(text)
+			memcpy(mData, text, len * sizeof(Tchar));
+		mData[len] = 0;
 	}
 
+	template<class Tchar> StringData<Tchar>::StringData(const Tchar* text, int len) {
+		init(text, len);
+	}
 
-	template<class Tchar> StringData<Tchar>::StringData(const Tchar* text)
-		: Vector<Tchar>(tstrlen(text) + 1), RefCounted(1)
-	{
-		int len = this->capacity() - 1;
-		this->resize(len);
-		memcpy(this->mData, text, this->capacity() * sizeof(Tchar));
+	template<class Tchar> StringData<Tchar>::StringData(const Tchar* text) {
+		init(text, tstrlen(text));
+	}
+
+	template<class Tchar> StringData<Tchar>::StringData(int len) {
+		init(NULL, len);
 	}
 
+	template<class Tchar> StringData<Tchar>::StringData(const StringData& other) {
+		init(other.pointer(), other.mSize);
+	}
 
-	template<class Tchar> StringData<Tchar>::StringData(int len)
-		: Vector<Tchar>(len+1), RefCounted(1)
+	template<class Tchar> StringData<Tchar>::StringData()
+		: mRefCount(1), mSize(0), mCapacity(0), mData(NULL)
 	{
-		this->resize(len);
-		this->mData[len] = 0;
 	}
 
+	template<class Tchar> StringData<Tchar>::~StringData() {
+		delete[] mData;
+	}
 
+	template<class Tchar> StringData<Tchar>* StringData<Tchar>::create(int len, int capacity) {
+		StringData* d = new(capacity) StringData();
+		MAASSERT(d);
+		d->mSize = len;
+		d->mCapacity = capacity;
+		d->pointer()[len] = 0;
+		return d;
+	}
 
-	template<class Tchar> StringData<Tchar>::StringData(const StringData& other)
-		: Vector<Tchar>(other.mSize+1), RefCounted(1)
-	{
-		this->mSize = other.mSize;
-		memcpy(this->mData, other.mData, (this->mSize+1) * sizeof(Tchar));
+	template<class Tchar> void* StringData<Tchar>::operator new(size_t size) {
+		return ::operator new(size);
+	}
+
+	template<class Tchar> void* StringData<Tchar>::operator new(size_t size, int capacity) {
+		return ::operator new(size + (capacity + 1) * sizeof(Tchar));
+	}
+
+	template<class Tchar> void StringData<Tchar>::operator delete(void* p) {
+		::operator delete(p);
+	}
+
+	template<class Tchar> void StringData<Tchar>::operator delete(void* p, int) {
+		::operator delete(p);
 	}
 
 #ifdef HAVE_EMPTY_STRING
 	const BasicString* BasicString<Tchar>::EMPTY_STRING = NULL;
 #endif
 
-	template<class Tchar> static StringData<Tchar>* getEmptyData() {
-		static StringData<Tchar>* ed = NULL;
-		if(ed == NULL) {
-			ed = new StringData<Tchar>(0);
-			MAASSERT(ed);
-		}
-		ed->addRef();
-		return ed;
-	}
-
 	template<class Tchar> BasicString<Tchar>::BasicString() {
-		sd = getEmptyData<Tchar>();
+		sd = NULL;
+		setSize(0);
 	}
 
 	template<class Tchar> BasicString<Tchar>::BasicString(int aCapacity) {
-		sd = new StringData<Tchar>(aCapacity);
-		resize(0);
+		sd = NULL;
+		setSize(0);
+		reserve(aCapacity);
 	}
 
 	template<class Tchar> void BasicString<Tchar>::allocStringData(const Tchar* text, int len) {
@@ -90,12 +110,17 @@ namespace MAUtil {
 			maPanic(0, "BasicString(const Tchar* text, int len), passed a negative length.");
 		}
 
-		if(text == NULL || *text == 0 || len == 0) {
-			sd = getEmptyData<Tchar>();
+		if(text == NULL || *text == 0) {
+			len = 0;
+		}
+		if(len <= SMALL_MAX) {
+			sd = NULL;
+			memcpy(mSmall, text, len * sizeof(Tchar));
+			setSize(len);
 		} else {
-			sd = new StringData<Tchar>(text, len);
-			MAASSERT(sd);
-		}		
+			sd = StringData<Tchar>::create(len, len);
+			memcpy(sd->pointer(), text, len * sizeof(Tchar));
+		}
 	}
 
 	template<class Tchar> BasicString<Tchar>::BasicString(const Tchar* text, int len) {
@@ -110,29 +135,39 @@ namespace MAUtil {
 
 	template<class Tchar> BasicString<Tchar>::BasicString(const BasicString& s) {
 		sd = s.sd;
-		sd->addRef();
+		if(sd)
+			sd->addRef();
+		else
+			memcpy(mSmall, s.mSmall, sizeof(mSmall));
 	}
 
 	template<class Tchar> const Tchar* BasicString<Tchar>::c_str() const {
-		return (const Tchar*) sd->mData;
+		return sd ? sd->pointer() : mSmall;
 	}
 
 	template<class Tchar> BasicString<Tchar>& BasicString<Tchar>::operator=(const BasicString& s) {
+		if(this == &s)
+			return *this;
 		StringData<Tchar>* old = sd;
 		sd = s.sd;
-		sd->addRef();
-		old->release();
+		if(sd)
+			sd->addRef();
+		else
+			memcpy(mSmall, s.mSmall, sizeof(mSmall));
+		if(old)
+			old->release();
 		return *this;
 	}
 
 	template<class Tchar> bool BasicString<Tchar>::operator==(const BasicString& other) const {
-		if(this->length() != other.length())
+		int len = this->length();
+		if(len != other.length())
 			return false;
 
-		if(this->sd == other.sd)
+		if(this->sd == other.sd && this->sd)
 			return true;
 
-		return tstrcmp(this->sd->mData, other.sd->mData)==0;
+		return memcmp(c_str(), other.c_str(), len * sizeof(Tchar)) == 0;
 	}
 
 	template<class Tchar> bool BasicString<Tchar>::operator!=(const BasicString& other) const {
@@ -161,59 +196,35 @@ namespace MAUtil {
 
 
 	template<class Tchar> Tchar& BasicString<Tchar>::operator[](int index) {
-		//if memory is shared, do copy on write
-
-		if(sd->getRefCount() > 1) {
-			StringData<Tchar>* newSd = new StringData<Tchar>(*sd);
-			MAASSERT(newSd);
-			sd->release();
-			sd = newSd;
-		}
-
-		return sd->mData[index];
+		return pointer()[index];
 	}
 
 #ifndef NEW_OPERATORS
 	template<class Tchar>
 	BasicString<Tchar> BasicString<Tchar>::operator+(const BasicString<Tchar>& other) const {
-#if 0
-		BasicString ret = *this;
-		//MAASSERT(sd->getRefCount() > 1);
-
-		StringData* newSd = new StringData(&((*sd)[0]));
-		MAASSERT(newSd);
-		sd->release();
-		ret.sd = newSd;
-		for(int i = 0; i < other.size(); i++) {
-			ret.sd->add(other[i]);
-		}
-		ret.sd->reserve(ret.size()+1);
-		ret[ret.size()] = '\0';
-		return ret;
-#else
-		BasicString<Tchar> s = *this;
-		s += other;
+		BasicString<Tchar> s(length() + other.length());
+		s.append(c_str(), length());
+		s.append(other.c_str(), other.length());
 		return s;
-#endif
 	}
 
 
 	template<class Tchar> void BasicString<Tchar>::append(const Tchar* other, int len) {
-		//order of operations is important here.
 		int oldLen = length();
-		int otherLen = len;
-		int newLen = oldLen + otherLen;
-		if(sd->getRefCount() > 1) {
-			StringData<Tchar>* newSd = new StringData<Tchar>(newLen);
-			memcpy(newSd->pointer(), sd->pointer(), oldLen * sizeof(Tchar));
-			sd->release();
-			sd = newSd;
+		int newLen = oldLen + len;
+		if(isWritable(newLen)) {
+			memcpy(pointer() + oldLen, other, len * sizeof(Tchar));
 		} else {
-			sd->reserve(newLen + 1);
+			// other may point into this string, so keep the old data alive until it's copied.
+			StringData<Tchar>* old = sd;
+			if(old)
+				old->addRef();
+			grow(newLen);
+			memcpy(sd->pointer() + oldLen, other, len * sizeof(Tchar));
+			if(old)
+				old->release();
 		}
-		memcpy(sd->pointer() + oldLen, other, otherLen * sizeof(Tchar));
-		pointer()[newLen] = 0;
-		sd->resize(newLen);		
+		setSize(newLen);
 	}
 
 	template<class Tchar>
@@ -224,8 +235,9 @@ namespace MAUtil {
 
 #if 1
 	template<class Tchar> BasicString<Tchar> BasicString<Tchar>::operator+(Tchar c) const {
-		BasicString s = *this;
-		s += c;
+		BasicString s(length() + 1);
+		s.append(c_str(), length());
+		s.append(&c, 1);
 		return s;
 	}
 
@@ -238,12 +250,14 @@ namespace MAUtil {
 
 	template<class Tchar>
 	int BasicString<Tchar>::find(const BasicString<Tchar>& s, unsigned int offset) const {
-		if (s.length()+offset <= (unsigned int)sd->size()) {
+		const Tchar* data = c_str();
+		int size = length();
+		if (s.length()+offset <= (unsigned int)size) {
 			if (!s.length())
 				return ((int) offset);	// Empty string is always found
-			const Tchar *str = (const Tchar*) sd->mData + offset;
+			const Tchar *str = data + offset;
 			const Tchar *search = s.c_str();
-			const Tchar *end = sd->mData + sd->size() - s.length() + 1;
+			const Tchar *end = data + size - s.length() + 1;
 			const Tchar *search_end = s.c_str() + s.length();
 skipp:
 			while (str != end) {
@@ -253,7 +267,7 @@ skipp:
 					j=(Tchar*) search+1;
 					while (j != search_end)
 						if (*i++ != *j++) goto skipp;
-					return (int) (str - sd->mData) - 1;
+					return (int) (str - data) - 1;
 				}
 			}
 		}
@@ -283,54 +297,45 @@ skipp:
 		return npos;
 	}
 
+	template<class Tchar>
+	void BasicString<Tchar>::insertChars(int position, const Tchar* text, int len) {
+		int oldLen = this->length();
+		int newLen = oldLen + len;
+		if(!isWritable(newLen))
+			grow(newLen);
+		Tchar* data = pointer();
+		memmove(data + position + len, data + position, (oldLen - position) * sizeof(Tchar));
+		memcpy(data + position, text, len * sizeof(Tchar));
+		setSize(newLen);
+	}
+
 	template<class Tchar>
 	void BasicString<Tchar>::insert(int position, const BasicString<Tchar>& other) {
-		int otherLen = other.length();
-		int newLen = this->length() + otherLen;
-		this->resize(newLen);
-		int endpos = position + otherLen;
-		for(int i = newLen-1; i >= endpos; i--) {
-			(*sd)[i] = (*sd)[i-otherLen];
-		}
-		for(int i = 0; i < otherLen; i++) {
-			(*sd)[position++] = other[i];
-		}
+		// the copy keeps the characters of other valid, even if other is this string.
+		BasicString<Tchar> copy(other);
+		insertChars(position, copy.c_str(), copy.length());
 	}
 
-	//TODO: cleanup
 	template<class Tchar> void BasicString<Tchar>::insert(int position, Tchar c) {
-		int otherLen = 1;
-		int newLen = this->length() + otherLen;
-		this->resize(newLen);
-		int endpos = position + otherLen;
-		for(int i = newLen-1; i >= endpos; i--) {
-			(*sd)[i] = (*sd)[i-otherLen];
-		}
-		for(int i = 0; i < otherLen; i++) {
-			(*sd)[position++] = c;
-		}
+		insertChars(position, &c, 1);
 	}
 
 	template<class Tchar> void BasicString<Tchar>::remove(int position, int number) {
-		if(sd->getRefCount() > 1) {
-			ASSERT_MSG(position >= 0 && position < this->length(), "invalid position");
-			ASSERT_MSG(number > 0 && (position + number) <= this->length(), "invalid number");
-			int newLen = size() - number;
-			StringData<Tchar>* temp = new StringData<Tchar>(newLen);
-			if(position > 0) {
-				memcpy(temp->pointer(), sd->pointer(), position * sizeof(Tchar));
-			}
-			if(position < newLen) {
-				memcpy(temp->pointer() + position, sd->pointer() + (position + number),
-					(newLen - position) * sizeof(Tchar));
-			}
-			sd->release();
-			sd = temp;
+		ASSERT_MSG(position >= 0 && position <= this->length(), "invalid position");
+		ASSERT_MSG(number >= 0 && (position + number) <= this->length(), "invalid number");
+		int newLen = size() - number;
+		if(sd && sd->getRefCount() > 1) {
+			// copy only the characters that remain.
+			BasicString<Tchar> temp(newLen);
+			temp.append(c_str(), position);
+			temp.append(c_str() + (position + number), newLen - position);
+			swap(temp);
 		} else {
-			sd->remove(position, number);
-			sd->reserve(sd->size() + 1);
+			Tchar* data = pointer();
+			memmove(data + position, data + (position + number),
+				(newLen - position) * sizeof(Tchar));
+			setSize(newLen);
 		}
-		(*sd)[sd->size()] = 0;
 	}
 
 	template<class Tchar>
@@ -340,69 +345,110 @@ skipp:
 			len = this->length() - startIndex;
 		ASSERT_MSG(len >= 0 && (startIndex+len) <= this->length(), "invalid length");
 
-		BasicString retString;
-#if 0
-		for(int i = startIndex; i < startIndex + len; i++) {
-			retString += (*this)[i];
-		}
-#else
-		if(len > 0) {
-			retString.sd->release();
-			retString.sd = new StringData<Tchar>(len);
-			memcpy(retString.sd->pointer(), sd->pointer() + startIndex, len * sizeof(Tchar));
-			retString[len] = 0;
-		}
-#endif
-		return retString;
+		return BasicString(c_str() + startIndex, len);
 	}
 
 
 	template<class Tchar> const Tchar& BasicString<Tchar>::operator[](int index) const {
-		return sd->mData[index];
+		return c_str()[index];
 	}
 
 	template<class Tchar> int BasicString<Tchar>::size() const {
-		return sd->size();
+		return sd ? sd->mSize : SMALL_MAX - (int)mSmall[SMALL_MAX];
 	}
 
 	template<class Tchar> int BasicString<Tchar>::length() const {
-		return sd->size();
+		return size();
 	}
 
 	template<class Tchar> int BasicString<Tchar>::capacity() const {
-		return sd->capacity() - 1;
+		return sd ? sd->mCapacity : SMALL_MAX;
 	}
 
 	template<class Tchar> BasicString<Tchar>::~BasicString() {
-		sd->release();
+		if(sd)
+			sd->release();
+	}
+
+	template<class Tchar> void BasicString<Tchar>::setSize(int len) {
+		if(sd) {
+			sd->mSize = len;
+			sd->pointer()[len] = 0;
+		} else {
+			mSmall[len] = 0;
+			mSmall[SMALL_MAX] = (Tchar)(SMALL_MAX - len);
+		}
+	}
+
+	template<class Tchar> bool BasicString<Tchar>::isWritable(int newCapacity) const {
+		if(sd == NULL)
+			return newCapacity <= SMALL_MAX;
+		return sd->mRefCount == 1 && newCapacity <= sd->mCapacity;
+	}
+
+	// Moves the characters to unshared space for newCapacity characters,
+	// which must be at least the current length.
+	template<class Tchar> void BasicString<Tchar>::reallocate(int newCapacity) {
+		int len = length();
+		StringData<Tchar>* old = sd;
+		if(newCapacity <= SMALL_MAX) {
+			if(old) {
+				memcpy(mSmall, old->pointer(), len * sizeof(Tchar));
+				sd = NULL;
+				setSize(len);
+				old->release();
+			}
+			return;
+		}
+		sd = StringData<Tchar>::create(len, newCapacity);
+		memcpy(sd->pointer(), old ? old->pointer() : mSmall, len * sizeof(Tchar));
+		if(old)
+			old->release();
+	}
+
+	template<class Tchar> void BasicString<Tchar>::grow(int newLen) {
+		int newCapacity = newLen;
+		if(newLen > SMALL_MAX) {
+			int cap = capacity();
+			cap += cap >> 1;
+			if(newCapacity < cap)
+				newCapacity = cap;
+		}
+		reallocate(newCapacity);
 	}
 
 	template<class Tchar> void BasicString<Tchar>::resize(int newLen) {
 		reserve(newLen);
-		sd->resize(newLen);
-		(*sd)[newLen] = 0;
+		setSize(newLen);
 	}
 
 	template<class Tchar> void BasicString<Tchar>::reserve(int newLen) {
-		if(sd->getRefCount() > 1) {
-			if(newLen < sd->capacity())
-				newLen = sd->capacity();
-			StringData<Tchar>* temp = new StringData<Tchar>(newLen);
-			temp->resize(sd->size());
-			memcpy(temp->pointer(), sd->pointer(), (sd->size() + 1) * sizeof(Tchar));
-			sd->release();
-			sd = temp;
-		} else {
-			sd->reserve(newLen+1);
-			(*sd)[sd->size()] = 0;
-		}
+		if(isWritable(newLen))
+			return;
+		int len = length();
+		if(newLen < len)
+			newLen = len;
+		if(sd && newLen < sd->mCapacity && newLen > SMALL_MAX)
+			newLen = sd->mCapacity;
+		reallocate(newLen);
 	}
 
 	template<class Tchar> void BasicString<Tchar>::clear() {
-		if(sd) {
+		if(sd && sd->getRefCount() > 1) {
 			sd->release();
+			sd = NULL;
 		}
-		sd = getEmptyData<Tchar>();
+		setSize(0);
+	}
+
+	template<class Tchar> void BasicString<Tchar>::swap(BasicString& other) {
+		StringData<Tchar>* tempSd = sd;
+		sd = other.sd;
+		other.sd = tempSd;
+		Tchar temp[SMALL_SIZE];
+		memcpy(temp, mSmall, sizeof(mSmall));
+		memcpy(mSmall, other.mSmall, sizeof(mSmall));
+		memcpy(other.mSmall, temp, sizeof(mSmall));
 	}
 
 #ifdef HAVE_EMPTY_STRING
@@ -412,12 +458,57 @@ skipp:
 #endif
 
 	template<class Tchar> void BasicString<Tchar>::setData(StringData<Tchar>* data) {
-		sd->release();
+		if(sd)
+			sd->release();
 		sd = data;
+		if(sd == NULL)
+			setSize(0);
 	}
 
 	template<class Tchar> Tchar* BasicString<Tchar>::pointer() {
-		return sd->pointer();
+		if(sd == NULL)
+			return mSmall;
+		//if memory is shared, do copy on write
+		if(sd->getRefCount() > 1)
+			reallocate(length());
+		return sd ? sd->pointer() : mSmall;
+	}
+
+	StringBuilder::StringBuilder(int capacity) : mString(capacity) {
+	}
+
+	StringBuilder& StringBuilder::append(const char* s, int len) {
+		mString.append(s, len);
+		return *this;
+	}
+
+	StringBuilder& StringBuilder::operator<<(const String& s) {
+		return append(s.c_str(), s.length());
+	}
+
+	StringBuilder& StringBuilder::operator<<(const char* s) {
+		return append(s, strlen(s));
+	}
+
+	StringBuilder& StringBuilder::operator<<(char c) {
+		return append(&c, 1);
+	}
+
+	StringBuilder& StringBuilder::operator<<(int i) {
+		char buf[16];
+		itoa(i, buf, 10);
+		return append(buf, strlen(buf));
+	}
+
+	StringBuilder& StringBuilder::operator<<(double d) {
+		char buf[32];
+		int len = sprintf(buf, "%g", d);
+		return append(buf, len);
+	}
+
+	void StringBuilder::moveTo(String& s) {
+		s.swap(mString);
+		mString.clear();
 	}
 
 	//explicit instantiation
@@ -82,24 +82,66 @@ namespace MAUtil {
 	/**
 	* \brief A class that holds the actual data used by String.
 	*
-	* It's a reference counted vector.
+	* It's a reference-counted character buffer. When created by String,
+	* the header and the characters share a single memory block.
 	*/
-	template<class Tchar> class StringData : public Vector<Tchar>, public RefCounted {
+	template<class Tchar> class StringData {
 	public:
 		StringData(const Tchar* text);
 		StringData(const Tchar* text, int len);
+		/** Makes room for \a len characters, which are undefined. */
 		StringData(int len);
 		StringData(const StringData& other);
+		~StringData();
+
+		/**
+		* Allocates a StringData with room for \a capacity characters,
+		* plus a null terminator, in the same memory block.
+		* The first \a len characters are undefined.
+		*/
+		static StringData* create(int len, int capacity);
+
+		/** Increments the reference count by one. */
+		void addRef() { mRefCount++; }
+		/** Decrements the reference count by one, and deletes the data when it reaches zero. */
+		void release() { if(--mRefCount == 0) delete this; }
+		/** Returns the current reference count. */
+		int getRefCount() const { return mRefCount; }
+
+		/** Returns a pointer to the null-terminated characters. */
+		Tchar* pointer() { return mData ? mData : (Tchar*)(this + 1); }
+		const Tchar* pointer() const { return mData ? mData : (const Tchar*)(this + 1); }
+		/** Returns the number of characters. */
+		int size() const { return mSize; }
+		/** Returns the number of characters that fit, not counting the null terminator. */
+		int capacity() const { return mCapacity; }
+
+		static void* operator new(size_t size);
+		static void operator delete(void* p);
+	private:
+		StringData();
+		StringData& operator=(const StringData&);
+		void init(const Tchar* text, int len);
+
+		static void* operator new(size_t size, int capacity);
+		static void operator delete(void* p, int capacity);
+
+		int mRefCount;
+		int mSize;
+		int mCapacity;
+		/** Separately allocated characters, or NULL if they follow the header. */
+		Tchar* mData;
+
 		template<class T> friend class BasicString;
-		virtual ~StringData() {}
 	};
 
 	/**
 	* \brief A dynamic, reference-counted string that behaves much like a subset of std::string.
 
-	* Each String references an instance of StringData, and these
-	* instances are shared between strings as much as possible by using
-	* the copy-on-write idiom.
+	* Short strings are stored inside the String object itself, and are
+	* never allocated or shared. Longer strings reference an instance of
+	* StringData, and these instances are shared between strings as much
+	* as possible by using the copy-on-write idiom.
 	*/
 	template<class Tchar> class BasicString {
 	public:
@@ -109,7 +151,7 @@ namespace MAUtil {
 		};
 
 		/**
-		* Initializes the new string with shared empty data.
+		* Initializes the new string as empty, without allocating.
 		*/
 		BasicString();
 
@@ -129,7 +171,7 @@ namespace MAUtil {
 		BasicString(const Tchar* text, int len);
 
 
-		/** Makes the new string share the data of \a s. */
+		/** Makes the new string share the data of \a s, or copies it if \a s is short. */
 		BasicString(const BasicString& s);
 
 		/** Returns a pointer to the null-terminated character data.
@@ -138,7 +180,7 @@ namespace MAUtil {
 		*/
 		const Tchar* c_str() const;
 
-		/** Makes this string share the \a other string's data. */
+		/** Makes this string share the \a other string's data, or copies it if \a other is short. */
 		BasicString& operator=(const BasicString& other);
 
 		/** Returns a reference to the character at position \a index. */
@@ -236,12 +278,22 @@ namespace MAUtil {
 		/** Reserves space in the string data object. */
 		void reserve(int newLen);
 
-		/** Resizes the string to zero. */
+		/** Resizes the string to zero. Unshared space is kept for reuse. */
 		void clear();
 
-		/** Appends a string at the end of the string. */
+		/**
+		* Appends a string at the end of the string.
+		* The space grows geometrically, so a series of appends is linear in time.
+		*/
 		void append(const Tchar* other, int len);
 
+		/**
+		* Exchanges the contents of this string and \a other, without copying
+		* any characters or touching reference counts.
+		* Use it to move a string out of an object that is about to be destroyed.
+		*/
+		void swap(BasicString& other);
+
 
 #ifdef HAVE_EMPTY_STRING
 		/** Returns a reference to an empty string. */
@@ -252,8 +304,8 @@ namespace MAUtil {
 		void setData(StringData<Tchar>* data);
 
 		/**
-		* Returns a pointer to the string data. The pointer becomes invalidated by
-		* any non-const method of this class.
+		* Returns a pointer to the string data, which is unshared first.
+		* The pointer becomes invalidated by any non-const method of this class.
 		*/
 		Tchar* pointer();
 
@@ -266,10 +318,32 @@ namespace MAUtil {
 		~BasicString();
 
 	protected:
+		enum {
+			/** The size of the inline buffer, in characters. */
+			SMALL_SIZE = 12 / sizeof(Tchar),
+			/** The length of the longest string stored inline. */
+			SMALL_MAX = SMALL_SIZE - 1
+		};
+
 		void allocStringData(const Tchar *text, int len);
-	
-		/** A pointer to the string data object shared by this string. */
+		void setSize(int len);
+		bool isWritable(int newCapacity) const;
+		void reallocate(int newCapacity);
+		void grow(int newLen);
+		void insertChars(int position, const Tchar* text, int len);
+
+		/**
+		* A pointer to the string data object shared by this string,
+		* or NULL if the string is stored in \a mSmall.
+		*/
 		StringData<Tchar>* sd;
+
+		/**
+		* The characters of a short string. The last element holds
+		* SMALL_MAX minus the length, so it doubles as the null terminator
+		* when the buffer is full.
+		*/
+		Tchar mSmall[SMALL_SIZE];
 #ifdef HAVE_EMPTY_STRING
 		/** a single empty string for convenience. */
 		static const BasicString* EMPTY_STRING;
@@ -279,6 +353,46 @@ namespace MAUtil {
 	typedef BasicString<char> String;
 	typedef BasicString<wchar_t> WString;
 
+	/**
+	* \brief Builds a String piece by piece, in one growing buffer.
+	*
+	* Unlike a chain of operator+, this creates no temporary strings.
+	* Numbers are formatted on the stack and appended directly.
+	*/
+	class StringBuilder {
+	public:
+		/** Reserves space for \a capacity characters. */
+		explicit StringBuilder(int capacity = 0);
+
+		StringBuilder& operator<<(const String& s);
+		StringBuilder& operator<<(const char* s);
+		StringBuilder& operator<<(char c);
+		StringBuilder& operator<<(int i);
+		/** Appends \a d in printf's %g format. */
+		StringBuilder& operator<<(double d);
+
+		/** Appends \a len characters from \a s. */
+		StringBuilder& append(const char* s, int len);
+
+		/** Returns the number of characters built so far. */
+		int size() const { return mString.size(); }
+
+		/** Returns the null-terminated characters built so far. */
+		const char* c_str() const { return mString.c_str(); }
+
+		/** Returns the string built so far. */
+		const String& str() const { return mString; }
+
+		/** Empties the builder, keeping its space for reuse. */
+		void clear() { mString.clear(); }
+
+		/** Moves the string built so far into \a s, and empties the builder. */
+		void moveTo(String& s);
+
+	private:
+		String mString;
+	};
+
 #ifdef NEW_OPERATORS
 
 	class StringDupeStream {
@@ -304,7 +418,7 @@ namespace MAUtil {
 		if(s.capacity() < newCap) {
 			s.reserve(newCap);
 		}
-		int usedSpace = StringTranscribe::transcribe(t, s.sd->pointer() + s.size());
+		int usedSpace = StringTranscribe::transcribe(t, s.pointer() + s.size());
 		s.resize(s.size() + usedSpace);
 		return StringStream(s);
 	}
@@ -0,0 +1,374 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+/**
+* \file DomStream.cpp
+* \brief Streaming DOM builder
+*/
+
+#include <mastring.h>
+#include <mactype.h>
+
+#include "DomStream.h"
+
+using namespace MAUtil;
+
+namespace Mtx
+{
+
+// Long enough for "&#x10FFFF;" and the longest named entity.
+#define MAX_REFERENCE_LENGTH 12
+
+/**
+ * Returns the number of bytes at the end of \a data that may be the start of a
+ * reference or a UTF-8 sequence that continues in the next feed.
+ * The parser would drop them, so they're kept for the next feed instead.
+ */
+static int incompleteTail(const char* data, int len)
+{
+	for (int i = 1;  i < 4 && i <= len;  i++)
+	{
+		const unsigned char c = data[len - i];
+		if (c < 0x80)
+			break;
+		if (c >= 0xC0)
+		{
+			const int seqLen = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+			return (seqLen > i) ? i : 0;
+		}
+	}
+	for (int i = 1;  i <= MAX_REFERENCE_LENGTH && i <= len;  i++)
+	{
+		const char c = data[len - i];
+		if (c == '&')
+			return i;
+		if (c == ';' || c == '<' || c == '>' || isspace(c))
+			break;
+	}
+	return 0;
+}
+
+//******************************************************************************
+// DomElement
+//******************************************************************************
+
+DomElement::DomElement(const char* name, const char** attributes, DomElement* parent) :
+	mName(name), mParent(parent)
+{
+	for (int i = 0;  attributes[i] != NULL;  i += 2)
+	{
+		mAttributes.add(attributes[i]);
+		mAttributes.add(attributes[i + 1]);
+	}
+}
+
+DomElement::~DomElement(void)
+{
+	for (int i = 0;  i < mChildren.size();  i++)
+		delete mChildren[i];
+}
+
+const String& DomElement::getName(void) const
+{
+	return mName;
+}
+
+const String* DomElement::getAttribute(const char* name) const
+{
+	for (int i = 0;  i < mAttributes.size();  i += 2)
+	{
+		if (mAttributes[i] == name)
+			return &mAttributes[i + 1];
+	}
+	return NULL;
+}
+
+int DomElement::getAttributeCount(void) const
+{
+	return mAttributes.size() / 2;
+}
+
+const String& DomElement::getAttributeName(int index) const
+{
+	return mAttributes[index * 2];
+}
+
+const String& DomElement::getAttributeValue(int index) const
+{
+	return mAttributes[index * 2 + 1];
+}
+
+const Vector<DomElement*>& DomElement::getChildren(void) const
+{
+	return mChildren;
+}
+
+const DomElement* DomElement::getChild(const char* name) const
+{
+	for (int i = 0;  i < mChildren.size();  i++)
+	{
+		if (mChildren[i]->mName == name)
+			return mChildren[i];
+	}
+	return NULL;
+}
+
+const String& DomElement::getText(void) const
+{
+	return mText;
+}
+
+const DomElement* DomElement::getParent(void) const
+{
+	return mParent;
+}
+
+//******************************************************************************
+// DomStreamParser
+//******************************************************************************
+
+DomStreamParser::DomStreamParser(void) :
+	mListener(NULL), mMaxElements(-1), mElementCount(0), mStopped(true),
+	mRoot(NULL), mCurrent(NULL), mReadyPos(0), mRemainsPos(0), mRemainsLength(0)
+{
+}
+
+DomStreamParser::~DomStreamParser(void)
+{
+	stop();
+	clearElements();
+}
+
+bool DomStreamParser::compile(const char* path)
+{
+	mSteps.clear();
+	if (path[0] != '/')
+		return false;
+
+	const char* p = path;
+	while (*p != '\0')
+	{
+		// Every step starts with / or //.
+		if (*p != '/')
+			return false;
+		Step step;
+		step.descendant = (p[1] == '/');
+		p += step.descendant ? 2 : 1;
+
+		const char* start = p;
+		while (*p != '\0' && *p != '/')
+		{
+			// Predicates, attributes, functions and unions need the whole tree.
+			if (strchr("[]@()=|'\"", *p) != NULL)
+				return false;
+			p++;
+		}
+		step.name = String(start, p - start);
+		if (step.name.length() == 0 || step.name == "." || step.name == "..")
+			return false;
+		mSteps.add(step);
+	}
+	// One bit for each step, plus one for the document.
+	return mSteps.size() < 31;
+}
+
+bool DomStreamParser::start(const char* path, DomStreamListener* listener,
+	int maxElements)
+{
+	stop();
+	clearElements();
+	if (!compile(path))
+		return false;
+	mListener = listener;
+	mMaxElements = maxElements;
+	mElementCount = 0;
+	mStates.clear();
+	mStates.add(1);
+	mBuffer.clear();
+	mRemainsLength = 0;
+	mStopped = false;
+	mContext.start(*this, *this);
+	return true;
+}
+
+bool DomStreamParser::feed(const char* data, int len)
+{
+	if (mStopped)
+		return false;
+	// The parser wants a single null-terminated buffer, which it alters,
+	// with the data that was left over from the last feed first.
+	const int total = mRemainsLength + len;
+	mBuffer.resize(total + 1);
+	memcpy(mBuffer.pointer() + mRemainsLength, data, len);
+	const int end = total - incompleteTail(mBuffer.pointer(), total);
+	const char held = mBuffer[end];
+	mBuffer[end] = '\0';
+	mRemainsPos = end;
+	mRemainsLength = 0;
+	mContext.feedProcess(mBuffer.pointer());
+	if (mStopped)
+		return false;
+
+	// What the parser left over is followed by what was held back.
+	mBuffer[end] = held;
+	mRemainsLength += total - end;
+	if (mRemainsLength > 0)
+		memmove(mBuffer.pointer(), mBuffer.pointer() + mRemainsPos, mRemainsLength);
+	return true;
+}
+
+DomElement* DomStreamParser::next(void)
+{
+	if (mReadyPos == mReady.size())
+		return NULL;
+	DomElement* element = mReady[mReadyPos++];
+	if (mReadyPos == mReady.size())
+	{
+		mReady.clear();
+		mReadyPos = 0;
+	}
+	return element;
+}
+
+void DomStreamParser::stop(void)
+{
+	// Safe from within a callback; the parser makes no more calls during that feed.
+	if (mContext.isStarted())
+		mContext.stop();
+	mStopped = true;
+	delete mRoot;
+	mRoot = NULL;
+	mCurrent = NULL;
+}
+
+bool DomStreamParser::isStopped(void) const
+{
+	return mStopped;
+}
+
+int DomStreamParser::getElementCount(void) const
+{
+	return mElementCount;
+}
+
+void DomStreamParser::clearElements(void)
+{
+	for (int i = mReadyPos;  i < mReady.size();  i++)
+		delete mReady[i];
+	mReady.clear();
+	mReadyPos = 0;
+}
+
+void DomStreamParser::deliver(DomElement* element)
+{
+	mElementCount++;
+	bool more = true;
+	if (mListener != NULL)
+		more = mListener->domElement(element);
+	else
+		mReady.add(element);
+	if (!more || mElementCount == mMaxElements)
+		stop();
+}
+
+void DomStreamParser::mtxEncoding(const char* value)
+{
+}
+
+void DomStreamParser::mtxStartElement(const char* name, const char** attributes)
+{
+	if (mRoot != NULL)
+	{
+		DomElement* element = new DomElement(name, attributes, mCurrent);
+		mCurrent->mChildren.add(element);
+		mCurrent = element;
+		return;
+	}
+
+	// Find the steps matched by this element, from the ones matched by its parent.
+	// A descendant step stays matched all the way down.
+	const int parent = mStates[mStates.size() - 1];
+	const int last = mSteps.size();
+	int state = 0;
+	for (int i = 0;  i < last;  i++)
+	{
+		if (!(parent & (1 << i)))
+			continue;
+		const Step& step = mSteps[i];
+		if (step.name == "*" || step.name == name)
+			state |= 1 << (i + 1);
+		if (step.descendant)
+			state |= 1 << i;
+	}
+	if (state & (1 << last))
+	{
+		mRoot = mCurrent = new DomElement(name, attributes, NULL);
+		return;
+	}
+	mStates.add(state);
+}
+
+void DomStreamParser::mtxEndElement(const char* name)
+{
+	if (mRoot == NULL)
+	{
+		mStates.resize(mStates.size() - 1);
+		// Nothing can match after the document element.
+		if (mStates.size() == 1)
+			stop();
+		return;
+	}
+	if (mCurrent != mRoot)
+	{
+		mCurrent = mCurrent->mParent;
+		return;
+	}
+	DomElement* element = mRoot;
+	mRoot = NULL;
+	mCurrent = NULL;
+	deliver(element);
+	if (mStates.size() == 1)
+		stop();
+}
+
+void DomStreamParser::mtxCharacters(const char* data, int length)
+{
+	// The text between two tags can come in more than one piece.
+	if (mCurrent != NULL)
+		mCurrent->mText.append(data, length);
+}
+
+void DomStreamParser::mtxParseError(int offset)
+{
+	stop();
+	if (mListener != NULL)
+		mListener->domParseError(offset);
+}
+
+unsigned char DomStreamParser::mtxUnicodeCharacter(int character)
+{
+	// Let mtxBasicUnicodeConvert() handle it.
+	return '\0';
+}
+
+void DomStreamParser::mtxDataRemains(const char* data, int len)
+{
+	mRemainsPos = data - mBuffer.pointer();
+	mRemainsLength = len;
+}
+
+} /* namespace Mtx */
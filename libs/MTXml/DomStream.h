@@ -0,0 +1,238 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+/**
+* \file DomStream.h
+* \brief Streaming DOM builder
+*
+* DomStreamParser builds element trees on top of MTSax, but only for the
+* elements that match a path, and hands each one out as soon as its end tag
+* has been parsed. Everything else is dropped as it is parsed.
+*/
+
+#ifndef _DOMSTREAM_H_
+#define _DOMSTREAM_H_
+
+#include "MTXml.h"
+#include "MTSax.h"
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+
+namespace Mtx
+{
+
+/**
+ * \brief An element built by a DomStreamParser.
+ *
+ * An element owns its children.
+ */
+class DomElement
+{
+public:
+	~DomElement(void);
+
+	/**
+	 * \return The name of this element.
+	 */
+	const MAUtil::String& getName(void) const;
+
+	/**
+	 * \return The value of the attribute \a name, or NULL if this element
+	 * doesn't have it.
+	 */
+	const MAUtil::String* getAttribute(const char* name) const;
+
+	/**
+	 * \return The number of attributes of this element.
+	 */
+	int getAttributeCount(void) const;
+	const MAUtil::String& getAttributeName(int index) const;
+	const MAUtil::String& getAttributeValue(int index) const;
+
+	/**
+	 * \return The child elements, in document order.
+	 */
+	const MAUtil::Vector<DomElement*>& getChildren(void) const;
+
+	/**
+	 * \return The first child element named \a name, or NULL if there is none.
+	 */
+	const DomElement* getChild(const char* name) const;
+
+	/**
+	 * \return The text directly inside this element. The text of child
+	 * elements is not included.
+	 */
+	const MAUtil::String& getText(void) const;
+
+	/**
+	 * \return The parent element, or NULL for the element that matched the path.
+	 */
+	const DomElement* getParent(void) const;
+
+private:
+	DomElement(const char* name, const char** attributes, DomElement* parent);
+	DomElement(const DomElement&);
+	DomElement& operator=(const DomElement&);
+
+	MAUtil::String mName;
+	// Names at even indices, each followed by its value.
+	MAUtil::Vector<MAUtil::String> mAttributes;
+	MAUtil::Vector<DomElement*> mChildren;
+	MAUtil::String mText;
+	DomElement* mParent;
+
+	friend class DomStreamParser;
+};
+
+/**
+ * \brief Receives the elements built by a DomStreamParser.
+ */
+class DomStreamListener
+{
+public:
+	/**
+	 * Called as soon as an element that matches the path has been completed.
+	 * The listener owns \a element, and must delete it.
+	 * \return \c false to stop parsing.
+	 */
+	virtual bool domElement(DomElement* element) = 0;
+
+	/**
+	 * Called if the XML is malformed. Parsing stops.
+	 */
+	virtual void domParseError(int offset) {}
+};
+
+/**
+ * \brief Builds elements while the XML is being parsed.
+ *
+ * Only the elements that match a path are built. Memory use depends on the
+ * largest matching element rather than on the whole document, and the first
+ * results arrive before the document has been read.
+ *
+ * The path is the subset of XPath that can be evaluated while streaming:
+ * child (/) and descendant (//) steps from the document, each with an
+ * element name or *. For example: "/rss/channel/item" or "//entry".
+ * Elements inside a matching element are only part of it, and are not
+ * matched by themselves.
+ *
+ * The data can be fed in chunks of any size, as it arrives. Names, text and
+ * attribute values are converted from UTF-8 to Latin-1, and entities are
+ * resolved, as by mtxFeedProcess().
+ * The elements are either passed to a DomStreamListener, or, if there is
+ * none, pulled with next().
+ */
+class DomStreamParser : protected SaxListener, protected MtxListener
+{
+public:
+	DomStreamParser(void);
+	~DomStreamParser(void);
+
+	/**
+	 * Starts parsing a new document, stopping any previous one.
+	 * \param path The path of the elements to build.
+	 * \param listener Receives the elements, or NULL to use next().
+	 * \param maxElements If not negative, parsing stops after this many
+	 * matching elements.
+	 * \return \c false if the path is not supported.
+	 */
+	bool start(const char* path, DomStreamListener* listener = NULL,
+		int maxElements = -1);
+
+	/**
+	 * Parses \a len bytes of XML.
+	 * \return \c true if more data is wanted, \c false if parsing has stopped.
+	 */
+	bool feed(const char* data, int len);
+
+	/**
+	 * Returns the next completed element, or NULL if there is none yet.
+	 * Only used when there's no listener. The caller owns the element,
+	 * and must delete it.
+	 */
+	DomElement* next(void);
+
+	/**
+	 * Stops parsing, and deletes any partly built element.
+	 */
+	void stop(void);
+
+	/**
+	 * \return \c true if parsing has stopped or not yet started.
+	 */
+	bool isStopped(void) const;
+
+	/**
+	 * \return The number of matching elements completed so far.
+	 */
+	int getElementCount(void) const;
+
+protected:
+	// SaxListener
+	void mtxEncoding(const char* value);
+	void mtxStartElement(const char* name, const char** attributes);
+	void mtxEndElement(const char* name);
+	void mtxCharacters(const char* data, int length);
+	void mtxParseError(int offset);
+	unsigned char mtxUnicodeCharacter(int character);
+
+	// MtxListener
+	void mtxDataRemains(const char* data, int len);
+
+private:
+	struct Step {
+		MAUtil::String name;
+		bool descendant;
+	};
+
+	DomStreamParser(const DomStreamParser&);
+	DomStreamParser& operator=(const DomStreamParser&);
+
+	bool compile(const char* path);
+	void deliver(DomElement* element);
+	void clearElements(void);
+
+	SaxContext mContext;
+	DomStreamListener* mListener;
+	int mMaxElements;
+	int mElementCount;
+	bool mStopped;
+
+	MAUtil::Vector<Step> mSteps;
+	// For each open element, a bit for each step that the path up to and
+	// including that element has matched, counting from bit 1.
+	// Bit 0 stands for the document itself.
+	MAUtil::Vector<int> mStates;
+
+	// The matching element being built, or NULL.
+	DomElement* mRoot;
+	DomElement* mCurrent;
+
+	// Completed elements not yet pulled with next().
+	MAUtil::Vector<DomElement*> mReady;
+	int mReadyPos;
+
+	// The data being parsed, starting with what was left from the last feed.
+	MAUtil::Vector<char> mBuffer;
+	int mRemainsPos;
+	int mRemainsLength;
+};
+
+} /* namespace Mtx */
+
+#endif /* _DOMSTREAM_H_ */
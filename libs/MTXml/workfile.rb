@@ -5,7 +5,7 @@ require File.expand_path('../../rules/mosync_lib.rb')
 mod = Module.new
 mod.class_eval do
 	def setup_native
-		@LOCAL_DLLS = ["mosync", "mastd"]
+		@LOCAL_DLLS = ["mosync", "mastd", "mautil"]
 		setup_base
 	end
 	
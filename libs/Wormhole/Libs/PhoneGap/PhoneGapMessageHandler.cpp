@@ -35,6 +35,41 @@ namespace Wormhole
 	using namespace MAUtil; // Class Moblet, String
 	using namespace NativeUI; // WebView widget
 
+	/**
+	 * Services handled by handlePhoneGapMessage, in the
+	 * order of the names in sServiceNames.
+	 */
+	enum
+	{
+		SERVICE_MOSYNC,
+		SERVICE_DEVICE,
+		SERVICE_NOTIFICATION,
+		SERVICE_CONNECTION,
+		SERVICE_ACCELEROMETER,
+		SERVICE_GEOLOCATION,
+		SERVICE_COMPASS,
+		SERVICE_SENSOR_MANAGER,
+		SERVICE_FILE,
+		SERVICE_PUSH_NOTIFICATION,
+		SERVICE_CAPTURE,
+		NUM_SERVICES
+	};
+
+	static const char* const sServiceNames[NUM_SERVICES] =
+	{
+		"mosync",
+		"Device",
+		"Notification",
+		"Connection",
+		"Accelerometer",
+		"GeoLocation",
+		"Compass",
+		"SensorManager",
+		"File",
+		"PushNotification",
+		"Capture"
+	};
+
 	/**
 	 * Constructor.
 	 */
@@ -45,7 +80,8 @@ namespace Wormhole
 		mPhoneGapFile(this),
 		mPhoneGapCapture(this),
 		mPushNotificationManager(this),
-		mBeepSound(0)
+		mBeepSound(0),
+		mServiceTable(sServiceNames, NUM_SERVICES)
 	{
 		enableHardware();
 
@@ -90,77 +126,86 @@ namespace Wormhole
 	 */
 	bool PhoneGapMessageHandler::handlePhoneGapMessage(JSONMessage& message)
 	{
-		// MoSync servcies implemented on top of the PhoneGap protocol
-		// for convenience. We can move this to its own message handler
-		// at a later point.
-		if ((message.getParam("service") == "mosync") &&
-			(message.getParam("action") == "mosync.notification.messageBox"))
-		{
-			String titleText = message.getParam("title");
-			String messageText = message.getParam("message");
-			maMessageBox(titleText.c_str(), messageText.c_str());
-		}
-		// Send device information to PhoneGap
-		else if ((message.getParam("service") == "Device") &&
-				(message.getParam("action") == "Get"))
-		{
-			sendDeviceProperties(message.getParam("PhoneGapCallBackId"));
-		}
-		// Process the vibration message
-		else if ((message.getParam("service") == "Notification") &&
-				(message.getParam("action") == "vibrate"))
-		{
-			int duration = message.getArgsFieldInt("duration");
-			maVibrate(duration);
-		}
-		//Process the beep message
-		else if ((message.getParam("service") == "Notification") &&
-				(message.getParam("action") == "beep"))
+		switch (message.getParamId("service", mServiceTable))
 		{
-			int repeatCount = message.getParamInt("args");
-			for (int i = 0; i < repeatCount; i++)
-			{
-				if (mBeepSound > 0)
+			// MoSync servcies implemented on top of the PhoneGap protocol
+			// for convenience. We can move this to its own message handler
+			// at a later point.
+			case SERVICE_MOSYNC:
+				if (message.paramIs("action", "mosync.notification.messageBox"))
 				{
-					maSoundPlay(mBeepSound, 0, maGetDataSize(mBeepSound));
+					String titleText = message.getParam("title");
+					String messageText = message.getParam("message");
+					maMessageBox(titleText.c_str(), messageText.c_str());
+					return true;
 				}
-			}
-		}
-		else if ((message.getParam("service") == "Connection") &&
-				(message.getParam("action") == "getConnectionInfo"))
-		{
-			sendConnectionType(message.getParam("PhoneGapCallBackId"));
-		}
-		else if ((message.getParam("service") == "Accelerometer")
-			|| (message.getParam("service") == "GeoLocation")
-			|| (message.getParam("service") == "Compass"))
-		{
-			mPhoneGapSensors.handleMessage(message);
-		}
-		else if (message.getParam("service") == "SensorManager")
-		{
-			mPhoneGapSensorManager.handleMessage(message);
-		}
-		else if (message.getParam("service") == "File")
-		{
-			mPhoneGapFile.handleMessage(message);
-		}
-		else if (message.getParam("service") == "PushNotification")
-		{
-			mPushNotificationManager.handleMessage(message);
-		}
-		else if (message.getParam("service") == "Capture")
-		{
-			mPhoneGapCapture.handleMessage(message);
-		}
-		else
-		{
-			// Message was not handled.
-			return false;
+				break;
+
+			// Send device information to PhoneGap
+			case SERVICE_DEVICE:
+				if (message.paramIs("action", "Get"))
+				{
+					sendDeviceProperties(message.getParam("PhoneGapCallBackId"));
+					return true;
+				}
+				break;
+
+			case SERVICE_NOTIFICATION:
+				// Process the vibration message
+				if (message.paramIs("action", "vibrate"))
+				{
+					int duration = message.getArgsFieldInt("duration");
+					maVibrate(duration);
+					return true;
+				}
+				//Process the beep message
+				else if (message.paramIs("action", "beep"))
+				{
+					int repeatCount = message.getParamInt("args");
+					for (int i = 0; i < repeatCount; i++)
+					{
+						if (mBeepSound > 0)
+						{
+							maSoundPlay(mBeepSound, 0, maGetDataSize(mBeepSound));
+						}
+					}
+					return true;
+				}
+				break;
+
+			case SERVICE_CONNECTION:
+				if (message.paramIs("action", "getConnectionInfo"))
+				{
+					sendConnectionType(message.getParam("PhoneGapCallBackId"));
+					return true;
+				}
+				break;
+
+			case SERVICE_ACCELEROMETER:
+			case SERVICE_GEOLOCATION:
+			case SERVICE_COMPASS:
+				mPhoneGapSensors.handleMessage(message);
+				return true;
+
+			case SERVICE_SENSOR_MANAGER:
+				mPhoneGapSensorManager.handleMessage(message);
+				return true;
+
+			case SERVICE_FILE:
+				mPhoneGapFile.handleMessage(message);
+				return true;
+
+			case SERVICE_PUSH_NOTIFICATION:
+				mPushNotificationManager.handleMessage(message);
+				return true;
+
+			case SERVICE_CAPTURE:
+				mPhoneGapCapture.handleMessage(message);
+				return true;
 		}
 
-		// Message was handled.
-		return true;
+		// Message was not handled.
+		return false;
 	}
 
 	/**
@@ -37,6 +37,7 @@ MA 02110-1301, USA.
 #include <NativeUI/WebView.h>
 #include <MAUtil/String.h>
 #include "../JSONMessage.h"
+#include "../../MessageNameTable.h"
 #include "PhoneGapSensors.h"
 #include "PhoneGapFile.h"
 #include "PhoneGapCapture.h"
@@ -239,6 +240,11 @@ namespace Wormhole
 		 * Controls where each sensor event is delivered.
 		 */
 		bool mSensorEventToManager[MAXIMUM_SENSORS];
+
+		/**
+		 * Table of the PhoneGap service names we handle.
+		 */
+		MessageNameTable mServiceTable;
 	};
 } // namespace
 
@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageNameTable.cpp
+ *
+ * Perfect hash table used to dispatch messages by name.
+ */
+
+#include <ma.h>
+#include <maheap.h>
+#include <mastring.h>
+
+#include "MessageNameTable.h"
+
+namespace Wormhole
+{
+	/**
+	 * Constructor. Here we search for a collision free seed.
+	 */
+	MessageNameTable::MessageNameTable(const char* const* names, int count) :
+		mNames(names),
+		mCount(count),
+		mSeed(0)
+	{
+		mLengths = new int[count > 0 ? count : 1];
+		for (int i = 0; i < count; ++i)
+		{
+			mLengths[i] = strlen(names[i]);
+		}
+
+		// Start with a load factor of at most one half, and grow the
+		// table if no seed is found within a reasonable number of tries.
+		int size = 1;
+		while (size < count * 2)
+		{
+			size <<= 1;
+		}
+		mSlots = NULL;
+		for (;;)
+		{
+			delete[] mSlots;
+			mSlots = new int[size];
+			mMask = size - 1;
+			for (unsigned int seed = 1; seed <= 256; ++seed)
+			{
+				if (place(seed))
+				{
+					mSeed = seed;
+					return;
+				}
+			}
+			size <<= 1;
+
+			// Only duplicate names can make every seed fail.
+			if (size > count * 64)
+			{
+				maPanic(1, "MessageNameTable: duplicate message names");
+			}
+		}
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageNameTable::~MessageNameTable()
+	{
+		delete[] mLengths;
+		delete[] mSlots;
+	}
+
+	/**
+	 * Find a name. The string does not need to be zero terminated.
+	 */
+	int MessageNameTable::lookup(const char* str, int length) const
+	{
+		int index = mSlots[hash(str, length, mSeed) & mMask];
+		if (index >= 0 &&
+			mLengths[index] == length &&
+			0 == memcmp(mNames[index], str, length))
+		{
+			return index;
+		}
+		return -1;
+	}
+
+	/**
+	 * Find a zero terminated name.
+	 */
+	int MessageNameTable::lookup(const char* str) const
+	{
+		return lookup(str, strlen(str));
+	}
+
+	/**
+	 * @return The number of names in the table.
+	 */
+	int MessageNameTable::getCount() const
+	{
+		return mCount;
+	}
+
+	/**
+	 * Hash function (FNV-1a) with a seed.
+	 */
+	unsigned int MessageNameTable::hash(
+		const char* str,
+		int length,
+		unsigned int seed)
+	{
+		unsigned int h = 2166136261u ^ (seed * 16777619u);
+		for (int i = 0; i < length; ++i)
+		{
+			h ^= (unsigned char)str[i];
+			h *= 16777619u;
+		}
+		// Mix the high bits into the low bits used as slot index.
+		h ^= h >> 15;
+		return h;
+	}
+
+	/**
+	 * Try to place all names using the given seed.
+	 */
+	bool MessageNameTable::place(unsigned int seed)
+	{
+		for (unsigned int i = 0; i <= mMask; ++i)
+		{
+			mSlots[i] = -1;
+		}
+		for (int i = 0; i < mCount; ++i)
+		{
+			unsigned int slot = hash(mNames[i], mLengths[i], seed) & mMask;
+			if (mSlots[slot] >= 0)
+			{
+				return false;
+			}
+			mSlots[slot] = i;
+		}
+		return true;
+	}
+
+} // namespace
@@ -0,0 +1,151 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageNameTable.h
+ *
+ * Perfect hash table used to dispatch messages by name.
+ */
+
+#ifndef WORMHOLE_MESSAGE_NAME_TABLE_H_
+#define WORMHOLE_MESSAGE_NAME_TABLE_H_
+
+#include <ma.h>
+
+namespace Wormhole
+{
+
+/**
+ * Maps a fixed set of message names to their index in the set.
+ *
+ * The table is built once, typically when a message handler is
+ * created, and searches for a hash seed that gives every name a slot
+ * of its own. A lookup is then one hash and one string compare,
+ * without any allocation.
+ *
+ * Example:
+ *
+ *   static const char* const sNames[] = { "SendSMS", "PageLoaded" };
+ *   MessageNameTable table(sNames, 2);
+ *   ...
+ *   switch (message.getMessageId(table))
+ *   {
+ *     case 0: ...   // SendSMS
+ *     case 1: ...   // PageLoaded
+ *     default: ...  // Unknown message
+ *   }
+ */
+class MessageNameTable
+{
+public:
+	/**
+	 * Constructor.
+	 * @param names Array of distinct names. The array and the
+	 * strings must stay valid for the lifetime of the table.
+	 * @param count Number of names.
+	 */
+	MessageNameTable(const char* const* names, int count);
+
+	/**
+	 * Destructor.
+	 */
+	~MessageNameTable();
+
+	/**
+	 * Find a name. The string does not need to be zero terminated.
+	 * @param str The name to look up.
+	 * @param length The length of the name in bytes.
+	 * @return The index of the name in the array passed to the
+	 * constructor, or -1 if the name is not in the table.
+	 */
+	int lookup(const char* str, int length) const;
+
+	/**
+	 * Find a zero terminated name.
+	 * @return The index of the name, or -1 if it is not in the table.
+	 */
+	int lookup(const char* str) const;
+
+	/**
+	 * @return The number of names in the table.
+	 */
+	int getCount() const;
+
+private:
+	/**
+	 * Not copyable, the table owns its length and slot arrays.
+	 */
+	MessageNameTable(const MessageNameTable&);
+	MessageNameTable& operator=(const MessageNameTable&);
+
+	/**
+	 * Hash function (FNV-1a) with a seed.
+	 */
+	static unsigned int hash(const char* str, int length, unsigned int seed);
+
+	/**
+	 * Try to place all names using the given seed.
+	 * @return true if there were no collisions.
+	 */
+	bool place(unsigned int seed);
+
+	/**
+	 * The names in the table.
+	 */
+	const char* const* mNames;
+
+	/**
+	 * Lengths of the names.
+	 */
+	int* mLengths;
+
+	/**
+	 * Number of names.
+	 */
+	int mCount;
+
+	/**
+	 * Slots holding name indexes, -1 for empty slots.
+	 * The number of slots is a power of two.
+	 */
+	int* mSlots;
+
+	/**
+	 * Number of slots minus one.
+	 */
+	unsigned int mMask;
+
+	/**
+	 * Hash seed that gives a collision free table.
+	 */
+	unsigned int mSeed;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -28,14 +28,228 @@ MA 02110-1301, USA.
 #include <mastring.h>		// C string functions
 #include <mavsprintf.h>		// C string functions
 #include <mastdlib.h>		// C string conversion functions
+#include <limits.h>
+#ifdef USE_NEWLIB
+#include <errno.h>
+#endif
 #include <conprint.h>
+#include <MAUtil/util.h>
+#include <MAP/MemoryMgr.h>
+#include <yajl/yajl_parse.h>
 
 #include "MessageStreamJSON.h"
 
 using namespace MAUtil;
+using namespace MAPUtil;
 
 namespace Wormhole
 {
+	/**
+	 * Returned by getParamNode for missing parameters,
+	 * like YAJLDom does for missing map keys.
+	 */
+	static YAJLDom::NullValue sNullValue;
+
+	/**
+	 * State of the parse, passed as context to the yajl callbacks.
+	 *
+	 * Depth 0 is outside the message array, depth 1 is inside it,
+	 * and depth 2 is inside a message. Only keys and values at
+	 * depth 2 are recorded, deeper values are skipped and their
+	 * JSON text is recorded when the enclosing container ends.
+	 */
+	struct MessageStreamJSON::Parser
+	{
+		MessageStreamJSON* stream;
+		yajl_handle handle;
+		char* text;
+		int textLength;
+		int depth;
+		const char* key;
+		int keyLength;
+		int containerStart;
+
+		/**
+		 * Current offset into the text, which is right after
+		 * the last token.
+		 */
+		int offset()
+		{
+			return yajl_get_bytes_consumed(handle);
+		}
+
+		/**
+		 * Strings are passed as pointers into the text, unless they
+		 * contain escapes, in which case yajl passes a decoded copy.
+		 * The decoded string is never longer than the escaped one,
+		 * so we write it back into the text, ending at the closing quote.
+		 */
+		const char* keep(const unsigned char* str, unsigned int length)
+		{
+			const char* s = (const char*) str;
+			if (s >= text && s < text + textLength)
+			{
+				return s;
+			}
+			char* dest = text + offset() - 1 - length;
+			memmove(dest, s, length);
+			return dest;
+		}
+
+		void addParam(
+			YAJLDom::Value::Type type,
+			const char* value,
+			int valueLength)
+		{
+			Param param;
+			param.key = key;
+			param.keyLength = keyLength;
+			param.value = value;
+			param.valueLength = valueLength;
+			param.type = type;
+			param.node = NULL;
+			stream->mParams.add(param);
+			stream->mMessages[stream->mMessages.size() - 1].numParams++;
+		}
+
+		/**
+		 * Elements of the message array that are not maps
+		 * count as messages without parameters.
+		 */
+		void addMessage()
+		{
+			Message message;
+			message.firstParam = stream->mParams.size();
+			message.numParams = 0;
+			stream->mMessages.add(message);
+		}
+
+		void value(
+			YAJLDom::Value::Type type,
+			const char* value,
+			int valueLength)
+		{
+			if (1 == depth)
+			{
+				addMessage();
+			}
+			else if (2 == depth)
+			{
+				addParam(type, value, valueLength);
+			}
+		}
+
+		static int onNull(void* ctx)
+		{
+			((Parser*) ctx)->value(YAJLDom::Value::NUL, "", 0);
+			return 1;
+		}
+
+		static int onBoolean(void* ctx, int boolean)
+		{
+			((Parser*) ctx)->value(
+				YAJLDom::Value::BOOLEAN,
+				boolean ? "true" : "false",
+				boolean ? 4 : 5);
+			return 1;
+		}
+
+		static int onNumber(void* ctx, const char* s, unsigned int length)
+		{
+			((Parser*) ctx)->value(YAJLDom::Value::NUMBER, s, length);
+			return 1;
+		}
+
+		static int onString(
+			void* ctx,
+			const unsigned char* s,
+			unsigned int length)
+		{
+			Parser* p = (Parser*) ctx;
+			if (2 == p->depth)
+			{
+				p->addParam(YAJLDom::Value::STRING, p->keep(s, length), length);
+			}
+			else if (1 == p->depth)
+			{
+				p->addMessage();
+			}
+			return 1;
+		}
+
+		static int onMapKey(
+			void* ctx,
+			const unsigned char* s,
+			unsigned int length)
+		{
+			Parser* p = (Parser*) ctx;
+			if (2 == p->depth)
+			{
+				p->key = p->keep(s, length);
+				p->keyLength = length;
+			}
+			return 1;
+		}
+
+		static int onStartMap(void* ctx)
+		{
+			Parser* p = (Parser*) ctx;
+			if (1 == p->depth)
+			{
+				p->addMessage();
+			}
+			else if (2 == p->depth)
+			{
+				p->containerStart = p->offset() - 1;
+			}
+			++p->depth;
+			return 1;
+		}
+
+		static int onEndMap(void* ctx)
+		{
+			Parser* p = (Parser*) ctx;
+			if (3 == p->depth)
+			{
+				p->addParam(
+					YAJLDom::Value::MAP,
+					p->text + p->containerStart,
+					p->offset() - p->containerStart);
+			}
+			--p->depth;
+			return 1;
+		}
+
+		static int onStartArray(void* ctx)
+		{
+			Parser* p = (Parser*) ctx;
+			if (1 == p->depth)
+			{
+				p->addMessage();
+			}
+			else if (2 == p->depth)
+			{
+				p->containerStart = p->offset() - 1;
+			}
+			++p->depth;
+			return 1;
+		}
+
+		static int onEndArray(void* ctx)
+		{
+			Parser* p = (Parser*) ctx;
+			if (3 == p->depth)
+			{
+				p->addParam(
+					YAJLDom::Value::ARRAY,
+					p->text + p->containerStart,
+					p->offset() - p->containerStart);
+			}
+			--p->depth;
+			return 1;
+		}
+	};
+
 	/**
 	 * Constructor. Here we parse the message.
 	 */
@@ -44,15 +258,23 @@ namespace Wormhole
 		MAHandle dataHandle)
 	{
 		mWebView = webView;
+		mData = NULL;
+		mJSONRoot = NULL;
 		mCurrentMessageIndex = -1;
 		parse(dataHandle);
 	}
 
 	/**
-	 * Destructor. Here we delete the JSON tree.
+	 * Destructor. Here we delete the message data and any
+	 * JSON nodes that were created.
 	 */
 	MessageStreamJSON::~MessageStreamJSON()
 	{
+		for (int i = 0; i < mParams.size(); ++i)
+		{
+			YAJLDom::deleteValue(mParams[i].node);
+		}
+
 		// The root must not be NULL or Value::NUL.
 		if (NULL != mJSONRoot && YAJLDom::Value::NUL != mJSONRoot->getType())
 		{
@@ -60,6 +282,8 @@ namespace Wormhole
 			YAJLDom::deleteValue(mJSONRoot);
 			mJSONRoot = NULL;
 		}
+
+		free(mData);
 	}
 
 	/**
@@ -81,12 +305,11 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::next()
 	{
-		if (NULL != mJSONRoot && YAJLDom::Value::ARRAY == mJSONRoot->getType())
+		if (mCurrentMessageIndex < mMessages.size())
 		{
 			++mCurrentMessageIndex;
-			return mCurrentMessageIndex < mJSONRoot->getNumChildValues();
 		}
-		return false;
+		return mCurrentMessageIndex < mMessages.size();
 	}
 
 	/**
@@ -94,23 +317,44 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::is(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode("messageName");
-		if (NULL != value && YAJLDom::Value::STRING == value->getType())
-		{
-		// Commented out code that was intended to be used with
-		// pointers into the unparsed JSON data. This was made as
-		// part of a project to remove creation of String objects
-		// from YAJLDom. But this was never finished. A problem
-		// with the raw string data is that it needs to be unstringified,
-		// and therefore one of the benefits of using raw data gets lost,
-		// you still need to create a new string. Code left here as a
-		// reference.
-//			YAJLDom::StringValue* stringValue = (YAJLDom::StringValue*) value;
-//			return 0 == strncmp(
-//				paramName,
-//				stringValue->getCharPointer(),
-//				stringValue->getLength());
-			return value->toString() == paramName;
+		return paramIs("messageName", paramName);
+	}
+
+	/**
+	 * Look up the name of this message in a table of message names.
+	 */
+	int MessageStreamJSON::getMessageId(const MessageNameTable& table)
+	{
+		return getParamId("messageName", table);
+	}
+
+	/**
+	 * Look up the string value of a top-level message parameter
+	 * in a table of names.
+	 */
+	int MessageStreamJSON::getParamId(
+		const char* paramName,
+		const MessageNameTable& table)
+	{
+		Param* param = findParam(paramName);
+		if (NULL != param && YAJLDom::Value::STRING == param->type)
+		{
+			return table.lookup(param->value, param->valueLength);
+		}
+		return -1;
+	}
+
+	/**
+	 * Checks if a top-level message parameter has the given string value.
+	 */
+	bool MessageStreamJSON::paramIs(const char* paramName, const char* value)
+	{
+		Param* param = findParam(paramName);
+		if (NULL != param && YAJLDom::Value::STRING == param->type)
+		{
+			int length = strlen(value);
+			return param->valueLength == length &&
+				0 == memcmp(param->value, value, length);
 		}
 		return false;
 	}
@@ -121,24 +365,58 @@ namespace Wormhole
 	 */
 	String MessageStreamJSON::getParam(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		if (NULL != value && YAJLDom::Value::STRING == value->getType())
+		Param* param = findParam(paramName);
+		if (NULL != param && YAJLDom::Value::STRING == param->type)
 		{
-			return value->toString();
+			return String(param->value, param->valueLength);
 		}
 		return "";
 	}
 
 	/**
 	 * Returns the integer value of a top-level message parameter.
-	 * @return The param value as an int.
+	 * @return The param value as an int, or 0 if the param is
+	 * missing, is not an integer or does not fit in an int.
 	 */
 	int MessageStreamJSON::getParamInt(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		if (NULL != value && YAJLDom::Value::NUMBER == value->getType())
+		Param* param = findParam(paramName);
+		if (NULL != param && YAJLDom::Value::NUMBER == param->type)
 		{
-			return value->toInt();
+			// The value is not null terminated; it is followed by a
+			// delimiter, which must be where strtol stops.
+			char* end;
+#ifdef USE_NEWLIB
+			errno = 0;
+#endif
+			long value = strtol(param->value, &end, 10);
+			if (end != param->value + param->valueLength
+				|| value < INT_MIN || value > INT_MAX)
+			{
+				return 0;
+			}
+
+#ifdef USE_NEWLIB
+			if (ERANGE == errno)
+			{
+				return 0;
+			}
+#else
+			// The strtol of MAStd doesn't set errno, it only saturates.
+			// JSON numbers have no leading zeros, so a saturated value
+			// is told apart by not reading the same as the text.
+			if (LONG_MIN == value || LONG_MAX == value)
+			{
+				char buffer[16];
+				int length = sprintf(buffer, "%ld", value);
+				if (param->valueLength != length ||
+					0 != memcmp(param->value, buffer, length))
+				{
+					return 0;
+				}
+			}
+#endif
+			return (int)value;
 		}
 		return 0;
 	}
@@ -148,37 +426,138 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::hasParam(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		return (NULL != value && YAJLDom::Value::NUL != value->getType());
+		Param* param = findParam(paramName);
+		return (NULL != param && YAJLDom::Value::NUL != param->type);
 	}
 
 	/**
 	 * Get the node of a top-level parameter in the current message.
+	 * The node is created on the first call and owned by this object.
 	 */
 	YAJLDom::Value* MessageStreamJSON::getParamNode(const char* paramName)
 	{
-		if (NULL != mJSONRoot && YAJLDom::Value::ARRAY == mJSONRoot->getType())
+		if (mCurrentMessageIndex < 0 ||
+			mCurrentMessageIndex >= mMessages.size())
 		{
-			YAJLDom::Value* message = mJSONRoot->getValueByIndex(mCurrentMessageIndex);
-			if (YAJLDom::Value::MAP == message->getType())
+			return NULL;
+		}
+
+		Param* param = findParam(paramName);
+		if (NULL == param)
+		{
+			return &sNullValue;
+		}
+
+		if (NULL == param->node)
+		{
+			param->node = createNode(*param);
+		}
+		return param->node;
+	}
+
+	/**
+	 * @return The JSON root node. The tree is created on the first call.
+	 */
+	MAUtil::YAJLDom::Value* MessageStreamJSON::getJSONRoot()
+	{
+		if (NULL == mJSONRoot && NULL != mData)
+		{
+			YAJLDom::ArrayValue* root = newobject(
+				YAJLDom::ArrayValue,
+				new YAJLDom::ArrayValue());
+			for (int i = 0; i < mMessages.size(); ++i)
 			{
-				return message->getValueForKey(paramName);
+				YAJLDom::MapValue* map = newobject(
+					YAJLDom::MapValue,
+					new YAJLDom::MapValue());
+				const Message& message = mMessages[i];
+				for (int j = 0; j < message.numParams; ++j)
+				{
+					const Param& param = mParams[message.firstParam + j];
+					map->setValueForKey(
+						String(param.key, param.keyLength),
+						createNode(param));
+				}
+				root->addValue(map);
+			}
+			mJSONRoot = root;
+		}
+		return mJSONRoot;
+	}
+
+	/**
+	 * Find a top-level parameter in the current message.
+	 * Messages have few parameters, so a linear search is used.
+	 * The last parameter with the name wins, as in YAJLDom.
+	 */
+	MessageStreamJSON::Param* MessageStreamJSON::findParam(
+		const char* paramName)
+	{
+		if (mCurrentMessageIndex < 0 ||
+			mCurrentMessageIndex >= mMessages.size())
+		{
+			return NULL;
+		}
+
+		const Message& message = mMessages[mCurrentMessageIndex];
+		int length = strlen(paramName);
+		for (int i = message.numParams - 1; i >= 0; --i)
+		{
+			Param& param = mParams[message.firstParam + i];
+			if (param.keyLength == length &&
+				0 == memcmp(param.key, paramName, length))
+			{
+				return &param;
 			}
 		}
 		return NULL;
 	}
 
 	/**
-	 * @return The JSON root node.
+	 * Create a JSON node for a parameter value.
 	 */
-	MAUtil::YAJLDom::Value* MessageStreamJSON::getJSONRoot()
+	YAJLDom::Value* MessageStreamJSON::createNode(const Param& param)
 	{
-		return mJSONRoot;
+		YAJLDom::Value* node = NULL;
+		switch (param.type)
+		{
+			case YAJLDom::Value::NUL:
+				node = newobject(YAJLDom::NullValue, new YAJLDom::NullValue());
+				break;
+			case YAJLDom::Value::BOOLEAN:
+				node = newobject(
+					YAJLDom::BooleanValue,
+					new YAJLDom::BooleanValue('t' == param.value[0]));
+				break;
+			case YAJLDom::Value::NUMBER:
+				node = newobject(
+					YAJLDom::NumberValue,
+					new YAJLDom::NumberValue(stringToDouble(
+						String(param.value, param.valueLength))));
+				break;
+			case YAJLDom::Value::STRING:
+				node = newobject(
+					YAJLDom::StringValue,
+					new YAJLDom::StringValue(param.value, param.valueLength));
+				break;
+			case YAJLDom::Value::MAP:
+			case YAJLDom::Value::ARRAY:
+				node = YAJLDom::parse(
+					(const unsigned char*) param.value,
+					param.valueLength);
+				break;
+		}
+
+		if (NULL == node)
+		{
+			node = newobject(YAJLDom::NullValue, new YAJLDom::NullValue());
+		}
+		return node;
 	}
 
 	/**
-	 * Parse the message. This finds the message name and
-	 * creates a dictionary with the message parameters.
+	 * Parse the message. This finds the messages and their
+	 * top-level parameters.
 	 */
 	void MessageStreamJSON::parse(MAHandle dataHandle)
 	{
@@ -193,33 +572,78 @@ namespace Wormhole
 		// Get length of the data, it is not zero terminated.
 		int dataSize = maGetDataSize(dataHandle);
 
-		// Allocate buffer for string data.
-		char* stringData = (char*) malloc(dataSize + 1);
+		// Check that we have the "ma:" prefix,
+		// followed by the JSON array.
+		if (dataSize < 4)
+		{
+			return;
+		}
+
+		// Allocate buffer for string data. The buffer is kept
+		// for the lifetime of this object, since the message
+		// parameters point into it.
+		mData = (char*) malloc(dataSize + 1);
 
 		// Get the data.
-		maReadData(dataHandle, stringData, 0, dataSize);
+		maReadData(dataHandle, mData, 0, dataSize);
 
 		// Zero terminate.
-		stringData[dataSize] = 0;
+		mData[dataSize] = 0;
 
-		//maWriteLog(stringData, dataSize);
+		//maWriteLog(mData, dataSize);
 
-		// Check that we have the "ma:" prefix,
-		// followed by the JSON array.
-		if (stringData[0] != 'm') { return; }
-		if (stringData[1] != 'a') { return; }
-		if (stringData[2] != ':') { return; }
-		if (stringData[3] != '[') { return; }
+		if (mData[0] != 'm' || mData[1] != 'a' ||
+			mData[2] != ':' || mData[3] != '[')
+		{
+			return;
+		}
 
-		// Pointer to the start of the JSOn array at the
-		// opening '[' character.
-		char* jsonData = stringData + 3;
+		// The JSON array starts at the opening '[' character.
+		Parser parser;
+		parser.stream = this;
+		parser.text = mData + 3;
+		parser.textLength = dataSize - 3;
+		parser.depth = 0;
+		parser.key = "";
+		parser.keyLength = 0;
+		parser.containerStart = 0;
 
-		mJSONRoot = YAJLDom::parse(
-			(const unsigned char*)jsonData,
-			dataSize - 3);
+		// Numbers are passed as text, so they can be
+		// recorded without conversion.
+		static yajl_callbacks callbacks =
+		{
+			Parser::onNull,
+			Parser::onBoolean,
+			NULL,
+			NULL,
+			Parser::onNumber,
+			Parser::onString,
+			Parser::onStartMap,
+			Parser::onMapKey,
+			Parser::onEndMap,
+			Parser::onStartArray,
+			Parser::onEndArray
+		};
+		yajl_parser_config config = { 1, 1 };
+		parser.handle = yajl_alloc(&callbacks, &config, NULL, &parser);
 
-		free(stringData);
+		yajl_status status = yajl_parse(
+			parser.handle,
+			(const unsigned char*) parser.text,
+			parser.textLength);
+		if (yajl_status_ok == status ||
+			yajl_status_insufficient_data == status)
+		{
+			status = yajl_parse_complete(parser.handle);
+		}
+		yajl_free(parser.handle);
+
+		if (yajl_status_ok != status)
+		{
+			// Invalid or truncated JSON, there are no messages.
+			mMessages.clear();
+			mParams.clear();
+		}
 	}
 
 } // namespace
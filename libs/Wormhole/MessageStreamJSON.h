@@ -37,8 +37,10 @@ MA 02110-1301, USA.
 #include <ma.h>
 #include <MAUtil/String.h>
 #include <MAUtil/HashMap.h>
+#include <MAUtil/Vector.h>
 #include <NativeUI/WebView.h>
 #include <yajl/YAJLDom.h>
+#include "MessageNameTable.h"
 
 namespace Wormhole
 {
@@ -51,6 +53,15 @@ namespace Wormhole
  *
  *   ma:[{"messageName":"message1",...},{"messageName":"message2",...},...]
  *
+ * The message data is parsed in a single pass with the yajl callback
+ * API. Top-level parameters are kept as pointers into the message data,
+ * so no JSON tree is built and no strings are allocated while parsing.
+ * Nested parameter values are turned into YAJLDom nodes only when
+ * requested with getParamNode or getJSONRoot.
+ *
+ * Use getMessageId or getParamId with a MessageNameTable to dispatch
+ * on message names without string compares or allocations.
+ *
  * TODO: Add copy constructor and assignment operator.
  */
 class MessageStreamJSON
@@ -87,6 +98,28 @@ public:
 	 */
 	bool is(const char* paramName);
 
+	/**
+	 * Look up the name of this message in a table of message names.
+	 * @return The index of the message name in the table, or -1
+	 * if the name is not in the table.
+	 */
+	int getMessageId(const MessageNameTable& table);
+
+	/**
+	 * Look up the string value of a top-level message parameter
+	 * in a table of names.
+	 * @return The index of the value in the table, or -1 if the
+	 * value is not in the table or is not a string.
+	 */
+	int getParamId(const char* paramName, const MessageNameTable& table);
+
+	/**
+	 * Checks if a top-level message parameter has the given string
+	 * value. Unlike comparing the result of getParam, this does
+	 * not allocate.
+	 */
+	bool paramIs(const char* paramName, const char* value);
+
 	/**
 	 * Returns the string value of a top-level message parameter.
 	 * @return The param value as a string.
@@ -95,7 +128,8 @@ public:
 
 	/**
 	 * Returns the integer value of a top-level message parameter.
-	 * @return The param value as an int.
+	 * @return The param value as an int, or 0 if the param is
+	 * missing, is not an integer or does not fit in an int.
 	 */
 	int getParamInt(const char* paramName);
 
@@ -121,14 +155,73 @@ public:
 	void parse(MAHandle dataHandle);
 
 private:
+	/**
+	 * A top-level message parameter. Strings point into the
+	 * message data. Nested maps and arrays point to their JSON text.
+	 */
+	struct Param
+	{
+		const char* key;
+		int keyLength;
+		const char* value;
+		int valueLength;
+		MAUtil::YAJLDom::Value::Type type;
+
+		/**
+		 * Node created by getParamNode, or NULL.
+		 */
+		MAUtil::YAJLDom::Value* node;
+	};
+
+	/**
+	 * A message, which is a range of parameters.
+	 */
+	struct Message
+	{
+		int firstParam;
+		int numParams;
+	};
+
+	/**
+	 * Parser callbacks, defined in MessageStreamJSON.cpp.
+	 */
+	struct Parser;
+	friend struct Parser;
+
+	/**
+	 * Find a top-level parameter in the current message.
+	 * @return The parameter, or NULL if it does not exist.
+	 */
+	Param* findParam(const char* paramName);
+
+	/**
+	 * Create a JSON node for a parameter value.
+	 */
+	static MAUtil::YAJLDom::Value* createNode(const Param& param);
+
 	/**
 	 * The WebView of this message.
 	 */
 	NativeUI::WebView* mWebView;
 
+	/**
+	 * The message data. Parameters point into this buffer.
+	 */
+	char* mData;
+
+	/**
+	 * Parameters of all messages.
+	 */
+	MAUtil::Vector<Param> mParams;
+
+	/**
+	 * The messages in the stream.
+	 */
+	MAUtil::Vector<Message> mMessages;
+
 protected:
 	/**
-	 * Table for message parameters.
+	 * JSON tree of all messages, created by getJSONRoot.
 	 */
 	MAUtil::YAJLDom::Value* mJSONRoot;
 
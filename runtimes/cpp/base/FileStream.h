@@ -72,6 +72,8 @@ namespace Base {
 		Stream* createLimitedCopy(int /*size*/) const { FAIL; }
 		Stream* createCopy() const { FAIL; }
 		bool truncate(int size);
+		// Waits until everything written has reached the storage device.
+		bool sync();
 	};
 
 	class LimitedFileStream : public FileStream {	//read-only
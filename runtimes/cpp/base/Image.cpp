@@ -27,6 +27,8 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include "base_errors.h"
 using namespace MoSyncError;
 
+#include "PolygonRasterizer.h"
+
 typedef s64 int64_t;
 
 #define SWAP(x, y, temp) {temp=x;x=y;y=temp;}
@@ -1363,4 +1365,51 @@ void Image::drawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int col
 	}
 	*/
 }
+
+template<class T> struct SpanFiller {
+	unsigned char* data;
+	int pitch;
+	T color;
+
+	void operator()(int y, int left, int right) {
+		T* scan = ((T*)&data[y*pitch]) + left;
+		int w = right - left;
+		while(w--) *scan++ = color;
+	}
+};
+
+static PolygonRasterizer sRasterizer;
+
+template<class T> static void fillTriangles(Image* img, const int* points, int count,
+	int color, bool fan)
+{
+	SpanFiller<T> filler = { img->data, img->pitch, (T)color };
+	if(fan)
+		sRasterizer.fillTriangleFan(points, count, filler);
+	else
+		sRasterizer.fillTriangleStrip(points, count, filler);
+}
+
+static void drawTriangles(Image* img, const int* points, int count, int color, bool fan) {
+	sRasterizer.setClip(img->clipRect.x, img->clipRect.y,
+		img->clipRect.x + img->clipRect.width, img->clipRect.y + img->clipRect.height);
+	switch(img->bytesPerPixel) {
+		case 2:
+			fillTriangles<unsigned short>(img, points, count, color, fan);
+			break;
+		case 4:
+			fillTriangles<unsigned int>(img, points, count, color, fan);
+			break;
+		default:
+			BIG_PHAT_ERROR(ERR_UNSUPPORTED_BPP);
+	}
+}
+
+void Image::drawTriangleStrip(const int* points, int count, int color) {
+	drawTriangles(this, points, count, color, false);
+}
+
+void Image::drawTriangleFan(const int* points, int count, int color) {
+	drawTriangles(this, points, count, color, true);
+}
 #endif	//SYMBIAN
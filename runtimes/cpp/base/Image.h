@@ -97,6 +97,9 @@ public:
 	void drawLine(int x1, int y1, int x2, int y2, int color);
 	void drawFilledRect(int x, int y, int w, int h, int color);
 	void drawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int color);
+	// points holds count x,y pairs.
+	void drawTriangleStrip(const int* points, int count, int color);
+	void drawTriangleFan(const int* points, int count, int color);
 	void drawImageRegion(int left, int top, ClipRect *srcRect, Image *src, int transformMode);
 	void drawImage(int left, int top, Image *src);
 
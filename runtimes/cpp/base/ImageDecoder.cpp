@@ -0,0 +1,139 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#include "config_platform.h"
+
+#include <helpers/helpers.h>
+
+#include "Syscall.h"
+
+#ifdef ASYNC_IMAGE_DECODING
+
+#include "ImageDecoder.h"
+
+using namespace MoSyncError;
+
+namespace Base {
+
+	ImageJob::ImageJob(unsigned index, MemStream* data)
+		: mIndex(index), mData(data), mImage(NULL) {}
+
+	ImageJob::~ImageJob() {
+		delete mData;
+	}
+
+	//*************************************************************************
+	// ImageDecoder
+	//*************************************************************************
+
+	ImageDecoder::ImageDecoder(ResourceArray& resources) : mResources(resources) {
+		mQueueLock.post();
+		for(int i=0; i<NUM_THREADS; i++) {
+			mThreads[i].start(homeRun, this);
+		}
+		mResources.setFluxResolver(this);
+	}
+
+	ImageDecoder::~ImageDecoder() {
+		mResources.setFluxResolver(NULL);
+		for(int i=0; i<NUM_THREADS; i++) {
+			enqueue(NULL);
+		}
+		for(int i=0; i<NUM_THREADS; i++) {
+			mThreads[i].join();
+		}
+		for(JobMap::iterator itr = mJobs.begin(); itr != mJobs.end(); itr++) {
+			ImageJob* job = itr->second;
+			mResources.extract_RT_FLUX(job->mIndex);
+			if(job->mImage)
+				Syscall::freeDecodedImage(job->mImage);
+			delete job;
+		}
+	}
+
+	int ImageDecoder::add(unsigned index, MemStream* data) {
+		int size = 0;
+		data->length(size);
+#ifdef RESOURCE_MEMORY_LIMIT
+		void* o = (void*)(size_t)size;
+#else
+		void* o = (void*)1;	// must not be NULL, or the handle would seem unloaded.
+#endif
+		int res = mResources.add_RT_FLUX(index, o);
+		if(res != RES_OK) {
+			delete data;
+			return res;
+		}
+		ImageJob* job = new ImageJob(index, data);
+		mJobs[index] = job;
+		enqueue(job);
+		return RES_OK;
+	}
+
+	bool ImageDecoder::resolve(unsigned index) {
+		JobMap::iterator itr = mJobs.find(index);
+		if(itr == mJobs.end())
+			return false;
+		ImageJob* job = itr->second;
+		mJobs.erase(itr);
+
+		job->mDone.wait();
+		RT_IMAGE_Type* decoded = job->mImage;
+		delete job;
+
+		mResources.extract_RT_FLUX(index);
+		if(!decoded)
+			BIG_PHAT_ERROR(ERR_IMAGE_LOAD_FAILED);
+		RT_IMAGE_Type* image = gSyscall->finishImage(decoded);
+		if(!image)
+			BIG_PHAT_ERROR(ERR_IMAGE_LOAD_FAILED);
+		ROOM(mResources.add_RT_IMAGE(index, image));
+		return true;
+	}
+
+	void ImageDecoder::enqueue(ImageJob* job) {
+		mQueueLock.wait();
+		mQueue.push_back(job);
+		mQueueLock.post();
+		mQueued.post();
+	}
+
+	void ImageDecoder::run() {
+		while(true) {
+			mQueued.wait();
+			mQueueLock.wait();
+			ImageJob* job = mQueue.front();
+			mQueue.pop_front();
+			mQueueLock.post();
+			if(job == NULL)
+				return;
+
+			// The encoded data is no longer needed once decoded.
+			job->mImage = Syscall::decodeImage(*job->mData);
+			delete job->mData;
+			job->mData = NULL;
+			job->mDone.post();
+		}
+	}
+
+	int ImageDecoder::homeRun(void* arg) {
+		((ImageDecoder*)arg)->run();
+		return 0;
+	}
+}
+
+#endif	//ASYNC_IMAGE_DECODING
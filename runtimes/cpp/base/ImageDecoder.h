@@ -0,0 +1,102 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef _BASE_IMAGE_DECODER_H_
+#define _BASE_IMAGE_DECODER_H_
+
+#include <map>
+#include <deque>
+
+#include "ThreadPool.h"
+#include "MemStream.h"
+#include "ResourceArray.h"
+
+namespace Base {
+
+	class ImageDecoder;
+
+	/**
+	 * An image waiting to be decoded, or decoded but not yet
+	 * added to the resource array.
+	 */
+	struct ImageJob {
+		ImageJob(unsigned index, MemStream* data);
+		~ImageJob();
+
+		unsigned mIndex;
+		MemStream* mData;
+		// Result of Syscall::decodeImage(). NULL if decoding failed.
+		RT_IMAGE_Type* mImage;
+		// Posted once the job is done.
+		MoSyncSemaphore mDone;
+	};
+
+	/**
+	 * Decodes image resources on worker threads, so that loading
+	 * resources doesn't wait for every image to be decoded.
+	 *
+	 * While an image is being decoded, its handle holds an RT_FLUX object
+	 * the size of the encoded data, so it counts against the resource memory
+	 * limit. The first time the image is used, the main thread waits for
+	 * the decoder if needed, then replaces the flux object with the image.
+	 * Only then is the decoded size counted. If it doesn't fit, the
+	 * program panics with ERR_RES_OOM, as it would have at load time.
+	 */
+	class ImageDecoder : public FluxResolver {
+	public:
+		ImageDecoder(ResourceArray& resources);
+
+		/**
+		 * Waits for the worker threads to finish. Images that were
+		 * never used are discarded.
+		 */
+		~ImageDecoder();
+
+		/**
+		 * Starts decoding an image.
+		 * @param index The resource handle. Must be a placeholder.
+		 * @param data The encoded image. The decoder takes ownership.
+		 * @return RES_OK or RES_OUT_OF_MEMORY.
+		 */
+		int add(unsigned index, MemStream* data);
+
+		virtual bool resolve(unsigned index);
+
+	private:
+		enum { NUM_THREADS = 2 };
+
+		ResourceArray& mResources;
+		MoSyncThread mThreads[NUM_THREADS];
+
+		// Jobs by resource handle. Only used by the main thread.
+		typedef std::map<unsigned, ImageJob*> JobMap;
+		JobMap mJobs;
+
+		// Jobs waiting for a worker. NULL tells a worker to quit.
+		std::deque<ImageJob*> mQueue;
+		// Guards mQueue.
+		MoSyncSemaphore mQueueLock;
+		// Posted once for each entry in mQueue.
+		MoSyncSemaphore mQueued;
+
+		void enqueue(ImageJob* job);
+		void run();
+		static int homeRun(void*);
+	};
+}
+
+#endif	//_BASE_IMAGE_DECODER_H_
@@ -0,0 +1,507 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#include "Platform.h"
+
+#ifdef LOG_STRUCTURED_STORES
+
+#include <stdio.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "LogStore.h"
+
+#define LOG_STORE_MAGIC 0x534c534d	// "MSLS"
+#define LOG_STORE_VERSION 1
+
+// The file is compacted when it's larger than twice the live data plus this.
+#define COMPACT_SLACK (256 * 1024)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+namespace Base {
+
+	enum RecordType {
+		RECORD_CHUNK = 1,
+		// index is the size of the store.
+		RECORD_COMMIT = 2
+	};
+
+	struct LogHeader {
+		int magic;
+		int version;
+		int chunkSize;
+		// Of the fields above.
+		uint crc;
+	};
+
+	struct RecordHeader {
+		int type;
+		int index;
+		// Of the data that follows the header.
+		int length;
+		// Of the fields above, seeded with the checksum of the data.
+		uint crc;
+	};
+
+	#define HEADER_CRC_SIZE (3 * sizeof(int))
+
+	static uint crc32(uint crc, const void* data, int len) {
+		static uint table[256];
+		if(table[1] == 0) {
+			for(uint i=0; i<256; i++) {
+				uint c = i;
+				for(int k=0; k<8; k++)
+					c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+				table[i] = c;
+			}
+		}
+		const byte* p = (const byte*)data;
+		crc = ~crc;
+		while(len--) {
+			crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	static int chunkCount(int size) {
+		return (size + LogStore::CHUNK_SIZE - 1) / LogStore::CHUNK_SIZE;
+	}
+
+	// Replaces \a to with \a from, atomically where the file system allows.
+	static bool replaceFile(const char* from, const char* to) {
+#ifdef WIN32
+		return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return ::rename(from, to) == 0;
+#endif
+	}
+
+	//*************************************************************************
+	// Opening and closing
+
+	LogStore* LogStore::open(const char* path) {
+		WriteFileStream* file = new WriteFileStream(path, false, true);
+		if(!file->isOpen()) {
+			delete file;
+			return NULL;
+		}
+		LogStore* store = new LogStore(path, file);
+		if(!store->load()) {
+			delete store;
+			return NULL;
+		}
+		return store;
+	}
+
+	LogStore::LogStore(const char* path, WriteFileStream* file)
+		: mFile(file), mRefCount(1), mSize(0), mLogEnd(0), mAppendPos(0), mLegacy(false)
+	{
+		int len = strlen(path) + 1;
+		mPath = new char[len];
+		memcpy(mPath, path, len);
+	}
+
+	LogStore::~LogStore() {
+		delete mFile;
+		delete[] mPath;
+	}
+
+	void LogStore::release() {
+		if(--mRefCount == 0)
+			delete this;
+	}
+
+	// ';' is not allowed in store names, so this can't be another store.
+	std::string LogStore::tempPath() const {
+		return std::string(mPath) + ";tmp";
+	}
+
+	bool LogStore::load() {
+		// Left over from a compaction that was interrupted before the rename,
+		// so the store itself is intact.
+		::remove(tempPath().c_str());
+
+		int length;
+		TEST(mFile->length(length));
+		if(length >= (int)sizeof(LogHeader)) {
+			LogHeader header;
+			TEST(mFile->seek(Seek::Start, 0));
+			TEST(mFile->read(&header, sizeof(header)));
+			if(header.magic == LOG_STORE_MAGIC &&
+				header.crc == crc32(0, &header, HEADER_CRC_SIZE))
+			{
+				if(header.version != LOG_STORE_VERSION || header.chunkSize != CHUNK_SIZE) {
+					LOG("LogStore: unknown format %i/%i in %s\n",
+						header.version, header.chunkSize, mPath);
+					FAIL;
+				}
+				return replay(length);
+			}
+		}
+
+		// A plain file. Its chunks are read in place until it's converted.
+		mLegacy = length > 0;
+		mSize = length;
+		mChunks.resize(chunkCount(length));
+		for(size_t i=0; i<mChunks.size(); i++) {
+			Chunk& c = mChunks[i];
+			c.offset = i * CHUNK_SIZE;
+			c.length = MIN(CHUNK_SIZE, length - c.offset);
+			c.crc = 0;
+		}
+		return true;
+	}
+
+	bool LogStore::replay(int fileLength) {
+		int pos = sizeof(LogHeader);
+		mLogEnd = pos;
+		while(pos + (int)sizeof(RecordHeader) <= fileLength) {
+			RecordHeader rec;
+			TEST(mFile->seek(Seek::Start, pos));
+			TEST(mFile->read(&rec, sizeof(rec)));
+			int dataPos = pos + sizeof(rec);
+			if(rec.type == RECORD_CHUNK) {
+				if(rec.index < 0 || rec.length <= 0 || rec.length > CHUNK_SIZE ||
+					dataPos + rec.length > fileLength)
+					break;
+				TEST(mFile->read(mBuffer, rec.length));
+				uint dataCrc = crc32(0, mBuffer, rec.length);
+				if(rec.crc != crc32(dataCrc, &rec, HEADER_CRC_SIZE))
+					break;
+				PendingChunk p = { rec.index, { dataPos, rec.length, dataCrc } };
+				mPending.push_back(p);
+				pos = dataPos + rec.length;
+			} else if(rec.type == RECORD_COMMIT) {
+				if(rec.index < 0 || rec.length != 0 ||
+					rec.crc != crc32(0, &rec, HEADER_CRC_SIZE))
+					break;
+				pos = dataPos;
+				applyCommit(rec.index);
+				mLogEnd = pos;
+			} else {
+				break;
+			}
+		}
+		mPending.clear();
+		mAppendPos = mLogEnd;
+
+		// Drop the remains of an interrupted write, so that they can't be
+		// mistaken for records once new ones have been written over them.
+		if(fileLength > mLogEnd) {
+			LOG("LogStore: dropping %i bytes after the last commit in %s\n",
+				fileLength - mLogEnd, mPath);
+			TEST(mFile->truncate(mLogEnd));
+		}
+		return true;
+	}
+
+	int LogStore::remove() {
+		delete mFile;
+		int res = ::remove(mPath);
+		mFile = new WriteFileStream(mPath, false, true);
+		mChunks.clear();
+		mPending.clear();
+		mSize = mLogEnd = mAppendPos = 0;
+		mLegacy = false;
+		return res;
+	}
+
+	//*************************************************************************
+	// Reading
+
+	bool LogStore::read(void* dst, int offset, int size) {
+		if(offset < 0 || size < 0 || offset > mSize - size) {
+			FAIL;
+		}
+		byte* out = (byte*)dst;
+		while(size > 0) {
+			int index = offset / CHUNK_SIZE;
+			int start = offset % CHUNK_SIZE;
+			int len = MIN(CHUNK_SIZE - start, size);
+			const Chunk& c = mChunks[index];
+			int stored = MIN(len, c.length - start);
+			if(stored > 0) {
+				TEST(mFile->seek(Seek::Start, c.offset + start));
+				TEST(mFile->read(out, stored));
+			} else {
+				stored = 0;
+			}
+			memset(out + stored, 0, len - stored);
+			out += len;
+			offset += len;
+			size -= len;
+		}
+		return true;
+	}
+
+	// Reads a whole chunk, zero-filled past its length.
+	bool LogStore::readChunk(int index, byte* dst) {
+		const Chunk& c = mChunks[index];
+		if(c.length > 0) {
+			TEST(mFile->seek(Seek::Start, c.offset));
+			TEST(mFile->read(dst, c.length));
+		}
+		memset(dst + c.length, 0, CHUNK_SIZE - c.length);
+		return true;
+	}
+
+	// Checksums differ for almost every changed chunk, but the data is
+	// compared anyway so that a collision can't drop a write.
+	bool LogStore::sameChunk(int index, const byte* data, int length) {
+		const Chunk& c = mChunks[index];
+		if(c.length != length || c.crc != crc32(0, data, length))
+			return false;
+		if(!readChunk(index, mCompareBuffer))
+			return false;
+		return memcmp(data, mCompareBuffer, length) == 0;
+	}
+
+	//*************************************************************************
+	// Writing
+
+	bool LogStore::write(const void* src, int offset, int size) {
+		if(offset < 0 || size < 0 || offset > 0x7fffffff - size) {
+			FAIL;
+		}
+		if(size == 0)
+			return true;
+		if(mLegacy) {
+			TEST(rewrite(NULL, mSize));
+		}
+		int newSize = offset + size > mSize ? offset + size : mSize;
+		TEST(begin());
+
+		const byte* in = (const byte*)src;
+		while(size > 0) {
+			int index = offset / CHUNK_SIZE;
+			int start = offset % CHUNK_SIZE;
+			int len = MIN(CHUNK_SIZE - start, size);
+			int chunkLength = MIN(CHUNK_SIZE, newSize - index * CHUNK_SIZE);
+			const byte* data = in;
+			if(start != 0 || len != chunkLength) {
+				// Merge with the current contents of the chunk.
+				if(index < (int)mChunks.size()) {
+					if(!readChunk(index, mBuffer)) {
+						rollback();
+						FAIL;
+					}
+				} else {
+					memset(mBuffer, 0, CHUNK_SIZE);
+				}
+				memcpy(mBuffer + start, in, len);
+				data = mBuffer;
+			}
+			if(!appendChunk(index, data, chunkLength)) {
+				rollback();
+				FAIL;
+			}
+			in += len;
+			offset += len;
+			size -= len;
+		}
+		return commit(newSize);
+	}
+
+	bool LogStore::replace(Stream& src, int size) {
+		if(!mLegacy) {
+			int count = chunkCount(size);
+			std::vector<int> changed;
+			TEST(src.seek(Seek::Start, 0));
+			for(int i=0; i<count; i++) {
+				int length = MIN(CHUNK_SIZE, size - i * CHUNK_SIZE);
+				TEST(src.read(mBuffer, length));
+				if(i >= (int)mChunks.size() || !sameChunk(i, mBuffer, length))
+					changed.push_back(i);
+			}
+			if(changed.empty() && size == mSize)
+				return true;
+
+			// If most of the store has changed, it's cheaper to write it anew,
+			// which also gets rid of the old chunks.
+			if((int)changed.size() * 2 <= count) {
+				TEST(begin());
+				for(size_t i=0; i<changed.size(); i++) {
+					int index = changed[i];
+					int length = MIN(CHUNK_SIZE, size - index * CHUNK_SIZE);
+					if(!src.seek(Seek::Start, index * CHUNK_SIZE) ||
+						!src.read(mBuffer, length) ||
+						!appendChunk(index, mBuffer, length))
+					{
+						rollback();
+						FAIL;
+					}
+				}
+				return commit(size);
+			}
+		}
+		TEST(src.seek(Seek::Start, 0));
+		return rewrite(&src, size);
+	}
+
+	// Writes the header if this is the first write to the file.
+	bool LogStore::begin() {
+		if(mLogEnd != 0)
+			return true;
+		if(!mFile->isOpen()) {
+			// The file was removed.
+			delete mFile;
+			mFile = new WriteFileStream(mPath);
+		}
+		LogHeader header = { LOG_STORE_MAGIC, LOG_STORE_VERSION, CHUNK_SIZE, 0 };
+		header.crc = crc32(0, &header, HEADER_CRC_SIZE);
+		TEST(mFile->seek(Seek::Start, 0));
+		TEST(mFile->write(&header, sizeof(header)));
+		mAppendPos = sizeof(header);
+		return true;
+	}
+
+	bool LogStore::appendChunk(int index, const byte* data, int length) {
+		uint dataCrc = crc32(0, data, length);
+		RecordHeader rec = { RECORD_CHUNK, index, length, 0 };
+		rec.crc = crc32(dataCrc, &rec, HEADER_CRC_SIZE);
+		TEST(mFile->seek(Seek::Start, mAppendPos));
+		TEST(mFile->write(&rec, sizeof(rec)));
+		TEST(mFile->write(data, length));
+		PendingChunk p = { index, { mAppendPos + (int)sizeof(rec), length, dataCrc } };
+		mPending.push_back(p);
+		mAppendPos += sizeof(rec) + length;
+		return true;
+	}
+
+	bool LogStore::commit(int size) {
+		RecordHeader rec = { RECORD_COMMIT, size, 0, 0 };
+		rec.crc = crc32(0, &rec, HEADER_CRC_SIZE);
+		if(!mFile->seek(Seek::Start, mAppendPos) ||
+			!mFile->write(&rec, sizeof(rec)) ||
+			!mFile->sync())
+		{
+			rollback();
+			FAIL;
+		}
+		mAppendPos += sizeof(rec);
+		mLogEnd = mAppendPos;
+		applyCommit(size);
+
+		int live = sizeof(LogHeader) + mSize + mChunks.size() * sizeof(RecordHeader);
+		if(mLogEnd - live > live + COMPACT_SLACK) {
+			// The commit stands even if this fails.
+			if(!rewrite(NULL, mSize)) {
+				LOG("LogStore: compaction of %s failed\n", mPath);
+			}
+		}
+		return true;
+	}
+
+	void LogStore::rollback() {
+		mPending.clear();
+		mAppendPos = mLogEnd;
+		if(mFile->isOpen())
+			mFile->truncate(mLogEnd);
+	}
+
+	void LogStore::applyCommit(int size) {
+		int count = chunkCount(size);
+		Chunk hole = { -1, 0, 0 };
+		mChunks.resize(count, hole);
+		for(size_t i=0; i<mPending.size(); i++) {
+			const PendingChunk& p = mPending[i];
+			if(p.index < count)
+				mChunks[p.index] = p.chunk;
+		}
+		mPending.clear();
+
+		// Data past the end must not come back if the store grows again.
+		if(count > 0) {
+			Chunk& last = mChunks[count - 1];
+			int max = size - (count - 1) * CHUNK_SIZE;
+			if(last.length > max)
+				last.length = max;
+		}
+		mSize = size;
+	}
+
+	bool LogStore::rewrite(Stream* src, int size) {
+		std::string temp = tempPath();
+		std::vector<Chunk> chunks;
+		int pos;
+		bool success;
+		{
+			WriteFileStream file(temp.c_str());
+			success = file.isOpen();
+			LogHeader header = { LOG_STORE_MAGIC, LOG_STORE_VERSION, CHUNK_SIZE, 0 };
+			header.crc = crc32(0, &header, HEADER_CRC_SIZE);
+			success = success && file.write(&header, sizeof(header));
+			pos = sizeof(header);
+
+			int count = chunkCount(size);
+			for(int i=0; i<count && success; i++) {
+				int length = MIN(CHUNK_SIZE, size - i * CHUNK_SIZE);
+				if(src) {
+					success = src->read(mBuffer, length);
+				} else if(mChunks[i].offset < 0) {
+					// Still a hole.
+					Chunk hole = { -1, 0, 0 };
+					chunks.push_back(hole);
+					continue;
+				} else {
+					success = readChunk(i, mBuffer);
+				}
+				uint dataCrc = crc32(0, mBuffer, length);
+				RecordHeader rec = { RECORD_CHUNK, i, length, 0 };
+				rec.crc = crc32(dataCrc, &rec, HEADER_CRC_SIZE);
+				success = success && file.write(&rec, sizeof(rec)) && file.write(mBuffer, length);
+				pos += sizeof(rec);
+				Chunk c = { pos, length, dataCrc };
+				chunks.push_back(c);
+				pos += length;
+			}
+
+			RecordHeader rec = { RECORD_COMMIT, size, 0, 0 };
+			rec.crc = crc32(0, &rec, HEADER_CRC_SIZE);
+			success = success && file.write(&rec, sizeof(rec)) && file.sync();
+			pos += sizeof(rec);
+		}
+		if(!success) {
+			::remove(temp.c_str());
+			FAIL;
+		}
+
+		// Windows can't replace a file that is open.
+		delete mFile;
+		success = replaceFile(temp.c_str(), mPath);
+		mFile = new WriteFileStream(mPath, false, true);
+		if(!success) {
+			LOG("LogStore: could not replace %s\n", mPath);
+			::remove(temp.c_str());
+			FAIL;
+		}
+		mChunks.swap(chunks);
+		mPending.clear();
+		mSize = size;
+		mLogEnd = mAppendPos = pos;
+		mLegacy = false;
+		return true;
+	}
+
+}	// namespace Base
+
+#endif	//LOG_STRUCTURED_STORES
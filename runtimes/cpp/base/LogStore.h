@@ -0,0 +1,136 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef _BASE_LOG_STORE_H_
+#define _BASE_LOG_STORE_H_
+
+#include <vector>
+#include <string>
+
+#include "FileStream.h"
+
+namespace Base {
+
+	/**
+	 * A store file that is only ever appended to, so that a small change
+	 * to a large store doesn't rewrite the whole file.
+	 *
+	 * The contents of the store are split into fixed-size chunks.
+	 * The file starts with a header, followed by records. A chunk record
+	 * holds the new contents of one chunk. A commit record holds the size
+	 * of the store, and makes the chunk records written since the previous
+	 * commit take effect. Every record is checksummed. When the file is
+	 * opened, the records are replayed up to the last intact commit,
+	 * so a write that was cut short by a crash is dropped as a whole.
+	 *
+	 * When old versions of chunks take up most of the file, the live chunks
+	 * are copied to a new file, which replaces the old one by a rename once
+	 * it has been synced.
+	 *
+	 * A file without the header was written by an older runtime.
+	 * It is read as is, and converted on the first write.
+	 *
+	 * All handles to the same store must share one LogStore.
+	 */
+	class LogStore {
+	public:
+		enum { CHUNK_SIZE = 4096 };
+
+		// Returns NULL if the file couldn't be opened, or has an unknown format.
+		// The reference count of the new store is 1.
+		static LogStore* open(const char* path);
+
+		void addRef() { mRefCount++; }
+		// Deletes the store when the last reference is released.
+		void release();
+
+		const char* path() const { return mPath; }
+		int size() const { return mSize; }
+
+		// The range must be inside the store.
+		bool read(void* dst, int offset, int size);
+
+		// Writes a range, growing the store if needed.
+		// A gap between the old end of the store and \a offset reads as zeros.
+		bool write(const void* src, int offset, int size);
+
+		// Replaces the contents of the store with \a size bytes from the
+		// start of \a src. Only chunks that have changed are written.
+		bool replace(Stream& src, int size);
+
+		// Deletes the file. The store is empty afterwards,
+		// and the file is created again if the store is written to.
+		// Returns the result of ::remove().
+		int remove();
+
+	private:
+		LogStore(const char* path, WriteFileStream* file);
+		~LogStore();
+
+		struct Chunk {
+			// Position of the data in the file, or -1 if the chunk has never
+			// been written. The part of the chunk past \a length reads as zeros.
+			int offset;
+			int length;
+			// Checksum of the data. Can be out of date if the store has been
+			// truncated, so it's only used to find chunks that have changed.
+			uint crc;
+		};
+		struct PendingChunk {
+			int index;
+			Chunk chunk;
+		};
+
+		char* mPath;
+		WriteFileStream* mFile;
+		int mRefCount;
+
+		std::vector<Chunk> mChunks;
+		// Chunk records written since the last commit.
+		std::vector<PendingChunk> mPending;
+		int mSize;
+		// End of the last commit, or 0 if the file has no header yet.
+		int mLogEnd;
+		// Where the next record will be written.
+		int mAppendPos;
+		// True if the file was written by an older runtime,
+		// in which case mChunks point straight into it.
+		bool mLegacy;
+
+		byte mBuffer[CHUNK_SIZE];
+		byte mCompareBuffer[CHUNK_SIZE];
+
+		bool load();
+		bool replay(int fileLength);
+		bool readChunk(int index, byte* dst);
+		bool sameChunk(int index, const byte* data, int length);
+
+		bool begin();
+		bool appendChunk(int index, const byte* data, int length);
+		bool commit(int size);
+		void rollback();
+		void applyCommit(int size);
+
+		// Writes the store to a new file, which then replaces the old one.
+		// The contents are read from \a src, or from the store itself if NULL.
+		bool rewrite(Stream* src, int size);
+		std::string tempPath() const;
+	};
+
+}	// namespace Base
+
+#endif	//_BASE_LOG_STORE_H_
@@ -0,0 +1,222 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef _POLYGON_RASTERIZER_H_
+#define _POLYGON_RASTERIZER_H_
+
+#include <stdlib.h>
+#include <helpers/types.h>
+#include <helpers/array.h>
+
+// Single-pass edge-table scanline rasterizer for triangle strips and fans.
+//
+// All triangles are normalized to the same orientation and filled with the
+// non-zero winding rule, so the result is the union of the triangles.
+// Edges shared by two consecutive triangles cancel out and are never walked.
+// Pixels are sampled at integer coordinates using the top-left fill rule
+// (top and left edges inclusive, bottom and right edges exclusive), so
+// adjacent triangles never touch the same pixel twice.
+//
+// Clipping is done once per call: edges are started at the first visible
+// scanline and spans are clamped to the clip rect before they are emitted.
+//
+// The span functor is called as span(y, left, right) for every visible
+// horizontal run of pixels, right exclusive.
+class PolygonRasterizer {
+public:
+	PolygonRasterizer() : mEdges(0), mActive(0) {}
+
+	// Sets the visible area. right and bottom are exclusive.
+	void setClip(int left, int top, int right, int bottom) {
+		mClipLeft = left;
+		mClipTop = top;
+		mClipRight = right;
+		mClipBottom = bottom;
+	}
+
+	// xy holds count points, stored as consecutive x,y int pairs (the layout of MAPoint2d).
+	template<class SpanFunc> void fillTriangleStrip(const int* xy, int count, SpanFunc& span) {
+		buildEdges(xy, count, false);
+		scan(span);
+	}
+	template<class SpanFunc> void fillTriangleFan(const int* xy, int count, SpanFunc& span) {
+		buildEdges(xy, count, true);
+		scan(span);
+	}
+
+private:
+	struct Edge {
+		int yStart, yEnd;	//visible scanlines, yEnd exclusive
+		int x;	//ceiling of the intersection with the current scanline
+		int step, rem, err, dy;	//exact integer DDA
+		int winding;
+	};
+
+	Array<Edge> mEdges;
+	Array<Edge*> mActive;
+	int mNumEdges;
+	int mClipLeft, mClipTop, mClipRight, mClipBottom;
+
+	static int orientation(const int* xy, int a, int b, int c) {
+		s64 cross = (s64)(xy[b*2] - xy[a*2]) * (xy[c*2+1] - xy[a*2+1]) -
+			(s64)(xy[b*2+1] - xy[a*2+1]) * (xy[c*2] - xy[a*2]);
+		return cross > 0 ? 1 : (cross < 0 ? -1 : 0);
+	}
+
+	// The winding contribution of the directed edge u->v in a triangle of orientation s.
+	static int winding(const int* xy, int u, int v, int s) {
+		int dy = xy[v*2+1] - xy[u*2+1];
+		return dy > 0 ? s : (dy < 0 ? -s : 0);
+	}
+
+	static int compareEdges(const void* a, const void* b) {
+		return ((const Edge*)a)->yStart - ((const Edge*)b)->yStart;
+	}
+
+	void addEdge(int x0, int y0, int x1, int y1, int w) {
+		if(y0 > y1) {
+			int temp;
+			temp = x0; x0 = x1; x1 = temp;
+			temp = y0; y0 = y1; y1 = temp;
+		}
+		int ys = y0 > mClipTop ? y0 : mClipTop;
+		int ye = y1 < mClipBottom ? y1 : mClipBottom;
+		if(ys >= ye)
+			return;
+
+		Edge& e(mEdges[mNumEdges++]);
+		int dx = x1 - x0;
+		e.dy = y1 - y0;
+		e.step = dx / e.dy;
+		if(dx % e.dy < 0)
+			e.step--;
+		e.rem = dx - e.step * e.dy;
+
+		// Start directly on the first visible scanline.
+		s64 n = (s64)dx * (ys - y0);
+		s64 q = n / e.dy;
+		if(n % e.dy > 0)
+			q++;
+		e.x = x0 + (int)q;
+		e.err = (int)(q * e.dy - n);
+		e.yStart = ys;
+		e.yEnd = ye;
+		e.winding = w;
+	}
+
+	void buildEdges(const int* xy, int count, bool fan) {
+		int nTriangles = count - 2;
+		if((int)mEdges.size() < nTriangles * 3) {
+			mEdges.resize(nTriangles * 3);
+			mActive.resize(nTriangles * 3);
+		}
+		mNumEdges = 0;
+
+		int s = orientation(xy, 0, 1, 2);
+		bool sharedWithPrev = false;
+		for(int t = 0; t < nTriangles; t++) {
+			int a = fan ? 0 : t, b = t + 1, c = t + 2;
+
+			// The edge this triangle shares with the next one.
+			int nu = fan ? c : b, nv = fan ? a : c;
+			bool sharedWithNext = false;
+			int sNext = 0;
+			if(t + 1 < nTriangles) {
+				int na = fan ? 0 : t + 1;
+				sNext = orientation(xy, na, t + 2, t + 3);
+				// The next triangle's a->b edge is the same vertex pair.
+				sharedWithNext = s != 0 && sNext != 0 &&
+					winding(xy, nu, nv, s) + winding(xy, na, t + 2, sNext) == 0;
+			}
+
+			if(s != 0) {
+				if(!sharedWithPrev)
+					addEdge(xy[a*2], xy[a*2+1], xy[b*2], xy[b*2+1], winding(xy, a, b, s));
+				if(!(sharedWithNext && !fan))
+					addEdge(xy[b*2], xy[b*2+1], xy[c*2], xy[c*2+1], winding(xy, b, c, s));
+				if(!(sharedWithNext && fan))
+					addEdge(xy[c*2], xy[c*2+1], xy[a*2], xy[a*2+1], winding(xy, c, a, s));
+			}
+
+			sharedWithPrev = sharedWithNext;
+			s = sNext;
+		}
+
+		qsort(mEdges.p(), mNumEdges, sizeof(Edge), compareEdges);
+	}
+
+	template<class SpanFunc> void scan(SpanFunc& span) {
+		if(mNumEdges == 0)
+			return;
+		int next = 0;
+		int numActive = 0;
+		int y = mEdges[0].yStart;
+		while(numActive > 0 || next < mNumEdges) {
+			if(numActive == 0 && y < mEdges[next].yStart)
+				y = mEdges[next].yStart;
+			while(next < mNumEdges && mEdges[next].yStart == y) {
+				mActive[numActive++] = &mEdges[next++];
+			}
+
+			// Crossings move little between scanlines; insertion sort is near linear.
+			for(int i = 1; i < numActive; i++) {
+				Edge* e = mActive[i];
+				int j = i;
+				while(j > 0 && mActive[j-1]->x > e->x) {
+					mActive[j] = mActive[j-1];
+					j--;
+				}
+				mActive[j] = e;
+			}
+
+			int w = 0;
+			int left = 0;
+			for(int i = 0; i < numActive; i++) {
+				Edge* e = mActive[i];
+				int prev = w;
+				w += e->winding;
+				if(prev == 0 && w != 0) {
+					left = e->x;
+				} else if(prev != 0 && w == 0) {
+					int l = left > mClipLeft ? left : mClipLeft;
+					int r = e->x < mClipRight ? e->x : mClipRight;
+					if(l < r)
+						span(y, l, r);
+				}
+			}
+
+			// Retire finished edges and step the rest to the next scanline.
+			int n = 0;
+			for(int i = 0; i < numActive; i++) {
+				Edge* e = mActive[i];
+				if(e->yEnd <= y + 1)
+					continue;
+				e->x += e->step;
+				e->err -= e->rem;
+				if(e->err < 0) {
+					e->x++;
+					e->err += e->dy;
+				}
+				mActive[n++] = e;
+			}
+			numActive = n;
+			y++;
+		}
+	}
+};
+
+#endif	//_POLYGON_RASTERIZER_H_
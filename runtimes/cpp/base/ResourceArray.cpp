@@ -62,7 +62,8 @@ namespace Base {
 		mDynResTypes(NULL),
 		mDynResPoolSize(0),
 		mDynResPoolCapacity(0),
-		mDynResPool(NULL)
+		mDynResPool(NULL),
+		mFluxResolver(NULL)
 	{
 	}
 
@@ -424,6 +425,7 @@ namespace Base {
 	void* ResourceArray::_get(unsigned index, byte R) {
 		void **res = mRes;
 		byte *types = mResTypes;
+		unsigned handle = index;
 		if(index&DYNAMIC_PLACEHOLDER_BIT) {
 			res = mDynRes;
 			types = mDynResTypes;
@@ -433,6 +435,9 @@ namespace Base {
 			TESTINDEX(index, mResSize);
 		}
 
+		if(types[index] == RT_FLUX && R != RT_FLUX) {
+			_resolveFlux(handle);
+		}
 		if(types[index] != R) {
 			BIG_PHAT_ERROR(ERR_RES_INVALID_TYPE);
 		}
@@ -442,6 +447,7 @@ namespace Base {
 	void* ResourceArray::_extract(unsigned index, byte R) {
 		void **res = mRes;
 		byte *types = mResTypes;
+		unsigned handle = index;
 		if(index&DYNAMIC_PLACEHOLDER_BIT) {
 			res = mDynRes;
 			types = mDynResTypes;
@@ -451,6 +457,9 @@ namespace Base {
 			TESTINDEX(index, mResSize);
 		}
 
+		if(types[index] == RT_FLUX && R != RT_FLUX) {
+			_resolveFlux(handle);
+		}
 		if(types[index] != R) {
 			BIG_PHAT_ERROR(ERR_RES_INVALID_TYPE);
 		}
@@ -471,6 +480,12 @@ namespace Base {
 		return temp;
 	}
 
+	bool ResourceArray::_resolveFlux(unsigned index) {
+		if(mFluxResolver == NULL)
+			return false;
+		return mFluxResolver->resolve(index);
+	}
+
 	void ResourceArray::__destroy(void* obj, byte type, unsigned index) {
 		switch(type) {
 #define CASE_DELETE(R, T, D) case R: D ((T*)obj);\
@@ -482,6 +497,7 @@ LOGD("%s: %s %s %i\n", #R, #D, #T, index); break;
 	void ResourceArray::_destroy(unsigned index) {
 		void **res = mRes;
 		byte *types = mResTypes;
+		unsigned handle = index;
 		if(index&DYNAMIC_PLACEHOLDER_BIT) {
 			res = mDynRes;
 			types = mDynResTypes;
@@ -491,6 +507,9 @@ LOGD("%s: %s %s %i\n", #R, #D, #T, index); break;
 			TESTINDEX(index, mResSize);
 		}
 
+		if(types[index] == RT_FLUX) {
+			_resolveFlux(handle);
+		}
 		MYASSERT(types[index] != RT_FLUX, ERR_RES_DESTROY_FLUX);
 
 #ifdef RESOURCE_MEMORY_LIMIT
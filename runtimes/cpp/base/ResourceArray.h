@@ -83,6 +83,23 @@ namespace Base {
 
 #define ROOM(func) if((func) == RES_OUT_OF_MEMORY) { BIG_PHAT_ERROR(ERR_RES_OOM); }
 
+	/**
+	 * Finishes resources that are in flux while they are being
+	 * loaded in the background.
+	 */
+	class FluxResolver {
+	public:
+		virtual ~FluxResolver() {}
+
+		/**
+		 * Waits until the resource is loaded and has replaced its
+		 * RT_FLUX object in the array.
+		 * @param index The resource handle.
+		 * @return false if the resource isn't being loaded.
+		 */
+		virtual bool resolve(unsigned index) = 0;
+	};
+
 	/**
 	 * Class that holds resources.
 	 * Internally, "resource" and "object" are used interchangably.
@@ -167,8 +184,21 @@ namespace Base {
 
 		void logEverything();
 
+		/**
+		 * Set the object that finishes resources in flux when they are
+		 * requested as another type or destroyed. May be NULL.
+		 */
+		void setFluxResolver(FluxResolver* resolver) { mFluxResolver = resolver; }
+
 	private:
 
+		/**
+		 * Lets the flux resolver finish a resource in flux.
+		 * @param index The resource handle.
+		 * @return true if the resource was replaced.
+		 */
+		bool _resolveFlux(unsigned index);
+
 		/**
 		 * Delete and add a resource ("dadd").
 		 * @param index Resource index.
@@ -251,6 +281,8 @@ namespace Base {
 		unsigned mDynResPoolCapacity;
 		// The array with free handle indexes.
 		unsigned* mDynResPool;
+
+		FluxResolver* mFluxResolver;
 	};
 	// End of class ResourceArray
 }
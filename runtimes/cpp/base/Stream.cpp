@@ -21,6 +21,9 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include "MemStream.h"
 #include <helpers/smartie.h>
 
+// Used by writeStream() when neither stream is in memory.
+#define STREAM_COPY_BUFFER_SIZE (64 * 1024)
+
 namespace Base {
 
 	//******************************************************************************
@@ -130,12 +133,25 @@ namespace Base {
 		} else {
 			void* pdst = this->ptr();
 			if(pdst) {	//memory destination stream
-				TEST(src.read(pdst, size));
+				int pos;
+				TEST(this->tell(pos));
+				int dstSize;
+				TEST(this->length(dstSize));
+				TEST(pos + size <= dstSize);
+				TEST(src.read((char*)pdst + pos, size));
+				TEST(this->seek(Seek::Current, size));
 			} else {
-				Smartie<char> temp(new char[size]);
+				// Copy through a bounded buffer, so that large transfers
+				// don't need their whole size in temporary memory.
+				int bufSize = MIN(size, STREAM_COPY_BUFFER_SIZE);
+				Smartie<char> temp(new char[bufSize]);
 				TEST(temp);
-				TEST(src.read(temp(), size));
-				TEST(this->write(temp(), size));
+				while(size > 0) {
+					int len = MIN(size, bufSize);
+					TEST(src.read(temp(), len));
+					TEST(this->write(temp(), len));
+					size -= len;
+				}
 			}
 		}
 		return true;
@@ -66,6 +66,11 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #define stricmp(x, y) strcasecmp(x, y)
 #endif
 
+#ifdef ASYNC_FILE_IO
+#define NETWORKING_H
+#include "networking.h"
+#endif
+
 using namespace Base;
 
 namespace Base {
@@ -132,11 +137,34 @@ namespace Base {
 		mPanicOnProgrammerError = true;
 		gStoreNextId = 1;
 		gFileNextHandle = 1;
+#ifdef ASYNC_IMAGE_DECODING
+		imageDecoder = new ImageDecoder(resources);
+#endif
+#ifdef ASYNC_FILE_IO
+		fileThreadPool = new ThreadPool;
+#endif
 	}
 
 	Syscall::~Syscall() {
 		LOGD("~Syscall\n");
+#ifdef ASYNC_IMAGE_DECODING
+		delete imageDecoder;
+#endif
+#ifdef LOG_STRUCTURED_STORES
+		{
+			HashMapNoDelete<LogStore>::TIteratorC itr = gLogStores.begin();
+			while(itr.hasMore()) {
+				itr.next().value->release();
+			}
+			gLogStores.close();
+		}
+#endif
 		gStores.close();
+#ifdef ASYNC_FILE_IO
+		// Wait for file operations, since they use the file handles.
+		fileThreadPool->close();
+		delete fileThreadPool;
+#endif
 		gFileHandles.close();
 		platformDestruct();
 	}
@@ -226,6 +254,15 @@ namespace Base {
 				break;
 			case RT_IMAGE:
 				{
+#ifdef ASYNC_IMAGE_DECODING
+					// The image is decoded in the background.
+					// It's finished when first used.
+					MemStream* ms = new MemStream(size);
+					TEST(file.readFully(*ms));
+					if(resources.is_loaded(rI))
+						resources.destroy(rI);
+					ROOM(imageDecoder->add(rI, ms));
+#else
 					MemStream b(size);
 					TEST(file.readFully(b));
 #ifndef _android
@@ -252,6 +289,7 @@ namespace Base {
 						size,
 						Base::gSyscall->getReloadHandle());
 #endif
+#endif	//ASYNC_IMAGE_DECODING
 				}
 				break;
 			case RT_SPRITE:
@@ -478,6 +516,13 @@ namespace Base {
 			break;
 		case RT_IMAGE:
 			{
+#ifdef ASYNC_IMAGE_DECODING
+				MemStream* ms = new MemStream(size);
+				TEST(file.readFully(*ms));
+				if(resources.is_loaded(rI))
+					resources.destroy(rI);
+				ROOM(imageDecoder->add(rI, ms));
+#else
 				MemStream b(size);
 				TEST(file.readFully(b));
 #ifndef _android
@@ -504,6 +549,7 @@ namespace Base {
 					size,
 					Base::gSyscall->getReloadHandle());
 #endif
+#endif	//ASYNC_IMAGE_DECODING
 			}
 			break;
 			case RT_SPRITE:
@@ -826,10 +872,78 @@ namespace Base {
 			}
 		}
 
+#ifdef LOG_STRUCTURED_STORES
+		LogStore* logStore = NULL;
+		{
+			HashMapNoDelete<LogStore>::TIteratorC itr = SYSCALL_THIS->gLogStores.begin();
+			while(itr.hasMore() && !logStore) {
+				LogStore* other = itr.next().value;
+				if(strcmp(other->path(), path) == 0) {
+					logStore = other;
+					logStore->addRef();
+				}
+			}
+		}
+		if(!logStore) {
+			logStore = LogStore::open(path);
+			if(!logStore)
+				return STERR_GENERIC;
+		}
+		SYSCALL_THIS->gLogStores.insert(SYSCALL_THIS->gStoreNextId, logStore);
+#endif
 		SYSCALL_THIS->gStores.insert(SYSCALL_THIS->gStoreNextId, path, len);
 		return SYSCALL_THIS->gStoreNextId++;
 	}
 
+#ifdef LOG_STRUCTURED_STORES
+	LogStore* Syscall::getLogStore(MAHandle store) {
+		LogStore* logStore = gLogStores.find(store);
+		MYASSERT(logStore, ERR_STORE_HANDLE_INVALID);
+		return logStore;
+	}
+
+	SYSCALL(int, maWriteStore(MAHandle store, MAHandle data))
+	{
+		LogStore* logStore = SYSCALL_THIS->getLogStore(store);
+		Stream* b = SYSCALL_THIS->resources.get_RT_BINARY(data);
+		int len;
+		if(!b->length(len) || !logStore->replace(*b, len)) {
+			return STERR_GENERIC;
+		}
+		return 1;
+	}
+
+	SYSCALL(int, maReadStore(MAHandle store, MAHandle placeholder))
+	{
+		LogStore* logStore = SYSCALL_THIS->getLogStore(store);
+		Smartie<MemStream> b(new MemStream(logStore->size()));
+		if(!logStore->read(b->ptr(), 0, logStore->size()))
+		{
+			BIG_PHAT_ERROR(ERR_STORE_READ_FAILED);
+		}
+		return SYSCALL_THIS->resources.add_RT_BINARY(placeholder, b.extract());
+	}
+
+	int Syscall::maGetStoreSize(MAHandle store) {
+		return getLogStore(store)->size();
+	}
+
+	int Syscall::maReadStoreRange(MAHandle store, void* dst, int offset, int size) {
+		LogStore* logStore = getLogStore(store);
+		MYASSERT(offset >= 0 && size >= 0 && offset <= logStore->size() - size, ERR_DATA_OOB);
+		if(!logStore->read(dst, offset, size))
+			return STERR_GENERIC;
+		return 0;
+	}
+
+	int Syscall::maWriteStoreRange(MAHandle store, const void* src, int offset, int size) {
+		LogStore* logStore = getLogStore(store);
+		MYASSERT(offset >= 0 && size >= 0, ERR_DATA_OOB);
+		if(!logStore->write(src, offset, size))
+			return STERR_GENERIC;
+		return 0;
+	}
+#else
 	SYSCALL(int, maWriteStore(MAHandle store, MAHandle data))
 	{
 		const char* name = SYSCALL_THIS->gStores.find(store);
@@ -862,11 +976,26 @@ namespace Base {
 		}
 		return SYSCALL_THIS->resources.add_RT_BINARY(placeholder, b.extract());
 	}
+#endif	//LOG_STRUCTURED_STORES
 
 	SYSCALL(void, maCloseStore(MAHandle store, int del))
 	{
 		const char* name = SYSCALL_THIS->gStores.find(store);
 		MYASSERT(name, ERR_STORE_HANDLE_INVALID);
+#ifdef LOG_STRUCTURED_STORES
+		LogStore* logStore = SYSCALL_THIS->getLogStore(store);
+		SYSCALL_THIS->gLogStores.erase(store);
+		if(del)
+		{
+			// The store has the file open.
+			int res = logStore->remove();
+			if(res != 0) {
+				LOG("maCloseStore: remove error %i. errno %i.\n", res, errno);
+				DEBIG_PHAT_ERROR;
+			}
+		}
+		logStore->release();
+#else
 		if(del)
 		{
 #ifdef SYMBIAN
@@ -911,6 +1040,7 @@ namespace Base {
 			}
 #endif	//SYMBIAN
 		}
+#endif	//LOG_STRUCTURED_STORES
 		SYSCALL_THIS->gStores.erase(store);
 	}
 #endif // NOT _android
@@ -1087,6 +1217,9 @@ namespace Base {
 			LOG("Handle: %i\n", file);
 		}
 		MYASSERT(fhp, ERR_FILE_HANDLE_INVALID);
+#ifdef ASYNC_FILE_IO
+		MYASSERT(!fhp->busy, ERR_FILE_BUSY);
+#endif
 		return *fhp;
 	}
 
@@ -1107,6 +1240,10 @@ namespace Base {
 		FileHandle* fhp = gFileHandles.find(file);
 		MYASSERT(fhp, ERR_FILE_HANDLE_INVALID);
 		FileHandle& fh(*fhp);
+#ifdef ASYNC_FILE_IO
+		// The pending operation uses the handle. Its event is still posted.
+		waitFileOp(fh);
+#endif
 		SAFE_DELETE(fh.fs);
 		gFileHandles.erase(file);
 		return 0;
@@ -1423,6 +1560,125 @@ namespace Base {
 		return 0;
 	}
 
+#ifdef ASYNC_FILE_IO
+	// Runs a read or write on a worker thread, then posts an EVENT_TYPE_FILE.
+	// Either mem or data is set.
+	class FileOp : public Runnable {
+	public:
+		FileOp(MAHandle file, Syscall::FileHandle& fh, int opType, int len)
+			: mFile(file), mFh(fh), mOpType(opType), mLen(len),
+			mMem(NULL), mData(NULL), mDataHandle(0), mOffset(0) {}
+
+		void run() {
+			FileStream& fs(*mFh.fs);
+			bool success;
+			if(mData) {
+				success = mData->seek(Seek::Start, mOffset);
+				if(mOpType == FILEOP_READ)
+					success = success && mData->writeStream(fs, mLen);
+				else
+					success = success && fs.writeStream(*mData, mLen);
+				DefluxBinPushEvent(mDataHandle, *mData);
+			} else if(mOpType == FILEOP_READ) {
+				success = fs.read(mMem, mLen);
+			} else {
+				success = fs.write(mMem, mLen);
+			}
+			mFh.busy = false;
+
+			MAEvent* ep = new MAEvent;
+			ep->type = EVENT_TYPE_FILE;
+			ep->conn.handle = mFile;
+			ep->conn.opType = mOpType;
+			ep->conn.result = success ? mLen : MA_FERR_GENERIC;
+			ConnPushEvent(ep);
+		}
+
+		const MAHandle mFile;
+		Syscall::FileHandle& mFh;
+		const int mOpType;
+		const int mLen;
+		void* mMem;
+		Stream* mData;
+		MAHandle mDataHandle;
+		int mOffset;
+	};
+
+	int Syscall::startFileOp(FileHandle& fh, Runnable* op) {
+		fh.busy = true;
+		fileThreadPool->execute(op);
+		return 0;
+	}
+
+	// Like MAConn::close(). The worker posts its event after clearing busy,
+	// so the wait can't miss it.
+	void Syscall::waitFileOp(FileHandle& fh) {
+		while(fh.busy) {
+			MAProcessEvents();
+			if(!fh.busy)
+				break;
+			ConnWaitEvent();
+		}
+	}
+
+	int Syscall::maFileReadAsync(MAHandle file, void* dst, int len) {
+		LOGF("maFileReadAsync(%i, 0x%"PFP", %i)\n", file, dst, len);
+		FileHandle& fh(getFileHandle(file));
+		if(!fh.fs)
+			FILE_FAIL(MA_FERR_GENERIC);
+		FileOp* op = new FileOp(file, fh, FILEOP_READ, len);
+		op->mMem = dst;
+		return startFileOp(fh, op);
+	}
+
+	int Syscall::maFileWriteAsync(MAHandle file, const void* src, int len) {
+		LOGF("maFileWriteAsync(%i, 0x%"PFP", %i)\n", file, src, len);
+		FileHandle& fh(getFileHandle(file));
+		if(!fh.fs)
+			FILE_FAIL(MA_FERR_GENERIC);
+		FileOp* op = new FileOp(file, fh, FILEOP_WRITE, len);
+		op->mMem = (void*)src;
+		return startFileOp(fh, op);
+	}
+
+	// The data object is replaced by a flux object until the operation is done.
+	static FileOp* createDataFileOp(MAHandle file, Syscall::FileHandle& fh, int opType,
+		MAHandle data, int offset, int len)
+	{
+		Stream* b = SYSCALL_THIS->resources.get_RT_BINARY(data);
+		int sLength;
+		MYASSERT(b->length(sLength), ERR_DATA_OOB);
+		MYASSERT(offset >= 0 && len >= 0 && offset <= sLength - len, ERR_DATA_OOB);
+		if(opType == FILEOP_READ) {
+			MYASSERT(b->ptr() != NULL, ERR_DATA_READ_ONLY);
+		}
+		SYSCALL_THIS->resources.extract_RT_BINARY(data);
+		ROOM(SYSCALL_THIS->resources.add_RT_FLUX(data, (void*)(size_t)sLength));
+
+		FileOp* op = new FileOp(file, fh, opType, len);
+		op->mData = b;
+		op->mDataHandle = data;
+		op->mOffset = offset;
+		return op;
+	}
+
+	int Syscall::maFileReadToDataAsync(MAHandle file, MAHandle data, int offset, int len) {
+		LOGF("maFileReadToDataAsync(%i, %i)\n", file, len);
+		FileHandle& fh(getFileHandle(file));
+		if(!fh.fs)
+			FILE_FAIL(MA_FERR_GENERIC);
+		return startFileOp(fh, createDataFileOp(file, fh, FILEOP_READ, data, offset, len));
+	}
+
+	int Syscall::maFileWriteFromDataAsync(MAHandle file, MAHandle data, int offset, int len) {
+		LOGF("maFileWriteFromDataAsync(%i, %i)\n", file, len);
+		FileHandle& fh(getFileHandle(file));
+		if(!fh.fs)
+			FILE_FAIL(MA_FERR_GENERIC);
+		return startFileOp(fh, createDataFileOp(file, fh, FILEOP_WRITE, data, offset, len));
+	}
+#endif	//ASYNC_FILE_IO
+
 	int Syscall::maFileTell(MAHandle file) {
 		LOGF("maFileTell(%i)\n", file);
 		FileHandle& fh(getFileHandle(file));
@@ -1616,6 +1872,115 @@ namespace Base {
 #endif	// NOT SYMBIAN
 #endif // NOT _android
 
+	//***************************************************************************
+	// String functions
+	//***************************************************************************
+
+	// Converts the result of a host comparison to -1, 0 or 1.
+	static int sign(int result) {
+		return (result > 0) - (result < 0);
+	}
+
+	int Syscall::maMemmove(int dst, int src, int size) {
+		void* d = GetValidatedMemRange(dst, size);
+		const void* s = GetValidatedMemRange(src, size);
+		memmove(d, s, size);
+		return 0;
+	}
+
+	int Syscall::maMemcmp(int a, int b, int size) {
+		if(size == 0)
+			return 0;
+		const void* pa = GetValidatedMemRange(a, size);
+		const void* pb = GetValidatedMemRange(b, size);
+		return sign(memcmp(pa, pb, size));
+	}
+
+	int Syscall::maMemchr(int buf, int ch, int size) {
+		if(size == 0)
+			return 0;
+		const char* p = (const char*)GetValidatedMemRange(buf, size);
+		const char* found = (const char*)memchr(p, ch, size);
+		return found ? buf + int(found - p) : 0;
+	}
+
+	int Syscall::maStrlen(int str) {
+		return ValidatedStrLen((const char*)GetValidatedMemRange(str, 0));
+	}
+
+	int Syscall::maStrchr(int str, int ch) {
+		const char* p = GetValidatedStr(str);
+		const char* found = strchr(p, ch);
+		return found ? str + int(found - p) : 0;
+	}
+
+	int Syscall::maStrrchr(int str, int ch) {
+		const char* p = GetValidatedStr(str);
+		const char* found = strrchr(p, ch);
+		return found ? str + int(found - p) : 0;
+	}
+
+	int Syscall::maStrncpy(int dst, int src, int count) {
+		if(count == 0)
+			return 0;
+		char* d = (char*)GetValidatedMemRange(dst, count);
+		const char* s = (const char*)GetValidatedMemRange(src, 0);
+		int len = ValidatedStrnLen(s, count);
+		// strncpy() pads with zeros up to count.
+		memmove(d, s, len);
+		memset(d + len, 0, count - len);
+		return 0;
+	}
+
+	int Syscall::maStrncmp(int a, int b, int count) {
+		if(count == 0)
+			return 0;
+		const char* pa = (const char*)GetValidatedMemRange(a, 0);
+		const char* pb = (const char*)GetValidatedMemRange(b, 0);
+		ValidatedStrnLen(pa, count);
+		ValidatedStrnLen(pb, count);
+		return sign(strncmp(pa, pb, count));
+	}
+
+	int Syscall::maStrcat(int dst, int src) {
+		int dstLen = maStrlen(dst);
+		const char* s = (const char*)GetValidatedMemRange(src, 0);
+		int srcLen = ValidatedStrLen(s);
+		char* d = (char*)GetValidatedMemRange(dst, dstLen + srcLen + 1);
+		memmove(d + dstLen, s, srcLen + 1);
+		return 0;
+	}
+
+	// MoSync's wchar is 16 bits, so the host's wide string functions can't be used.
+	static int wstrlen(const wchar* str) {
+		const wchar* p = str;
+		while(*p)
+			p++;
+		return int(p - str);
+	}
+
+	int Syscall::maWcslen(int str) {
+		return wstrlen(GetValidatedWStr(str));
+	}
+
+	int Syscall::maWcscmp(int a, int b) {
+		const wchar* pa = GetValidatedWStr(a);
+		const wchar* pb = GetValidatedWStr(b);
+		while(*pa && *pa == *pb) {
+			pa++;
+			pb++;
+		}
+		return sign(int(*pa) - int(*pb));
+	}
+
+	int Syscall::maWcscpy(int dst, int src) {
+		const wchar* s = GetValidatedWStr(src);
+		int size = (wstrlen(s) + 1) * sizeof(wchar);
+		void* d = GetValidatedMemRange(dst, size);
+		memmove(d, s, size);
+		return 0;
+	}
+
 #ifdef SYMBIAN
 #if 0
 void chrashTestDummy() {
@@ -24,6 +24,15 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include "Stream.h"
 #include "MemStream.h"
 #include "FileStream.h"
+#ifdef ASYNC_IMAGE_DECODING
+#include "ImageDecoder.h"
+#endif
+#ifdef LOG_STRUCTURED_STORES
+#include "LogStore.h"
+#endif
+#ifdef ASYNC_FILE_IO
+#include "ThreadPool.h"
+#endif
 
 //#ifndef SYMBIAN
 #if !defined(SYMBIAN) && !defined(_android)
@@ -99,6 +108,15 @@ namespace Base {
 
 		int gStoreNextId;
 		StringMap gStores;
+#ifdef LOG_STRUCTURED_STORES
+		// Handles to the same store share one LogStore, which is reference counted.
+		HashMapNoDelete<LogStore> gLogStores;
+		LogStore* getLogStore(MAHandle store);
+
+		int maGetStoreSize(MAHandle store);
+		int maReadStoreRange(MAHandle store, void* dst, int offset, int size);
+		int maWriteStoreRange(MAHandle store, const void* src, int offset, int size);
+#endif
 
 #ifdef SYMBIAN
 #define DIRSEP '\\'
@@ -111,10 +129,19 @@ namespace Base {
 			FileStream* fs;
 			int mode;
 			Array<char> name;
+#ifdef ASYNC_FILE_IO
+			// True while an asynchronous operation is using the file.
+			// Set on the VM thread, cleared by the worker thread when done.
+			volatile bool busy;
+#endif
 			bool isDirectory() const {
 				return name[name.size()-2] == DIRSEP;
 			}
+#ifdef ASYNC_FILE_IO
+			FileHandle() : name(0), busy(false) {}
+#else
 			FileHandle() : name(0) {}
+#endif
 		};
 		typedef HashMap<FileHandle> FileMap;
 		FileMap gFileHandles;
@@ -142,14 +169,45 @@ namespace Base {
 		int maFileTell(MAHandle file);
 		int maFileSeek(MAHandle file, int offset, int whence);
 
+#ifdef ASYNC_FILE_IO
+		ThreadPool* fileThreadPool;
+		int startFileOp(FileHandle& fh, Runnable* op);
+		void waitFileOp(FileHandle& fh);
+
+		int maFileReadAsync(MAHandle file, void* dst, int len);
+		int maFileWriteAsync(MAHandle file, const void* src, int len);
+		int maFileReadToDataAsync(MAHandle file, MAHandle data, int offset, int len);
+		int maFileWriteFromDataAsync(MAHandle file, MAHandle data, int offset, int len);
+#endif
+
 		MAHandle maFileListStart(const char* path, const char* filter, int sorting);
 		int maFileListNext(MAHandle list, char* nameBuf, int bufSize);
 		int maFileListClose(MAHandle list);
 
+		// Native string functions for MAStd. They take and return MoSync addresses,
+		// and validate each range once before calling the host's libc.
+		int maMemmove(int dst, int src, int size);
+		int maMemcmp(int a, int b, int size);
+		int maMemchr(int buf, int ch, int size);
+		int maStrlen(int str);
+		int maStrchr(int str, int ch);
+		int maStrrchr(int str, int ch);
+		int maStrncpy(int dst, int src, int count);
+		int maStrncmp(int a, int b, int count);
+		int maStrcat(int dst, int src);
+		int maWcslen(int str);
+		int maWcscmp(int a, int b);
+		int maWcscpy(int dst, int src);
+
 		ResourceArray resources;
+#ifdef ASYNC_IMAGE_DECODING
+		ImageDecoder* imageDecoder;
+#endif
 
 		void ValidateMemRange(const void* ptr, int size);
 		int ValidatedStrLen(const char* ptr);
+		// Returns at most \a max. Only the bytes that are read must be valid.
+		int ValidatedStrnLen(const char* ptr, int max);
 
 		//for ioctl
 		void* GetValidatedMemRange(int address, int size);
@@ -99,6 +99,11 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 	m(40079, ERR_DB_INVALID_COLUMN_INDEX, "Invalid database column index")\
 	m(40080, ERR_RES_PLACEHOLDER_NOT_DYNAMIC, "Placeholder not created using maCreatePlaceholder")\
 	m(40081, ERR_RES_PLACEHOLDER_ALREADY_DESTROYED, "Placeholder is already destroyed")\
+	m(40082, ERR_DRAW_COMMAND_INVALID, "Invalid draw command")\
+	m(40083, ERR_AOT_LOAD, "Failed to load native module")\
+	m(40084, ERR_AOT_VERSION, "Native module doesn't match the program")\
+	m(40085, ERR_FILE_BUSY, "File operation already in progress")\
+	m(40086, ERR_AOT_RETURNED, "Native module returned without calling maExit")\
 
 DECLARE_ERROR_ENUM(BASE)
 
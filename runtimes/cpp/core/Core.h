@@ -183,6 +183,7 @@ namespace Core {
 	int& GetVMYield(VMCore* core);
 	void ValidateMemRange(VMCore* core, const void* ptr, int size);
 	int ValidatedStrLen(const VMCore* core, const char* ptr);
+	int ValidatedStrnLen(const VMCore* core, const char* ptr, int max);
 
 	//for ioctl
 	void* GetValidatedMemRange(VMCore* core, int address, int size);
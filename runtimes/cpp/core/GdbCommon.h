@@ -22,4 +22,10 @@ enum GdbSignal {
 	eNone, eBreakpoint, eInterrupt, eStep
 };
 
+//Data memory is tracked in pages of this size, both by the stub,
+//which reports the pages that changed while the program ran,
+//and by MDB's memory cache.
+#define GDB_MEMORY_PAGE_SHIFT 8
+#define GDB_MEMORY_PAGE_SIZE (1 << GDB_MEMORY_PAGE_SHIFT)
+
 #endif	//GDBCOMMON_H
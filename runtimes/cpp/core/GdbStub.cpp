@@ -211,12 +211,72 @@ void GdbStub::exceptionHandler(int code) {
 }
 void GdbStub::sendExceptionPacket(int code) {
 	clearOutputBuffer();
-	appendOut('S');
+	appendOut('T');
 	appendOut(hexChars[(code>>4)&0xf]);
 	appendOut(hexChars[(code)&0xf]);
+	appendDirtyPages();
 	putPacket();
 }
 
+// Copies the pages covering the range to the shadow,
+// since that is what the debugger now has in its cache.
+void GdbStub::shadowPages(int address, int length) {
+	int numPages = (mCore->DATA_SEGMENT_SIZE + GDB_MEMORY_PAGE_SIZE - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	if((int)mShadowValid.size() != numPages) {
+		mShadow.resize(mCore->DATA_SEGMENT_SIZE);
+		mShadowValid.resize(numPages);
+		memset(mShadowValid.pointer(), 0, numPages);
+	}
+	if(length <= 0)
+		return;
+	const byte* mem = (const byte*)mCore->mem_ds;
+	int last = (address + length - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	for(int page = address >> GDB_MEMORY_PAGE_SHIFT; page <= last; page++) {
+		int begin = page << GDB_MEMORY_PAGE_SHIFT;
+		int end = MIN(begin + GDB_MEMORY_PAGE_SIZE, (int)mCore->DATA_SEGMENT_SIZE);
+		memcpy(mShadow.pointer() + begin, mem + begin, end - begin);
+		mShadowValid[page] = 1;
+	}
+}
+
+// Appends "dirty:<pages>;" listing the shadowed pages that the program
+// has changed since the debugger read them, as hex page numbers and ranges,
+// "a,b-c". Only the pages the debugger has read are compared, and they are
+// dropped from the shadow, since the debugger drops them from its cache.
+void GdbStub::appendDirtyPages() {
+	shadowPages(0, 0);
+	int numPages = mShadowValid.size();
+	appendOut("dirty:");
+	const byte* mem = (const byte*)mCore->mem_ds;
+	int runStart = -1;
+	bool first = true;
+	for(int page = 0; page <= numPages; page++) {
+		bool dirty = false;
+		if(page < numPages && mShadowValid[page]) {
+			int begin = page << GDB_MEMORY_PAGE_SHIFT;
+			int end = MIN(begin + GDB_MEMORY_PAGE_SIZE, (int)mCore->DATA_SEGMENT_SIZE);
+			dirty = memcmp(mShadow.pointer() + begin, mem + begin, end - begin) != 0;
+			if(dirty)
+				mShadowValid[page] = 0;
+		}
+		if(dirty && runStart < 0) {
+			runStart = page;
+		} else if(!dirty && runStart >= 0) {
+			if(!first)
+				appendOut(',');
+			first = false;
+			char buf[32];
+			if(page - 1 == runStart)
+				sprintf(buf, "%x", runStart);
+			else
+				sprintf(buf, "%x-%x", runStart, page - 1);
+			appendOut(buf);
+			runStart = -1;
+		}
+	}
+	appendOut(';');
+}
+
 void GdbStub::exitHandler(int code) {
 	MESSAGE m;
 	m.type = eExit;
@@ -447,6 +507,8 @@ bool GdbStub::readMemory() {
 		return false;
 	}
 	src += address;
+	if(src == (byte*)mCore->mem_ds + address)
+		shadowPages(address, length);
 
 	for(int i = 0; i < length; i++) {
 		appendDataTypeToOutput<byte>(src[i]);
@@ -477,6 +539,8 @@ bool GdbStub::writeMemory() {
 	for(int i = 0; i < length; i++) {
 		dst[address+i] = getDataTypeFromInput<byte>();
 	}
+	if(dst == (byte*)mCore->mem_ds)
+		shadowPages(address, length);
 	appendOut("OK");
 
 	return true;
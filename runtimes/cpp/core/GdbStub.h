@@ -19,6 +19,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #define _GDB_STUB_H_
 
 #include "Core.h"
+#include "GdbCommon.h"
 #include <net/net.h>
 #include "ThreadPoolImpl.h"
 #include <mostl/vector.h>
@@ -79,6 +80,14 @@ private:
 	void putMessage(MESSAGE);
 	void handleMessage();
 
+	// Copies of the GDB_MEMORY_PAGE_SIZE pages of data memory that the debugger
+	// has read, as they were when it read them. At a stop, the pages that no
+	// longer match are reported, so the debugger can keep the rest of its cache.
+	mostd::vector<byte> mShadow;
+	mostd::vector<byte> mShadowValid;	// one per page
+	void shadowPages(int address, int length);
+	void appendDirtyPages();
+
 	// handlers
 	void sendExceptionPacket(int code);
 	void sendExitPacket(int code);
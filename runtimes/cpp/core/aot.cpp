@@ -0,0 +1,109 @@
+/* Copyright (C) 2009 Mobile Sorcery AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#include "aot.h"
+#include "aotCommon.h"
+#include "dll/dll.h"
+#include "base_errors.h"
+#include "../core/Core.h"
+#include "../core/CoreCommon.h"
+
+using namespace Base;
+using namespace MoSyncError;
+
+#define AOT_ASSERT(func) MYASSERT(func, ERR_AOT_LOAD)
+
+// Thrown through the module when a syscall makes the program yield,
+// since native code can't stop and resume at the syscall like the interpreter.
+struct AotYield {};
+
+static Dll sDll;
+static AotModuleData sModule;
+static bool sStop;
+
+static void aotInvokeSysCall(int id) {
+	gCore->invokeSysCall(id);
+	if(sStop)
+		throw AotYield();
+	// Run2() would return and be called again, resuming at the next
+	// instruction. Native code resumes by simply continuing.
+	Core::GetVMYield(gCore) = 0;
+}
+
+static void aotDivisionByZero() {
+	BIG_PHAT_ERROR(ERR_DIVISION_BY_ZERO);
+}
+
+static void aotStackOutOfBounds() {
+	BIG_PHAT_ERROR(ERR_STACK_OOB);
+}
+
+// FNV-1a, the same hash that pipe-tool writes as ds_hash.
+static uint hashData(const byte* data, int len) {
+	uint hash = 2166136261u;
+	for(int i=0; i<len; i++) {
+		hash ^= data[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+void loadAotModule(const char* fileName) {
+	// the module stays loaded when the program is reloaded.
+	sDll.close();
+	bool success = sDll.open(fileName);
+	AOT_ASSERT(success);
+	InitializeAotModule initializeAotModule =
+		(InitializeAotModule)sDll.get("initializeAotModule");
+	AOT_ASSERT(initializeAotModule);
+
+	AotCoreData cd;
+	cd.regs = gCore->regs;
+	cd.memDs = gCore->mem_ds;
+	cd.dataMask = gCore->DATA_SEGMENT_SIZE - 1;
+	cd.invokeSysCall = aotInvokeSysCall;
+	cd.divisionByZero = aotDivisionByZero;
+	cd.stackOutOfBounds = aotStackOutOfBounds;
+	initializeAotModule(&sModule, &cd);
+
+	MYASSERT(sModule.version == AOT_MODULE_VERSION, ERR_AOT_VERSION);
+	AOT_ASSERT(sModule.main);
+
+	// the module must have been built from the program that was loaded.
+	// the data section is still untouched, since nothing has run yet.
+	int dataLen = gCore->Head.DataLen;
+	MYASSERT(sModule.dataLength == dataLen, ERR_AOT_VERSION);
+	MYASSERT(sModule.dataHash == hashData((byte*)gCore->mem_ds, dataLen), ERR_AOT_VERSION);
+}
+
+void runAotModule() {
+	Core::GetVMYield(gCore) = 0;
+	sStop = false;
+	try {
+		sModule.main();
+	} catch(AotYield) {
+		LOG("AOT module stopped.\n");
+		return;
+	}
+	// The entry point ends with maExit(), so this is a broken program.
+	// Running main() again would restart it from the top.
+	BIG_PHAT_ERROR(ERR_AOT_RETURNED);
+}
+
+void stopAotModule() {
+	sStop = true;
+}
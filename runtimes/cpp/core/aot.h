@@ -0,0 +1,36 @@
+/* Copyright (C) 2009 Mobile Sorcery AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef AOT_H
+#define AOT_H
+
+#include "helpers/types.h"
+
+// Loads a native module built from the program's pipe-tool -cpp output.
+// Must be called after LoadVMApp(). Panics if the module doesn't match the program.
+void loadAotModule(const char* fileName);
+
+// Runs the loaded module instead of interpreting the program.
+// Returns only when stopAotModule() was called; the module can't be resumed
+// after that, unlike Core::Run2(). Other yields are ignored.
+void runAotModule();
+
+// Makes the running module unwind back to runAotModule() at the end of the
+// current syscall. Used when another program is about to be loaded.
+void stopAotModule();
+
+#endif	//AOT_H
@@ -0,0 +1,80 @@
+/* Copyright (C) 2009 Mobile Sorcery AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Builds pipe-tool -cpp output into a native module for the runtime to load.
+// Compile this file as a shared library, with rebuild.build.cpp in the include path.
+
+#include "aotCommon.h"
+#include "CoreCommon.h"
+#include "mstypeinfo.h"
+
+#ifdef WIN32
+#define AOT_EXPORT __declspec(dllexport)
+#else
+#define AOT_EXPORT __attribute__((visibility("default")))
+#endif
+
+int sp;
+int __dbl_high;
+unsigned char* mem_ds;
+unsigned int mem_mask;
+
+static const AotCoreData* sCore;
+
+// Arguments past the fourth are already on the stack, at sp.
+int aotSysCall(int id, int i0, int i1, int i2, int i3) {
+	int* regs = sCore->regs;
+	regs[REG_sp] = sp;
+	regs[REG_i0] = i0;
+	regs[REG_i1] = i1;
+	regs[REG_i2] = i2;
+	regs[REG_i3] = i3;
+	sCore->invokeSysCall(id);
+	__dbl_high = regs[REG_r15];
+	return regs[REG_r14];
+}
+
+void MoSyncDiv0() {
+	sCore->divisionByZero();
+}
+
+void MoSyncStackOOB() {
+	sCore->stackOutOfBounds();
+}
+
+// The runtime has already loaded the data section and set up the stack.
+unsigned char* CppInitReadData(const char* file, int fileSize, int mallocSize) {
+	sp = sCore->regs[REG_sp];
+	return (unsigned char*)sCore->memDs;
+}
+
+#include "rebuild.build.cpp"
+
+static void aotMain() {
+	cpp_main();
+}
+
+extern "C" AOT_EXPORT void initializeAotModule(AotModuleData* md, const AotCoreData* cd);
+
+extern "C" void initializeAotModule(AotModuleData* md, const AotCoreData* cd) {
+	sCore = cd;
+	mem_mask = cd->dataMask;
+	md->version = AOT_MODULE_VERSION;
+	md->dataLength = ds_len;
+	md->dataHash = ds_hash;
+	md->main = aotMain;
+}
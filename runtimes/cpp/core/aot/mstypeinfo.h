@@ -0,0 +1,71 @@
+/* Copyright (C) 2009 Mobile Sorcery AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef _MOSYNC_AOT_MSTYPEINFO_H_
+#define _MOSYNC_AOT_MSTYPEINFO_H_
+
+// Included by pipe-tool -cpp output when it is built as a native module.
+// Memory is the runtime's data segment, and syscalls go through the runtime
+// by number, so the program behaves as it does in the interpreter.
+
+// Addresses are masked like MEMREF in Core.cpp, so a wild pointer stays
+// inside the data segment and unaligned accesses are rounded down.
+#define RINT(xx) 		(*(int*)(mem_ds + ((xx) & mem_mask & ~3)))
+#define RSHORT(xx) 		(*(unsigned short*)(mem_ds + ((xx) & mem_mask & ~1)))
+#define RBYTE(xx) 		(*(mem_ds + ((xx) & mem_mask)))
+
+#define WINT(xx,yy)		RINT(xx) = yy
+#define WSHORT(xx,yy)	RSHORT(xx) = yy
+#define WBYTE(xx,yy)	RBYTE(xx) = yy
+
+// Stack accesses that pipe-tool has found to be aligned and in range, once
+// CHECK_STACK has checked sp on entry to the function, aren't masked.
+// lo and len are the range of those accesses, relative to sp.
+#define RINT_SP(xx) 	(*(int*)(mem_ds + (xx)))
+#define RSHORT_SP(xx) 	(*(unsigned short*)(mem_ds + (xx)))
+#define RBYTE_SP(xx) 	(*(mem_ds + (xx)))
+
+#define WINT_SP(xx,yy)		RINT_SP(xx) = yy
+#define WSHORT_SP(xx,yy)	RSHORT_SP(xx) = yy
+#define WBYTE_SP(xx,yy)		RBYTE_SP(xx) = yy
+
+#define CHECK_STACK(lo, len) \
+	if(((unsigned)sp & 3) != 0 || (unsigned)(sp + (lo)) > mem_mask || \
+		(unsigned)(sp + (lo)) + ((len) - 1) > mem_mask) MoSyncStackOOB()
+
+#define SXSHORT(xx) ((((xx) & 0x8000) == 0) ? ((xx) & 0xFFFF) : ((xx) | ~0xFFFF))
+#define SXBYTE(xx) ((((xx) & 0x80) == 0) ? ((xx) & 0xFF) : ((xx) | ~0xFF))
+
+#define SYSCALL(name)	wrap_##name
+
+// Used by the syscall thunks that pipe-tool emits.
+#define AOT_SYSCALL aotSysCall
+
+void MoSyncDiv0();
+void MoSyncStackOOB();
+
+extern int sp;
+extern int __dbl_high;
+
+extern unsigned char* mem_ds;
+extern unsigned int mem_mask;
+
+int aotSysCall(int id, int i0, int i1, int i2, int i3);
+
+unsigned char* CppInitReadData(const char* file, int fileSize, int mallocSize);
+
+#endif	//_MOSYNC_AOT_MSTYPEINFO_H_
@@ -0,0 +1,54 @@
+/* Copyright (C) 2009 Mobile Sorcery AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef _MOSYNC_AOT_COMMON_H_
+#define _MOSYNC_AOT_COMMON_H_
+
+// Shared by the runtime and native modules built from pipe-tool -cpp output.
+
+// Bump when either struct changes.
+#define AOT_MODULE_VERSION 3
+
+struct AotCoreData {
+	// The registers and data memory of the loaded program.
+	int* regs;
+	void* memDs;
+	// Size of the data memory minus one. The size is a power of two.
+	unsigned int dataMask;
+	// Invokes a syscall with the arguments in regs, like the interpreter does.
+	// The result is stored in r14 and r15.
+	void (*invokeSysCall)(int id);
+	void (*divisionByZero)();
+	// Called when sp is outside the data segment or unaligned.
+	void (*stackOutOfBounds)();
+};
+
+struct AotModuleData {
+	int version;
+	// Length and FNV-1a hash of the data section that the module was built
+	// with. They must match the program that was loaded.
+	int dataLength;
+	unsigned int dataHash;
+	// Runs the program from its entry point.
+	void (*main)();
+};
+
+// Each module exports this function.
+// Don't mix 32-bit and 64-bit code. (Should be impossible on most systems.)
+typedef void (*InitializeAotModule)(AotModuleData*, const AotCoreData*);
+
+#endif	//_MOSYNC_AOT_COMMON_H_
@@ -17,9 +17,21 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #include <string.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <set>
+#include <algorithm>
 //#include <functional>
 
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #ifndef CONFIG_H
 #define CONFIG_H	//HACK
 #endif
@@ -34,6 +46,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <demangle/demangle.h>
 
 #include "sld.h"
+#include "sldIndex.h"
 
 #define BUFSIZE 1024
 
@@ -46,61 +59,239 @@ using namespace std;
 #define stricmp strcasecmp
 #endif
 
-struct linemap_file_line_less
-//	: public std::binary_function<LineMapping, LineMapping, bool>
-{	// functor for operator<
-	bool operator()(const LineMapping& _Left, const LineMapping& _Right) const
-	{	// apply operator< to operands
-		if(_Left.file != _Right.file)
-			return _Left.file < _Right.file;
-		else
-			return _Left.line < _Right.line;
-	}
+//******************************************************************************
+// Index tables
+//******************************************************************************
+
+// All lookups go through these tables. They point either into a memory-mapped
+// .idx file, or into the vectors below, which are built from the text SLD.
+struct SldTables {
+	int nFiles;
+	const SLD_INDEX_FILE* files;
+	int nLines;
+	const SLD_INDEX_LINE* lines;
+	const SLD_INDEX_LINE* linesByFile;
+	int nFunctions;
+	const SLD_INDEX_FUNCTION* functions;
+	int functionHashSize;
+	const int* functionHash;
+	int nVariables;
+	const SLD_INDEX_VARIABLE* variables;
+	int variableHashSize;
+	const int* variableHash;
+	int stringsSize;
+	const char* strings;
 };
 
-struct funcmap_start_less
-//	: public std::binary_function<FuncMapping*, FuncMapping*, bool>
-{
-	bool operator()(const FuncMapping* const& l, const FuncMapping* const& r) const
-	{
-		return l->start < r->start;
+static SldTables sTables;
+
+static Vector<SLD_INDEX_FILE> sFileVec;
+static Vector<SLD_INDEX_LINE> sLineVec;
+static Vector<SLD_INDEX_LINE> sLineByFileVec;
+static Vector<SLD_INDEX_FUNCTION> sFunctionVec;
+static Vector<int> sFunctionHashVec;
+static Vector<SLD_INDEX_VARIABLE> sVariableVec;
+static Vector<int> sVariableHashVec;
+static Vector<char> sStringVec;
+
+static Vector<FileMapping> gFiles;
+
+// One entry per index function. Names are demangled on first use.
+static Vector<FuncMapping> gFuncs;
+static Vector<bool> gFuncDemangled;
+
+// Function indices sorted by demangled name. Built on first use.
+static Vector<int> gFuncsByName;
+
+static const char* indexString(int offset) {
+	if(offset < 0 || offset >= sTables.stringsSize)
+		return "";
+	return sTables.strings + offset;
+}
+
+static const FuncMapping& funcMapping(int index) {
+	FuncMapping& fm(gFuncs[index]);
+	if(!gFuncDemangled[index]) {
+		const SLD_INDEX_FUNCTION& f(sTables.functions[index]);
+		fm.mangledName = indexString(f.name);
+		const char *demangledName = cplus_demangle_v3(fm.mangledName.c_str(), DMGL_PARAMS);
+		/* Only update names that we could demangle */
+		if(demangledName != NULL) {
+			fm.name = demangledName;
+			free((void*)demangledName);
+		} else {
+			fm.name = fm.mangledName;
+		}
+		gFuncDemangled[index] = true;
 	}
-};
+	return fm;
+}
 
-struct funcmap_name_less
-//	: public std::binary_function<FuncMapping*, FuncMapping*, bool>
-{
-	bool operator()(const FuncMapping* const& l, const FuncMapping* const& r) const
-	{
-		return l->name < r->name;
+//******************************************************************************
+// Memory-mapped index
+//******************************************************************************
+
+class MappedFile {
+public:
+	MappedFile() : data(NULL), size(0) {
+#ifdef WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#endif
 	}
+	~MappedFile() { close(); }
+
+	bool open(const char* filename) {
+		close();
+#ifdef WIN32
+		file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+		size = GetFileSize(file, NULL);
+		if(size == INVALID_FILE_SIZE || size == 0) {
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping == NULL) {
+			close();
+			return false;
+		}
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if(data == NULL) {
+			close();
+			return false;
+		}
+#else
+		int fd = ::open(filename, O_RDONLY);
+		if(fd < 0)
+			return false;
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		size = st.st_size;
+		void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if(p == MAP_FAILED)
+			return false;
+		data = (const char*)p;
+#endif
+		return true;
+	}
+
+	void close() {
+#ifdef WIN32
+		if(data)
+			UnmapViewOfFile(data);
+		if(mapping)
+			CloseHandle(mapping);
+		if(file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		if(data)
+			munmap((void*)data, size);
+#endif
+		data = NULL;
+		size = 0;
+	}
+
+	const char* data;
+	size_t size;
+private:
+#ifdef WIN32
+	HANDLE file, mapping;
+#endif
 };
 
-static Vector<FileMapping> gFiles;
+static MappedFile sMappedIndex;
 
-static std::set<LineMapping> sLineSet;	//maps addresses to lines
+//returns true if the table lies within the mapped file.
+static bool checkTable(int offset, int count, size_t elemSize) {
+	if(offset < 0 || count < 0 || (offset & 3) != 0)
+		return false;
+	return (size_t)offset + (size_t)count * elemSize <= sMappedIndex.size;
+}
 
-//maps lines to addresses.
-//multiple addresses may map to the same line.
-//this map will only contain the first.
-typedef std::multiset<LineMapping, linemap_file_line_less> AddressSet;
-static AddressSet gAddressSet;
+static bool isPowerOfTwo(int x) {
+	return x > 0 && (x & (x - 1)) == 0;
+}
 
-typedef set<FuncMapping*, funcmap_start_less> FuncMapAddr;
-static FuncMapAddr sFuncMapAddr;
+//returns true if every slot of the hash table is empty or holds a valid index,
+//and there is at least one empty slot, so that probing always ends.
+static bool checkHash(const int* table, int size, int count) {
+	bool hasEmpty = false;
+	for(int i=0; i<size; i++) {
+		if(table[i] == -1)
+			hasEmpty = true;
+		else if(table[i] < 0 || table[i] >= count)
+			return false;
+	}
+	return hasEmpty;
+}
 
-//should probably be a hash set, for fastest lookup
-typedef set<FuncMapping*, funcmap_name_less> FuncMapName;
-static FuncMapName sFuncMapName;
+//returns true if indexName is a valid index at least as new as sldName.
+//in that case, sTables point into the mapping.
+static bool loadIndex(const char* sldName, const char* indexName) {
+	struct stat sldStat, indexStat;
+	if(stat(sldName, &sldStat) != 0 || stat(indexName, &indexStat) != 0)
+		return false;
+	if(indexStat.st_mtime < sldStat.st_mtime)
+		return false;
 
-struct VarMapping {
-	int scope;
-	int start;
-	String name;
-};
-//TODO: make into a set, for faster lookup.
-Vector<VarMapping> gVarMap;
+	if(!sMappedIndex.open(indexName))
+		return false;
+	const char* base = sMappedIndex.data;
+	if(sMappedIndex.size < sizeof(SLD_INDEX_HEADER)) {
+		sMappedIndex.close();
+		return false;
+	}
+	const SLD_INDEX_HEADER& h(*(const SLD_INDEX_HEADER*)base);
+	if(h.magic != SLD_INDEX_MAGIC || h.version != SLD_INDEX_VERSION ||
+		!checkTable(h.filesOffset, h.nFiles, sizeof(SLD_INDEX_FILE)) ||
+		!checkTable(h.linesOffset, h.nLines, sizeof(SLD_INDEX_LINE)) ||
+		!checkTable(h.linesByFileOffset, h.nLines, sizeof(SLD_INDEX_LINE)) ||
+		!checkTable(h.functionsOffset, h.nFunctions, sizeof(SLD_INDEX_FUNCTION)) ||
+		!checkTable(h.functionHashOffset, h.functionHashSize, sizeof(int)) ||
+		!checkTable(h.variablesOffset, h.nVariables, sizeof(SLD_INDEX_VARIABLE)) ||
+		!checkTable(h.variableHashOffset, h.variableHashSize, sizeof(int)) ||
+		!isPowerOfTwo(h.functionHashSize) || !isPowerOfTwo(h.variableHashSize) ||
+		h.stringsOffset < 0 || h.stringsSize <= 0 ||
+		(size_t)h.stringsOffset + h.stringsSize > sMappedIndex.size ||
+		base[h.stringsOffset + h.stringsSize - 1] != 0 ||
+		!checkHash((const int*)(base + h.functionHashOffset), h.functionHashSize, h.nFunctions) ||
+		!checkHash((const int*)(base + h.variableHashOffset), h.variableHashSize, h.nVariables))
+	{
+		LOG("Invalid SLD index \"%s\". Using the SLD file.\n", indexName);
+		sMappedIndex.close();
+		return false;
+	}
 
+	sTables.nFiles = h.nFiles;
+	sTables.files = (const SLD_INDEX_FILE*)(base + h.filesOffset);
+	sTables.nLines = h.nLines;
+	sTables.lines = (const SLD_INDEX_LINE*)(base + h.linesOffset);
+	sTables.linesByFile = (const SLD_INDEX_LINE*)(base + h.linesByFileOffset);
+	sTables.nFunctions = h.nFunctions;
+	sTables.functions = (const SLD_INDEX_FUNCTION*)(base + h.functionsOffset);
+	sTables.functionHashSize = h.functionHashSize;
+	sTables.functionHash = (const int*)(base + h.functionHashOffset);
+	sTables.nVariables = h.nVariables;
+	sTables.variables = (const SLD_INDEX_VARIABLE*)(base + h.variablesOffset);
+	sTables.variableHashSize = h.variableHashSize;
+	sTables.variableHash = (const int*)(base + h.variableHashOffset);
+	sTables.stringsSize = h.stringsSize;
+	sTables.strings = base + h.stringsOffset;
+	return true;
+}
+
+//******************************************************************************
+// Text SLD
+//******************************************************************************
 
 class File {
 public:
@@ -125,106 +316,57 @@ static bool readLine(char* dst, int maxLen, File& file) {
 	return true;
 }
 
-const FuncMapping* mapFunctionEx(int ip) {
-	FuncMapping temp;
-	temp.start = ip;
-	FuncMapAddr::const_iterator itr = sFuncMapAddr.lower_bound(&temp);
-	if(itr == sFuncMapAddr.end())
-		return NULL;
-	if((*itr)->start > ip) {
-		if(itr == sFuncMapAddr.begin())
-			return NULL;
-		itr--;
-	}
-	DEBUG_ASSERT((*itr)->start <= ip);
-	if((*itr)->stop >= ip)
-		return *itr;
-	else
-		return NULL;
+static int addString(const char* str) {
+	int offset = (int)sStringVec.size();
+	sStringVec.insert(sStringVec.end(), str, str + strlen(str) + 1);
+	return offset;
 }
 
-const char* mapFunction(int ip) {
-	const FuncMapping* fm = mapFunctionEx(ip);
-	if(fm == NULL)
-		return NULL;
-	return fm->name.c_str();
+// qsort() comparators.
+static int compareLineIp(const void* a, const void* b) {
+	return ((const SLD_INDEX_LINE*)a)->ip - ((const SLD_INDEX_LINE*)b)->ip;
 }
 
-int mapFunctionStart(int ip) {
-	const FuncMapping* fm = mapFunctionEx(ip);
-	if(fm == NULL)
-		return -1;
-	return fm->start;
+static int compareLineFile(const void* pa, const void* pb) {
+	const SLD_INDEX_LINE& a(*(const SLD_INDEX_LINE*)pa);
+	const SLD_INDEX_LINE& b(*(const SLD_INDEX_LINE*)pb);
+	if(a.file != b.file)
+		return a.file - b.file;
+	if(a.line != b.line)
+		return a.line - b.line;
+	return a.ip - b.ip;
 }
 
-#if 0
-int mapFunction(const char* name) {
-	for(size_t i=0; i<gFuncMap.size(); i++) {
-		FuncMapping& fm(gFuncMap[i]);
-		if(strcmp(name, fm.name.c_str()) == 0)
-			return fm.start;
-	}
-	return -1;
-}
-#endif
-int mapFunction(const char* name) {
-	FuncMapping temp;
-	temp.name = name;
-	FuncMapName::const_iterator itr = sFuncMapName.find(&temp);
-	if(itr == sFuncMapName.end())
-		return -1;
-	else
-		return (*itr)->start;
+static int hashSize(int count) {
+	int size = 1;
+	while(size < count * 2)
+		size <<= 1;
+	return size;
 }
 
-int mapVariable(const char* name, int scope) {
-	for(size_t i=0; i<gVarMap.size(); i++) {
-		VarMapping& vm(gVarMap[i]);
-		if(scope == vm.scope && strcmp(name, vm.name.c_str()) == 0)
-			return vm.start;
-	}
-	return -1;
-}
-
-int nextSldEntry(int address) {
-	LineMapping key;
-	key.ip = address;
-	set<LineMapping>::iterator itr = sLineSet.find(key);
-	if(itr == sLineSet.end())
-		return -1;
-	itr++;
-	if(itr == sLineSet.end())
-		return -1;
-	return itr->ip;
-}
-
-void clearSLD() {
-	FuncMapAddr::iterator itr = sFuncMapAddr.begin();
-	while(itr != sFuncMapAddr.end()) {
-		delete *itr;
-		itr++;
-	}
-	sFuncMapAddr.clear();
-	sFuncMapName.clear();
-	sLineSet.clear();
-	gAddressSet.clear();
-	gFiles.clear();
+static void hashInsert(Vector<int>& table, unsigned int hash, int index) {
+	int mask = (int)table.size() - 1;
+	int slot = hash & mask;
+	while(table[slot] >= 0)
+		slot = (slot + 1) & mask;
+	table[slot] = index;
 }
 
 static int fileIndexFromScope(int scope) {
-	for(size_t i=0; i<gFiles.size(); i++) {
-		if(gFiles[i].scope == scope)
+	for(size_t i=0; i<sFileVec.size(); i++) {
+		if(sFileVec[i].scope == scope)
 			return (int)i;
 	}
 	return -1;
 }
 
-bool loadSLD(const char* filename) {
-	clearSLD();
-
+//parses the text file into the vectors.
+static bool parseText(const char* filename) {
 	File file(filename);
 	char buffer[BUFSIZE];
 
+	addString("");
+
 	//read files
 	int lastIndex = 0;
 	TEST(readLine(buffer, BUFSIZE, file));
@@ -232,9 +374,9 @@ bool loadSLD(const char* filename) {
 	while(1) {
 		TEST(readLine(buffer, BUFSIZE, file));
 
-		FileMapping fm;
+		SLD_INDEX_FILE f;
 		int index, nameStartPoint;
-		if(sscanf(buffer, "%i:%i%n", &index, &fm.scope, &nameStartPoint) != 2)
+		if(sscanf(buffer, "%i:%i%n", &index, &f.scope, &nameStartPoint) != 2)
 			break;
 		if(buffer[nameStartPoint] != ':')
 			break;
@@ -243,35 +385,29 @@ bool loadSLD(const char* filename) {
 		index++;
 		if(index != lastIndex)
 			return 1;
-		fm.name = buffer + nameStartPoint;
-
-		//transform to unix-style paths for easy handling in the rest of the program.
-		for(size_t i=0; i<fm.name.size(); i++) {
-			if(fm.name[i] == '\\')
-				fm.name[i] = '/';
-		}
-#ifdef LINUX
-		//windows absolute paths cannot be parsed by unix programs
-		if(fm.name[1] == ':') {
-			fm.name[1] = '_';
-		}
-#endif
-		gFiles.push_back(fm);
+		f.name = addString(buffer + nameStartPoint);
+		sFileVec.push_back(f);
 	}
-	//LOG("Found %i files\n", gFiles.size());
+	//LOG("Found %i files\n", sFileVec.size());
 
 	//read address map
 	FAILIF(strcmp(buffer, "SLD") != 0);
 	while(1) {
 		TEST(readLine(buffer, BUFSIZE, file));
-		LineMapping m;
-		if(sscanf(buffer, "%x:%i:%"PFZT"i", &m.ip, &m.line, &m.file) != 3)
+		SLD_INDEX_LINE m;
+		if(sscanf(buffer, "%x:%i:%i", &m.ip, &m.line, &m.file) != 3)
 			break;
-		std::pair<std::set<LineMapping>::iterator, bool> res = sLineSet.insert(m);
-		TEST(res.second);
-		gAddressSet.insert(m);
+		sLineVec.push_back(m);
+	}
+	if(!sLineVec.empty())
+		qsort(&sLineVec[0], sLineVec.size(), sizeof(SLD_INDEX_LINE), compareLineIp);
+	for(size_t i=1; i<sLineVec.size(); i++) {
+		TEST(sLineVec[i-1].ip != sLineVec[i].ip);
 	}
-	//LOG("Found %i lines\n", gLineMap.size());
+	sLineByFileVec = sLineVec;
+	if(!sLineByFileVec.empty())
+		qsort(&sLineByFileVec[0], sLineByFileVec.size(), sizeof(SLD_INDEX_LINE), compareLineFile);
+	//LOG("Found %i lines\n", sLineVec.size());
 
 	//read function map
 	FAILIF(strcmp(buffer, "FUNCTIONS") != 0);
@@ -279,7 +415,7 @@ bool loadSLD(const char* filename) {
 	int lastStop = -1;
 	while(1) {
 		TEST(readLine(buffer, BUFSIZE, file));
-		FuncMapping fm;
+		SLD_INDEX_FUNCTION fm;
 		int nameLen;
 		if(sscanf(buffer, "%*s%n %x,%x", &nameLen, &fm.start, &fm.stop) != 2)
 			break;
@@ -291,13 +427,11 @@ bool loadSLD(const char* filename) {
 			FAIL;
 		}
 		lastStop = fm.stop;
-		FuncMapping* fmp = new FuncMapping(fm);
 		if(buffer[0] == '_')
-			fmp->name = buffer + 1;	//skip the extra '_'.
+			fm.name = addString(buffer + 1);	//skip the extra '_'.
 		else
-			fmp->name = buffer;
-		sFuncMapAddr.insert(fmp);
-		sFuncMapName.insert(fmp);
+			fm.name = addString(buffer);
+		sFunctionVec.push_back(fm);
 	}
 
 	//read variable map
@@ -305,7 +439,7 @@ bool loadSLD(const char* filename) {
 	//int lastStart = -1;
 	while(1) {
 		TEST(readLine(buffer, BUFSIZE, file));
-		VarMapping vm;
+		SLD_INDEX_VARIABLE vm;
 		int nameLen;
 		if(sscanf(buffer, "%*s%n %i %x", &nameLen, &vm.scope, &vm.start) != 2)
 			break;
@@ -317,41 +451,240 @@ bool loadSLD(const char* filename) {
 		}
 #endif
 		vm.scope = fileIndexFromScope(vm.scope);
-		FAILIF(vm.scope < 0);
 		//lastStart = vm.start;
-		if(buffer[0] == '_') {	//because we seem to be getting a few too many variables.
-			vm.name = buffer + 1;	//skip the extra '_'.
-			gVarMap.push_back(vm);
+		//pipe-tool leaves variables in unknown files out of the index, so we do too.
+		if(vm.scope >= 0 && buffer[0] == '_') {	//because we seem to be getting a few too many variables.
+			vm.name = addString(buffer + 1);	//skip the extra '_'.
+			sVariableVec.push_back(vm);
 		}
 	}
 
-	for(FuncMapAddr::iterator itr = sFuncMapAddr.begin(); itr != sFuncMapAddr.end(); itr++) {
-		const char *mangledName = cplus_demangle_v3((*itr)->name.c_str(), DMGL_PARAMS);
-		/* Only update names that we could mangle */
-		if(mangledName != NULL) {
-			(*itr)->name = mangledName;
+	//build hash tables. names are only final once the string pool is complete.
+	sFunctionHashVec.assign(hashSize((int)sFunctionVec.size()), -1);
+	for(size_t i=0; i<sFunctionVec.size(); i++) {
+		hashInsert(sFunctionHashVec, SldIndexHash(&sStringVec[sFunctionVec[i].name], 0), (int)i);
+	}
+	sVariableHashVec.assign(hashSize((int)sVariableVec.size()), -1);
+	for(size_t i=0; i<sVariableVec.size(); i++) {
+		const SLD_INDEX_VARIABLE& vm(sVariableVec[i]);
+		hashInsert(sVariableHashVec, SldIndexHash(&sStringVec[vm.name], vm.scope), (int)i);
+	}
+	return true;
+}
+
+//parses the text file and points sTables at the vectors.
+static bool parseSLD(const char* filename) {
+	bool result = parseText(filename);
+	if(sStringVec.empty())
+		addString("");
+	if(sFunctionHashVec.empty())
+		sFunctionHashVec.assign(1, -1);
+	if(sVariableHashVec.empty())
+		sVariableHashVec.assign(1, -1);
+
+	sTables.nFiles = (int)sFileVec.size();
+	sTables.files = sFileVec.empty() ? NULL : &sFileVec[0];
+	sTables.nLines = (int)sLineVec.size();
+	sTables.lines = sLineVec.empty() ? NULL : &sLineVec[0];
+	sTables.linesByFile = sLineByFileVec.empty() ? NULL : &sLineByFileVec[0];
+	sTables.nFunctions = (int)sFunctionVec.size();
+	sTables.functions = sFunctionVec.empty() ? NULL : &sFunctionVec[0];
+	sTables.functionHashSize = (int)sFunctionHashVec.size();
+	sTables.functionHash = &sFunctionHashVec[0];
+	sTables.nVariables = (int)sVariableVec.size();
+	sTables.variables = sVariableVec.empty() ? NULL : &sVariableVec[0];
+	sTables.variableHashSize = (int)sVariableHashVec.size();
+	sTables.variableHash = &sVariableHashVec[0];
+	sTables.stringsSize = (int)sStringVec.size();
+	sTables.strings = &sStringVec[0];
+	return result;
+}
+
+//******************************************************************************
+// Public interface
+//******************************************************************************
+
+void clearSLD() {
+	sMappedIndex.close();
+	memset(&sTables, 0, sizeof(sTables));
+	sFileVec.clear();
+	sLineVec.clear();
+	sLineByFileVec.clear();
+	sFunctionVec.clear();
+	sFunctionHashVec.clear();
+	sVariableVec.clear();
+	sVariableHashVec.clear();
+	sStringVec.clear();
+	gFiles.clear();
+	gFuncs.clear();
+	gFuncDemangled.clear();
+	gFuncsByName.clear();
+}
+
+bool loadSLD(const char* filename) {
+	clearSLD();
+
+	String indexName = String(filename) + ".idx";
+	if(!loadIndex(filename, indexName.c_str())) {
+		if(!parseSLD(filename)) {
+			clearSLD();
+			return false;
 		}
 	}
+
+	for(int i=0; i<sTables.nFiles; i++) {
+		FileMapping fm;
+		fm.scope = sTables.files[i].scope;
+		fm.name = indexString(sTables.files[i].name);
+
+		//transform to unix-style paths for easy handling in the rest of the program.
+		for(size_t j=0; j<fm.name.size(); j++) {
+			if(fm.name[j] == '\\')
+				fm.name[j] = '/';
+		}
+#ifdef LINUX
+		//windows absolute paths cannot be parsed by unix programs
+		if(fm.name.size() > 1 && fm.name[1] == ':') {
+			fm.name[1] = '_';
+		}
+#endif
+		gFiles.push_back(fm);
+	}
+
+	gFuncs.resize(sTables.nFunctions);
+	gFuncDemangled.assign(sTables.nFunctions, false);
+	for(int i=0; i<sTables.nFunctions; i++) {
+		gFuncs[i].start = sTables.functions[i].start;
+		gFuncs[i].stop = sTables.functions[i].stop;
+	}
 	return true;
 }
 
+//returns the index of the last function starting at or before ip, or -1.
+static int findFunction(int ip) {
+	int lo = 0, hi = sTables.nFunctions;
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(sTables.functions[mid].start <= ip)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
+const FuncMapping* mapFunctionEx(int ip) {
+	int index = findFunction(ip);
+	if(index < 0)
+		return NULL;
+	DEBUG_ASSERT(sTables.functions[index].start <= ip);
+	if(sTables.functions[index].stop >= ip)
+		return &funcMapping(index);
+	else
+		return NULL;
+}
+
+const char* mapFunction(int ip) {
+	const FuncMapping* fm = mapFunctionEx(ip);
+	if(fm == NULL)
+		return NULL;
+	return fm->name.c_str();
+}
+
+int mapFunctionStart(int ip) {
+	int index = findFunction(ip);
+	if(index < 0 || sTables.functions[index].stop < ip)
+		return -1;
+	return sTables.functions[index].start;
+}
+
+struct funcmap_name_less {
+	bool operator()(int l, int r) const {
+		return gFuncs[l].name < gFuncs[r].name;
+	}
+};
+
+int mapFunction(const char* name) {
+	//mangled or C names are in the index hash.
+	if(sTables.nFunctions > 0) {
+		int mask = sTables.functionHashSize - 1;
+		int slot = SldIndexHash(name, 0) & mask;
+		while(sTables.functionHash[slot] >= 0) {
+			const SLD_INDEX_FUNCTION& f(sTables.functions[sTables.functionHash[slot]]);
+			if(strcmp(name, indexString(f.name)) == 0)
+				return f.start;
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	//demangled names need the name table.
+	if(gFuncsByName.empty() && sTables.nFunctions > 0) {
+		gFuncsByName.resize(sTables.nFunctions);
+		for(int i=0; i<sTables.nFunctions; i++) {
+			funcMapping(i);
+			gFuncsByName[i] = i;
+		}
+		std::sort(gFuncsByName.begin(), gFuncsByName.end(), funcmap_name_less());
+	}
+	int lo = 0, hi = (int)gFuncsByName.size();
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(gFuncs[gFuncsByName[mid]].name < name)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if(lo < (int)gFuncsByName.size() && gFuncs[gFuncsByName[lo]].name == name)
+		return gFuncs[gFuncsByName[lo]].start;
+	return -1;
+}
+
+int mapVariable(const char* name, int scope) {
+	if(sTables.nVariables == 0)
+		return -1;
+	int mask = sTables.variableHashSize - 1;
+	int slot = SldIndexHash(name, scope) & mask;
+	while(sTables.variableHash[slot] >= 0) {
+		const SLD_INDEX_VARIABLE& vm(sTables.variables[sTables.variableHash[slot]]);
+		if(scope == vm.scope && strcmp(name, indexString(vm.name)) == 0)
+			return vm.start;
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+//returns the index of the first line entry with an ip greater than ip.
+static int lineUpperBound(int ip) {
+	int lo = 0, hi = sTables.nLines;
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(sTables.lines[mid].ip <= ip)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int nextSldEntry(int address) {
+	int index = lineUpperBound(address);
+	if(index == 0 || sTables.lines[index - 1].ip != address)
+		return -1;
+	if(index == sTables.nLines)
+		return -1;
+	return sTables.lines[index].ip;
+}
+
 bool mapIpEx(int inIp, LineMapping& lm) {
 	//find mapping with ip equal to or less than inIp.
-	LineMapping key;
-	key.ip = inIp;
-	set<LineMapping>::const_iterator itr = sLineSet.lower_bound(key);
-	//lower_bound returns >=, instead of <=. So we do this:
-	if(itr == sLineSet.end()) {
-		if(sLineSet.empty())
-			return false;
-		itr--;
-	} else if(itr->ip > inIp) {
-		itr--;
-		if(itr == sLineSet.begin())
-			return false;
-	}
+	int index = lineUpperBound(inIp) - 1;
+	if(index < 0)
+		return false;
 
-	lm = *itr;
+	const SLD_INDEX_LINE& l(sTables.lines[index]);
+	lm.ip = l.ip;
+	lm.line = l.line;
+	lm.file = l.file;
 	return true;
 }
 
@@ -359,6 +692,8 @@ bool mapIp(int inIp, int& outLine, String& outFile) {
 	LineMapping lm;
 	if(!mapIpEx(inIp, lm))
 		return false;
+	if(lm.file < 0 || lm.file >= (int)gFiles.size())
+		return false;
 	outLine = lm.line;
 	outFile = gFiles[lm.file].name;
 	return true;
@@ -380,44 +715,44 @@ const char* getMapFileLineError(int ret) {
 }
 
 int mapFileLine(const char* filename, int lineNumber, vector<int>& addresses) {
-	if(gAddressSet.size() == 0 || gFiles.size() == 0) {
+	if(sTables.nLines == 0 || gFiles.size() == 0) {
 		return ERR_NOMAP;
 	}
-	size_t fileIndex;
-	for(fileIndex=0; fileIndex<gFiles.size(); fileIndex++) {
+	int fileIndex;
+	for(fileIndex=0; fileIndex<(int)gFiles.size(); fileIndex++) {
 		if(stricmp(gFiles[fileIndex].name.c_str(), filename) == 0)	//hack
 			break;
 	}
-	if(fileIndex == gFiles.size())
+	if(fileIndex == (int)gFiles.size())
 		return ERR_NOFILE;
 
-	LineMapping lm;
-	lm.file = fileIndex;
-	lm.line = lineNumber;
-
-	AddressSet::const_iterator itr = gAddressSet.lower_bound(lm);
-
-	addresses.clear();
-
-	set<int> foundFunctions;
-
 	// find first valid line
-	while(itr!=gAddressSet.end() && itr->file==fileIndex && itr->line<lineNumber) {
-		itr++;
+	const SLD_INDEX_LINE* lines = sTables.linesByFile;
+	int lo = 0, hi = sTables.nLines;
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(lines[mid].file < fileIndex ||
+			(lines[mid].file == fileIndex && lines[mid].line < lineNumber))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	if(itr==gAddressSet.end()) {
+	if(lo == sTables.nLines || lines[lo].file != fileIndex) {
 		return ERR_NOLINE;
 	}
 
-	lineNumber = itr->line;
+	addresses.clear();
+
+	set<int> foundFunctions;
+
+	lineNumber = lines[lo].line;
 
-	while(itr!=gAddressSet.end() && itr->file==fileIndex && itr->line==lineNumber) {
-		const FuncMapping* fm = mapFunctionEx(itr->ip);
-		if(foundFunctions.find(fm->start) == foundFunctions.end()) {
-			addresses.push_back(itr->ip);
-			foundFunctions.insert(fm->start);
+	for(int i=lo; i<sTables.nLines && lines[i].file==fileIndex && lines[i].line==lineNumber; i++) {
+		int start = mapFunctionStart(lines[i].ip);
+		if(foundFunctions.find(start) == foundFunctions.end()) {
+			addresses.push_back(lines[i].ip);
+			foundFunctions.insert(start);
 		}
-		itr++;
 	}
 
 	if(addresses.size() == 0)
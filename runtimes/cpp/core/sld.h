@@ -36,12 +36,14 @@ bool loadFunctionMap(const char* filename);
 void clearFunctionMap();
 #endif
 
+//If <filename>.idx exists and is not older than the SLD file,
+//the binary index written by pipe-tool is memory-mapped instead of parsing the text.
 bool loadSLD(const char* filename);
 void clearSLD();
 
 struct LineMapping {
 	int ip, line;
-	size_t file;
+	int file;	//index into sldFiles()
 
 	bool operator<(const LineMapping& o) const {
 		return ip < o.ip;
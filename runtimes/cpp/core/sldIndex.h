@@ -0,0 +1,83 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef SLD_INDEX_H
+#define SLD_INDEX_H
+
+// Binary index of an SLD file, written by pipe-tool next to the text file
+// as <sld>.idx and memory-mapped read-only by loadSLD().
+// This file is shared between pipe-tool (C) and the runtime/debugger (C++).
+//
+// All values are 32-bit integers in host (little-endian) byte order.
+// Offsets are in bytes from the start of the file. Names are offsets into
+// the string table, which holds nul-terminated strings.
+//
+// Function and variable names are stored the way loadSLD() uses them,
+// with the leading '_' removed. Function names are not demangled.
+//
+// The hash tables use open addressing with linear probing. Their sizes are
+// powers of two, and empty slots hold -1. Variables are hashed on name and scope.
+
+#define SLD_INDEX_MAGIC 0x58444c53	/* "SLDX" */
+#define SLD_INDEX_VERSION 1
+
+typedef struct SLD_INDEX_HEADER {
+	int magic;
+	int version;
+	int nFiles, filesOffset;	/* SLD_INDEX_FILE, in file number order */
+	int nLines, linesOffset;	/* SLD_INDEX_LINE, sorted by ip */
+	int linesByFileOffset;	/* SLD_INDEX_LINE, sorted by file, line and ip */
+	int nFunctions, functionsOffset;	/* SLD_INDEX_FUNCTION, sorted by start */
+	int functionHashSize, functionHashOffset;	/* function indices */
+	int nVariables, variablesOffset;	/* SLD_INDEX_VARIABLE */
+	int variableHashSize, variableHashOffset;	/* variable indices */
+	int stringsSize, stringsOffset;
+} SLD_INDEX_HEADER;
+
+typedef struct SLD_INDEX_FILE {
+	int scope;
+	int name;
+} SLD_INDEX_FILE;
+
+typedef struct SLD_INDEX_LINE {
+	int ip, line, file;
+} SLD_INDEX_LINE;
+
+typedef struct SLD_INDEX_FUNCTION {
+	int start, stop;
+	int name;
+} SLD_INDEX_FUNCTION;
+
+typedef struct SLD_INDEX_VARIABLE {
+	int scope;	/* file index */
+	int start;
+	int name;
+} SLD_INDEX_VARIABLE;
+
+/* FNV-1a */
+static unsigned int SldIndexHash(const char* name, int scope) {
+	unsigned int h = 2166136261u;
+	while(*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+	h ^= (unsigned int)scope;
+	h *= 16777619u;
+	return h;
+}
+
+#endif	/* SLD_INDEX_H */
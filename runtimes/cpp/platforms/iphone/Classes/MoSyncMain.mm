@@ -57,6 +57,10 @@ void Base::Syscall::ValidateMemRange(const void* ptr, int size) {
 int Base::Syscall::ValidatedStrLen(const char* ptr) {
 	return strlen(ptr);
 }
+int Base::Syscall::ValidatedStrnLen(const char* ptr, int max) {
+	const char* end = (const char*)memchr(ptr, 0, max);
+	return end ? end - ptr : max;
+}
 const char* Base::Syscall::GetValidatedStr(int address) {
     if(address == 0) return NULL;
 	return (const char*)mem_ds+address;
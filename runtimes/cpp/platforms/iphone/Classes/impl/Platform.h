@@ -193,7 +193,7 @@ public:
 
 class EventQueue : public CircularFifo<MAEvent, EVENT_BUFFER_SIZE> {
 public:
-	EventQueue() : CircularFifo<MAEvent, EVENT_BUFFER_SIZE>(), mEventOverflow(false), mWaiting(false) {
+	EventQueue() : CircularFifo<MAEvent, EVENT_BUFFER_SIZE>(), mEventOverflow(false), mWaiting(0) {
 		pthread_cond_init(&mCond, NULL);
 		pthread_mutex_init(&mMutex, NULL);
 	}
@@ -221,13 +221,21 @@ public:
 	void put(const MAEvent& e) {
 		CircularFifo<MAEvent, EVENT_BUFFER_SIZE>::put(e);
 
-		pthread_mutex_lock(&mMutex);	
-		pthread_cond_signal(&mCond);
-		pthread_mutex_unlock(&mMutex);
+		// Only take the mutex if the VM thread is sleeping in wait().
+		// wait() sets mWaiting before it checks count(), so either it sees
+		// this event or we see mWaiting.
+		atomicMemoryBarrier();
+		if(atomicLoad(&mWaiting)) {
+			pthread_mutex_lock(&mMutex);
+			pthread_cond_signal(&mCond);
+			pthread_mutex_unlock(&mMutex);
+		}
 	}
 
 	void wait(int ms) {
 		pthread_mutex_lock(&mMutex);
+		atomicStore(&mWaiting, 1);
+		atomicMemoryBarrier();
 		if(count()==0) {
 			if(ms>0) {
 				struct timeval now;
@@ -240,24 +248,29 @@ public:
 				pthread_cond_wait(&mCond, &mMutex);
 			}
 		}
+		atomicStore(&mWaiting, 0);
 		pthread_mutex_unlock(&mMutex);	
 	}
 
 	void addPointerEvent(int x, int y, int touchId, int type) {
-		if(!mEventOverflow) {
-			if(count() + 2 == EVENT_BUFFER_SIZE) {	//leave space for Close event
+		//leave space for Close event. Only the VM thread may clear the queue,
+		//so pointer events are dropped until it has caught up.
+		if(count() + 2 >= EVENT_BUFFER_SIZE) {
+			if(!mEventOverflow) {
 				mEventOverflow = true;
-				clear();
-				LOG("EventBuffer overflow!\n");
+				LOG("EventBuffer overflow! %i events put, at most %i queued.\n",
+					stats().puts, stats().maxCount);
 			}
-			/* put event in event queue */
-			MAEvent event;
-			event.type = type;
-			event.point.x = x;
-			event.point.y = y;
-			event.touchId = touchId;
-			put(event);
-		}		
+			return;
+		}
+		mEventOverflow = false;
+		/* put event in event queue */
+		MAEvent event;
+		event.type = type;
+		event.point.x = x;
+		event.point.y = y;
+		event.touchId = touchId;
+		put(event);
 	}
 	
 	void addScreenChangedEvent() {
@@ -284,7 +297,7 @@ private:
 	pthread_cond_t mCond;
 
 	bool mEventOverflow;
-	bool mWaiting;
+	volatile int mWaiting;
 	
 };
 
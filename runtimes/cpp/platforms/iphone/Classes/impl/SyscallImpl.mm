@@ -25,6 +25,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <time.h>
 #include <math.h>
 #include <helpers/fifo.h>
+#include <helpers/CriticalSection.h>
 #include <helpers/log.h>
 #include <helpers/helpers.h>
 #include <helpers/smartie.h>
@@ -450,32 +451,14 @@ namespace Base {
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			gDrawTarget->mImageDrawer->drawTriangle(
-											 points[i-2].x,
-											 points[i-2].y,
-											 points[i-1].x,
-											 points[i-1].y,
-											 points[i].x,
-											 points[i].y,
-											 realColor);
-		}
+		gDrawTarget->mImageDrawer->drawTriangleStrip((const int*)points, count, realColor);
 	}
 
 	SYSCALL(void, maFillTriangleFan(const MAPoint2d *points, int count)) {
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			gDrawTarget->mImageDrawer->drawTriangle(
-											 points[0].x,
-											 points[0].y,
-											 points[i-1].x,
-											 points[i-1].y,
-											 points[i].x,
-											 points[i].y,
-											 realColor);
-		}
+		gDrawTarget->mImageDrawer->drawTriangleFan((const int*)points, count, realColor);
 	}
 
 	int stringLength(const wchar_t* str) {
@@ -838,6 +821,20 @@ namespace Base {
 		gDrawTarget->mImageDrawer->drawImageRegion(dstTopLeft->x, dstTopLeft->y, &srcRect, img->mImageDrawer, transformMode);
 	}
 
+	static int maDrawImageRegions(MAHandle image, const MAImageRegion* regions, int count) {
+		Surface* img = gSyscall->resources.get_RT_IMAGE(image);
+		ClipRect srcRect;
+		for(int i = 0; i < count; i++) {
+			const MAImageRegion& r(regions[i]);
+			srcRect.x = r.srcRect.left;
+			srcRect.y = r.srcRect.top;
+			srcRect.width = r.srcRect.width;
+			srcRect.height = r.srcRect.height;
+			gDrawTarget->mImageDrawer->drawImageRegion(r.dstPoint.x, r.dstPoint.y, &srcRect, img->mImageDrawer, TRANS_NONE);
+		}
+		return 0;
+	}
+
 	SYSCALL(MAExtent, maGetImageSize(MAHandle image)) {
 		Surface* img = gSyscall->resources.get_RT_IMAGE(image);
 		return EXTENT(img->width, img->height);
@@ -1966,6 +1963,11 @@ namespace Base {
 		maIOCtl_case(maFrameBufferGetInfo);
 		maIOCtl_case(maFrameBufferInit);
 		maIOCtl_case(maFrameBufferClose);
+		case maIOCtl_maDrawImageRegions:
+			if(uint(c) > 0x7fffffff / sizeof(MAImageRegion))
+				BIG_PHAT_ERROR(ERR_MEMORY_OOB);
+			return maDrawImageRegions(a, (MAImageRegion*)SYSCALL_THIS->GetValidatedMemRange(b,
+				c * sizeof(MAImageRegion)), c);
         maIOCtl_syscall_case(maPimListOpen);
         maIOCtl_syscall_case(maPimListNext);
         maIOCtl_syscall_case(maPimItemCount);
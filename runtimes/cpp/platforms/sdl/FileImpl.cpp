@@ -191,5 +191,13 @@ namespace Base {
 		LTEST(ftruncate(mFd, size));
 		return true;
 	}
+#ifdef WIN32
+#define fsync _commit
+#endif
+	bool WriteFileStream::sync() {
+		TEST(isOpen());
+		LTEST(fsync(mFd));
+		return true;
+	}
 
 };
@@ -35,6 +35,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <core/Core.h>
 #include <core/sld.h>
 #include <core/extensions.h>
+#include <core/aot.h>
 #include <base/Syscall.h>
 #include <helpers/helpers.h>
 
@@ -97,6 +98,7 @@ int main2(int argc, char **argv) {
 #endif
 	const char* sldFile = NULL;
 	const char* xFile = NULL;
+	const char* aotFile = NULL;
 #ifdef GDB_DEBUG
 	bool gdb = false;
 #endif
@@ -141,6 +143,7 @@ int main2(int argc, char **argv) {
 				"  -resmem <bytes:integer>                set resource memory limit.\n"
 				"  -gdb                                   start gdb stub.\n"
 				"  -x <filename:string>                   load extension config file.\n"
+				"  -aot <filename:string>                 run a native module built from the program with pipe-tool -cpp.\n"
 #ifdef EMULATOR
 				"  -allowdivzero                          allow floating-point division by zero. this produces ieee standard results.\n"
 				"  -timeout <seconds:integer>             close the program if it runs longer than the timeout.\n"
@@ -243,6 +246,13 @@ int main2(int argc, char **argv) {
 				return 1;
 			}
 			xFile = argv[i];
+		} else if(strcmp(argv[i], "-aot")==0) {
+			i++;
+			if(i>=argc) {
+				LOG("not enough parameters for -aot");
+				return 1;
+			}
+			aotFile = argv[i];
 #ifdef GDB_DEBUG
 		} else if(strcmp(argv[i], "-gdb")==0) {
 			gdb = true;
@@ -300,6 +310,10 @@ int main2(int argc, char **argv) {
 		loadExtensions(xFile);
 	}
 
+	if(aotFile) {
+		loadAotModule(aotFile);
+	}
+
 #ifdef ENABLE_DEBUGGER
 	Core::initDebugger(gCore, 4711);
 	atexit(Core::closeDebugger);
@@ -308,9 +322,14 @@ int main2(int argc, char **argv) {
 
 	while(1) {
 		try {
-			Core::Run2(gCore);
+			if(aotFile)
+				runAotModule();
+			else
+				Core::Run2(gCore);
 
 			if(gReloadHandle > 0) {
+				// the native module was built for the old program.
+				aotFile = NULL;
 #ifdef FAKE_CALL_STACK
 				clearSLD();
 #endif
@@ -335,12 +354,17 @@ int main2(int argc, char **argv) {
 				BIG_PHAT_ERROR(ERR_PROGRAM_LOAD_FAILED);
 				return 1;
 			}
+			if(aotFile) {
+				loadAotModule(aotFile);
+			}
 		}
 	}
 }
 
 SYSCALL(void, maLoadProgram(MAHandle data, int reload)) {
 	Base::gSyscall->VM_Yield();
+	if(data > 0)
+		stopAotModule();
 	gReloadHandle = data;
 	gReload |= (reload != 0);
 }
@@ -38,6 +38,15 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #define FILESYSTEM_CHROOT 0
 #endif	//EMULATOR
 
+// Decode image resources on worker threads. See ImageDecoder.h.
+#define ASYNC_IMAGE_DECODING
+
+// Keep stores in append-only files. See LogStore.h.
+#define LOG_STRUCTURED_STORES
+
+// Run maFile*Async() operations on worker threads.
+#define ASYNC_FILE_IO
+
 namespace Core {
 	class VMCore;
 }
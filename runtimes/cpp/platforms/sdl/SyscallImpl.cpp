@@ -75,6 +75,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 extern "C" {
 #include "SDL_prim.h"
 }
+#include "PolygonRasterizer.h"
 //#include "audio.h"
 #include "AudioEngine.h"
 #include "AudioChannel.h"
@@ -553,19 +554,36 @@ namespace Base {
 	#endif	//0
 
 	SDL_Surface* Syscall::loadImage(MemStream& s) {
+		SDL_Surface* surf = decodeImage(s);
+		MYASSERT(surf, SDLERR_IMAGE_LOAD_FAILED);
+		return finishImage(surf);
+	}
+
+	// Must not panic or touch the screen; it may run on any thread.
+	SDL_Surface* Syscall::decodeImage(MemStream& s) {
 		int size;
-		TEST(s.length(size));
+		if(!s.length(size))
+			return NULL;
 		SDL_RWops* rwops = SDL_RWFromConstMem(s.ptr(), size);
+		if(!rwops)
+			return NULL;
 		//SDL_Surface* surf = IMG_LoadPNG_RW(rwops);
 		//if(!surf) IMG_LoadJPG_RW(rwops);
 		SDL_Surface* surf = IMG_Load_RW(rwops, 0);
-		MYASSERT(surf, SDLERR_IMAGE_LOAD_FAILED);
-		surf = SDL_DisplayFormatAlpha(surf);
 		SDL_FreeRW(rwops);
+		return surf;
+	}
 
+	SDL_Surface* Syscall::finishImage(SDL_Surface* decoded) {
+		SDL_Surface* surf = SDL_DisplayFormatAlpha(decoded);
+		SDL_FreeSurface(decoded);
 		return surf;
 	}
 
+	void Syscall::freeDecodedImage(SDL_Surface* decoded) {
+		SDL_FreeSurface(decoded);
+	}
+
 	SDL_Surface* Syscall::loadSprite(SDL_Surface* surface, ushort left, ushort top, ushort width, ushort height, ushort cx, ushort cy) {
 		SDL_Surface* surf = SDL_CreateRGBSurface(SDL_SWSURFACE, surface->w, surface->h, surface->format->BitsPerPixel,
 			surface->format->Rmask, surface->format->Gmask, surface->format->Bmask, surface->format->Amask);
@@ -790,7 +808,8 @@ namespace Base {
 				if(gEventFifo.count() + 2 == EVENT_BUFFER_SIZE) {	//leave space for Close event
 					gEventOverflow = true;
 					gEventFifo.clear();
-					LOG("EventBuffer overflow!\n");
+					LOG("EventBuffer overflow! %i events put, at most %i queued.\n",
+						gEventFifo.stats().puts, gEventFifo.stats().maxCount);
 				}
 				MAEvent event;
 				event.type = type;
@@ -806,7 +825,8 @@ namespace Base {
 			if(gEventFifo.count() + 2 == EVENT_BUFFER_SIZE) {	//leave space for Close event
 				gEventOverflow = true;
 				gEventFifo.clear();
-				LOG("EventBuffer overflow!\n");
+				LOG("EventBuffer overflow! %i events put, at most %i queued.\n",
+					gEventFifo.stats().puts, gEventFifo.stats().maxCount);
 			}
 			MAEvent event;
 			event.type = pressed ? EVENT_TYPE_KEY_PRESSED : EVENT_TYPE_KEY_RELEASED;
@@ -1078,6 +1098,66 @@ namespace Base {
 		SDL_UserEvent event = { FE_ADD_EVENT, 0, ep, NULL };
 		FE_PushEvent((SDL_Event*)&event);
 	}
+
+	struct SDLSpanFiller {
+		SDL_Surface* surface;
+		Uint32 color;
+
+		void operator()(int y, int left, int right) {
+			int bpp = surface->format->BytesPerPixel;
+			Uint8* p = (Uint8*)surface->pixels + y * surface->pitch + left * bpp;
+			int w = right - left;
+			switch(bpp) {
+			case 1:
+				memset(p, color, w);
+				break;
+			case 2:
+				{
+					Uint16* scan = (Uint16*)p;
+					while(w--) *scan++ = (Uint16)color;
+				}
+				break;
+			case 3:
+				while(w--) {
+					if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+						p[0] = (color >> 16) & 0xff;
+						p[1] = (color >> 8) & 0xff;
+						p[2] = color & 0xff;
+					} else {
+						p[0] = color & 0xff;
+						p[1] = (color >> 8) & 0xff;
+						p[2] = (color >> 16) & 0xff;
+					}
+					p += 3;
+				}
+				break;
+			case 4:
+				{
+					Uint32* scan = (Uint32*)p;
+					while(w--) *scan++ = color;
+				}
+				break;
+			}
+		}
+	};
+
+	static PolygonRasterizer sRasterizer;
+
+	// Fills a whole strip or fan in one pass, instead of one SDL_fillTriangle per triangle.
+	static void fillTriangles(const MAPoint2d* points, int count, bool fan) {
+		SDL_Surface* surface = gDrawSurface;
+		const SDL_Rect& clip(surface->clip_rect);
+		// maSetClipRect doesn't intersect the clip rect with the surface.
+		sRasterizer.setClip(MAX(clip.x, 0), MAX(clip.y, 0),
+			MIN(clip.x + clip.w, surface->w), MIN(clip.y + clip.h, surface->h));
+		SDLSpanFiller filler = { surface, gCurrentConvertedColor };
+		__SDL_PRIM_LOCKSURFACE(surface);
+		if(fan)
+			sRasterizer.fillTriangleFan((const int*)points, count, filler);
+		else
+			sRasterizer.fillTriangleStrip((const int*)points, count, filler);
+		__SDL_PRIM_UNLOCKSURFACE(surface);
+	}
 }	//namespace Base
 
 	//***************************************************************************
@@ -1129,16 +1209,7 @@ namespace Base {
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			SDL_fillTriangle(gDrawSurface,
-				points[i-2].x,
-				points[i-2].y,
-				points[i-1].x,
-				points[i-1].y,
-				points[i].x,
-				points[i].y,
-				gCurrentConvertedColor);
-		}
+		fillTriangles(points, count, false);
 		LOGG("fp color 0x%08x %i:", gCurrentConvertedColor, count);
 		for(int i=0; i<count; i++) {
 			LOGG(" %ix%i", points[i].x, points[i].y);
@@ -1150,16 +1221,7 @@ namespace Base {
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			SDL_fillTriangle(gDrawSurface,
-				points[0].x,
-				points[0].y,
-				points[i-1].x,
-				points[i-1].y,
-				points[i].x,
-				points[i].y,
-				gCurrentConvertedColor);
-		}
+		fillTriangles(points, count, true);
 		LOGG("fp color 0x%08x %i:", gCurrentConvertedColor, count);
 		for(int i=0; i<count; i++) {
 			LOGG(" %ix%i", points[i].x, points[i].y);
@@ -1258,6 +1320,120 @@ namespace Base {
 		SDL_FreeSurface(srcSurface);
 	}
 
+	// Clips a source rect to the clip rect of the image, moving the
+	// destination point accordingly. Returns false if nothing is left.
+	static bool clipImageSource(SDL_Surface* surf, int& u, int& v, int& width, int& height,
+		int& left, int& top)
+	{
+		if( width <= 0 || height <= 0) return false;
+
+		if (u > surf->clip_rect.x + surf->clip_rect.w)
+			return false;
+		else if(u < surf->clip_rect.x) {
+			left += surf->clip_rect.x - u;
+			u = surf->clip_rect.x;
+		}
+		if (v > surf->clip_rect.y + surf->clip_rect.h)
+			return false;
+		else if(v < surf->clip_rect.y) {
+			top += surf->clip_rect.y - v;
+			v = surf->clip_rect.y;
+		}
+		if(u + surf->clip_rect.w < surf->clip_rect.x)
+			return false;
+		else if(u + width > surf->clip_rect.x + surf->clip_rect.w)
+			width -= (u + width) - (surf->clip_rect.x + surf->clip_rect.w);
+		if(v + height< surf->clip_rect.y)
+			return false;
+		else if(v + height > surf->clip_rect.y + surf->clip_rect.h)
+			height -= (v + height) - (surf->clip_rect.y + surf->clip_rect.h);
+
+		return width > 0 && height > 0;
+	}
+
+	// Draws untransformed image regions to gDrawSurface.
+	// The pixel formats are read once, and each region is clipped against the
+	// draw surface before the pixel loops, which then need no per-pixel tests.
+	class ImageRegionBlitter {
+	public:
+		ImageRegionBlitter(SDL_Surface* surf) : mSurf(surf) {
+			SDL_PixelFormat* dst = gDrawSurface->format;
+			SDL_PixelFormat* src = surf->format;
+			mDstRedMask = dst->Rmask; mDstRedShift = dst->Rshift;
+			mDstGreenMask = dst->Gmask; mDstGreenShift = dst->Gshift;
+			mDstBlueMask = dst->Bmask; mDstBlueShift = dst->Bshift;
+			mDstAlphaMask = dst->Amask;
+			mSrcRedMask = src->Rmask; mSrcRedShift = src->Rshift;
+			mSrcGreenMask = src->Gmask; mSrcGreenShift = src->Gshift;
+			mSrcBlueMask = src->Bmask; mSrcBlueShift = src->Bshift;
+			mSrcAlphaMask = src->Amask; mSrcAlphaShift = src->Ashift;
+		}
+
+		// The source rect must already be clipped with clipImageSource().
+		void blit(int u, int v, int width, int height, int left, int top) {
+			const SDL_Rect& clip = gDrawSurface->clip_rect;
+			if(left < clip.x) {
+				u += clip.x - left;
+				width -= clip.x - left;
+				left = clip.x;
+			}
+			if(top < clip.y) {
+				v += clip.y - top;
+				height -= clip.y - top;
+				top = clip.y;
+			}
+			if(left + width > clip.x + clip.w)
+				width = clip.x + clip.w - left;
+			if(top + height > clip.y + clip.h)
+				height = clip.y + clip.h - top;
+			if(width <= 0 || height <= 0)
+				return;
+
+			int srcPitch = mSurf->pitch>>2;
+			int dstPitch = gDrawSurface->pitch>>2;
+			const unsigned int* srcRow = (unsigned int*)mSurf->pixels + v*srcPitch + u;
+			unsigned int* dstRow = (unsigned int*)gDrawSurface->pixels + top*dstPitch + left;
+
+			if(mSurf->flags&SDL_SRCALPHA) {
+				while(height--) {
+					for(int x = 0; x < width; x++) {
+						unsigned int s = srcRow[x];
+						unsigned int d = dstRow[x];
+						int a = (s&mSrcAlphaMask)>>mSrcAlphaShift;
+						int sr = ((s&mSrcRedMask)>>mSrcRedShift);
+						int sg = ((s&mSrcGreenMask)>>mSrcGreenShift);
+						int sb = ((s&mSrcBlueMask)>>mSrcBlueShift);
+						int dr = ((d&mDstRedMask)>>mDstRedShift);
+						int dg = ((d&mDstGreenMask)>>mDstGreenShift);
+						int db = ((d&mDstBlueMask)>>mDstBlueShift);
+						dstRow[x] =
+							(((dr + (((sr-dr)*(a))>>8)) << mDstRedShift)  &mDstRedMask) |
+							(((dg + (((sg-dg)*(a))>>8)) << mDstGreenShift)&mDstGreenMask) |
+							(((db + (((sb-db)*(a))>>8)) << mDstBlueShift) &mDstBlueMask);
+					}
+					srcRow += srcPitch;
+					dstRow += dstPitch;
+				}
+			} else {
+				unsigned int rgbMask = mSrcRedMask | mSrcGreenMask | mSrcBlueMask;
+				while(height--) {
+					for(int x = 0; x < width; x++) {
+						dstRow[x] = (dstRow[x] & mDstAlphaMask) | (srcRow[x] & rgbMask);
+					}
+					srcRow += srcPitch;
+					dstRow += dstPitch;
+				}
+			}
+		}
+
+	private:
+		SDL_Surface* mSurf;
+		unsigned int mDstRedMask, mDstRedShift, mDstGreenMask, mDstGreenShift;
+		unsigned int mDstBlueMask, mDstBlueShift, mDstAlphaMask;
+		unsigned int mSrcRedMask, mSrcRedShift, mSrcGreenMask, mSrcGreenShift;
+		unsigned int mSrcBlueMask, mSrcBlueShift, mSrcAlphaMask, mSrcAlphaShift;
+	};
+
 	SYSCALL(void, maDrawImageRegion(MAHandle image, const MARect* src, const MAPoint2d* dstTopLeft, int transformMode)) {
 		//LOG("Entering DrawImageRegion start\n");
 
@@ -1279,40 +1455,15 @@ namespace Base {
 		int left = dstTopLeft->x;
 		int top = dstTopLeft->y;
 
-		if( width <= 0 || height <= 0) return;
-
-		if (u > surf->clip_rect.x + surf->clip_rect.w)
+		if(!clipImageSource(surf, u, v, width, height, left, top))
 			return;
-		else if(u < surf->clip_rect.x) {
-			left += surf->clip_rect.x - u;
-			u = surf->clip_rect.x;
-		}
-		if (v > surf->clip_rect.y + surf->clip_rect.h)
+
+		if(transformMode == TRANS_NONE) {
+			ImageRegionBlitter(surf).blit(u, v, width, height, left, top);
 			return;
-		else if(v < surf->clip_rect.y) {
-			top += surf->clip_rect.y - v;
-			v = surf->clip_rect.y;
 		}
-		if(u + surf->clip_rect.w < surf->clip_rect.x)
-			return;
-		else if(u + width > surf->clip_rect.x + surf->clip_rect.w)
-			width -= (u + width) - (surf->clip_rect.x + surf->clip_rect.w);
-		if(v + height< surf->clip_rect.y)
-			return;
-		else if(v + height > surf->clip_rect.y + surf->clip_rect.h)
-			height -= (v + height) - (surf->clip_rect.y + surf->clip_rect.h);
-
-		if( width <= 0 || height <= 0) return;
 
 		switch(transformMode) {
-			case TRANS_NONE:
-				srcPitchX = bpp;
-				srcPitchY = surf->pitch;
-				transTopLeftX = u;
-				transTopLeftY = v;
-				transWidth = width;
-				transHeight = height;
-				break;
 			case TRANS_ROT90:
 				srcPitchX = -surf->pitch;
 				srcPitchY = bpp;
@@ -1469,6 +1620,116 @@ namespace Base {
 	}
 
 
+	static int maDrawImageRegions(MAHandle image, const MAImageRegion* regions, int count) {
+		SDL_Surface* surf = gSyscall->resources.get_RT_IMAGE(image);
+		ImageRegionBlitter blitter(surf);
+		for(int i = 0; i < count; i++) {
+			const MAImageRegion& r(regions[i]);
+			int u = r.srcRect.left, v = r.srcRect.top;
+			int width = r.srcRect.width, height = r.srcRect.height;
+			int left = r.dstPoint.x, top = r.dstPoint.y;
+			if(clipImageSource(surf, u, v, width, height, left, top))
+				blitter.blit(u, v, width, height, left, top);
+		}
+		return 0;
+	}
+
+	// The length in words of each GFX_CMD_, including the header.
+	// Text commands have a minimum length instead.
+	static const int sDrawCommandLengths[] = {
+		0,	//unused
+		5,	//SET_CLIP_RECT
+		2,	//SET_COLOR
+		3,	//PLOT
+		5,	//LINE
+		5,	//FILL_RECT
+		4,	//DRAW_TEXT
+		4,	//DRAW_TEXT_W
+		4,	//DRAW_IMAGE
+		9,	//DRAW_RGB
+		9,	//DRAW_IMAGE_REGION
+	};
+
+	static int maDrawCommands(const int* commands, int count) {
+		const int* cmd = commands;
+		const int* end = commands + count;
+		while(cmd < end) {
+			int op = cmd[0] & 0xff;
+			int length = (unsigned int)cmd[0] >> 8;
+			if(length < 1 || length > end - cmd)
+				BIG_PHAT_ERROR(ERR_DRAW_COMMAND_INVALID);
+			if(op != 0 && op < (int)(sizeof(sDrawCommandLengths) / sizeof(int))) {
+				int expected = sDrawCommandLengths[op];
+				bool text = (op == GFX_CMD_DRAW_TEXT || op == GFX_CMD_DRAW_TEXT_W);
+				if(text ? length < expected : length != expected)
+					BIG_PHAT_ERROR(ERR_DRAW_COMMAND_INVALID);
+			}
+
+			switch(op) {
+			case GFX_CMD_SET_CLIP_RECT:
+				maSetClipRect(cmd[1], cmd[2], cmd[3], cmd[4]);
+				break;
+			case GFX_CMD_SET_COLOR:
+				maSetColor(cmd[1]);
+				break;
+			case GFX_CMD_PLOT:
+				maPlot(cmd[1], cmd[2]);
+				break;
+			case GFX_CMD_LINE:
+				maLine(cmd[1], cmd[2], cmd[3], cmd[4]);
+				break;
+			case GFX_CMD_FILL_RECT:
+				maFillRect(cmd[1], cmd[2], cmd[3], cmd[4]);
+				break;
+			case GFX_CMD_DRAW_TEXT:
+				if(((const char*)(cmd + length))[-1] != 0)
+					BIG_PHAT_ERROR(ERR_DRAW_COMMAND_INVALID);
+				maDrawText(cmd[1], cmd[2], (const char*)(cmd + 3));
+				break;
+			case GFX_CMD_DRAW_TEXT_W:
+				if(((const wchar*)(cmd + length))[-1] != 0)
+					BIG_PHAT_ERROR(ERR_DRAW_COMMAND_INVALID);
+				maDrawTextW(cmd[1], cmd[2], (const wchar*)(cmd + 3));
+				break;
+			case GFX_CMD_DRAW_IMAGE:
+				maDrawImage(cmd[1], cmd[2], cmd[3]);
+				break;
+			case GFX_CMD_DRAW_RGB:
+				if(cmd[7] < 0 || cmd[8] < 0 ||
+					(cmd[7] != 0 && cmd[8] > 0x7fffffff / (int)sizeof(int) / cmd[7]))
+				{
+					BIG_PHAT_ERROR(ERR_DRAW_COMMAND_INVALID);
+				}
+				maDrawRGB((const MAPoint2d*)(cmd + 1),
+					gSyscall->GetValidatedMemRange(cmd[3], sizeof(int) * cmd[7] * cmd[8]),
+					(const MARect*)(cmd + 4), cmd[8]);
+				break;
+			case GFX_CMD_DRAW_IMAGE_REGION:
+				if(cmd[2] == TRANS_NONE) {
+					// Runs of untransformed regions of the same image share a blitter.
+					int header = cmd[0];
+					MAHandle image = cmd[1];
+					SDL_Surface* surf = gSyscall->resources.get_RT_IMAGE(image);
+					ImageRegionBlitter blitter(surf);
+					do {
+						int u = cmd[3], v = cmd[4];
+						int width = cmd[5], height = cmd[6];
+						int left = cmd[7], top = cmd[8];
+						if(clipImageSource(surf, u, v, width, height, left, top))
+							blitter.blit(u, v, width, height, left, top);
+						cmd += length;
+					} while(end - cmd >= length && cmd[0] == header &&
+						cmd[1] == image && cmd[2] == TRANS_NONE);
+					continue;
+				}
+				maDrawImageRegion(cmd[1], (const MARect*)(cmd + 3), (const MAPoint2d*)(cmd + 7), cmd[2]);
+				break;
+			}
+			cmd += length;
+		}
+		return 0;
+	}
+
 	SYSCALL(MAExtent, maGetImageSize(MAHandle image)) {
 		SDL_Surface* surf = gSyscall->resources.get_RT_IMAGE(image);
 		return EXTENT(surf->w, surf->h);
@@ -2237,6 +2498,65 @@ namespace Base {
 			maIOCtl_case(maTextBox);
 #endif
 
+		case maIOCtl_maDrawImageRegions:
+			if(uint(c) > 0x7fffffff / sizeof(MAImageRegion))
+				BIG_PHAT_ERROR(ERR_MEMORY_OOB);
+			return maDrawImageRegions(a, (MAImageRegion*)SYSCALL_THIS->GetValidatedMemRange(b,
+				c * sizeof(MAImageRegion)), c);
+
+		case maIOCtl_maDrawCommands:
+			if(uint(b) > 0x7fffffff / sizeof(int))
+				BIG_PHAT_ERROR(ERR_MEMORY_OOB);
+			return maDrawCommands((int*)SYSCALL_THIS->GetValidatedMemRange(a, b * sizeof(int)), b);
+
+#ifdef LOG_STRUCTURED_STORES
+			maIOCtl_syscall_case(maGetStoreSize);
+		case maIOCtl_maReadStoreRange:
+		{
+			int size = SYSCALL_THIS->GetValidatedStackValue(0 VSV_ARGPTR_USE);
+			return SYSCALL_THIS->maReadStoreRange(a, SYSCALL_THIS->GetValidatedMemRange(b, size), c, size);
+		}
+		case maIOCtl_maWriteStoreRange:
+		{
+			int size = SYSCALL_THIS->GetValidatedStackValue(0 VSV_ARGPTR_USE);
+			return SYSCALL_THIS->maWriteStoreRange(a, SYSCALL_THIS->GetValidatedMemRange(b, size), c, size);
+		}
+#endif
+
+#ifdef ASYNC_FILE_IO
+		case maIOCtl_maFileReadAsync:
+			return SYSCALL_THIS->maFileReadAsync(a, SYSCALL_THIS->GetValidatedMemRange(b, c), c);
+		case maIOCtl_maFileWriteAsync:
+			return SYSCALL_THIS->maFileWriteAsync(a, SYSCALL_THIS->GetValidatedMemRange(b, c), c);
+			maIOCtl_syscall_case(maFileReadToDataAsync);
+			maIOCtl_syscall_case(maFileWriteFromDataAsync);
+#endif
+
+		case maIOCtl_maStrlen:
+			return SYSCALL_THIS->maStrlen(a);
+		case maIOCtl_maMemmove:
+			return SYSCALL_THIS->maMemmove(a, b, c);
+		case maIOCtl_maMemcmp:
+			return SYSCALL_THIS->maMemcmp(a, b, c);
+		case maIOCtl_maMemchr:
+			return SYSCALL_THIS->maMemchr(a, b, c);
+		case maIOCtl_maStrchr:
+			return SYSCALL_THIS->maStrchr(a, b);
+		case maIOCtl_maStrrchr:
+			return SYSCALL_THIS->maStrrchr(a, b);
+		case maIOCtl_maStrncpy:
+			return SYSCALL_THIS->maStrncpy(a, b, c);
+		case maIOCtl_maStrncmp:
+			return SYSCALL_THIS->maStrncmp(a, b, c);
+		case maIOCtl_maStrcat:
+			return SYSCALL_THIS->maStrcat(a, b);
+		case maIOCtl_maWcslen:
+			return SYSCALL_THIS->maWcslen(a);
+		case maIOCtl_maWcscmp:
+			return SYSCALL_THIS->maWcscmp(a, b);
+		case maIOCtl_maWcscpy:
+			return SYSCALL_THIS->maWcscpy(a, b);
+
 		case maIOCtl_maSyscallPanicsEnable:
 			LOG("maSyscallPanicsEnable\n");
 			gSyscall->mPanicOnProgrammerError = true;
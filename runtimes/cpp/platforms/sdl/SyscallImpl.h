@@ -21,6 +21,13 @@ private:
 public:
 #endif
 SDL_Surface* loadImage(MemStream& s);
+
+// Used by ImageDecoder. decodeImage() runs on worker threads,
+// finishImage() converts its result on the main thread.
+friend class ImageDecoder;
+static SDL_Surface* decodeImage(MemStream& s);
+SDL_Surface* finishImage(SDL_Surface* decoded);
+static void freeDecodedImage(SDL_Surface* decoded);
 SDL_Surface* loadSprite(SDL_Surface* surface, ushort left, ushort top,
 	ushort width, ushort height, ushort cx, ushort cy);
 
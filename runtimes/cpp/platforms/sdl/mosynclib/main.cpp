@@ -131,6 +131,9 @@ void Base::Syscall::ValidateMemRange(const void* ptr, int size) {
 int Base::Syscall::ValidatedStrLen(const char* ptr) {
 	return strlen(ptr);
 }
+int Base::Syscall::ValidatedStrnLen(const char* ptr, int max) {
+	return strnlen(ptr, max);
+}
 int Base::Syscall::GetValidatedStackValue(int offset, va_list argptr) {
 	DEBUG_ASSERT((offset % 4) == 0);
 	for(int i=0; i<offset; i+=4) {
@@ -33,6 +33,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <time.h>
 #include <math.h>
 #include <helpers/fifo.h>
+#include <helpers/CriticalSection.h>
 #include <helpers/log.h>
 #include <helpers/helpers.h>
 #include <helpers/smartie.h>
@@ -393,7 +394,8 @@ namespace Base {
 			if(gEventFifo.count() + 2 == EVENT_BUFFER_SIZE) {	//leave space for Close event
 				gEventOverflow = true;
 				gEventFifo.clear();
-				LOG("EventBuffer overflow!\n");
+				LOG("EventBuffer overflow! %i events put, at most %i queued.\n",
+					gEventFifo.stats().puts, gEventFifo.stats().maxCount);
 			}
 
 			if(eventType==EVENT_TYPE_KEY_PRESSED) {
@@ -426,7 +428,8 @@ namespace Base {
 			if(gEventFifo.count() + 2 == EVENT_BUFFER_SIZE) {	//leave space for Close event
 				gEventOverflow = true;
 				gEventFifo.clear();
-				LOG("EventBuffer overflow!\n");
+				LOG("EventBuffer overflow! %i events put, at most %i queued.\n",
+					gEventFifo.stats().puts, gEventFifo.stats().maxCount);
 			}
 			/* put event in event queue */
 			MAEvent event;
@@ -1368,32 +1371,14 @@ DWORD GetScreenOrientation()
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			currentDrawSurface->drawTriangle(
-				points[i-2].x,
-				points[i-2].y,
-				points[i-1].x,
-				points[i-1].y,
-				points[i].x,
-				points[i].y,
-				realColor);
-		}
+		currentDrawSurface->drawTriangleStrip((const int*)points, count, realColor);
 	}
 
 	SYSCALL(void, maFillTriangleFan(const MAPoint2d *points, int count)) {
 		SYSCALL_THIS->ValidateMemRange(points, sizeof(MAPoint2d) * count);
 		CHECK_INT_ALIGNMENT(points);
 		MYASSERT(count >= 3, ERR_POLYGON_TOO_FEW_POINTS);
-		for(int i = 2; i < count; i++) {
-			currentDrawSurface->drawTriangle(
-				points[0].x,
-				points[0].y,
-				points[i-1].x,
-				points[i-1].y,
-				points[i].x,
-				points[i].y,
-				realColor);
-		}
+		currentDrawSurface->drawTriangleFan((const int*)points, count, realColor);
 	}
 
 	SYSCALL(MAExtent, maGetTextSize(const char* str)) {
@@ -1536,6 +1521,16 @@ DWORD GetScreenOrientation()
 		currentDrawSurface->drawImageRegion(dstTopLeft->x, dstTopLeft->y, &srcRect, img, transformMode);
 	}
 
+	static int maDrawImageRegions(MAHandle image, const MAImageRegion* regions, int count) {
+		Image* img = gSyscall->resources.get_RT_IMAGE(image);
+		for(int i = 0; i < count; i++) {
+			const MAImageRegion& r(regions[i]);
+			ClipRect srcRect = {r.srcRect.left, r.srcRect.top, r.srcRect.width, r.srcRect.height};
+			currentDrawSurface->drawImageRegion(r.dstPoint.x, r.dstPoint.y, &srcRect, img, TRANS_NONE);
+		}
+		return 0;
+	}
+
 	SYSCALL(MAExtent, maGetImageSize(MAHandle image)) {
 		Image* img = gSyscall->resources.get_RT_IMAGE(image);
 		return EXTENT(img->width, img->height);
@@ -3011,6 +3006,12 @@ retry:
 		case maIOCtl_maFileRead:
 			return SYSCALL_THIS->maFileRead(a, SYSCALL_THIS->GetValidatedMemRange(b, c), c);
 
+		case maIOCtl_maDrawImageRegions:
+			if(uint(c) > 0x7fffffff / sizeof(MAImageRegion))
+				BIG_PHAT_ERROR(ERR_MEMORY_OOB);
+			return maDrawImageRegions(a, (MAImageRegion*)SYSCALL_THIS->GetValidatedMemRange(b,
+				c * sizeof(MAImageRegion)), c);
+
 		maIOCtl_syscall_case(maFileWriteFromData);
 		maIOCtl_syscall_case(maFileReadToData);
 
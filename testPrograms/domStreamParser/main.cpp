@@ -0,0 +1,231 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Feeds documents to Mtx::DomStreamParser in chunks of different sizes,
+// and checks the elements that come out.
+
+#include <ma.h>
+#include <mastring.h>
+#include <conprint.h>
+#include <maassert.h>
+#include <MTXml/DomStream.h>
+
+using namespace MAUtil;
+using namespace Mtx;
+
+static const char sRss[] =
+	"<?xml version=\"1.0\"?>"
+	"<rss version=\"2.0\"><channel><title>News</title>"
+	"<item id=\"1\"><title>First</title><link>http://a/1</link></item>"
+	"<item id=\"2\"><title>Second &amp; more</title><link>http://a/2</link></item>"
+	"<other><item id=\"x\"/></other>"
+	"<item id=\"3\" kind=\"last\"><title>Caf\xC3\xA9 &lt;3&gt;</title></item>"
+	"</channel></rss>";
+
+static const char sNested[] =
+	"<feed><entry n=\"1\"/><group><entry n=\"2\"><entry n=\"inner\"/></entry>"
+	"<deep><entry n=\"3\"/></deep></group></feed>";
+
+static const char sWild[] =
+	"<a><b><c n=\"1\"/><d/></b><x><c n=\"2\"/></x><c n=\"no\"/><b><e><c n=\"no\"/></e></b></a>";
+
+static int sFailures = 0;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL line %i: %s\n", __LINE__, #cond); \
+	sFailures++; } } while(0)
+
+class Collector : public DomStreamListener {
+public:
+	Collector() : mStopAfter(-1), mErrors(0) {}
+	~Collector() {
+		for(int i = 0; i < mElements.size(); i++) {
+			delete mElements[i];
+		}
+	}
+	bool domElement(DomElement* element) {
+		mElements.add(element);
+		return mElements.size() != mStopAfter;
+	}
+	void domParseError(int offset) {
+		mErrors++;
+	}
+
+	Vector<DomElement*> mElements;
+	int mStopAfter;
+	int mErrors;
+};
+
+// Feeds the whole document in chunks of the given size.
+static void feedChunks(DomStreamParser& parser, const char* xml, int chunk) {
+	int len = strlen(xml);
+	for(int pos = 0; pos < len && !parser.isStopped(); pos += chunk) {
+		int n = (len - pos < chunk) ? len - pos : chunk;
+		parser.feed(xml + pos, n);
+	}
+}
+
+static const char* attr(const DomElement* e, const char* name) {
+	const String* value = e->getAttribute(name);
+	return value ? value->c_str() : "";
+}
+
+static void testRss(int chunk) {
+	printf("rss, %i byte chunks\n", chunk);
+	DomStreamParser parser;
+	Collector c;
+	CHECK(parser.start("/rss/channel/item", &c));
+	feedChunks(parser, sRss, chunk);
+	CHECK(parser.isStopped());
+	CHECK(c.mErrors == 0);
+	CHECK(c.mElements.size() == 3);
+	CHECK(parser.getElementCount() == 3);
+	if(c.mElements.size() != 3)
+		return;
+
+	const DomElement* first = c.mElements[0];
+	CHECK(first->getName() == "item");
+	CHECK(strcmp(attr(first, "id"), "1") == 0);
+	CHECK(first->getParent() == NULL);
+	CHECK(first->getChildren().size() == 2);
+	const DomElement* title = first->getChild("title");
+	CHECK(title != NULL && title->getText() == "First");
+	CHECK(title != NULL && title->getParent() == first);
+	const DomElement* link = first->getChild("link");
+	CHECK(link != NULL && link->getText() == "http://a/1");
+
+	const DomElement* second = c.mElements[1];
+	title = second->getChild("title");
+	CHECK(title != NULL && title->getText() == "Second & more");
+	CHECK(second->getChild("missing") == NULL);
+
+	const DomElement* third = c.mElements[2];
+	CHECK(third->getAttributeCount() == 2);
+	CHECK(third->getAttributeName(1) == "kind");
+	CHECK(third->getAttributeValue(1) == "last");
+	CHECK(third->getAttribute("missing") == NULL);
+	title = third->getChild("title");
+	CHECK(title != NULL && title->getText() == "Caf\xE9 <3>");
+}
+
+static void testDescendant() {
+	printf("descendant\n");
+	DomStreamParser parser;
+	Collector c;
+	CHECK(parser.start("//entry", &c));
+	feedChunks(parser, sNested, 5);
+	CHECK(c.mElements.size() == 3);
+	if(c.mElements.size() != 3)
+		return;
+	CHECK(strcmp(attr(c.mElements[0], "n"), "1") == 0);
+	// The inner entry belongs to the outer one, and is not matched by itself.
+	CHECK(strcmp(attr(c.mElements[1], "n"), "2") == 0);
+	CHECK(c.mElements[1]->getChildren().size() == 1);
+	CHECK(strcmp(attr(c.mElements[2], "n"), "3") == 0);
+}
+
+static void testWildcard() {
+	printf("wildcard, pulled with next()\n");
+	DomStreamParser parser;
+	CHECK(parser.start("/a/*/c"));
+	feedChunks(parser, sWild, 3);
+	DomElement* e = parser.next();
+	CHECK(e != NULL && strcmp(attr(e, "n"), "1") == 0);
+	delete e;
+	e = parser.next();
+	CHECK(e != NULL && strcmp(attr(e, "n"), "2") == 0);
+	delete e;
+	CHECK(parser.next() == NULL);
+}
+
+static void testStop() {
+	printf("maxElements and listener stop\n");
+	{
+		DomStreamParser parser;
+		Collector c;
+		CHECK(parser.start("/rss/channel/item", &c, 2));
+		feedChunks(parser, sRss, 1);
+		CHECK(parser.isStopped());
+		CHECK(c.mElements.size() == 2);
+		CHECK(!parser.feed("<item/>", 7));
+	}
+	{
+		DomStreamParser parser;
+		Collector c;
+		c.mStopAfter = 1;
+		CHECK(parser.start("/rss/channel/item", &c));
+		CHECK(!parser.feed(sRss, strlen(sRss)));
+		CHECK(c.mElements.size() == 1);
+		CHECK(parser.getElementCount() == 1);
+	}
+	{
+		// Stopping in the middle of an element throws away the partial element.
+		DomStreamParser parser;
+		Collector c;
+		CHECK(parser.start("/rss/channel/item", &c));
+		parser.feed(sRss, 80);
+		parser.stop();
+		CHECK(parser.isStopped());
+		CHECK(c.mElements.size() == 0);
+	}
+}
+
+static void testErrors() {
+	printf("errors\n");
+	DomStreamParser parser;
+	Collector c;
+	CHECK(parser.start("/a/b", &c));
+	static const char bad[] = "<a><b x=1></b></a>";
+	CHECK(!parser.feed(bad, strlen(bad)));
+	CHECK(c.mErrors == 1);
+	CHECK(c.mElements.size() == 0);
+
+	static const char* const unsupported[] = {
+		"", "a/b", "/", "/a/", "/a///b", "/a[1]", "/a/@id", "/a/..", "/a/.",
+		"/a/text()", "/a|/b", "/a/b[@id='1']",
+	};
+	for(size_t i = 0; i < sizeof(unsupported) / sizeof(unsupported[0]); i++) {
+		if(parser.start(unsupported[i], &c)) {
+			printf("accepted \"%s\"\n", unsupported[i]);
+			sFailures++;
+		}
+		CHECK(parser.isStopped());
+	}
+
+	// Restarting after an error works.
+	CHECK(parser.start("/a/b", &c));
+	static const char good[] = "<a><b/></a>";
+	parser.feed(good, strlen(good));
+	CHECK(c.mElements.size() == 1);
+}
+
+extern "C" int MAMain() {
+	// Small chunks split names, references and UTF-8 sequences everywhere.
+	for(int chunk = 1; chunk <= 16; chunk++) {
+		testRss(chunk);
+	}
+	testRss(strlen(sRss));
+	testDescendant();
+	testWildcard();
+	testStop();
+	testErrors();
+
+	if(sFailures == 0)
+		printf("All tests passed.\n");
+	else
+		printf("%i failures.\n", sFailures);
+	FREEZE;
+}
@@ -0,0 +1,240 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Tests the range requests of MAUtil::Downloader: resuming downloads that
+// are cut short, splitting downloads over several connections, and checking
+// the servers' responses. Start server.rb on the host before running this.
+// Every download is checked byte by byte, and the number of requests the
+// server got is checked through its /count page.
+
+#include <MAUtil/Moblet.h>
+#include <MAUtil/Downloader.h>
+#include <MAUtil/util.h>
+#include <conprint.h>
+
+using namespace MAUtil;
+
+#define SERVER "http://localhost:8080"
+
+// Don't count a download as a success or a failure, just that it was cancelled.
+#define CANCELLED 1
+
+struct TestCase {
+	const char* name;
+	const char* query;
+	int maxRetries;
+	int ranges;
+	int minRangeSize;
+	// 0 for success, CANCELLED, or the expected error: <0 for any error,
+	// or a specific CONNERR code.
+	int expected;
+	// The number of requests the server should get, or 0 to not check.
+	int requests;
+	// If not 0, cancel the download from notifyProgress after this many bytes.
+	int cancelAt;
+};
+
+static const TestCase sTests[] = {
+	{ "resume after a cut", "len=200000&cut=70000", 2, 1, 1, 0, 2, 0 },
+	{ "no resume without retries", "len=200000&cut=70000", 0, 1, 1, -1, 1, 0 },
+	{ "4-way split", "len=300000", 0, 4, 16 * 1024, 0, 4, 0 },
+	{ "split limited by range size", "len=40000", 0, 4, 16 * 1024, 0, 2, 0 },
+	{ "odd length split", "len=100003", 0, 7, 1, 0, 7, 0 },
+	{ "retry range 0 after its connection is closed", "len=300000&cut=20000",
+		1, 4, 16 * 1024, 0, 5, 0 },
+	{ "retry other ranges", "len=60000&cutrange=10000", 2, 3, 16 * 1024, 0, 5, 0 },
+	{ "out of retries", "len=60000&cutrange=10000", 1, 3, 16 * 1024, -1, 0, 0 },
+	{ "error in a range without retries", "len=100000&cutrange=5000",
+		0, 2, 16 * 1024, -1, 0, 0 },
+	{ "Content-Range with the wrong start", "len=100000&badstart=1",
+		3, 2, 16 * 1024, CONNERR_DOWNLOADER_RANGE, 0, 0 },
+	{ "Content-Range with the wrong length", "len=100000&badtotal=1",
+		3, 2, 16 * 1024, CONNERR_DOWNLOADER_RANGE, 0, 0 },
+	{ "range ignored by the server", "len=100000&norange=1",
+		3, 2, 16 * 1024, CONNERR_DOWNLOADER_RANGE, 0, 0 },
+	{ "cancel from notifyProgress", "len=300000", 0, 3, 16 * 1024,
+		CANCELLED, 0, 150000 },
+	{ "invalid range settings are clamped", "len=50000", 1, -3, 0, 0, 1, 0 },
+};
+
+#define NUM_TESTS (int)(sizeof(sTests) / sizeof(sTests[0]))
+
+class RangeMoblet : public Moblet, public DownloadListener, public TimerListener {
+public:
+	RangeMoblet() : mTest(-1), mFailures(0) {
+		mDownloader.addDownloadListener(this);
+		mCounter.addDownloadListener(this);
+		printf("Downloader range tests against %s\n", SERVER);
+		nextTest();
+	}
+
+	~RangeMoblet() {
+		mDownloader.removeDownloadListener(this);
+		mCounter.removeDownloadListener(this);
+	}
+
+	void keyPressEvent(int keyCode, int nativeCode) {
+		if(keyCode == MAK_0 || keyCode == MAK_BACK)
+			close();
+	}
+
+	void nextTest() {
+		mTest++;
+		if(mTest == NUM_TESTS) {
+			if(mFailures == 0)
+				printf("All tests passed.\n");
+			else
+				printf("%i failures.\n", mFailures);
+			return;
+		}
+		const TestCase& t = sTests[mTest];
+		printf("%s\n", t.name);
+
+		// A new id for each test, so that the server counts the requests
+		// and cuts the first response of this test only.
+		mId = integerToString(maGetMilliSecondCount()) + "-" + integerToString(mTest);
+		String url = String(SERVER) + "/file?id=" + mId + "&" + t.query;
+		mLength = stringToInteger(String(strstr(t.query, "len=") + 4));
+
+		mDownloader.setMaxRetries(t.maxRetries);
+		mDownloader.setParallelRanges(t.ranges, t.minRangeSize);
+		int res = mDownloader.beginDownloading(url.c_str());
+		if(res <= 0)
+			fail("beginDownloading", res);
+	}
+
+	// The next test is started from a timer rather than from inside the
+	// callbacks, so that each download is torn down by the Downloader itself.
+	void scheduleNextTest() {
+		addTimer(this, 1, 1);
+	}
+
+	void runTimerEvent() {
+		nextTest();
+	}
+
+	void fail(const char* what, int value) {
+		printf("  FAIL: %s (%i)\n", what, value);
+		mFailures++;
+		scheduleNextTest();
+	}
+
+	// Checks the outcome, then the request count, then goes on.
+	void testDone(int result) {
+		const TestCase& t = sTests[mTest];
+		bool ok;
+		if(t.expected < 0 && t.expected != CONNERR_DOWNLOADER_RANGE)
+			ok = (result < 0 && result != CONNERR_DOWNLOADER_RANGE);
+		else
+			ok = (result == t.expected);
+		if(!ok) {
+			fail("unexpected result", result);
+			return;
+		}
+		if(t.requests == 0) {
+			scheduleNextTest();
+			return;
+		}
+		String url = String(SERVER) + "/count?id=" + mId;
+		int res = mCounter.beginDownloading(url.c_str());
+		if(res <= 0)
+			fail("beginDownloading count", res);
+	}
+
+	// Returns true if the data is what the server sends.
+	bool checkData(MAHandle data) {
+		if(maGetDataSize(data) != mLength) {
+			printf("  size %i, expected %i\n", maGetDataSize(data), mLength);
+			return false;
+		}
+		static unsigned char buf[1024];
+		for(int offset = 0; offset < mLength; offset += sizeof(buf)) {
+			int n = mLength - offset;
+			if(n > (int)sizeof(buf))
+				n = sizeof(buf);
+			maReadData(data, buf, offset, n);
+			for(int i = 0; i < n; i++) {
+				int pos = offset + i;
+				if(buf[i] != ((pos * 7 + (pos >> 8)) & 0xff)) {
+					printf("  wrong byte at %i\n", pos);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void notifyProgress(Downloader* downloader, int downloadedBytes, int totalBytes) {
+		if(downloader != &mDownloader)
+			return;
+		int cancelAt = sTests[mTest].cancelAt;
+		if(cancelAt > 0 && downloadedBytes >= cancelAt && mDownloader.isDownloading())
+			mDownloader.cancelDownloading();
+	}
+
+	void finishedDownloading(Downloader* downloader, MAHandle data) {
+		if(downloader == &mCounter) {
+			char buf[16];
+			int size = maGetDataSize(data);
+			if(size >= (int)sizeof(buf))
+				size = sizeof(buf) - 1;
+			maReadData(data, buf, 0, size);
+			buf[size] = 0;
+			maDestroyPlaceholder(data);
+			int count = stringToInteger(buf);
+			if(count != sTests[mTest].requests) {
+				fail("request count", count);
+				return;
+			}
+			scheduleNextTest();
+			return;
+		}
+
+		bool ok = checkData(data);
+		maDestroyPlaceholder(data);
+		if(!ok) {
+			fail("data", 0);
+			return;
+		}
+		testDone(0);
+	}
+
+	void downloadCancelled(Downloader* downloader) {
+		testDone(CANCELLED);
+	}
+
+	void error(Downloader* downloader, int code) {
+		if(downloader == &mCounter) {
+			fail("count download", code);
+			return;
+		}
+		testDone(code);
+	}
+
+private:
+	Downloader mDownloader;
+	Downloader mCounter;
+	String mId;
+	int mLength;
+	int mTest;
+	int mFailures;
+};
+
+extern "C" int MAMain() {
+	Moblet::run(new RangeMoblet());
+	return 0;
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/ruby
+
+# HTTP server for the downloaderRanges test program.
+#
+# GET /file?id=<id>&len=<n>[&<option>...] sends <n> bytes, where byte i is
+# (i * 7 + (i >> 8)) & 0xff, and accepts range requests. Options:
+#   cut=<k>        Closes the first response for <id> after <k> bytes.
+#   cutrange=<k>   Closes every response to a range not starting at 0
+#                  after <k> bytes.
+#   badstart=1     Gives a Content-Range that starts one byte late.
+#   badtotal=1     Gives a Content-Range with the wrong total length.
+#   norange=1      Ignores the Range header, but still claims to accept ranges.
+#
+# GET /count?id=<id> sends the number of /file requests seen for <id>.
+#
+# Usage: ruby server.rb [port]
+
+require 'socket'
+require 'thread'
+
+PORT = (ARGV[0] || 8080).to_i
+
+$counts = Hash.new(0)
+$lock = Mutex.new
+
+def body_byte(i)
+	(i * 7 + (i >> 8)) & 0xff
+end
+
+def body(first, last)
+	(first..last).map { |i| body_byte(i) }.pack('C*')
+end
+
+def send_response(sock, status, headers, data, cut = nil)
+	sock.write("HTTP/1.1 #{status}\r\n")
+	headers['Content-Length'] = data.length.to_s
+	headers['Connection'] = 'close'
+	headers.each { |k, v| sock.write("#{k}: #{v}\r\n") }
+	sock.write("\r\n")
+	if(cut && cut < data.length)
+		sock.write(data[0, cut])
+	else
+		sock.write(data)
+	end
+end
+
+def handle(sock)
+	request = sock.gets
+	return if(!request)
+	method, target = request.split(' ')
+	headers = {}
+	while((line = sock.gets) && line != "\r\n")
+		name, value = line.split(':', 2)
+		headers[name.strip.downcase] = value.strip
+	end
+
+	path, query = target.split('?', 2)
+	params = {}
+	(query || '').split('&').each do |pair|
+		k, v = pair.split('=', 2)
+		params[k] = v
+	end
+	id = params['id'] || ''
+
+	if(path == '/count')
+		count = $lock.synchronize { $counts[id] }
+		send_response(sock, '200 OK', {'Content-Type' => 'text/plain'}, count.to_s)
+		return
+	end
+	if(path != '/file')
+		send_response(sock, '404 Not Found', {}, '')
+		return
+	end
+
+	n = $lock.synchronize { $counts[id] += 1 }
+	len = (params['len'] || '100000').to_i
+	out = {'Content-Type' => 'application/octet-stream', 'Accept-Ranges' => 'bytes'}
+	range = headers['range']
+	if(range && !params['norange'] && range =~ /^bytes=(\d+)-(\d*)$/)
+		first = $1.to_i
+		last = ($2.empty? ? len - 1 : [$2.to_i, len - 1].min)
+		reported = params['badstart'] ? first + 1 : first
+		total = params['badtotal'] ? len + 1 : len
+		out['Content-Range'] = "bytes #{reported}-#{last}/#{total}"
+		cut = nil
+		cut = params['cutrange'].to_i if(params['cutrange'] && first > 0)
+		send_response(sock, '206 Partial Content', out, body(first, last), cut)
+	else
+		cut = nil
+		cut = params['cut'].to_i if(params['cut'] && n == 1)
+		send_response(sock, '200 OK', out, body(0, len - 1), cut)
+	end
+end
+
+server = TCPServer.new(PORT)
+puts "Listening on port #{PORT}"
+loop do
+	Thread.start(server.accept) do |sock|
+		begin
+			handle(sock)
+		rescue => e
+			puts e
+		ensure
+			sock.close
+		end
+	end
+end
@@ -0,0 +1,152 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Closes files while an asynchronous read is still running.
+// maFileClose() should wait for the read, which should complete in full
+// and still post its EVENT_TYPE_FILE.
+
+#include <ma.h>
+#include <mastring.h>
+#include <conprint.h>
+#include <MAUtil/String.h>
+
+#define FILE_SIZE (1024 * 1024)
+
+static char sBuffer[FILE_SIZE];
+static int sFailures = 0;
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL line %i: %s\n", __LINE__, #cond); \
+	sFailures++; } } while(0)
+
+static unsigned char fileByte(int i) {
+	return (unsigned char)(i * 13 + (i >> 10));
+}
+
+static MAUtil::String getLocalPath() {
+	char buf[1024];
+	int size = maGetSystemProperty("mosync.path.local", buf, sizeof(buf));
+	if(size < 0 || size > (int)sizeof(buf))
+		return "/";
+	return buf;
+}
+
+static bool writeTestFile(const char* path) {
+	MAHandle file = maFileOpen(path, MA_ACCESS_READ_WRITE);
+	if(file < 0)
+		return false;
+	if(!maFileExists(file) && maFileCreate(file) < 0)
+		return false;
+	for(int i = 0; i < FILE_SIZE; i++) {
+		sBuffer[i] = fileByte(i);
+	}
+	int res = maFileWrite(file, sBuffer, FILE_SIZE);
+	maFileClose(file);
+	return res == 0;
+}
+
+static bool checkBytes(const char* data, int len) {
+	for(int i = 0; i < len; i++) {
+		if((unsigned char)data[i] != fileByte(i)) {
+			printf("wrong byte at %i\n", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Returns the result of the EVENT_TYPE_FILE for \a file.
+static int waitForFileEvent(MAHandle file) {
+	while(true) {
+		maWait(0);
+		MAEvent event;
+		while(maGetEvent(&event)) {
+			if(event.type == EVENT_TYPE_CLOSE)
+				maExit(0);
+			if(event.type == EVENT_TYPE_FILE && event.conn.handle == file) {
+				CHECK(event.conn.opType == FILEOP_READ);
+				return event.conn.result;
+			}
+		}
+	}
+}
+
+static void testReadToMemory(const char* path) {
+	printf("close during maFileReadAsync\n");
+	memset(sBuffer, 0, FILE_SIZE);
+	MAHandle file = maFileOpen(path, MA_ACCESS_READ);
+	CHECK(file > 0);
+	int res = maFileReadAsync(file, sBuffer, FILE_SIZE);
+	if(res == IOCTL_UNAVAILABLE) {
+		printf("maFileReadAsync is unavailable.\n");
+		maFileClose(file);
+		return;
+	}
+	CHECK(res == 0);
+	CHECK(maFileClose(file) == 0);
+	CHECK(waitForFileEvent(file) == FILE_SIZE);
+	CHECK(checkBytes(sBuffer, FILE_SIZE));
+}
+
+static void testReadToData(const char* path) {
+	printf("close during maFileReadToDataAsync\n");
+	MAHandle data = maCreatePlaceholder();
+	CHECK(maCreateData(data, FILE_SIZE) == RES_OK);
+	MAHandle file = maFileOpen(path, MA_ACCESS_READ);
+	CHECK(file > 0);
+	int res = maFileReadToDataAsync(file, data, 0, FILE_SIZE);
+	if(res == IOCTL_UNAVAILABLE) {
+		maFileClose(file);
+		maDestroyPlaceholder(data);
+		return;
+	}
+	CHECK(res == 0);
+	CHECK(maFileClose(file) == 0);
+	CHECK(waitForFileEvent(file) == FILE_SIZE);
+	// The data object is usable again once the event has come.
+	memset(sBuffer, 0, FILE_SIZE);
+	maReadData(data, sBuffer, 0, FILE_SIZE);
+	CHECK(checkBytes(sBuffer, FILE_SIZE));
+	maDestroyPlaceholder(data);
+}
+
+extern "C" int MAMain() {
+	InitConsole();
+	gConsoleLogging = 1;
+
+	MAUtil::String path = getLocalPath() + "fileAsyncClose.bin";
+	if(!writeTestFile(path.c_str())) {
+		printf("Could not write %s\n", path.c_str());
+		FREEZE;
+	}
+	// Several rounds, so that the close comes at different points of the read.
+	for(int i = 0; i < 4; i++) {
+		testReadToMemory(path.c_str());
+		testReadToData(path.c_str());
+	}
+
+	MAHandle file = maFileOpen(path.c_str(), MA_ACCESS_READ_WRITE);
+	if(file > 0) {
+		maFileDelete(file);
+		maFileClose(file);
+	}
+
+	if(sFailures == 0)
+		printf("All tests passed.\n");
+	else
+		printf("%i failures.\n", sFailures);
+	FREEZE;
+}
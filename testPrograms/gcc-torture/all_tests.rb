@@ -4,12 +4,14 @@ require 'FileUtils'
 require 'settings.rb'
 require 'skipped.rb'
 require '../../rules/util.rb'
+require '../../rules/host.rb'
 
 BUILD_DIR = 'build'
 MOSYNCDIR = ENV['MOSYNCDIR']
 GCC_FLAGS = " -I. -I#{MOSYNCDIR}/include -DNO_TRAMPOLINES"
 PIPE_FLAGS = " -datasize=#{2*1024*1024} -stacksize=#{512*1024} -heapsize=#{1024*1024}"
 PIPE_LIBS = " #{MOSYNCDIR}/lib/pipe_debug/mastd.lib"
+AOT_INCLUDE = "#{MOSYNCDIR}/aot-include"
 
 # SETTINGS[:source_path] - directory in which source files are stored.
 
@@ -94,6 +96,50 @@ def link_and_test(ofn, dead_code, force_rebuild)
 	return force_rebuild
 end
 
+# Builds the test into a native module with pipe-tool -cpp, and checks that
+# running it with MoRE -aot gives the same exit code and output as the interpreter.
+def aot_test(ofn, force_rebuild)
+	aotDir = ofn.ext('.aot')
+	winFile = ofn.ext('.winaot')
+	failFile = ofn.ext('.failaot')
+	soFile = 'program' + DLL_FILE_ENDING
+
+	if((File.exists?(winFile) || !SETTINGS[:retry_failed]) && !force_rebuild)
+		return
+	end
+
+	FileUtils.mkdir_p(aotDir)
+	Dir.chdir(aotDir) do
+		# the module and the program it is checked against come from the same pass.
+		sh "pipe-tool -cpp#{PIPE_FLAGS} -B program ../#{File.basename(ofn)} ../helpers.s#{PIPE_LIBS}"
+		sh "g++ -shared -fPIC -O2 -I#{AOT_INCLUDE} -I. #{AOT_INCLUDE}/aot_module.cpp -o #{soFile}"
+
+		cmd = "#{MOSYNCDIR}/bin/more -noscreen -program program"
+		$stderr.puts cmd
+		interpreted = `#{cmd}`
+		interpretedStatus = $?.exitstatus
+		FileUtils.mv('log.txt', 'interpreted.log') if(File.exists?('log.txt'))
+
+		$stderr.puts "#{cmd} -aot #{soFile}"
+		native = `#{cmd} -aot #{soFile}`
+		nativeStatus = $?.exitstatus
+		FileUtils.mv('log.txt', 'aot.log') if(File.exists?('log.txt'))
+
+		if(native == interpreted && nativeStatus == interpretedStatus)
+			puts "AOT matches: #{interpretedStatus}"
+			FileUtils.touch('../' + File.basename(winFile))
+			FileUtils.rm_f('../' + File.basename(failFile))
+			return
+		end
+		puts "AOT mismatch: interpreted #{interpretedStatus}, native #{nativeStatus}"
+		FileUtils.touch('../' + File.basename(failFile))
+		FileUtils.rm_f('../' + File.basename(winFile))
+	end
+	if(SETTINGS[:stop_on_fail])
+		error "Stop on fail"
+	end
+end
+
 files.each do |filename|
 	bn = File.basename(filename)
 	if(SKIPPED.include?(bn))
@@ -117,4 +163,5 @@ files.each do |filename|
 	
 	force_rebuild = link_and_test(ofn, false, force_rebuild)
 	link_and_test(ofn, true, force_rebuild) if(SETTINGS[:test_dce])
+	aot_test(ofn, force_rebuild) if(SETTINGS[:test_aot])
 end
@@ -0,0 +1,168 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Compares the B-tree behind MAUtil::Map and Set with kazlib's red-black tree,
+// which they used before, on insert, lookup, iteration and erase.
+
+#include <ma.h>
+#include <mastdlib.h>
+#include <conprint.h>
+#include <maassert.h>
+#include <kazlib/dict.h>
+#include <MAUtil/Map.h>
+#include <MAUtil/Set.h>
+
+using namespace MAUtil;
+
+#define COUNT 20000
+#define LOOKUP_ROUNDS 5
+#define ITERATE_ROUNDS 20
+
+static int sKeys[COUNT];
+static volatile int sSink;
+
+//******************************************************************************
+// kazlib
+//******************************************************************************
+
+struct KNode : dnode_t {
+	int key;
+	int value;
+};
+
+static int compareInt(const void* a, const void* b) {
+	return Compare<int>(*(const int*)a, *(const int*)b);
+}
+
+static void kazInsert(dict_t* d) {
+	for(int i=0; i<COUNT; i++) {
+		KNode* node = new KNode;
+		dnode_init(node, NULL);
+		node->key = sKeys[i];
+		node->value = i;
+		dict_insert(d, node, &node->key);
+	}
+}
+
+static void kazLookup(dict_t* d) {
+	for(int r=0; r<LOOKUP_ROUNDS; r++) {
+		for(int i=0; i<COUNT; i++) {
+			KNode* node = (KNode*)dict_lookup(d, &sKeys[i]);
+			sSink += node->value;
+		}
+	}
+}
+
+static void kazIterate(dict_t* d) {
+	for(int r=0; r<ITERATE_ROUNDS; r++) {
+		for(dnode_t* n = dict_first(d); n != NULL; n = dict_next(d, n)) {
+			sSink += ((KNode*)n)->value;
+		}
+	}
+}
+
+static void kazErase(dict_t* d) {
+	for(int i=0; i<COUNT; i++) {
+		KNode* node = (KNode*)dict_lookup(d, &sKeys[i]);
+		dict_delete(d, node);
+		delete node;
+	}
+}
+
+//******************************************************************************
+// MAUtil::Map
+//******************************************************************************
+
+static void mapInsert(Map<int, int>& m) {
+	for(int i=0; i<COUNT; i++) {
+		m.insert(sKeys[i], i);
+	}
+}
+
+static void mapLookup(Map<int, int>& m) {
+	for(int r=0; r<LOOKUP_ROUNDS; r++) {
+		for(int i=0; i<COUNT; i++) {
+			sSink += m.find(sKeys[i])->second;
+		}
+	}
+}
+
+static void mapIterate(Map<int, int>& m) {
+	for(int r=0; r<ITERATE_ROUNDS; r++) {
+		for(Map<int, int>::Iterator itr = m.begin(); itr != m.end(); ++itr) {
+			sSink += itr->second;
+		}
+	}
+}
+
+static void mapErase(Map<int, int>& m) {
+	for(int i=0; i<COUNT; i++) {
+		m.erase(sKeys[i]);
+	}
+}
+
+//******************************************************************************
+// Main
+//******************************************************************************
+
+#define BENCH(name, kaz, map) do { \
+	int start = maGetMilliSecondCount(); \
+	kaz; \
+	int tk = maGetMilliSecondCount() - start; \
+	start = maGetMilliSecondCount(); \
+	map; \
+	printf("%-8s %5i ms %5i ms\n", name, tk, maGetMilliSecondCount() - start); \
+} while(0)
+
+extern "C" int MAMain() {
+	// unique keys in random order.
+	for(int i=0; i<COUNT; i++) {
+		sKeys[i] = i * 7;
+	}
+	for(int i=COUNT-1; i>0; i--) {
+		int j = rand() % (i + 1);
+		int t = sKeys[i];
+		sKeys[i] = sKeys[j];
+		sKeys[j] = t;
+	}
+
+	dict_t d;
+	dict_init(&d, DICTCOUNT_T_MAX, compareInt);
+	Map<int, int> m;
+
+	printf("%i elements  kazlib  B-tree\n", COUNT);
+	BENCH("insert", kazInsert(&d), mapInsert(m));
+	MAASSERT(dict_count(&d) == COUNT && m.size() == COUNT);
+	BENCH("lookup", kazLookup(&d), mapLookup(m));
+	BENCH("iterate", kazIterate(&d), mapIterate(m));
+	BENCH("erase", kazErase(&d), mapErase(m));
+	MAASSERT(dict_count(&d) == 0 && m.size() == 0);
+
+	// a small Set lives in a single node.
+	Set<int> s;
+	for(int i=0; i<10; i++) {
+		s.insert(10 - i);
+	}
+	int prev = 0;
+	for(Set<int>::Iterator itr = s.begin(); itr != s.end(); ++itr) {
+		MAASSERT(*itr > prev);
+		prev = *itr;
+	}
+
+	printf("Done.\n");
+	FREEZE;
+}
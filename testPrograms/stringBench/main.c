@@ -0,0 +1,165 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Compares the string functions of MAStd, which use the runtime's native
+// string functions when it has them, with the same functions in bytecode.
+
+#include <ma.h>
+#include <mastring.h>
+#include <mawstring.h>
+#include <conprint.h>
+#include <maassert.h>
+
+// Each length processes about this many characters per function.
+#define TOTAL_CHARS (2000 * 1000)
+#define MAX_LEN 1000
+
+// Short strings are handled in bytecode, even when the runtime has the
+// native functions, since the syscall would cost more. 15 and 16 are on
+// either side of that limit.
+static const int sLengths[] = { 1, 4, 15, 16, 64, MAX_LEN };
+
+static char sA[MAX_LEN + 1], sB[MAX_LEN + 1], sDst[2 * MAX_LEN + 2];
+static wchar sWA[MAX_LEN + 1], sWB[MAX_LEN + 1];
+static volatile int sSink;
+static int sIterations;
+
+// Bytecode versions, as in MAStd.
+
+static size_t bc_strlen(const char *s) {
+	const char *eos = s;
+	while (*eos++);
+	return (int) (eos - s - 1);
+}
+
+static char *bc_strchr(const char *s, int ch) {
+	while (*s && *s != (char) ch) s++;
+	if (*s == (char) ch) return (char *) s;
+	return NULL;
+}
+
+static int bc_strncmp(const char *s1, const char *s2, size_t count) {
+	if (!count) return 0;
+	while (--count && *s1 && *s1 == *s2) {
+		s1++;
+		s2++;
+	}
+	return *(unsigned char *) s1 - *(unsigned char *) s2;
+}
+
+static char *bc_strncpy(char *dest, const char *source, size_t count) {
+	char *start = dest;
+	while (count && (*dest++ = *source++)) count--;
+	if (count) while (--count) *dest++ = '\0';
+	return start;
+}
+
+static int bc_memcmp(const void *dst, const void *src, size_t n) {
+	if (!n) return 0;
+	while (--n && *(char *) dst == *(char *) src) {
+		dst = (char *) dst + 1;
+		src = (char *) src + 1;
+	}
+	return *((unsigned char *) dst) - *((unsigned char *) src);
+}
+
+static void *bc_memmove(void *dst, const void *src, size_t count) {
+	char *d = (char *) dst + count;
+	const char *s = (const char *) src + count;
+	while (count--) *--d = *--s;
+	return dst;
+}
+
+static void *bc_memchr(const void *buf, int ch, size_t count) {
+	while (count && (*(unsigned char *) buf != (unsigned char) ch)) {
+		buf = (unsigned char *) buf + 1;
+		count--;
+	}
+	return (count ? (void *) buf : NULL);
+}
+
+static size_t bc_wcslen(const wchar *s) {
+	const wchar *eos = s;
+	while (*eos++);
+	return (int) (eos - s - 1);
+}
+
+static int bc_wcscmp(const wchar *s1, const wchar *s2) {
+	int ret = 0;
+	while (!(ret = *(wchar *) s1 - *(wchar *) s2) && *s2) ++s1, ++s2;
+	return ret;
+}
+
+#define BENCH(name, bytecode, native) do { \
+	int i, start, tb, tn; \
+	start = maGetMilliSecondCount(); \
+	for(i=0; i<sIterations; i++) sSink += (int)(bytecode); \
+	tb = maGetMilliSecondCount() - start; \
+	start = maGetMilliSecondCount(); \
+	for(i=0; i<sIterations; i++) sSink += (int)(native); \
+	tn = maGetMilliSecondCount() - start; \
+	printf("%-8s %5i ms %5i ms\n", name, tb, tn); \
+} while(0)
+
+static void check(int ok, const char* name) {
+	if(!ok)
+		printf("%s: wrong result!\n", name);
+}
+
+static void benchLength(int len) {
+	int i;
+	for(i=0; i<len; i++) {
+		sA[i] = sB[i] = 'a' + (i % 26);
+		sWA[i] = sWB[i] = 0x400 + (i % 26);
+	}
+	sA[len] = sB[len] = 0;
+	sWA[len] = sWB[len] = 0;
+	// The strings differ only in the last character.
+	sB[len - 1] = '!';
+	sWB[len - 1] = '!';
+
+	check((int)strlen(sA) == len, "strlen");
+	check(strchr(sB, '!') == sB + len - 1, "strchr");
+	check(strrchr(sA, 'a') == sA + (len - 1) / 26 * 26, "strrchr");
+	check(strncmp(sA, sB, len) > 0 && strncmp(sA, sB, len - 1) == 0, "strncmp");
+	check(memcmp(sA, sB, len) > 0, "memcmp");
+	check(memchr(sB, '!', len) == sB + len - 1, "memchr");
+	check((int)wcslen(sWA) == len, "wcslen");
+	check(wcscmp(sWA, sWB) > 0, "wcscmp");
+
+	sIterations = TOTAL_CHARS / len;
+	printf("%i x %i chars\n", sIterations, len);
+	printf("function bytecode   libc\n");
+	BENCH("strlen", bc_strlen(sA), strlen(sA));
+	BENCH("strchr", bc_strchr(sB, '!'), strchr(sB, '!'));
+	BENCH("strncmp", bc_strncmp(sA, sB, len), strncmp(sA, sB, len));
+	BENCH("strncpy", bc_strncpy(sDst, sA, len + 1), strncpy(sDst, sA, len + 1));
+	BENCH("memcmp", bc_memcmp(sA, sB, len), memcmp(sA, sB, len));
+	BENCH("memmove", bc_memmove(sDst + 1, sDst, len), memmove(sDst + 1, sDst, len));
+	BENCH("memchr", bc_memchr(sB, '!', len), memchr(sB, '!', len));
+	BENCH("wcslen", bc_wcslen(sWA), wcslen(sWA));
+	BENCH("wcscmp", bc_wcscmp(sWA, sWB), wcscmp(sWA, sWB));
+}
+
+int MAMain() {
+	int i;
+	for(i=0; i<(int)(sizeof(sLengths) / sizeof(sLengths[0])); i++) {
+		benchLength(sLengths[i]);
+	}
+	printf("Done.\n");
+	FREEZE;
+}
@@ -0,0 +1,229 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Measures MAUtil::String on the paths that create many short strings:
+// XML parsing, JSON parsing and Wormhole message handling.
+
+#include <ma.h>
+#include <mastring.h>
+#include <mavsprintf.h>
+#include <conprint.h>
+#include <maassert.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+#include <MAUtil/util.h>
+#include <MTXml/MTSax.h>
+#include <yajl/YAJLDom.h>
+
+using namespace MAUtil;
+
+#define ITEMS 200
+#define ROUNDS 20
+
+static char sXml[ITEMS * 80 + 64];
+static char sXmlCopy[sizeof(sXml)];
+static char sJson[ITEMS * 80 + 64];
+static char sMessages[ITEMS * 40];
+static int sMessagesLength;
+static volatile int sSink;
+
+//******************************************************************************
+// Short strings
+//******************************************************************************
+
+static void benchShort() {
+	static const char* words[] = { "id", "name", "value", "x", "true", "messageName" };
+	for(int r=0; r<ROUNDS * 10; r++) {
+		Vector<String> v;
+		for(int i=0; i<ITEMS; i++) {
+			String s(words[i % 6]);
+			String copy = s;
+			copy += '=';
+			v.add(copy);
+		}
+		sSink += v[ITEMS - 1].size();
+	}
+}
+
+//******************************************************************************
+// XML
+//******************************************************************************
+
+static Vector<String>* sXmlStrings;
+
+static void xmlEncoding(MTXSaxContext*, const char*) {
+}
+
+static void xmlStartElement(MTXSaxContext*, const void* name, const void** attributes) {
+	sXmlStrings->add((const char*)name);
+	for(int i=0; attributes[i]; i++) {
+		sXmlStrings->add((const char*)attributes[i]);
+	}
+}
+
+static void xmlEndElement(MTXSaxContext*, const void*) {
+}
+
+static void xmlCharacters(MTXSaxContext*, const void* data, int length) {
+	sXmlStrings->add(String((const char*)data, length));
+}
+
+static unsigned char xmlUnicodeCharacter(MTXSaxContext*, int) {
+	return '?';
+}
+
+static void xmlDataRemains(MTXSaxContext*, const char*, int) {
+}
+
+static void xmlParseError(MTXSaxContext*, int offset) {
+	printf("XML error at %i\n", offset);
+}
+
+static void benchXml() {
+	for(int r=0; r<ROUNDS; r++) {
+		Vector<String> strings;
+		sXmlStrings = &strings;
+		MTXSaxContext context;
+		memset(&context, 0, sizeof(context));
+		context.encoding = xmlEncoding;
+		context.startElement = xmlStartElement;
+		context.endElement = xmlEndElement;
+		context.characters = xmlCharacters;
+		context.unicodeCharacter = xmlUnicodeCharacter;
+		context.dataRemains = xmlDataRemains;
+		context.parseError = xmlParseError;
+		// the parser alters its input.
+		memcpy(sXmlCopy, sXml, sizeof(sXml));
+		mtxSaxStart(&context);
+		mtxSaxFeed(&context, sXmlCopy);
+		mtxSaxStop(&context);
+		sSink += strings.size();
+	}
+}
+
+//******************************************************************************
+// JSON
+//******************************************************************************
+
+static void benchJson() {
+	for(int r=0; r<ROUNDS; r++) {
+		YAJLDom::Value* root = YAJLDom::parse((const unsigned char*)sJson, strlen(sJson));
+		MAASSERT(root);
+		for(int i=0; i<root->getNumChildValues(); i++) {
+			YAJLDom::Value* item = root->getValueByIndex(i);
+			sSink += item->getValueForKey("name")->toString().size();
+		}
+		YAJLDom::deleteValue(root);
+	}
+}
+
+//******************************************************************************
+// Wormhole
+//******************************************************************************
+
+// Messages are null-separated strings, as read by Wormhole::MessageStream.
+static void benchWormholeParse() {
+	for(int r=0; r<ROUNDS; r++) {
+		Vector<String> params;
+		const char* p = sMessages;
+		const char* end = sMessages + sMessagesLength;
+		while(p < end) {
+			int len = strlen(p);
+			params.add(String(p, len));
+			p += len + 1;
+		}
+		sSink += params.size();
+	}
+}
+
+// Builds the JavaScript calls that callJS() sends back to the WebView.
+static void benchWormholeConcat() {
+	for(int r=0; r<ROUNDS; r++) {
+		for(int i=0; i<ITEMS; i++) {
+			String script = "mosync.bridge.reply(" + integerToString(i) + ", '" +
+				String("result") + "', " + integerToString(i * 3) + ")";
+			sSink += script.size();
+		}
+	}
+}
+
+static void benchWormholeBuilder() {
+	StringBuilder sb(64);
+	for(int r=0; r<ROUNDS; r++) {
+		for(int i=0; i<ITEMS; i++) {
+			sb.clear();
+			sb << "mosync.bridge.reply(" << i << ", '" << "result" << "', " << (i * 3) << ")";
+			sSink += sb.size();
+		}
+	}
+}
+
+//******************************************************************************
+// Main
+//******************************************************************************
+
+static void makeData() {
+	char* x = sXml;
+	x += sprintf(x, "<items>");
+	for(int i=0; i<ITEMS; i++) {
+		x += sprintf(x, "<item id=\"%i\" type=\"t%i\"><name>item%i</name></item>", i, i % 7, i);
+	}
+	sprintf(x, "</items>");
+
+	char* j = sJson;
+	j += sprintf(j, "[");
+	for(int i=0; i<ITEMS; i++) {
+		j += sprintf(j, "%s{\"id\":%i,\"name\":\"item%i\",\"ok\":true}", i ? "," : "", i, i);
+	}
+	sprintf(j, "]");
+
+	char* m = sMessages;
+	for(int i=0; i<ITEMS; i++) {
+		m += sprintf(m, "StringMessage") + 1;
+		m += sprintf(m, "param%i", i) + 1;
+	}
+	sMessagesLength = m - sMessages;
+}
+
+#define BENCH(name, func) do { \
+	int start = maGetMilliSecondCount(); \
+	func(); \
+	printf("%-16s %5i ms\n", name, maGetMilliSecondCount() - start); \
+} while(0)
+
+extern "C" int MAMain() {
+	makeData();
+
+	String a("short");
+	String b = a + " and some more";
+	MAASSERT(a == "short" && b.size() == 19);
+	b.swap(a);
+	MAASSERT(a.size() == 19 && b == "short");
+	StringBuilder sb;
+	sb << "n=" << 42 << ' ' << b;
+	MAASSERT(sb.str() == "n=42 short");
+
+	printf("String: %i bytes\n", (int)sizeof(String));
+	BENCH("short", benchShort);
+	BENCH("xml", benchXml);
+	BENCH("json", benchJson);
+	BENCH("wormhole parse", benchWormholeParse);
+	BENCH("wormhole +", benchWormholeConcat);
+	BENCH("wormhole <<", benchWormholeBuilder);
+	printf("Done.\n");
+	FREEZE;
+}
@@ -0,0 +1,119 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+// Measures the cost of a task switch, with few and many tasks,
+// and checks that sleeping tasks wake up in order.
+
+#include <ma.h>
+#include <maheap.h>
+#include <matask.h>
+#include <conprint.h>
+#include <maassert.h>
+
+#define NUM_TASKS 64
+#define NUM_YIELDS 2000
+#define NUM_SLEEPERS 8
+
+static int sSwitches;
+static int sWakeOrder[NUM_SLEEPERS];
+static int sWoken;
+
+static void Yielder(int count, int unused) {
+	int i;
+	for(i=0; i<count; i++) {
+		sSwitches++;
+		maYield();
+	}
+	maKillTask();
+}
+
+static void Sleeper(int index, int unused) {
+	SetTaskLocal(0, (void*)index);
+	// Sleep in reverse order of creation.
+	SleepTask((NUM_SLEEPERS - index) * 20);
+	sWakeOrder[sWoken++] = (int)GetTaskLocal(0);
+	maKillTask();
+}
+
+static void benchSwitch(int numTasks) {
+	int i, start, time;
+	InitTasks(numTasks);
+	SetTaskStackSize(2048);
+	sSwitches = 0;
+
+	for(i=0; i<numTasks; i++) {
+		CreateTask((char*)Yielder, NUM_YIELDS, 0);
+	}
+	start = maGetMilliSecondCount();
+	while(GetTaskCount() > 0) {
+		RunAllTasks();
+	}
+	time = maGetMilliSecondCount() - start;
+
+	printf("%i tasks: %i switches in %i ms\n", numTasks, sSwitches, time);
+	if(time > 0)
+		printf("%i switches/ms\n", sSwitches / time);
+	DisposeTasks();
+}
+
+static void testSleep(void) {
+	int i, start;
+	if(!InitTasks(NUM_SLEEPERS)) {
+		printf("InitTasks failed\n");
+		return;
+	}
+	SetTaskStackSize(2048);
+	sWoken = 0;
+
+	// Not in a task, so this must fail instead of sleeping.
+	if(SleepTask(1) || BlockTask())
+		printf("SleepTask/BlockTask outside a task didn't fail\n");
+	if(WakeTask(-1) || WakeTask(NUM_SLEEPERS))
+		printf("WakeTask accepted an invalid task\n");
+
+	start = maGetMilliSecondCount();
+	for(i=0; i<NUM_SLEEPERS; i++) {
+		if(CreateTask((char*)Sleeper, i, 0) < 0) {
+			printf("CreateTask failed\n");
+			break;
+		}
+	}
+	while(GetTaskCount() > 0) {
+		WaitForTasks();
+		RunAllTasks();
+	}
+
+	for(i=0; i<sWoken; i++) {
+		if(sWakeOrder[i] != NUM_SLEEPERS - 1 - i) {
+			printf("Sleep order wrong at %i: %i\n", i, sWakeOrder[i]);
+			break;
+		}
+	}
+	if(sWoken == NUM_SLEEPERS && i == NUM_SLEEPERS)
+		printf("Sleepers done in %i ms\n", maGetMilliSecondCount() - start);
+
+	// Frees the stacks of any tasks left, as well as the task table.
+	DisposeTasks();
+}
+
+int MAMain() {
+	benchSwitch(2);
+	benchSwitch(NUM_TASKS);
+	testSleep();
+	printf("Done.\n");
+	FREEZE;
+}
@@ -572,6 +572,19 @@ public:
 		itr = m.find(2);
 		assert("Map::erase()", itr == m.end());
 
+		//erase while iterating, with enough elements to fill several tree nodes
+		for(int i=0; i<100; i++) {
+			m[i] = i;
+		}
+		itr = m.begin();
+		while(itr != m.end()) {
+			if(itr->first % 2)
+				itr = m.erase(itr);
+			else
+				++itr;
+		}
+		assert("Map::erase(Iterator)", m.size() == 50 && m.find(1) == m.end() && m.find(98) != m.end());
+
 		//clear
 		m.clear();
 		itr = m.find(3);
@@ -23,6 +23,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include "config.h"
 #include "helpers/log.h"
 #include "helpers/smartie.h"
+#include "helpers/helpers.h"
 
 #include "GdbCommon.h"
 #include "CoreCommon.h"
@@ -40,9 +41,15 @@ using namespace std;
 // statics
 //******************************************************************************
 
-static StubConnection::AckCallback sReadMemoryCallback;
-static int sReadMemoryLen;
-static byte* sReadMemoryDst;
+struct PendingRead {
+	byte* dst;
+	int src, len;
+	StubConnection::AckCallback cb;
+};
+static vector<PendingRead> sPendingReads;
+static bool sFetching = false;
+static int sFetchStart, sFetchLen;
+static int sPrefetchFrame, sPrefetchLevel;
 static StubConnection::AckCallback sWriteMemoryCallback;
 static vector<StubConnection::AckCallback> sContinueListeners;
 static vector<StubConnection::AckCallback> sStopListeners;
@@ -72,6 +79,9 @@ static bool asyncPacket(const char* data, int len);
 
 static void cacheContinue();
 static void getRegisters();
+static void fetchPendingReads();
+static void drainPendingReads();
+static void prefetchStack();
 
 static void unIdle();
 static void setIdle();
@@ -179,33 +189,36 @@ bool StubConnection::isIdle() {
 // asyncPacket
 //******************************************************************************
 
-static bool asyncPacket(const char* data, int len) {
-	if(len != 3)
-		return false;
-	//todo: fix code dupes
-	if(strcmp(data, "S01") == 0) {	//breakpoint
-		sRunning = false;
-		sFunctor.f = (void*)StubConnection::breakpointHit;
-		sFunctor.hasParam = false;
-		getRegisters();
-		return true;
-	}
-	if(strcmp(data, "S02") == 0) {	//interrupt
-		sRunning = false;
-		sFunctor.f = (void*)StubConnection::interruptHit;
-		sFunctor.hasParam = false;
-		getRegisters();
-		return true;
-	}
-	if(strcmp(data, "S03") == 0) {	//step
-		sRunning = false;
-		sFunctor.f = (void*)StubConnection::stepHit;
-		sFunctor.hasParam = false;
-		getRegisters();
-		return true;
+//parses the list of pages the stub reports as changed, "a,b-c,...",
+//and removes them from the memory cache.
+//returns false if the list is malformed.
+static bool invalidateDirtyPages(const char* list) {
+	while(*list && *list != ';') {
+		char* end;
+		int first = strtoul(list, &end, 16);
+		if(end == list)
+			return false;
+		int last = first;
+		list = end;
+		if(*list == '-') {
+			list++;
+			last = strtoul(list, &end, 16);
+			if(end == list || last < first)
+				return false;
+			list = end;
+		}
+		invalidateMemoryCache(first << GDB_MEMORY_PAGE_SHIFT,
+			(last - first + 1) << GDB_MEMORY_PAGE_SHIFT);
+		if(*list == ',')
+			list++;
 	}
-	if(data[0] == 'W') {	//exit
+	return true;
+}
+
+static bool asyncPacket(const char* data, int len) {
+	if(len == 3 && data[0] == 'W') {	//exit
 		sRunning = false;
+		clearMemoryCacheBits();
 		int code = strtoul(data + 1, NULL, 16);
 		sFunctor.f = (void*)StubConnection::exitHit;
 		sFunctor.p = code;
@@ -213,7 +226,39 @@ static bool asyncPacket(const char* data, int len) {
 		getRegisters();
 		return true;
 	}
-	return false;
+
+	//"Sxx", or "Txxdirty:<pages>;" if the stub knows which pages the program wrote.
+	if(len < 3 || (data[0] != 'S' && data[0] != 'T'))
+		return false;
+	if(data[0] == 'S' && len != 3)
+		return false;
+	char codeBuf[3] = { data[1], data[2], 0 };
+	void* hit;
+	switch(strtoul(codeBuf, NULL, 16)) {
+	case 1:	//breakpoint
+		hit = (void*)StubConnection::breakpointHit;
+		break;
+	case 2:	//interrupt
+		hit = (void*)StubConnection::interruptHit;
+		break;
+	case 3:	//step
+		hit = (void*)StubConnection::stepHit;
+		break;
+	default:
+		return false;
+	}
+	static const char dirtyTag[] = "dirty:";
+	if(data[0] == 'T' && strncmp(data + 3, dirtyTag, sizeof(dirtyTag) - 1) == 0) {
+		if(!invalidateDirtyPages(data + 3 + sizeof(dirtyTag) - 1))
+			clearMemoryCacheBits();
+	} else {
+		clearMemoryCacheBits();
+	}
+	sRunning = false;
+	sFunctor.f = hit;
+	sFunctor.hasParam = false;
+	getRegisters();
+	return true;
 }
 
 //******************************************************************************
@@ -267,30 +312,93 @@ static bool getRegistersPacket(const char* data, int len) {
 	else
 		((vfptr)sFunctor.f)();
 	sFunctor.f = NULL;
+
+	//reads queued while we were busy go first.
+	drainPendingReads();
+
+	//use the time the user spends looking at the stop to load the stack.
+	if(!sRunning && StubConnection::isIdle())
+		prefetchStack();
 	return true;
 }
 
+//the memory cache survives execution; the stop packet tells us what changed.
 static void cacheContinue() {
 	sCachedRegValid = false;
-	clearMemoryCacheBits();
 }
 
 //******************************************************************************
 // readMemory
 //******************************************************************************
 
+//larger reads are split into several packets.
+#define MAX_FETCH_SIZE (64 * 1024)
+
+//the number of caller frames to prefetch, and the maximum total amount.
+#define PREFETCH_FRAMES 4
+#define MAX_PREFETCH_SIZE (16 * 1024)
+
+static void copyFromCache(byte* dst, int src, int len) {
+	if(dst != (byte*)gMemBuf + src)
+		memcpy(dst, gMemBuf + src, len);
+}
+
+//reads are served from gMemBuf, which is filled one page-aligned packet at a time.
+//reads that arrive while a packet is in flight are queued,
+//and fetched together with other queued reads near them.
 void StubConnection::readMemory(void* dst, int src, int len, AckCallback cb) {
 	_ASSERT(len > 0);
 	_ASSERT(src > 0);
 	_ASSERT(src+len <= gMemSize);
-	if(isMemoryCached(src, len)) { cb(); return; }
+	if(isMemoryCached(src, len)) {
+		copyFromCache((byte*)dst, src, len);
+		if(cb)
+			cb();
+		return;
+	}
 
-	sReadMemoryCallback = cb;
-	sReadMemoryLen = len;
-	sReadMemoryDst = (byte*)dst;
-	char buffer[64];
-	sprintf(buffer, "m%X,%X", src, len);
+	PendingRead pr = { (byte*)dst, src, len, cb };
+	sPendingReads.push_back(pr);
+	drainPendingReads();
+}
+
+//starts fetching the queued reads, unless a fetch is already in flight.
+//if the connection is busy with something else, this is done again
+//when that command completes.
+static void drainPendingReads() {
+	if(sFetching || sPendingReads.empty() || !StubConnection::isIdle())
+		return;
 	unIdle();
+	fetchPendingReads();
+}
+
+static void fetchPendingReads() {
+	int start = 0, end = 0;
+	bool found = false;
+	for(size_t i=0; i<sPendingReads.size(); i++) {
+		const PendingRead& pr(sPendingReads[i]);
+		int s, e;
+		if(!getUncachedRange(pr.src, pr.len, s, e))
+			continue;
+		if(!found) {
+			start = s;
+			end = e;
+			found = true;
+		} else if(s <= end + GDB_MEMORY_PAGE_SIZE && e >= start - GDB_MEMORY_PAGE_SIZE) {
+			//close enough that refetching a page in between is cheaper than another round trip.
+			start = MIN(start, s);
+			end = MAX(end, e);
+		}
+	}
+	_ASSERT(found);
+	if(end - start > MAX_FETCH_SIZE)
+		end = start + MAX_FETCH_SIZE;
+
+	sFetching = true;
+	sFetchStart = start;
+	sFetchLen = end - start;
+	char buffer[64];
+	sprintf(buffer, "m%X,%X", sFetchStart, sFetchLen);
 	StubConnLow::sendPacket(buffer, readMemoryAck);
 }
 static void readMemoryAck() {
@@ -298,10 +406,14 @@ static void readMemoryAck() {
 }
 static bool readMemoryPacket(const char* data, int len) {
 	//eprintf("Recieved packet, %i bytes (we want %i): '%s'\n",
-		//len, sReadMemoryLen * 2, data);
-	if(checkErrorPacket(data, len))
+		//len, sFetchLen * 2, data);
+	if(checkErrorPacket(data, len)) {
+		sPendingReads.clear();
+		sFetching = false;
+		setIdle();
 		return true;
-	if(len != sReadMemoryLen * 2)
+	}
+	if(len != sFetchLen * 2)
 		return false;
 	//we also check that there are no non-hex characters
 	for(int i=0; i<len; i++) {
@@ -309,17 +421,76 @@ static bool readMemoryPacket(const char* data, int len) {
 			return false;
 	}
 	//parse data, byte for byte
-	for(int i=0; i<sReadMemoryLen; i++) {
+	byte* dst = (byte*)gMemBuf + sFetchStart;
+	for(int i=0; i<sFetchLen; i++) {
 		char buf[4];
 		memcpy(buf, data + i*2, 2);
 		buf[3] = 0;
-		sReadMemoryDst[i] = (byte)strtoul(buf, NULL, 16);
+		dst[i] = (byte)strtoul(buf, NULL, 16);
 	}
+	setMemoryCached(sFetchStart, sFetchLen);
+
+	vector<PendingRead> done;
+	vector<PendingRead> waiting;
+	for(size_t i=0; i<sPendingReads.size(); i++) {
+		const PendingRead& pr(sPendingReads[i]);
+		if(isMemoryCached(pr.src, pr.len))
+			done.push_back(pr);
+		else
+			waiting.push_back(pr);
+	}
+	sPendingReads = waiting;
+	sFetching = false;
 	setIdle();
-	sReadMemoryCallback();
+
+	//the callbacks may queue more reads.
+	for(size_t i=0; i<done.size(); i++) {
+		copyFromCache(done[i].dst, done[i].src, done[i].len);
+		if(done[i].cb)
+			done[i].cb();
+	}
+	drainPendingReads();
 	return true;
 }
 
+//******************************************************************************
+// prefetch
+//******************************************************************************
+
+static void prefetchFrameRead();
+
+//loads the current stack frame and a few of its callers, following the frame pointers.
+//each frame ends with the caller's frame pointer and return address, at fr-8.
+static void prefetchStack() {
+	int sp = sCachedReg.gpr[REG_sp];
+	int fr = sCachedReg.gpr[REG_fr];
+	if(sp <= 0 || sp >= gMemSize || fr < sp || fr > gMemSize)
+		return;
+	sPrefetchFrame = fr;
+	sPrefetchLevel = 0;
+	int end = MIN(fr, sp + MAX_PREFETCH_SIZE);
+	if(end <= sp) {
+		prefetchFrameRead();
+		return;
+	}
+	StubConnection::readMemory(gMemBuf + sp, sp, end - sp, prefetchFrameRead);
+}
+
+static void prefetchFrameRead() {
+	int sp = sCachedReg.gpr[REG_sp];
+	int fr = sPrefetchFrame;
+	if(sPrefetchLevel++ >= PREFETCH_FRAMES || fr - 8 < sp || fr >= sp + MAX_PREFETCH_SIZE)
+		return;
+	if(!isMemoryCached(fr - 8, 8))
+		return;
+	int caller = *(int*)&gMemBuf[fr - 8];
+	if(caller <= fr || caller > gMemSize)
+		return;
+	sPrefetchFrame = caller;
+	int end = MIN(caller, sp + MAX_PREFETCH_SIZE);
+	StubConnection::readMemory(gMemBuf + fr, fr, end - fr, prefetchFrameRead);
+}
+
 //******************************************************************************
 // writeMemory
 //******************************************************************************
@@ -349,5 +520,6 @@ static bool writeMemoryPacket(const char* data, int len) {
 		return false;
 	setIdle();
 	sWriteMemoryCallback();
+	drainPendingReads();
 	return true;
 }
@@ -20,12 +20,15 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #include "config.h"
 #include "helpers/helpers.h"
+#include "GdbCommon.h"
 
 int gMemSize = 0;
 char* gMemBuf = NULL;
 
-#define CACHED_MEM_BITS_SIZE ((sizeof(int)*gMemSize*8+32)>>5)
+#define NUM_PAGES ((gMemSize + GDB_MEMORY_PAGE_SIZE - 1) >> GDB_MEMORY_PAGE_SHIFT)
+#define CACHED_MEM_BITS_SIZE ((NUM_PAGES + 31) >> 5)
 static int *sCachedMemBits = NULL;
+static int sNumCachedPages = 0;
 
 //******************************************************************************
 // init
@@ -34,26 +37,82 @@ static int *sCachedMemBits = NULL;
 void setMemSize(int size) {
 	gMemSize = size;
 	SAFE_DELETE(gMemBuf);
+	SAFE_DELETE(sCachedMemBits);
 	gMemBuf = new char[size];
 	sCachedMemBits = new int[CACHED_MEM_BITS_SIZE];
 	clearMemoryCacheBits();
 }
 
 void clearMemoryCacheBits() {
-	memset(sCachedMemBits, 0, CACHED_MEM_BITS_SIZE);
+	memset(sCachedMemBits, 0, CACHED_MEM_BITS_SIZE * sizeof(int));
+	sNumCachedPages = 0;
+}
+
+//******************************************************************************
+// page bits
+//******************************************************************************
+
+static bool isPageCached(int page) {
+	return (sCachedMemBits[page >> 5] & (1 << (page & 31))) != 0;
+}
+
+static void setPageCached(int page) {
+	if(!isPageCached(page)) {
+		sCachedMemBits[page >> 5] |= 1 << (page & 31);
+		sNumCachedPages++;
+	}
+}
+
+static void clearPageCached(int page) {
+	if(isPageCached(page)) {
+		sCachedMemBits[page >> 5] &= ~(1 << (page & 31));
+		sNumCachedPages--;
+	}
 }
 
 bool isMemoryCached(int src, int len) {
-	int numSet = 0;
-	for(int i = src; i < src+len; i++) {
-		int j_hi = i>>5;
-		int j_lo = 1<<(i&((1<<5)-1));
-		if(!(sCachedMemBits[j_hi]&j_lo)) {
-			sCachedMemBits[j_hi]|=j_lo;
-		} else {
-			numSet++;
-		}
+	int first = src >> GDB_MEMORY_PAGE_SHIFT;
+	int last = (src + len - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	for(int page = first; page <= last; page++) {
+		if(!isPageCached(page))
+			return false;
 	}
-	if(numSet==len) return true;
-	else return false;
+	return true;
+}
+
+bool getUncachedRange(int src, int len, int& start, int& end) {
+	int first = src >> GDB_MEMORY_PAGE_SHIFT;
+	int last = (src + len - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	while(first <= last && isPageCached(first))
+		first++;
+	if(first > last)
+		return false;
+	while(isPageCached(last))
+		last--;
+	start = first << GDB_MEMORY_PAGE_SHIFT;
+	end = MIN((last + 1) << GDB_MEMORY_PAGE_SHIFT, gMemSize);
+	return true;
+}
+
+void setMemoryCached(int src, int len) {
+	int first = (src + GDB_MEMORY_PAGE_SIZE - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	int last = (src + len) >> GDB_MEMORY_PAGE_SHIFT;
+	//the partial page at the end of memory counts as whole.
+	if(src + len == gMemSize && (gMemSize & (GDB_MEMORY_PAGE_SIZE - 1)) != 0)
+		last++;
+	for(int page = first; page < last; page++) {
+		setPageCached(page);
+	}
+}
+
+void invalidateMemoryCache(int src, int len) {
+	int first = src >> GDB_MEMORY_PAGE_SHIFT;
+	int last = (src + len - 1) >> GDB_MEMORY_PAGE_SHIFT;
+	for(int page = first; page <= last && page < NUM_PAGES; page++) {
+		clearPageCached(page);
+	}
+}
+
+int getNumCachedPages() {
+	return sNumCachedPages;
 }
@@ -34,14 +34,48 @@ void setMemSize(int size);
 void clearMemoryCacheBits();
 
 /**
- * Checks if the given memory locations are cached. After this call the 
- * specified memory locations will be marked as cached, i.e. assuming a call
- * to chache them will be made after this call.
+ * Checks if the given memory locations are cached in gMemBuf.
+ * The cache is kept in pages of GDB_MEMORY_PAGE_SIZE bytes.
  *
- * @param src Address of the beginning of the cached locations.
- * @param len The range of the bytes being cached.
- * @return True if the specified memory locations was cached, false otherwise.
+ * @param src Address of the beginning of the locations.
+ * @param len The range of the bytes.
+ * @return True if all the specified memory locations are cached, false otherwise.
  */
 bool isMemoryCached(int src, int len);
 
+/**
+ * Finds the memory that must be fetched to cache the given locations.
+ * The result is page-aligned and runs from the first to the last uncached
+ * page, so that it can be fetched with a single packet.
+ *
+ * @param src Address of the beginning of the locations.
+ * @param len The range of the bytes.
+ * @param start Receives the first address to fetch.
+ * @param end Receives the address after the last one to fetch.
+ * @return False if everything is already cached.
+ */
+bool getUncachedRange(int src, int len, int& start, int& end);
+
+/**
+ * Marks the pages fully covered by the given locations as cached.
+ * The data must already have been stored in gMemBuf.
+ *
+ * @param src Address of the beginning of the locations.
+ * @param len The range of the bytes.
+ */
+void setMemoryCached(int src, int len);
+
+/**
+ * Removes the pages touched by the given locations from the cache.
+ *
+ * @param src Address of the beginning of the locations.
+ * @param len The range of the bytes.
+ */
+void invalidateMemoryCache(int src, int len);
+
+/**
+ * Returns the number of cached pages.
+ */
+int getNumCachedPages();
+
 #endif /* _MEMORY_H_ */
@@ -212,6 +212,271 @@ char * RebuildRetType(int type)
 	return RBType;
 }
 
+//****************************************
+//			Leaf inlining
+//****************************************
+
+// With -inline, calls to small straight-line leaf functions are replaced
+// by the function body, without its ret. A call only sets rt, so the body
+// behaves the same inline as long as it never touches rt.
+// The callees themselves are kept, the second pipe-tool pass drops them
+// once nothing references them.
+
+#define INLINE_MAX_OPS	12
+
+static int InlineCount = 0;
+
+int InlineUsesReg(OpcodeInfo *op, int reg)
+{
+	if (op->op == _PUSH)
+		return reg >= op->rd && reg < op->rd + op->rs;
+
+	if (op->op == _POP)
+		return reg > op->rd - op->rs && reg <= op->rd;
+
+	if ((op->flags & fetch_d) && op->rd == reg)
+		return 1;
+
+	if ((op->flags & fetch_s) && op->rs == reg)
+		return 1;
+
+	return 0;
+}
+
+// Ops that only write rd
+
+int InlineWritesOnly(OpcodeInfo *op)
+{
+	switch (op->op)
+	{
+		case _LDI:
+		case _LDR:
+		case _LDB:
+		case _LDH:
+		case _LDW:
+		case _NOT:
+		case _NEG:
+		case _XB:
+		case _XH:
+			return !((op->flags & fetch_s) && op->rs == op->rd);
+	}
+
+	return 0;
+}
+
+int RebuildInlineAnalyse(SYMBOL *sym, InlineInfo *info)
+{
+	OpcodeInfo thisOp;
+	uchar *ip, *ip_end;
+	int real_ip;
+	int ops = 0;
+	int used = 0;
+	int push_rd = 0, push_count = 0;
+	int pop_rd = 0, pop_count = 0;
+	int has_ret = 0;
+	int uses_sp = 0;
+	int written = 0;
+	int reads_saved = 0;
+	int n, r;
+
+	if (!sym || sym->Type != SECT_code)
+		return 0;
+
+	if (sym->LabelType < label_Function)
+		return 0;
+
+	if (strcmp(sym->Name, Code_EntryPoint) == 0)
+		return 0;
+
+	ip_end = (uchar *) ArrayPtr(&CodeMemArray, sym->EndIP);
+	ip = (uchar *) ArrayPtr(&CodeMemArray, sym->Value);
+	real_ip = sym->Value;
+
+	while (ip <= ip_end)
+	{
+		// Any label in the body is a jump target
+
+		if (real_ip != sym->Value && ArrayGet(&CodeLabelArray, real_ip))
+			return 0;
+
+		if (has_ret)
+			return 0;
+
+		if (++ops > INLINE_MAX_OPS)
+			return 0;
+
+		ip = DecodeOpcode(&thisOp, ip);
+		real_ip += thisOp.len;
+
+		switch (thisOp.op)
+		{
+			case _CALL:
+			case _CALLI:
+			case _JPI:
+			case _JPR:
+			case _CASE:
+			case _FAR:
+			case _JC_EQ:
+			case _JC_NE:
+			case _JC_GE:
+			case _JC_GEU:
+			case _JC_GT:
+			case _JC_GTU:
+			case _JC_LE:
+			case _JC_LEU:
+			case _JC_LT:
+			case _JC_LTU:
+				return 0;
+
+			case _RET:
+				has_ret = 1;
+				continue;
+
+			case _PUSH:
+				if (ops != 1)
+					return 0;
+
+				push_rd = thisOp.rd;
+				push_count = thisOp.rs;
+				break;
+
+			case _POP:
+				if (pop_count)
+					return 0;
+
+				pop_rd = thisOp.rd - thisOp.rs + 1;
+				pop_count = thisOp.rs;
+				break;
+
+			default:
+				if (pop_count)
+					return 0;
+
+				if (InlineUsesReg(&thisOp, REG_sp))
+					uses_sp = 1;
+
+				// A saved register read before it is written holds the
+				// caller's value, which a renamed register would not.
+
+				for (r=push_rd;r<push_rd+push_count;r++)
+				{
+					if (!InlineUsesReg(&thisOp, r) || (written & (1 << r)))
+						continue;
+
+					if (InlineWritesOnly(&thisOp) && thisOp.rd == r)
+						written |= 1 << r;
+					else
+						reads_saved = 1;
+				}
+		}
+
+		if (InlineUsesReg(&thisOp, REG_rt))
+			return 0;
+
+		for (r=0;r<32;r++)
+			if (InlineUsesReg(&thisOp, r))
+				used |= 1 << r;
+	}
+
+	if (!has_ret)
+		return 0;
+
+	if (push_count != pop_count || push_rd != pop_rd)
+		return 0;
+
+	info->DropPushPop = 0;
+
+	for (n=0;n<32;n++)
+		info->Rename[n] = n;
+
+	// The pushed registers only need saving because the caller expects
+	// them back. If the body leaves sp alone, give it scratch registers
+	// instead, which the caller already expects a call to clobber.
+
+	if (push_count && !uses_sp && !reads_saved)
+	{
+		r = REG_r0;
+
+		for (n=push_rd;n<push_rd+push_count;n++)
+		{
+			while (r <= REG_r13 && (used & (1 << r)))
+				r++;
+
+			if (r > REG_r13)
+				break;
+
+			info->Rename[n] = r++;
+		}
+
+		// Too few free scratch registers: keep the save and restore,
+		// and leave every register as it is.
+
+		if (n < push_rd + push_count)
+		{
+			for (n=push_rd;n<push_rd+push_count;n++)
+				info->Rename[n] = n;
+		}
+		else
+			info->DropPushPop = 1;
+	}
+
+	return 1;
+}
+
+//****************************************
+//		 Emit an inlined call
+//****************************************
+
+int RebuildInlineCall(OpcodeInfo *callOp, int untouched)
+{
+	InlineInfo info;
+	OpcodeInfo thisOp;
+	SYMBOL *ref;
+	uchar *ip, *ip_end;
+	char str[256];
+
+	if (!ArgInline || callOp->op != _CALLI)
+		return 0;
+
+	ref = (SYMBOL *) ArrayGet(&CallArray, callOp->rip);
+
+	if (!ref)
+		return 0;
+
+	ref = (SYMBOL *) ArrayGet(&CodeLabelArray, ref->Value);
+
+	if (!RebuildInlineAnalyse(ref, &info))
+		return 0;
+
+	RebuildEmit("%s\t// inlined %s\n", untouched ? "// " : "", ref->Name);
+
+	ip_end = (uchar *) ArrayPtr(&CodeMemArray, ref->EndIP);
+	ip = (uchar *) ArrayPtr(&CodeMemArray, ref->Value);
+
+	while (ip <= ip_end)
+	{
+		ip = DecodeOpcode(&thisOp, ip);
+
+		if (thisOp.op == _RET)
+			break;
+
+		if (info.DropPushPop && (thisOp.op == _PUSH || thisOp.op == _POP))
+			continue;
+
+		if ((thisOp.flags & fetch_d) && thisOp.rd < 32)
+			thisOp.rd = info.Rename[thisOp.rd];
+
+		if ((thisOp.flags & fetch_s) && thisOp.rs < 32)
+			thisOp.rs = info.Rename[thisOp.rs];
+
+		DecodeAsmString(&thisOp, str, 1);
+		RebuildEmit("%s\t%s\n", untouched ? "// " : "", str);
+	}
+
+	InlineCount++;
+	return 1;
+}
+
 //****************************************
 //		Disassemble Function
 //****************************************
@@ -224,6 +489,7 @@ void RebuildFunc(SYMBOL *sym)
 	uchar *ip, *ip_end, *ip_last;
 
 	int real_ip;
+	int untouched;
 	char str[256];
 
 	if (!sym)
@@ -282,13 +548,25 @@ void RebuildFunc(SYMBOL *sym)
 
 //		Peeper(ip, ip_end);
 
+		untouched = 0;
+
 		if (ArgSkipElim == 0)
 			if (ArrayGet(&CodeTouchArray, real_ip) == 0)
-				RebuildEmit("// ");
+				untouched = 1;
 
 		CaseRef = 0;
 
 		ip = DecodeOpcode(&thisOp, ip);
+
+		if (RebuildInlineCall(&thisOp, untouched))
+		{
+			real_ip += (ip - ip_last);
+			continue;
+		}
+
+		if (untouched)
+			RebuildEmit("// ");
+
 		DecodeAsmString(&thisOp, str, 1);
 		RebuildEmit("\t%s", str);
 
@@ -358,6 +636,261 @@ void RebuildEmitStabs(int ip)
 	RebuildEmit(".line %d\n", line);
 }
 
+//****************************************
+//		Profile guided layout
+//****************************************
+
+// Functions are ordered by the instruction counts that a runtime built
+// with INSTRUCTION_PROFILING writes to profile.txt. The counts are mapped
+// to functions through the sld file of the profiled program.
+
+static ProfileFunc *ProfileFuncs = 0;
+static int ProfileFuncCount = 0;
+
+int ProfileCompareStart(const void *a, const void *b)
+{
+	return ((const ProfileFunc *) a)->Start - ((const ProfileFunc *) b)->Start;
+}
+
+int ProfileCompareName(const void *a, const void *b)
+{
+	return strcmp(((const ProfileFunc *) a)->Name, ((const ProfileFunc *) b)->Name);
+}
+
+int LayoutCompare(const void *a, const void *b)
+{
+	const LayoutFunc *fa = (const LayoutFunc *) a;
+	const LayoutFunc *fb = (const LayoutFunc *) b;
+
+	if (fa->Group != fb->Group)
+		return fa->Group - fb->Group;
+
+	if (fa->Count > fb->Count)
+		return -1;
+
+	if (fa->Count < fb->Count)
+		return 1;
+
+	return fa->Index - fb->Index;
+}
+
+ProfileFunc * ProfileFindIP(int ip)
+{
+	int lo = 0;
+	int hi = ProfileFuncCount - 1;
+
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		ProfileFunc *f = &ProfileFuncs[mid];
+
+		if (ip < f->Start)
+			hi = mid - 1;
+		else if (ip > f->End)
+			lo = mid + 1;
+		else
+			return f;
+	}
+
+	return 0;
+}
+
+void LoadLayoutProfile()
+{
+	FILE *in;
+	char line[1024];
+	char name[1024];
+	int start, end, ip, count;
+	int alloc = 0;
+	int inFunctions = 0;
+	double total = 0;
+
+	in = fopen(LayoutSldName, "r");
+
+	if (!in)
+		Error(Error_Fatal, "Could not open layout sld file '%s'", LayoutSldName);
+
+	while (fgets(line, sizeof(line), in))
+	{
+		if (!inFunctions)
+		{
+			if (strncmp(line, "FUNCTIONS", 9) == 0)
+				inFunctions = 1;
+
+			continue;
+		}
+
+		if (strncmp(line, "CDTOR", 5) == 0 || strncmp(line, "END", 3) == 0)
+			break;
+
+		if (sscanf(line, "%1023s %x,%x", name, &start, &end) != 3)
+			continue;
+
+		if (ProfileFuncCount == alloc)
+		{
+			alloc = alloc ? alloc * 2 : 1024;
+			ProfileFuncs = (ProfileFunc *) realloc(ProfileFuncs, sizeof(ProfileFunc) * alloc);
+
+			if (!ProfileFuncs)
+				Error(Error_Fatal, "LoadLayoutProfile: out of memory");
+		}
+
+		ProfileFuncs[ProfileFuncCount].Name = NewPtr(strlen(name) + 1);
+		strcpy(ProfileFuncs[ProfileFuncCount].Name, name);
+		ProfileFuncs[ProfileFuncCount].Start = start;
+		ProfileFuncs[ProfileFuncCount].End = end;
+		ProfileFuncs[ProfileFuncCount].Count = 0;
+		ProfileFuncCount++;
+	}
+
+	fclose(in);
+
+	qsort(ProfileFuncs, ProfileFuncCount, sizeof(ProfileFunc), ProfileCompareStart);
+
+	in = fopen(LayoutProfileName, "r");
+
+	if (!in)
+		Error(Error_Fatal, "Could not open layout profile '%s'", LayoutProfileName);
+
+	while (fgets(line, sizeof(line), in))
+	{
+		ProfileFunc *f;
+
+		// Skips the "INSTRUCTION COUNTS" header too
+
+		if (sscanf(line, "%x: %i", &ip, &count) != 2)
+			continue;
+
+		f = ProfileFindIP(ip);
+
+		if (f)
+		{
+			f->Count += count;
+			total += count;
+		}
+	}
+
+	fclose(in);
+
+	qsort(ProfileFuncs, ProfileFuncCount, sizeof(ProfileFunc), ProfileCompareName);
+
+	if (!ArgQuiet)
+		printf("Layout profile: %d functions, %.0f instructions\n", ProfileFuncCount, total);
+}
+
+ProfileFunc * ProfileFindSym(SYMBOL *sym)
+{
+	ProfileFunc key;
+	ProfileFunc *f;
+	char name[1024];
+
+	if (!ProfileFuncs)
+		return 0;
+
+	// The profiled program may itself have been built with -elim,
+	// which renames functions to name_scope.
+
+	sprintf(name, "%s_%d", sym->Name, sym->LocalScope);
+	key.Name = name;
+	f = (ProfileFunc *) bsearch(&key, ProfileFuncs, ProfileFuncCount, sizeof(ProfileFunc), ProfileCompareName);
+
+	if (f)
+		return f;
+
+	key.Name = sym->Name;
+	return (ProfileFunc *) bsearch(&key, ProfileFuncs, ProfileFuncCount, sizeof(ProfileFunc), ProfileCompareName);
+}
+
+//****************************************
+//	Emit functions ordered by profile
+//****************************************
+
+// Hot functions come first, hottest first, so that they share cache lines
+// and pages. Functions the profile never reached go last. The entry point
+// keeps its place at the front.
+
+int Rebuild_CodeByProfile()
+{
+	LayoutFunc *funcs;
+	SYMBOL *sym;
+	int count = 0;
+	int hot = 0;
+	int cold = 0;
+	int group = -1;
+	int n;
+
+	LoadLayoutProfile();
+
+	funcs = (LayoutFunc *) NewPtrClear(sizeof(LayoutFunc) * (CodeIP + 2));
+
+	for (n=0;n<CodeIP+1;n++)
+	{
+		sym = (SYMBOL *) ArrayGet(&CodeLabelArray, n);
+
+		if (!sym)
+			continue;
+
+		if (!(sym->Flags & SymFlag_Ref) && !ArgSkipElim)
+			continue;
+
+		if (sym->LabelType < label_Function)
+			continue;
+
+		funcs[count].Sym = sym;
+		funcs[count].Index = count;
+
+		if (strcmp(sym->Name, Code_EntryPoint) == 0)
+		{
+			funcs[count].Group = 0;
+			funcs[count].Count = 1e300;
+		}
+		else
+		{
+			ProfileFunc *f = ProfileFindSym(sym);
+
+			if (!f)
+				funcs[count].Group = 1;
+			else if (f->Count > 0)
+			{
+				funcs[count].Group = 0;
+				funcs[count].Count = f->Count;
+				hot++;
+			}
+			else
+			{
+				funcs[count].Group = 2;
+				cold++;
+			}
+		}
+
+		count++;
+	}
+
+	qsort(funcs, count, sizeof(LayoutFunc), LayoutCompare);
+
+	for (n=0;n<count;n++)
+	{
+		if (funcs[n].Group != group)
+		{
+			group = funcs[n].Group;
+
+			if (group == 0)
+				RebuildEmit("\n// Hot functions\n");
+			else if (group == 2)
+				RebuildEmit("\n// Cold functions\n");
+		}
+
+		RebuildFunc(funcs[n].Sym);
+	}
+
+	DisposePtr((char *) funcs);
+
+	if (!ArgQuiet)
+		printf("Layout: %d hot, %d cold, %d unprofiled functions\n", hot, cold, count - hot - cold);
+
+	return count;
+}
+
 //****************************************
 //
 //****************************************
@@ -368,7 +901,9 @@ void Rebuild_Code()
 	int n;
 	int c = 0;
 
-	for (n=0;n<CodeIP+1;n++)
+	if (ArgLayoutProfile)
+		c = Rebuild_CodeByProfile();
+	else for (n=0;n<CodeIP+1;n++)
 	{
 		sym = (SYMBOL *) ArrayGet(&CodeLabelArray, n);
 
@@ -387,6 +922,9 @@ void Rebuild_Code()
 	}
 
 	CRPRINT("Processed %d functions\n", c);
+
+	if (ArgInline && !ArgQuiet)
+		printf("Inlined %d calls\n", InlineCount);
 }
 
 //****************************************
@@ -44,6 +44,26 @@ static int ReturnCount;
 
 static int CppUsedCallReg;
 
+// Functions that use sp keep it in a local, and store it back in the
+// global sp (which callees and syscalls read) only before calls.
+// Memory is addressed through a local copy of mem_ds.
+// Neither can then be changed by a store, so the host compiler is free
+// to keep them in registers.
+
+static int CppLocalSp;					// This function has a local sp
+static int CppLocalSpDirty;				// The global sp may be out of date
+static int CppLocalSpStored;			// The global sp has been changed
+
+// Where sp is a known distance from its value on entry, sp-relative
+// accesses are at known offsets. The prolog checks once that all of them
+// are inside the data segment, and they are then emitted without masking.
+
+static char *CppSpSafe;					// Per code byte: access needs no mask
+static int CppSpSafeStart;				// Code address of CppSpSafe[0]
+static int CppSpSafeLen;
+static int CppSpCheckLo;				// Range to check on entry, from sp
+static int CppSpCheckLen;
+
 static char *Cpp_reg[] = {"zr","sp","rt","fr","d0","d1","d2","d3",
 					"d4","d5","d6","d7","i0","i1","i2","i3",
 					"r0","r1","r2","r3","r4","r5","r6","r7",
@@ -516,6 +536,8 @@ void CppDecodeSysCall(OpcodeInfo *theOp)
 
 	param_count = syscall->Params;
 
+	CppStoreLocalSp();
+
 	CppEmitReturnType(syscall->RetType);
 
 
@@ -565,6 +587,7 @@ void CppForceSysCallUsed(char *name)
 
 void Cpp_LoadMem(OpcodeInfo *theOp, char *str)
 {
+	char *sp_safe = "";
 
 	if (theOp->rs == 0)
 	{
@@ -572,13 +595,16 @@ void Cpp_LoadMem(OpcodeInfo *theOp, char *str)
 		return;
 	}
 
+	if (theOp->rs == REG_sp && CppSpAccessIsSafe(theOp))
+		sp_safe = "_SP";
+
 	if (theOp->imm == 0)
 	{
-		RebuildEmit("	%s = %s(%s);", Cpp_reg[theOp->rd], str, Cpp_reg[theOp->rs]);
+		RebuildEmit("	%s = %s%s(%s);", Cpp_reg[theOp->rd], str, sp_safe, Cpp_reg[theOp->rs]);
 		return;
 	}
 
-	RebuildEmit("	%s = %s(%s+0x%x);", Cpp_reg[theOp->rd], str, Cpp_reg[theOp->rs], theOp->imm);
+	RebuildEmit("	%s = %s%s(%s+0x%x);", Cpp_reg[theOp->rd], str, sp_safe, Cpp_reg[theOp->rs], theOp->imm);
 }
 
 
@@ -588,6 +614,7 @@ void Cpp_LoadMem(OpcodeInfo *theOp, char *str)
 
 void Cpp_StoreMem(OpcodeInfo *theOp, char *str)
 {
+	char *sp_safe = "";
 
 	if (theOp->rd == 0)
 	{
@@ -595,16 +622,35 @@ void Cpp_StoreMem(OpcodeInfo *theOp, char *str)
 		return;
 	}
 
+	if (theOp->rd == REG_sp && CppSpAccessIsSafe(theOp))
+		sp_safe = "_SP";
+
 	if (theOp->imm == 0)
 	{
-		RebuildEmit("	%s(%s, %s);", str, Cpp_reg[theOp->rd], Cpp_reg[theOp->rs]);
+		RebuildEmit("	%s%s(%s, %s);", str, sp_safe, Cpp_reg[theOp->rd], Cpp_reg[theOp->rs]);
 		return;
 	}
 
-	RebuildEmit("	%s(%s+0x%x, %s);", str, Cpp_reg[theOp->rd], theOp->imm, Cpp_reg[theOp->rs]);
+	RebuildEmit("	%s%s(%s+0x%x, %s);", str, sp_safe, Cpp_reg[theOp->rd], theOp->imm, Cpp_reg[theOp->rs]);
 }
 
 
+//****************************************
+//
+//****************************************
+
+void CppStoreLocalSp()
+{
+	if (!CppLocalSp || !CppLocalSpDirty)
+		return;
+
+	// No newline, so that untouched instructions stay commented out
+	RebuildEmit("	::sp = sp;");
+
+	CppLocalSpDirty = 0;
+	CppLocalSpStored = 1;
+}
+
 //****************************************
 //
 //****************************************
@@ -661,6 +707,8 @@ int CppDecodeCall(OpcodeInfo *theOp)
 
 	ref = labref;
 
+	CppStoreLocalSp();
+
 	return CppCallFunction(ref, 1);
 }
 
@@ -676,6 +724,8 @@ void CppDecodeCallReg(OpcodeInfo *theOp)
 	int i2 = funcprop.reg_used & REGBIT(REG_i2);
 	int i3 = funcprop.reg_used & REGBIT(REG_i3);
 
+	CppStoreLocalSp();
+
 	RebuildEmit("	r14 = CallReg(%s", Cpp_reg[theOp->rd]);
 
 	if (i0)
@@ -969,6 +1019,314 @@ void CppEmitReturnDecl(int rettype)
 	}
 }
 
+//****************************************
+//
+//****************************************
+
+int CppFunctionUsesMemory(SYMBOL *sym)
+{
+	OpcodeInfo thisOp;
+	uchar *ip, *ip_end;
+
+	ip_end = (uchar *) ArrayPtr(&CodeMemArray, sym->EndIP);
+	ip = (uchar *) ArrayPtr(&CodeMemArray, sym->Value);
+
+	while(ip <= ip_end)
+	{
+		ip = DecodeOpcode(&thisOp, ip);
+
+		switch (thisOp.op)
+		{
+			case _LDW:
+			case _LDH:
+			case _LDB:
+			case _STW:
+			case _STH:
+			case _STB:
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+//****************************************
+//	  Merge sp offset into a jump target
+//****************************************
+
+#define SP_UNSEEN	0
+#define SP_KNOWN	1
+#define SP_UNKNOWN	2
+
+// Returns 1 if the state at pos changed, -1 if pos is outside the function
+
+int CppSpMerge(char *state, int *offset, int len, int pos, int from_state, int sp_offset)
+{
+	if (pos < 0 || pos >= len)
+		return -1;
+
+	if (state[pos] == SP_UNKNOWN)
+		return 0;
+
+	if (state[pos] == SP_UNSEEN && from_state == SP_KNOWN)
+	{
+		state[pos] = SP_KNOWN;
+		offset[pos] = sp_offset;
+		return 1;
+	}
+
+	if (state[pos] == SP_KNOWN && from_state == SP_KNOWN && offset[pos] == sp_offset)
+		return 0;
+
+	state[pos] = SP_UNKNOWN;
+	return 1;
+}
+
+//****************************************
+//	Find stack accesses that are in range
+//****************************************
+
+void CppFindSafeStackAccesses(SYMBOL *sym, int uses_mem)
+{
+	OpcodeInfo thisOp;
+	uchar *ip, *ip_start, *ip_end;
+	SYMBOL *ref;
+	char *state;
+	int *offset;
+	int len, pos, next, from_state, sp_offset;
+	int data_ip, count, size, base, addr, lo, hi;
+	int changed, res, n;
+
+	CppSpSafe = 0;
+	CppSpCheckLen = 0;
+
+	if (!CppLocalSp || !uses_mem)
+		return;
+
+	ip_start = (uchar *) ArrayPtr(&CodeMemArray, sym->Value);
+	ip_end = (uchar *) ArrayPtr(&CodeMemArray, sym->EndIP);
+	len = sym->EndIP - sym->Value + 1;
+
+	state = NewPtrClear(len);
+	offset = (int *) NewPtrClear(len * sizeof(int));
+
+	// Follow every path from the entry, where sp is at offset 0.
+	// A state only moves from unseen to known to unknown, so this ends.
+
+	state[0] = SP_KNOWN;
+	res = 0;
+
+	do
+	{
+		changed = 0;
+		ip = ip_start;
+
+		while (ip <= ip_end && res >= 0)
+		{
+			pos = ip - ip_start;
+			ip = DecodeOpcode(&thisOp, ip);
+			next = ip - ip_start;
+
+			from_state = state[pos];
+			sp_offset = offset[pos];
+
+			if (from_state == SP_UNSEEN)
+				continue;
+
+			switch (thisOp.op)
+			{
+				case _PUSH:
+				sp_offset -= thisOp.rs * 4;
+				break;
+
+				case _POP:
+				sp_offset += thisOp.rs * 4;
+				break;
+
+				case _ADDI:
+				if (thisOp.rd == REG_sp)
+					sp_offset += thisOp.imm;
+				break;
+
+				case _SUBI:
+				if (thisOp.rd == REG_sp)
+					sp_offset -= thisOp.imm;
+				break;
+
+				// These don't write rd, and calls leave sp as it was
+
+				case _STW:
+				case _STH:
+				case _STB:
+				case _JC_EQ:
+				case _JC_NE:
+				case _JC_GE:
+				case _JC_GEU:
+				case _JC_GT:
+				case _JC_GTU:
+				case _JC_LE:
+				case _JC_LEU:
+				case _JC_LT:
+				case _JC_LTU:
+				case _JPI:
+				case _CASE:
+				case _CALL:
+				case _CALLI:
+				case _SYSCALL:
+				case _RET:
+				break;
+
+				default:
+				if (thisOp.rd == REG_sp)
+					from_state = SP_UNKNOWN;
+				break;
+			}
+
+			switch (thisOp.op)
+			{
+				case _RET:
+				continue;
+
+				case _JPI:
+				case _JC_EQ:
+				case _JC_NE:
+				case _JC_GE:
+				case _JC_GEU:
+				case _JC_GT:
+				case _JC_GTU:
+				case _JC_LE:
+				case _JC_LEU:
+				case _JC_LT:
+				case _JC_LTU:
+				ref = (SYMBOL *) ArrayGet(&CallArray, thisOp.rip);
+
+				if (!ref)
+				{
+					res = -1;
+					continue;
+				}
+
+				res = CppSpMerge(state, offset, len, ref->Value - sym->Value, from_state, sp_offset);
+				changed |= (res > 0);
+
+				if (thisOp.op == _JPI)
+					continue;
+				break;
+
+				case _CASE:
+				data_ip = thisOp.imm;
+				count = GetDataMemLong(data_ip + 1) + 2;	// Cases and the default
+				data_ip += 2;
+
+				for (n=0;n<count && res >= 0;n++)
+				{
+					res = CppSpMerge(state, offset, len, GetDataMemLong(data_ip++) - sym->Value, from_state, sp_offset);
+					changed |= (res > 0);
+				}
+				continue;
+			}
+
+			// Running off the end is left to the code after the function
+
+			if (next < len)
+				changed |= (CppSpMerge(state, offset, len, next, from_state, sp_offset) > 0);
+		}
+	}
+	while (changed && res >= 0);
+
+	// A jump we can't follow may lead anywhere, so leave all accesses masked
+
+	if (res < 0)
+	{
+		DisposePtr(state);
+		DisposePtr((char *) offset);
+		return;
+	}
+
+	// Find the range of the aligned accesses at known offsets
+
+	CppSpSafe = NewPtrClear(len);
+	CppSpSafeStart = sym->Value;
+	CppSpSafeLen = len;
+
+	lo = 0;
+	hi = 0;
+
+	ip = ip_start;
+
+	while (ip <= ip_end)
+	{
+		pos = ip - ip_start;
+		ip = DecodeOpcode(&thisOp, ip);
+
+		if (state[pos] != SP_KNOWN)
+			continue;
+
+		switch (thisOp.op)
+		{
+			case _LDW:	size = 4;	base = thisOp.rs;	break;
+			case _LDH:	size = 2;	base = thisOp.rs;	break;
+			case _LDB:	size = 1;	base = thisOp.rs;	break;
+			case _STW:	size = 4;	base = thisOp.rd;	break;
+			case _STH:	size = 2;	base = thisOp.rd;	break;
+			case _STB:	size = 1;	base = thisOp.rd;	break;
+			default:	size = 0;	base = 0;			break;
+		}
+
+		if (base != REG_sp)
+			continue;
+
+		addr = offset[pos] + thisOp.imm;
+
+		// Masking would round an unaligned access down
+
+		if (addr % size)
+			continue;
+
+		if (CppSpCheckLen == 0 || addr < lo)
+			lo = addr;
+
+		if (CppSpCheckLen == 0 || addr + size > hi)
+			hi = addr + size;
+
+		CppSpCheckLen = hi - lo;
+		CppSpSafe[pos] = 1;
+	}
+
+	DisposePtr(state);
+	DisposePtr((char *) offset);
+
+	CppSpCheckLo = lo;
+
+	// Keep the check simple: the range is far smaller than any data segment
+
+	if (CppSpCheckLen > 0x10000)
+	{
+		DisposePtr(CppSpSafe);
+		CppSpSafe = 0;
+		CppSpCheckLen = 0;
+	}
+}
+
+//****************************************
+//
+//****************************************
+
+int CppSpAccessIsSafe(OpcodeInfo *theOp)
+{
+	int pos;
+
+	if (!CppSpSafe)
+		return 0;
+
+	pos = theOp->rip - CppSpSafeStart;
+
+	if (pos < 0 || pos >= CppSpSafeLen)
+		return 0;
+
+	return CppSpSafe[pos];
+}
+
 //****************************************
 //		Disassemble Function
 //****************************************
@@ -980,6 +1338,7 @@ void RebuildCppProlog(SYMBOL *sym, int isproto)
 
 	int param_count;
 	int need_comma;
+	int uses_mem;
 	int n;
 
 	// Find registers used in function
@@ -1104,6 +1463,25 @@ void RebuildCppProlog(SYMBOL *sym, int isproto)
 		RebuildEmit(";\n\n");
 	}
 
+	CppLocalSp = REGUSED(funcprop.reg_used, REG_sp) != 0;
+	CppLocalSpDirty = 0;
+	CppLocalSpStored = 0;
+
+	uses_mem = CppFunctionUsesMemory(sym);
+
+	if (CppLocalSp)
+		RebuildEmit("\tint sp = ::sp;\n");
+
+	if (uses_mem)
+		RebuildEmit("\tunsigned char *mem_ds = ::mem_ds;\n");
+
+	CppFindSafeStackAccesses(sym, uses_mem);
+
+	if (CppSpCheckLen)
+		RebuildEmit("\tCHECK_STACK(%d, %d);\n", CppSpCheckLo, CppSpCheckLen);
+
+	if (CppLocalSp || uses_mem)
+		RebuildEmit("\n");
 }
 
 //****************************************
@@ -1117,6 +1495,18 @@ void RebuildCppEpilog(SYMBOL *sym)
 	if (ReturnCount > 0)
 		RebuildEmit("label_0:;\n");
 
+	// sp is back where it was on entry, and callers may read it
+	if (CppLocalSpStored)
+		RebuildEmit("	::sp = sp;\n");
+
+	CppLocalSp = 0;
+
+	if (CppSpSafe)
+	{
+		DisposePtr(CppSpSafe);
+		CppSpSafe = 0;
+	}
+
 	CppDecodeReturn(1);
 	RebuildEmit("\n");
 
@@ -1185,6 +1575,9 @@ void RebuildCppFunc(SYMBOL *sym, int isproto)
 				RebuildEmit("// %s_%d:\n", ref->Name, ref->LocalScope);
 #endif
 				RebuildEmit("label_%d:;\n", ref->LabelEnum);
+
+				// Jumped to from anywhere
+				CppLocalSpDirty = 1;
 			}
 		}
 
@@ -1202,6 +1595,9 @@ void RebuildCppFunc(SYMBOL *sym, int isproto)
 
 		RebuildCppInst(&thisOp);
 
+		if (thisOp.op == _PUSH || thisOp.op == _POP || thisOp.rd == REG_sp)
+			CppLocalSpDirty = 1;
+
 //		DecodeAsmString(&thisOp, str);
 //		RebuildEmit("\t%s", str);
 
@@ -1395,6 +1791,27 @@ void RebuildCpp_EmitDS()
 //
 //****************************************
 
+// FNV-1a hash of the data section, used by native modules
+// to check that they were built from the program being run.
+
+uint CppDataHash()
+{
+	uint hash = 2166136261u;
+	int n;
+
+	for (n=0;n<DataIP;n++)
+	{
+		hash ^= ArrayGet(&DataMemArray, n) & 0xff;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+//****************************************
+//
+//****************************************
+
 void RebuildCpp_StartUp()
 {
 	SYMBOL *ep;
@@ -1425,7 +1842,8 @@ void RebuildCpp_StartUp()
 	RebuildEmit("#define ds_len  %d\n", DataIP);
 	RebuildEmit("#define bs_len  %d\n", BssIP);
 	RebuildEmit("#define all_len %d\n", (BssIP + DataIP));
-	RebuildEmit("#define max_data %d\n\n", MaxDataIP);
+	RebuildEmit("#define max_data %d\n", MaxDataIP);
+	RebuildEmit("#define ds_hash 0x%08x\n\n", CppDataHash());
 
 //	RebuildEmit("int *mem_ds;\n");
 
@@ -1562,6 +1980,51 @@ void RebuildCpp_EmitExtensionsProto()
 	}
 }
 
+//****************************************
+//	 Syscall thunks for native modules
+//****************************************
+
+// Runtimes that load the generated code as a native module
+// define AOT_SYSCALL, and every syscall goes through it by number,
+// so that the module uses the same syscall bindings as the interpreter.
+
+void RebuildCpp_EmitAotSyscalls()
+{
+	SYMBOL *sym;
+	int len = sizeof(CppSyscallUsed);
+	int param_count;
+	int n, p;
+
+	RebuildEmit("#ifdef AOT_SYSCALL\n");
+
+	for (n=0;n<len;n++)
+	{
+		sym = FindSysCall(n);
+
+		if (!sym)
+			continue;
+
+		param_count = sym->Params;
+
+		if (param_count > 4)
+			param_count = 4;
+
+		RebuildEmit("static inline int wrap_%s(", &sym->Name[1]);
+
+		for (p=0;p<param_count;p++)
+			RebuildEmit("%sint %s", p ? ", " : "", Cpp_reg[REG_i0 + p]);
+
+		RebuildEmit(") { return AOT_SYSCALL(%d", n);
+
+		for (p=0;p<4;p++)
+			RebuildEmit(", %s", p < param_count ? Cpp_reg[REG_i0 + p] : "0");
+
+		RebuildEmit("); }\n");
+	}
+
+	RebuildEmit("#endif\n\n");
+}
+
 //****************************************
 //
 //****************************************
@@ -1594,6 +2057,8 @@ void RebuildCpp_Main()
 	RebuildEmit("#include \"mstypeinfo.h\"\n");
 	RebuildEmit("\n");
 
+	RebuildCpp_EmitAotSyscalls();
+
 #if 0			//My Testing only
 	RebuildCpp_EmitExtensionsProto();
 #endif
@@ -636,7 +636,10 @@ int WriteLibrarian(char *outfile)
 	SrcFile = fopen(outfile,"wb");
 
 	if (!SrcFile)
+	{
+		gDisposePtr(cptrtop);
 		return 0;
+	}
 
 	thisObj.dsize = SourceIdx;
 
@@ -664,17 +667,29 @@ int WriteLibrarian(char *outfile)
 		
 		res = fwrite(&head, 1, sizeof(head), SrcFile);
 		if(res != sizeof(head))
+		{
+			gDisposePtr(cptrtop);
+			fclose(SrcFile);
 			return 0;
+		}
 
 		// Save object header
 		res = fwrite(&thisObj, 1, sizeof(thisObj), SrcFile);
 		if(res != sizeof(thisObj))
+		{
+			gDisposePtr(cptrtop);
+			fclose(SrcFile);
 			return 0;
+		}
 
 		// Save the data
 		res = fwrite(cptr, 1, thisObj.csize, SrcFile);
-		if(res != sizeof(thisObj.csize))
+		if(res != thisObj.csize)
+		{
+			gDisposePtr(cptrtop);
+			fclose(SrcFile);
 			return 0;
+		}
 	}
 	
 	gDisposePtr(cptrtop);
@@ -257,6 +257,21 @@ int main(int argc,char *argv[])
 			continue;
 		}
 
+		if (Token("layout-profile="))
+		{
+			ArgLayoutProfile = 1;
+			GetCmdString();
+			strcpy(LayoutProfileName, Name);
+			continue;
+		}
+
+		if (Token("layout-sld="))
+		{
+			GetCmdString();
+			strcpy(LayoutSldName, Name);
+			continue;
+		}
+
 		if (Token("stabs="))
 		{
 			ArgUseStabs = 1;
@@ -301,6 +316,12 @@ int main(int argc,char *argv[])
 			continue;
 		}
 
+		if (Token("inline"))
+		{
+			ArgInline = 1;
+			continue;
+		}
+
 		if (Token("dump-syms"))
 		{
 			Do_Dump_Symbols = 1;
@@ -531,6 +552,12 @@ int main(int argc,char *argv[])
 		ExitApp(1);
 	}
 
+	if (ArgLayoutProfile && (!Do_Elimination || !LayoutSldName[0]))
+	{
+		printf("-layout-profile needs -elim and -layout-sld\n");
+		ExitApp(1);
+	}
+
 //--------------------------------
 //		Get ENV settings
 //--------------------------------
@@ -742,6 +769,9 @@ Build application (-B) options:\n\
   -sld=file            output source/line translation\n\
   -stabs=file          output debug information\n\
   -elim                eliminate unreferenced code/data\n\
+  -inline              with -elim, inline small leaf functions\n\
+  -layout-profile=file with -elim, order functions by this instruction profile\n\
+  -layout-sld=file     the sld file of the program that was profiled\n\
   -no-verify           prevent code verification\n\
   -java                build a Java class file\n\
   -gcj=flags           for -java option: set flags for GCJ\n\
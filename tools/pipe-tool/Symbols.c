@@ -24,6 +24,8 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include "compile.h"
 #include <assert.h>
 
+#include "../../runtimes/cpp/core/sldIndex.h"
+
 #define USE_HASHING
 
 //****************************************
@@ -1457,6 +1459,7 @@ void DumpIPTrans()
 
 	fprintf(SldFile, "Files\n");
 
+	SldIndexInitFiles();
 
 	do
 	{
@@ -1500,6 +1503,7 @@ void DumpIPTrans()
 			temp[j] = 0;
 
 			fprintf(SldFile, "%d:%d:%s\n", Sym->Value, Sym->Type, temp);
+			SldIndexSetFile(Sym->Value, Sym->Type, temp);
 		}
 
 		Sym++;
@@ -1508,18 +1512,21 @@ void DumpIPTrans()
 
 	fprintf(SldFile, "SLD\n");
 
-	if (!SLD_Line_Array.array)
-		return;
+	// Without line info the line table is left empty, but the rest
+	// of the file and the index are still written.
 
-	for (n=SLD_Line_Array.lo;n<SLD_Line_Array.hi+1;n++)
+	if (SLD_Line_Array.array)
 	{
+		for (n=SLD_Line_Array.lo;n<SLD_Line_Array.hi+1;n++)
+		{
 
-		line = ArrayGet(&SLD_Line_Array, n);
-		file= ArrayGet(&SLD_File_Array, n);
+			line = ArrayGet(&SLD_Line_Array, n);
+			file= ArrayGet(&SLD_File_Array, n);
 
-		if (line)
-		{
-			fprintf(SldFile, "%x:%d:%d\n", n, line, file);
+			if (line)
+			{
+				fprintf(SldFile, "%x:%d:%d\n", n, line, file);
+			}
 		}
 	}
 
@@ -1531,9 +1538,351 @@ void DumpIPTrans()
 	fprintf(SldFile, "END\n");
 
 	fclose(SldFile);
+
+	DumpSLDIndex();
 	return;
 }
 
+//****************************************
+//		SLD binary index
+//****************************************
+
+// See runtimes/cpp/core/sldIndex.h for the format.
+
+static char **SldIndexFileNames = 0;
+static int *SldIndexFileScopes = 0;
+static int SldIndexFileCount = 0;
+
+static char *SldIndexStrings = 0;
+static int SldIndexStringsSize = 0;
+static int SldIndexStringsAlloc = 0;
+
+void SldIndexInitFiles()
+{
+	char IndexName[256 + 8];
+
+	// Never leave a stale index behind if we fail to write a new one.
+	sprintf(IndexName, "%s.idx", SldName);
+	remove(IndexName);
+
+	SldIndexFileCount = Current_SLD_FileNo;
+	SldIndexFileNames = (char **) NewPtrClear(sizeof(char *) * (SldIndexFileCount + 1));
+	SldIndexFileScopes = (int *) NewPtrClear(sizeof(int) * (SldIndexFileCount + 1));
+}
+
+void SldIndexSetFile(int file, int scope, char *name)
+{
+	if (file < 0 || file >= SldIndexFileCount)
+		return;
+
+	SldIndexFileNames[file] = NewPtr(strlen(name) + 1);
+	strcpy(SldIndexFileNames[file], name);
+	SldIndexFileScopes[file] = scope;
+}
+
+int SldIndexAddString(char *str)
+{
+	int len = strlen(str) + 1;
+	int offset = SldIndexStringsSize;
+
+	if (SldIndexStringsSize + len > SldIndexStringsAlloc)
+	{
+		SldIndexStringsAlloc = (SldIndexStringsSize + len) * 2;
+		SldIndexStrings = (char *) realloc(SldIndexStrings, SldIndexStringsAlloc);
+
+		if (!SldIndexStrings)
+			Error(Error_Fatal, "Out of memory in SLD index\n");
+	}
+
+	memcpy(SldIndexStrings + offset, str, len);
+	SldIndexStringsSize += len;
+	return offset;
+}
+
+int SldIndexCompareLineByFile(const void *a, const void *b)
+{
+	const SLD_INDEX_LINE *la = (const SLD_INDEX_LINE *) a;
+	const SLD_INDEX_LINE *lb = (const SLD_INDEX_LINE *) b;
+
+	if (la->file != lb->file)
+		return la->file - lb->file;
+	if (la->line != lb->line)
+		return la->line - lb->line;
+	return la->ip - lb->ip;
+}
+
+int SldIndexCompareFunction(const void *a, const void *b)
+{
+	return ((const SLD_INDEX_FUNCTION *) a)->start - ((const SLD_INDEX_FUNCTION *) b)->start;
+}
+
+int SldIndexHashSize(int count)
+{
+	int size = 1;
+
+	while (size < count * 2)
+		size <<= 1;
+
+	return size;
+}
+
+void SldIndexHashInsert(int *table, int size, unsigned int hash, int index)
+{
+	int slot = hash & (size - 1);
+
+	while (table[slot] >= 0)
+		slot = (slot + 1) & (size - 1);
+
+	table[slot] = index;
+}
+
+int SldIndexFileFromScope(int scope)
+{
+	int n;
+
+	for (n=0;n<SldIndexFileCount;n++)
+	{
+		if (SldIndexFileNames[n] && SldIndexFileScopes[n] == scope)
+			return n;
+	}
+
+	return -1;
+}
+
+void DumpSLDIndex()
+{
+	SLD_INDEX_HEADER header;
+	SLD_INDEX_FILE *files;
+	SLD_INDEX_LINE *lines, *linesByFile;
+	SLD_INDEX_FUNCTION *functions;
+	SLD_INDEX_VARIABLE *variables;
+	int *functionHash, *variableHash;
+	int nLines = 0, nFunctions = 0, nVariables = 0;
+	char IndexName[256 + 8];
+	FILE *out;
+	SYMBOL *Sym;
+	uint n;
+	int i, offset;
+
+	sprintf(IndexName, "%s.idx", SldName);
+
+	SldIndexStringsSize = 0;
+	SldIndexAddString("");
+
+	// Files
+
+	files = (SLD_INDEX_FILE *) NewPtrClear(sizeof(SLD_INDEX_FILE) * (SldIndexFileCount + 1));
+
+	for (i=0;i<SldIndexFileCount;i++)
+	{
+		files[i].scope = SldIndexFileScopes[i];
+		files[i].name = SldIndexFileNames[i] ? SldIndexAddString(SldIndexFileNames[i]) : 0;
+	}
+
+	// Lines, already in ip order
+
+	if (SLD_Line_Array.array)
+	{
+		for (n=SLD_Line_Array.lo;n<SLD_Line_Array.hi+1;n++)
+			if (ArrayGet(&SLD_Line_Array, n))
+				nLines++;
+	}
+
+	lines = (SLD_INDEX_LINE *) NewPtrClear(sizeof(SLD_INDEX_LINE) * (nLines + 1));
+	linesByFile = (SLD_INDEX_LINE *) NewPtrClear(sizeof(SLD_INDEX_LINE) * (nLines + 1));
+
+	if (nLines)
+	{
+		i = 0;
+
+		for (n=SLD_Line_Array.lo;n<SLD_Line_Array.hi+1;n++)
+		{
+			int line = ArrayGet(&SLD_Line_Array, n);
+
+			if (line)
+			{
+				lines[i].ip = n;
+				lines[i].line = line;
+				lines[i].file = ArrayGet(&SLD_File_Array, n);
+				i++;
+			}
+		}
+
+		memcpy(linesByFile, lines, sizeof(SLD_INDEX_LINE) * nLines);
+		qsort(linesByFile, nLines, sizeof(SLD_INDEX_LINE), SldIndexCompareLineByFile);
+	}
+
+	// Functions, selected like DumpFunctions()
+
+	Sym = SymTab;
+	n = SYMMAX;
+
+	do
+	{
+		if (((Sym->LabelType == label_Function) || (Sym->LabelType == label_Virtual))
+			&& (Sym->Section == section_Enum) && (Sym->Type != SECT_null))
+			nFunctions++;
+
+		Sym++;
+	}
+	while(--n);
+
+	functions = (SLD_INDEX_FUNCTION *) NewPtrClear(sizeof(SLD_INDEX_FUNCTION) * (nFunctions + 1));
+
+	i = 0;
+	Sym = SymTab;
+	n = SYMMAX;
+
+	do
+	{
+		if (((Sym->LabelType == label_Function) || (Sym->LabelType == label_Virtual))
+			&& (Sym->Section == section_Enum) && (Sym->Type != SECT_null))
+		{
+			functions[i].start = Sym->Value;
+			functions[i].stop = Sym->EndIP;
+			functions[i].name = SldIndexAddString(Sym->Name[0] == '_' ? Sym->Name + 1 : Sym->Name);
+			i++;
+		}
+
+		Sym++;
+	}
+	while(--n);
+
+	qsort(functions, nFunctions, sizeof(SLD_INDEX_FUNCTION), SldIndexCompareFunction);
+
+	header.functionHashSize = SldIndexHashSize(nFunctions);
+	functionHash = (int *) NewPtr(sizeof(int) * header.functionHashSize);
+	memset(functionHash, -1, sizeof(int) * header.functionHashSize);
+
+	for (i=0;i<nFunctions;i++)
+		SldIndexHashInsert(functionHash, header.functionHashSize,
+			SldIndexHash(SldIndexStrings + functions[i].name, 0), i);
+
+	// Variables, selected like DumpVariables() and loadSLD()
+
+	Sym = SymTab;
+	n = SYMMAX;
+
+	do
+	{
+		if(Sym->LabelType == label_Local && Sym->Section == section_Enum &&
+			(Sym->Type == SECT_data || Sym->Type == SECT_bss) &&
+			strchr(Sym->Name, '.') == 0 && Sym->Name[0] == '_')
+			nVariables++;
+
+		Sym++;
+	}
+	while(--n);
+
+	variables = (SLD_INDEX_VARIABLE *) NewPtrClear(sizeof(SLD_INDEX_VARIABLE) * (nVariables + 1));
+
+	i = 0;
+	Sym = SymTab;
+	n = SYMMAX;
+
+	do
+	{
+		if(Sym->LabelType == label_Local && Sym->Section == section_Enum &&
+			(Sym->Type == SECT_data || Sym->Type == SECT_bss) &&
+			strchr(Sym->Name, '.') == 0 && Sym->Name[0] == '_')
+		{
+			int file = SldIndexFileFromScope(Sym->LocalScope);
+
+			if (file >= 0)
+			{
+				variables[i].scope = file;
+				variables[i].start = Sym->Value;
+
+				if(Sym->Type == SECT_bss)
+					variables[i].start += MaxDataIP;
+
+				variables[i].name = SldIndexAddString(Sym->Name + 1);
+				i++;
+			}
+		}
+
+		Sym++;
+	}
+	while(--n);
+
+	nVariables = i;
+
+	header.variableHashSize = SldIndexHashSize(nVariables);
+	variableHash = (int *) NewPtr(sizeof(int) * header.variableHashSize);
+	memset(variableHash, -1, sizeof(int) * header.variableHashSize);
+
+	for (i=0;i<nVariables;i++)
+		SldIndexHashInsert(variableHash, header.variableHashSize,
+			SldIndexHash(SldIndexStrings + variables[i].name, variables[i].scope), i);
+
+	// Layout
+
+	offset = sizeof(SLD_INDEX_HEADER);
+
+	header.magic = SLD_INDEX_MAGIC;
+	header.version = SLD_INDEX_VERSION;
+	header.nFiles = SldIndexFileCount;
+	header.filesOffset = offset;
+	offset += sizeof(SLD_INDEX_FILE) * SldIndexFileCount;
+	header.nLines = nLines;
+	header.linesOffset = offset;
+	offset += sizeof(SLD_INDEX_LINE) * nLines;
+	header.linesByFileOffset = offset;
+	offset += sizeof(SLD_INDEX_LINE) * nLines;
+	header.nFunctions = nFunctions;
+	header.functionsOffset = offset;
+	offset += sizeof(SLD_INDEX_FUNCTION) * nFunctions;
+	header.functionHashOffset = offset;
+	offset += sizeof(int) * header.functionHashSize;
+	header.nVariables = nVariables;
+	header.variablesOffset = offset;
+	offset += sizeof(SLD_INDEX_VARIABLE) * nVariables;
+	header.variableHashOffset = offset;
+	offset += sizeof(int) * header.variableHashSize;
+	header.stringsSize = SldIndexStringsSize;
+	header.stringsOffset = offset;
+
+	out = fopen(IndexName, "wb");
+
+	if (!out)
+	{
+		printf("Failed to create source line index '%s'\n", IndexName);
+	}
+	else
+	{
+		fwrite(&header, sizeof(SLD_INDEX_HEADER), 1, out);
+		fwrite(files, sizeof(SLD_INDEX_FILE), SldIndexFileCount, out);
+		fwrite(lines, sizeof(SLD_INDEX_LINE), nLines, out);
+		fwrite(linesByFile, sizeof(SLD_INDEX_LINE), nLines, out);
+		fwrite(functions, sizeof(SLD_INDEX_FUNCTION), nFunctions, out);
+		fwrite(functionHash, sizeof(int), header.functionHashSize, out);
+		fwrite(variables, sizeof(SLD_INDEX_VARIABLE), nVariables, out);
+		fwrite(variableHash, sizeof(int), header.variableHashSize, out);
+		fwrite(SldIndexStrings, 1, SldIndexStringsSize, out);
+		fclose(out);
+	}
+
+	for (i=0;i<SldIndexFileCount;i++)
+		if (SldIndexFileNames[i])
+			DisposePtr(SldIndexFileNames[i]);
+
+	DisposePtr((char *) SldIndexFileNames);
+	DisposePtr((char *) SldIndexFileScopes);
+	DisposePtr((char *) files);
+	DisposePtr((char *) lines);
+	DisposePtr((char *) linesByFile);
+	DisposePtr((char *) functions);
+	DisposePtr((char *) functionHash);
+	DisposePtr((char *) variables);
+	DisposePtr((char *) variableHash);
+	free(SldIndexStrings);
+
+	SldIndexFileNames = 0;
+	SldIndexFileScopes = 0;
+	SldIndexStrings = 0;
+	SldIndexStringsAlloc = 0;
+}
+
 
 //****************************************
 //		Dump Function Table
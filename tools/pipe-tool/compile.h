@@ -614,6 +614,32 @@ typedef struct
 	TreeEntry *current;
 } TreeArray;
 
+// Profile guided layout, see CodeRebuild.c
+
+typedef struct
+{
+	char	*Name;
+	int		Start;
+	int		End;
+	double	Count;
+} ProfileFunc;
+
+typedef struct
+{
+	SYMBOL	*Sym;
+	int		Index;
+	int		Group;		// 0 hot, 1 unprofiled, 2 cold
+	double	Count;
+} LayoutFunc;
+
+// Inlining, see CodeRebuild.c
+
+typedef struct
+{
+	int		DropPushPop;	// the save/restore of the pushed registers is removed
+	int		Rename[32];		// and they are renamed to free scratch registers
+} InlineInfo;
+
 //****************************************
 //		  Some useful defines
 //****************************************
@@ -748,12 +774,16 @@ decset(int ArgSkipElim, 0)
 decset(int ArgSLD, 0)
 decset(int ArgUseStabs, 0)
 decset(int ArgWriteMeta, 0)
+decset(int ArgLayoutProfile, 0)
+decset(int ArgInline, 0)
 
 decset(int ArgQuiet, 0)
 
 dec(char SldName[256])
 dec(char StabsName[256])
 dec(char MetaFileName[256])
+dec(char LayoutProfileName[256])
+dec(char LayoutSldName[256])
 
 decset(int ArgUseMasterDump, 0)
 
@@ -23,6 +23,17 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #define WSHORT(xx,yy)	RSHORT(xx) = yy
 #define WBYTE(xx,yy)	RBYTE(xx) = yy
 
+// Stack accesses that pipe-tool has found to be in range. Nothing is masked here.
+#define RINT_SP(xx) 	RINT(xx)
+#define RSHORT_SP(xx) 	RSHORT(xx)
+#define RBYTE_SP(xx) 	RBYTE(xx)
+
+#define WINT_SP(xx,yy)		WINT(xx,yy)
+#define WSHORT_SP(xx,yy)	WSHORT(xx,yy)
+#define WBYTE_SP(xx,yy)		WBYTE(xx,yy)
+
+#define CHECK_STACK(lo, len)
+
 //#define SXSHORT(xx) (int)((short)(xx))
 //#define SXBYTE(xx) (int)((char)(xx))
 #define SXSHORT(xx) ((((xx) & 0x8000) == 0) ? ((xx) & 0xFFFF) : ((xx) | ~0xFFFF))
@@ -88,9 +88,10 @@ int main(int argc,char *argv[]) {
 		}
 	}
 
-	resources.writeResources(lstFile);
-	if (!generateOnly) {
-		string resFile = resources.parseLST(lstFile, outputDir);
+	if (generateOnly) {
+		resources.writeLST(lstFile);
+	} else {
+		resources.compileResources(outputDir);
 	}
 
 	return 0;
@@ -49,6 +49,13 @@ void ResourceDirective::writeDirectives(ostringstream& output, bool asVariant) {
 	}
 }
 
+void ResourceDirective::initEntry(ResourceEntry& entry, bool asVariant) {
+	entry.type = getResourceTypeAsInt();
+	if (!asVariant) {
+		entry.name = fId;
+	}
+}
+
 void ResourceDirective::initDirectiveFromAttributes(const char** attributes) {
 	const char* id = findAttr(ATTR_ID, attributes);
 	if (id) {
@@ -112,10 +119,6 @@ LoadType ResourceDirective::getLoadType() {
 	return fLoadType;
 }
 
-string ResourceDirective::getUniqueToken() {
-	return string();
-}
-
 void FileResourceDirective::setResource(string resource) {
 	fResource = resource;
 }
@@ -131,6 +134,27 @@ void FileResourceDirective::writeDirectives(ostringstream& output, bool asVarian
 	writeResourceTypeDirective(output);
 }
 
+void FileResourceDirective::initEntry(ResourceEntry& entry, bool asVariant) {
+	ResourceDirective::initEntry(entry, asVariant);
+	entry.path = getResourcePath();
+}
+
+// Resources are relative to the file they were declared in,
+// just like the .lfile directive makes them for pipe-tool.
+string FileResourceDirective::getResourcePath() {
+	size_t lastSeparator = fFile.find_last_of("/\\");
+	if (lastSeparator == string::npos) {
+		return fResource;
+	}
+	string path = fFile.substr(0, lastSeparator + 1);
+	for (size_t i = 0; i < path.length(); i++) {
+		if (path[i] == '\\') {
+			path[i] = '/';
+		}
+	}
+	return path + fResource;
+}
+
 void FileResourceDirective::writeResourceTypeDirective(ostringstream& output) {
 	string resourceStr = string("\"") + fResource + string("\"");
 	if (fUseIncludeDirective) {
@@ -156,10 +180,6 @@ string FileResourceDirective::validate() {
 	return ResourceDirective::validate();
 }
 
-string FileResourceDirective::getUniqueToken() {
-	return fResource + "|" + fFile;
-}
-
 void MediaResourceDirective::writeResourceTypeDirective(ostringstream& output) {
 	if (!fUseIncludeDirective) {
 		output << ".media \"" << getMimeType() << "\",\"" << fResource << "\"\n";
@@ -168,6 +188,15 @@ void MediaResourceDirective::writeResourceTypeDirective(ostringstream& output) {
 	}
 }
 
+void MediaResourceDirective::initEntry(ResourceEntry& entry, bool asVariant) {
+	FileResourceDirective::initEntry(entry, asVariant);
+	if (!fUseIncludeDirective) {
+		// The mime type is stored first, with its terminating null.
+		string mimeType = getMimeType();
+		entry.data.assign(mimeType.c_str(), mimeType.length() + 1);
+	}
+}
+
 string MediaResourceDirective::getMimeType() {
 	if (!fMimeType.empty()) {
 		return fMimeType;
@@ -235,20 +264,26 @@ void StringResourceDirective::writeDirectives(ostringstream& output, bool asVari
 	}
 }
 
+void StringResourceDirective::initEntry(ResourceEntry& entry, bool asVariant) {
+	ResourceDirective::initEntry(entry, asVariant);
+	entry.data = fStringValue;
+}
+
 void StringResourceDirective::initDirectiveFromCData(const char* cdata, int length) {
 	// O(n^2)
 	fStringValue += string(cdata, length);
 }
 
-string StringResourceDirective::getUniqueToken() {
-	return fStringValue;
-}
-
 void PlaceholderDirective::writeDirectives(ostringstream& output, bool asVariant) {
 	ResourceDirective::writeDirectives(output, asVariant);
 	output << '.' << fResType << '\n';
 }
 
+void PlaceholderDirective::initEntry(ResourceEntry& entry, bool asVariant) {
+	ResourceDirective::initEntry(entry, asVariant);
+	entry.type = ResType_PlaceHolder;
+}
+
 string AudioResourceDirective::validate() {
 	string mimeType = getMimeType();
 	if (mimeType.length() < 5 || mimeType.substr(0, 5) != "audio") {
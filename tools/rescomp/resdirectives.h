@@ -20,6 +20,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 
 #include <sstream>
 #include <string>
+#include "reswriter.h"
 
 enum LoadType { LoadType_Startup, LoadType_Unloaded };
 
@@ -60,9 +61,9 @@ public:
 	LoadType getLoadType();
 	virtual int getResourceTypeAsInt() { return ResType_Binary; }
 	virtual void writeDirectives(ostringstream& output, bool asVariant);
+	virtual void initEntry(ResourceEntry& entry, bool asVariant);
 	virtual void initDirectiveFromAttributes(const char **attributes);
 	virtual void initDirectiveFromCData(const char* cdata, int length);
-	virtual string getUniqueToken();
 	virtual string validate();
 	void setFile(string file);
 	string getFile();
@@ -81,8 +82,9 @@ public:
 	FileResourceDirective(const char* resType, bool useIncludeDirective)
 		: ResourceDirective(resType) { fUseIncludeDirective = useIncludeDirective; }
 	void setResource(string resource);
-	string getUniqueToken();
+	string getResourcePath();
 	virtual void writeDirectives(ostringstream& output, bool asVariant);
+	virtual void initEntry(ResourceEntry& entry, bool asVariant);
 	virtual void writeResourceTypeDirective(ostringstream& output);
 	virtual void initDirectiveFromAttributes(const char **attributes);
 	virtual string validate();
@@ -108,6 +110,7 @@ public:
 	void setMimeType(string mimeType);
 	virtual string getMimeType();
 	void writeResourceTypeDirective(ostringstream& output);
+	void initEntry(ResourceEntry& entry, bool asVariant);
 	virtual void initDirectiveFromAttributes(const char **attributes);
 	virtual string validate();
 };
@@ -125,14 +128,15 @@ private:
 public:
 	StringResourceDirective() : ResourceDirective("string") { }
 	void writeDirectives(ostringstream& output, bool asVariant);
+	void initEntry(ResourceEntry& entry, bool asVariant);
 	void initDirectiveFromCData(const char* cdata, int length);
-	string getUniqueToken();
 };
 
 class PlaceholderDirective : public ResourceDirective {
 public:
 	PlaceholderDirective() : ResourceDirective("placeholder") { }
 	void writeDirectives(ostringstream& output, bool asVariant);
+	void initEntry(ResourceEntry& entry, bool asVariant);
 	int getResourceType() { return ResType_PlaceHolder; }
 };
 
@@ -0,0 +1,326 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include "reswriter.h"
+
+#ifdef WIN32
+#include <windows.h>
+#define THREAD_ENTRY(name, arg) unsigned long __stdcall name(void *arg)
+#else
+#include <pthread.h>
+#define THREAD_ENTRY(name, arg) void *name(void *arg)
+#endif
+
+#define COPY_BUFFER_SIZE (64 * 1024)
+#define MAX_HASH_THREADS 8
+
+using namespace std;
+
+// FNV-1a, 64-bit
+#define HASH_BASIS 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
+
+static unsigned long long hashBytes(unsigned long long hash, const char* bytes, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) bytes[i];
+		hash *= HASH_PRIME;
+	}
+	return hash;
+}
+
+static void hashResource(ResourceEntry* entry, char* buffer) {
+	entry->hash = hashBytes(HASH_BASIS, entry->data.data(), entry->data.length());
+	entry->fileSize = 0;
+	if (entry->path.empty()) {
+		return;
+	}
+	FILE* file = fopen(entry->path.c_str(), "rb");
+	if (!file) {
+		entry->fileSize = -1;
+		return;
+	}
+	size_t len;
+	while ((len = fread(buffer, 1, COPY_BUFFER_SIZE, file)) > 0) {
+		entry->hash = hashBytes(entry->hash, buffer, len);
+		entry->fileSize += len;
+	}
+	if (ferror(file)) {
+		entry->fileSize = -1;
+	}
+	fclose(file);
+}
+
+struct HashWorker {
+	vector<ResourceEntry*>* entries;
+	size_t first;
+	size_t step;
+};
+
+static void runHashWorker(HashWorker* worker) {
+	char* buffer = new char[COPY_BUFFER_SIZE];
+	vector<ResourceEntry*>& entries = *worker->entries;
+	for (size_t i = worker->first; i < entries.size(); i += worker->step) {
+		hashResource(entries[i], buffer);
+	}
+	delete[] buffer;
+}
+
+static THREAD_ENTRY(hashWorkerThread, arg) {
+	runHashWorker((HashWorker*) arg);
+	return 0;
+}
+
+void hashResources(vector<ResourceEntry*>& entries) {
+	HashWorker workers[MAX_HASH_THREADS];
+#ifdef WIN32
+	HANDLE threads[MAX_HASH_THREADS];
+#else
+	pthread_t threads[MAX_HASH_THREADS];
+#endif
+	bool started[MAX_HASH_THREADS];
+	size_t threadCount = entries.size() < MAX_HASH_THREADS ? entries.size() : MAX_HASH_THREADS;
+
+	for (size_t i = 0; i < threadCount; i++) {
+		workers[i].entries = &entries;
+		workers[i].first = i;
+		workers[i].step = threadCount;
+	}
+
+	// Worker 0 runs on this thread, and so do the workers
+	// whose threads could not be started.
+	for (size_t i = 1; i < threadCount; i++) {
+#ifdef WIN32
+		threads[i] = CreateThread(NULL, 0, hashWorkerThread, &workers[i], 0, NULL);
+		started[i] = threads[i] != NULL;
+#else
+		started[i] = pthread_create(&threads[i], NULL, hashWorkerThread, &workers[i]) == 0;
+#endif
+	}
+
+	if (threadCount > 0) {
+		runHashWorker(&workers[0]);
+	}
+
+	for (size_t i = 1; i < threadCount; i++) {
+		if (!started[i]) {
+			runHashWorker(&workers[i]);
+			continue;
+		}
+#ifdef WIN32
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+#else
+		pthread_join(threads[i], NULL);
+#endif
+	}
+}
+
+bool samePayload(ResourceEntry& a, ResourceEntry& b) {
+	if (a.fileSize < 0 || a.fileSize != b.fileSize || a.hash != b.hash || a.data != b.data) {
+		return false;
+	}
+	if (a.fileSize == 0 || a.path == b.path) {
+		return true;
+	}
+
+	// Hashes can collide, so we make sure.
+	FILE* fileA = fopen(a.path.c_str(), "rb");
+	FILE* fileB = fopen(b.path.c_str(), "rb");
+	bool same = fileA && fileB;
+	char* bufferA = new char[COPY_BUFFER_SIZE];
+	char* bufferB = new char[COPY_BUFFER_SIZE];
+	while (same) {
+		size_t lenA = fread(bufferA, 1, COPY_BUFFER_SIZE, fileA);
+		size_t lenB = fread(bufferB, 1, COPY_BUFFER_SIZE, fileB);
+		same = lenA == lenB && !memcmp(bufferA, bufferB, lenA);
+		if (lenA == 0) {
+			break;
+		}
+	}
+	delete[] bufferA;
+	delete[] bufferB;
+	if (fileA) {
+		fclose(fileA);
+	}
+	if (fileB) {
+		fclose(fileB);
+	}
+	return same;
+}
+
+int ResourceWriter::addResource(const ResourceEntry& entry) {
+	fEntries.push_back(entry);
+	return fEntries.size();
+}
+
+void ResourceWriter::addDependency(const string& path) {
+	fDependencies.push_back(path);
+}
+
+int ResourceWriter::getResourceCount() {
+	return fEntries.size();
+}
+
+static long getFileSize(const string& path) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return -1;
+	}
+	long size = -1;
+	if (!fseek(file, 0, SEEK_END)) {
+		size = ftell(file);
+	}
+	fclose(file);
+	return size;
+}
+
+static int getEncodedIntSize(unsigned int value) {
+	int size = 1;
+	while (value >= 128) {
+		value >>= 7;
+		size++;
+	}
+	return size;
+}
+
+// The same variable length encoding as pipe-tool's WriteEncodedInt().
+static void writeEncodedInt(FILE* file, unsigned int value) {
+	while (value >= 128) {
+		fputc(value & 0x7f, file);
+		value >>= 7;
+	}
+	fputc(value | 0x80, file);
+}
+
+// pipe-tool escapes spaces in dependency file names this way.
+static string escapeDependency(const string& path) {
+	string result;
+	for (size_t i = 0; i < path.length(); i++) {
+		if (path[i] == ' ') {
+			result += "__&NBSP;__";
+		} else {
+			result += path[i];
+		}
+	}
+	return result;
+}
+
+static string copyFile(FILE* output, const string& path, long size, char* buffer) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return "Error reading data file '" + path + "'";
+	}
+	long copied = 0;
+	size_t len;
+	while (copied < size && (len = fread(buffer, 1, COPY_BUFFER_SIZE, file)) > 0) {
+		if ((long) len > size - copied) {
+			len = size - copied;
+		}
+		fwrite(buffer, 1, len, output);
+		copied += len;
+	}
+	fclose(file);
+	if (copied != size) {
+		return "Data file '" + path + "' changed while it was being read";
+	}
+	return string();
+}
+
+string ResourceWriter::write(string output, string header, string deps) {
+	// The total size must be known before the resources are written.
+	unsigned int resLen = 0;
+	vector<unsigned int> sizes;
+	for (size_t i = 0; i < fEntries.size(); i++) {
+		ResourceEntry& entry = fEntries[i];
+		if (!entry.path.empty() && entry.fileSize < 0) {
+			entry.fileSize = getFileSize(entry.path);
+			if (entry.fileSize < 0) {
+				return "Error reading data file '" + entry.path + "'";
+			}
+		}
+		unsigned int size = entry.data.length() + (entry.path.empty() ? 0 : entry.fileSize);
+		sizes.push_back(size);
+		resLen += 1 + getEncodedIntSize(size) + size;
+	}
+
+	FILE* resFile = fopen(output.c_str(), "wb");
+	if (!resFile) {
+		return "Problem creating '" + output + "' file";
+	}
+	FILE* headerFile = fopen(header.c_str(), "w");
+	if (!headerFile) {
+		fclose(resFile);
+		return "Problem creating '" + header + "' file";
+	}
+
+	fwrite("MARS", 1, 4, resFile);
+	writeEncodedInt(resFile, fEntries.size());
+	writeEncodedInt(resFile, resLen);
+
+	string errorMsg;
+	char* buffer = new char[COPY_BUFFER_SIZE];
+	for (size_t i = 0; i < fEntries.size() && errorMsg.empty(); i++) {
+		ResourceEntry& entry = fEntries[i];
+		fputc(entry.type, resFile);
+		writeEncodedInt(resFile, sizes[i]);
+		fwrite(entry.data.data(), 1, entry.data.length(), resFile);
+		if (!entry.path.empty()) {
+			errorMsg = copyFile(resFile, entry.path, entry.fileSize, buffer);
+		}
+		if (entry.name.empty()) {
+			fprintf(headerFile, "//not defined %d\n", (int) i + 1);
+		} else {
+			fprintf(headerFile, "#define %s %d\n", entry.name.c_str(), (int) i + 1);
+		}
+	}
+	delete[] buffer;
+
+	fputc(0, resFile);
+	if (errorMsg.empty() && ferror(resFile)) {
+		errorMsg = "Could not write resources";
+	}
+	fclose(resFile);
+	fclose(headerFile);
+	if (!errorMsg.empty()) {
+		return errorMsg;
+	}
+
+	if (!deps.empty()) {
+		FILE* depsFile = fopen(deps.c_str(), "w");
+		if (!depsFile) {
+			return "Problem creating '" + deps + "' file";
+		}
+		fprintf(depsFile, "%s: \\\n", output.c_str());
+		for (size_t i = 0; i < fEntries.size(); i++) {
+			if (!fEntries[i].path.empty()) {
+				fprintf(depsFile, "\t%s \\\n", escapeDependency(fEntries[i].path).c_str());
+			}
+		}
+		for (size_t i = 0; i < fDependencies.size(); i++) {
+			fprintf(depsFile, "\t%s \\\n", escapeDependency(fDependencies[i]).c_str());
+		}
+		fprintf(depsFile, "\n\n");
+		fclose(depsFile);
+	}
+
+	printf("Wrote %d resources (%u bytes) to %s\n", (int) fEntries.size(), resLen, output.c_str());
+	return string();
+}
@@ -0,0 +1,65 @@
+/* Copyright (C) 2011 MoSync AB
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License, version 2, as published by
+the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, write to the Free
+Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.
+*/
+
+#ifndef RESWRITER_H_
+#define RESWRITER_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One resource, as it is stored in the resource file.
+// The payload is the inline data followed by the contents
+// of the file at path, if there is one.
+struct ResourceEntry {
+	ResourceEntry() : type(0), fileSize(-1), hash(0) { }
+	int type;
+	// The name written to MAHeaders.h, or empty.
+	string name;
+	string data;
+	string path;
+	// Set by hashResources(). fileSize is -1 if the file could not be read.
+	long fileSize;
+	unsigned long long hash;
+};
+
+// Computes the file size and payload hash of each entry,
+// reading the files on several threads.
+void hashResources(vector<ResourceEntry*>& entries);
+
+// Compares the payloads of two hashed entries byte by byte.
+bool samePayload(ResourceEntry& a, ResourceEntry& b);
+
+// Writes resources to a MARS file, in the same format as pipe-tool -R.
+// File contents are copied straight from disk, in chunks.
+class ResourceWriter {
+private:
+	vector<ResourceEntry> fEntries;
+	vector<string> fDependencies;
+public:
+	// Adds a resource and returns its index.
+	int addResource(const ResourceEntry& entry);
+	// Adds a file that the resources depend on without being stored,
+	// such as a deduplicated variant.
+	void addDependency(const string& path);
+	int getResourceCount();
+	// Returns an error message, or an empty string on success.
+	string write(string output, string header, string deps);
+};
+
+#endif /* RESWRITER_H_ */
@@ -15,7 +15,7 @@ work.instance_eval do
         @NAME = "rescomp"
         if(HOST==:linux || HOST==:darwin)
                 @IGNORED_FILES = ["WinmobileInjector.cpp", "ErrorCheck.cpp", "IconFileLoader.cpp"]
-                @LIBRARIES = ["expat"]
+                @LIBRARIES = ["expat", "pthread"]
         else    # win32
                 @CUSTOM_LIBS = ["libexpat.lib"]
         end
@@ -337,31 +337,6 @@ void VariantResourceSet::parseLSTX(string inputFile) {
 	delete state;
 }
 
-const char* mosyncdir() {
-	static const char* md = NULL;
-	if(!md) {
-		md	= getenv("MOSYNCDIR");
-		if(!md) {
-			printf("MOSYNCDIR is not set!\n");
-			exit(1);
-		}
-	}
-	return md;
-}
-
-string VariantResourceSet::parseLST(string lstFile, string outputDir) {
-	ostringstream pipetoolCmd;
-	string output = outputDir + "/resources";
-	string deps = outputDir + "/resources.deps";
-	pipetoolCmd << mosyncdir() << "/bin/pipe-tool -R -depend=\"" << deps << "\" \"" << output << "\" \"" << lstFile << "\"";
-	printf("%s\n", pipetoolCmd.str().c_str());
-	int res = system(pipetoolCmd.str().c_str());
-	if (res) {
-		error(NULL, "Resource compilation failed");
-	}
-	return output;
-}
-
 const char* getDefaultVariantAttr(const char* resourceType) {
 	if (!strcmp(RES_BINARY, resourceType)) {
 		return ATTR_PLATFORM;
@@ -534,16 +509,56 @@ void VariantResourceSet::setPlatform(string platform) {
 	VariantResourceSet::fPlatform = platform;
 }
 
-void VariantResourceSet::writeResources(string lstOutput) {
+void addLabelDirective(ostringstream& output, const char* label) {
+	output << ".label \"" << label << "\"\n";
+}
+
+// A variant resource and its entry, hashed before any
+// variant resource is written so that duplicates can be found.
+struct VariantResource {
+	string id;
+	string variant;
+	ResourceDirective* directive;
+	ResourceEntry entry;
+};
+
+static void addLabel(ResourceWriter& writer, ostringstream* lstOutput, const char* label, const string& data) {
+	ResourceEntry labelEntry;
+	labelEntry.type = ResType_Label;
+	labelEntry.data.assign(label, strlen(label) + 1);
+	writer.addResource(labelEntry);
+
+	ResourceEntry dataEntry;
+	dataEntry.type = ResType_Binary;
+	dataEntry.data = data;
+	writer.addResource(dataEntry);
+
+	if (lstOutput) {
+		*lstOutput << ".res\n";
+		addLabelDirective(*lstOutput, label);
+		*lstOutput << ".res\n";
+		*lstOutput << ".bin\n";
+		ResourceDirective::writeByteDirective(*lstOutput, data.data(), 0, data.length());
+	}
+}
+
+void VariantResourceSet::writeResources(ResourceWriter& writer, ostringstream* lstOutput) {
 	int resId = 1; // First resource.
 
-	ostringstream lstFileOutput;
-	lstFileOutput << "// This file has been generated by the ResComp tool\n";
+	if (lstOutput) {
+		*lstOutput << "// This file has been generated by the ResComp tool\n";
+	}
 
 	// First, we write all the placeholders.
 	vector<string> variantResIds = getAllVariantResIds();
 	for (vector<string>::const_iterator variantId = variantResIds.begin(); variantId != variantResIds.end(); variantId++) {
-		lstFileOutput << ".res " << (*variantId).c_str() << " // ID: " << resId << "\n.placeholder\n";
+		if (lstOutput) {
+			*lstOutput << ".res " << (*variantId).c_str() << " // ID: " << resId << "\n.placeholder\n";
+		}
+		ResourceEntry placeholder;
+		placeholder.type = ResType_PlaceHolder;
+		placeholder.name = *variantId;
+		writer.addResource(placeholder);
 		assignVirtualIndex(*variantId, resId);
 		assignResAndLoadType(resId, ResType_PlaceHolder, LoadType_Startup);
 		resId++;
@@ -555,55 +570,132 @@ void VariantResourceSet::writeResources(string lstOutput) {
 	for (vector<string>::const_iterator nonVariantResId = nonVariantResIds.begin(); nonVariantResId != nonVariantResIds.end(); nonVariantResId++) {
 		ResourceDirective* directive = getDirective(*nonVariantResId, string());
 		if (directive) {
-			directive->writeDirectives(lstFileOutput, false);
+			if (lstOutput) {
+				directive->writeDirectives(*lstOutput, false);
+			}
+			ResourceEntry entry;
+			directive->initEntry(entry, false);
+			writer.addResource(entry);
 			assignMappedIndex(*nonVariantResId, string(), resId);
 			assignResAndLoadType(resId, directive->getResourceTypeAsInt(), directive->getLoadType());
 			resId++;
 		}
 	}
 
-	lstFileOutput << "\n// *** End of non-variant resources\n\n";
+	if (lstOutput) {
+		*lstOutput << "\n// *** End of non-variant resources\n\n";
+	}
 
 	// Finally, we write the variant resources.
-	// The map here just makes sure that we don't
-	// write any file resource or string resource twice
-	map<string, int> cachedResources;
+	// Variants often share files or strings, so we hash all
+	// payloads up front and write each distinct one only once.
+	vector<VariantResource> variantResources;
 	vector<string> ids = getAllVariantResIds();
 	vector<string> variants = getAllVariants();
 	for(vector<string>::iterator id = ids.begin(); id != ids.end(); ++id) {
 		for (vector<string>::iterator variantIt = variants.begin(); variantIt != variants.end(); ++variantIt) {
 			ResourceDirective* directive = getDirective(*id, *variantIt);
 			if (directive) {
-				int resIdToUse = resId;
-				string uniqueToken = directive->getUniqueToken();
-				int cachedId = cachedResources[uniqueToken];
-				lstFileOutput << "// " << *id << " - " << getVariantStr(*variantIt) << '\n';
-				if (uniqueToken.length() > 0 && cachedId > 0) {
-					lstFileOutput << "// Using cached resource #" << cachedId << '\n';
-					resIdToUse = cachedId;
-				} else {
-					lstFileOutput << "// Resource #" << resIdToUse << '\n';
-					directive->writeDirectives(lstFileOutput, true);
-					cachedResources[uniqueToken] = resId;
-					resId++;
-				}
-				assignMappedIndex(*id, *variantIt, resIdToUse);
-				assignResAndLoadType(resIdToUse, directive->getResourceTypeAsInt(), directive->getLoadType());
+				VariantResource variantResource;
+				variantResource.id = *id;
+				variantResource.variant = *variantIt;
+				variantResource.directive = directive;
+				directive->initEntry(variantResource.entry, true);
+				variantResources.push_back(variantResource);
+			}
+		}
+	}
 
-				// We *must* have a fallback resource!
-				if (getDirective(*id, string()) == NULL) {
-					error(NULL, string("No fallback resource for id ") + *id);
-				}
+	vector<ResourceEntry*> entriesToHash;
+	for (size_t i = 0; i < variantResources.size(); i++) {
+		entriesToHash.push_back(&variantResources[i].entry);
+	}
+	hashResources(entriesToHash);
+
+	// Payload hash -> resources written with that hash
+	map<unsigned long long, vector<VariantResource*> > cachedResources;
+	map<VariantResource*, int> cachedIds;
+	for (size_t i = 0; i < variantResources.size(); i++) {
+		VariantResource& variantResource = variantResources[i];
+		ResourceDirective* directive = variantResource.directive;
+		int resAndLoadType = computeResAndLoadType(directive);
+		int resIdToUse = resId;
+		int cachedId = 0;
+		vector<VariantResource*>& candidates = cachedResources[variantResource.entry.hash];
+		for (size_t j = 0; j < candidates.size() && cachedId == 0; j++) {
+			VariantResource* candidate = candidates[j];
+			if (computeResAndLoadType(candidate->directive) == resAndLoadType &&
+					candidate->entry.type == variantResource.entry.type &&
+					samePayload(candidate->entry, variantResource.entry)) {
+				cachedId = cachedIds[candidate];
 			}
 		}
+		if (lstOutput) {
+			*lstOutput << "// " << variantResource.id << " - " << getVariantStr(variantResource.variant) << '\n';
+		}
+		if (cachedId > 0) {
+			if (lstOutput) {
+				*lstOutput << "// Using cached resource #" << cachedId << '\n';
+			}
+			if (!variantResource.entry.path.empty()) {
+				writer.addDependency(variantResource.entry.path);
+			}
+			resIdToUse = cachedId;
+		} else {
+			if (lstOutput) {
+				*lstOutput << "// Resource #" << resIdToUse << '\n';
+				directive->writeDirectives(*lstOutput, true);
+			}
+			writer.addResource(variantResource.entry);
+			candidates.push_back(&variantResource);
+			cachedIds[&variantResource] = resId;
+			resId++;
+		}
+		assignMappedIndex(variantResource.id, variantResource.variant, resIdToUse);
+		assignResAndLoadType(resIdToUse, directive->getResourceTypeAsInt(), directive->getLoadType());
+
+		// We *must* have a fallback resource!
+		if (getDirective(variantResource.id, string()) == NULL) {
+			error(NULL, string("No fallback resource for id ") + variantResource.id);
+		}
 	}
 
-	lstFileOutput << createResMap();
-	lstFileOutput << createResTypeList();
+	string resMap = createResMap();
+	if (!resMap.empty()) {
+		if (lstOutput) {
+			// Some debug info
+			*lstOutput << "/*\n";
+			*lstOutput << "\t" << variants.size() << " variants, " << ids.size() << " variant resources\n";
+			for (vector<string>::iterator variantIt = variants.begin(); variantIt != variants.end(); ++variantIt) {
+				*lstOutput << "\t" << getVariantStr(*variantIt) << "\n";
+			}
+			*lstOutput << "*/\n";
+		}
+		addLabel(writer, lstOutput, "variant-mapping", resMap);
+	}
+	addLabel(writer, lstOutput, "res-types", createResTypeList());
+}
+
+void VariantResourceSet::writeLST(string lstFile) {
+	ResourceWriter writer;
+	ostringstream lstFileOutput;
+	writeResources(writer, &lstFileOutput);
 
-	ofstream lst(lstOutput.c_str(), ios::binary);
+	ofstream lst(lstFile.c_str(), ios::binary);
 	lst << lstFileOutput.str();
-	printf("Wrote resource file %s\n", lstOutput.c_str());
+	printf("Wrote resource file %s\n", lstFile.c_str());
+}
+
+void VariantResourceSet::compileResources(string outputDir) {
+	ResourceWriter writer;
+	writeResources(writer, NULL);
+
+	string output = outputDir + "/resources";
+	string deps = outputDir + "/resources.deps";
+	string errorMsg = writer.write(output, "MAHeaders.h", deps);
+	if (!errorMsg.empty()) {
+		error(NULL, "Resource compilation failed: " + errorMsg);
+	}
 }
 
 static void writeByte(char* array, int& offset, int value) {
@@ -625,10 +717,6 @@ static void writePStr(char* array, int& offset, const char* str, size_t len) {
 	}
 }
 
-void addLabelDirective(ostringstream& output, const char* label) {
-	output << ".label \"" << label << "\"\n";
-}
-
 int VariantResourceSet::computeResAndLoadType(int resType, LoadType loadType) {
 	int loadTypeAsInt = loadType == LoadType_Unloaded ? 0x40 : 0x00;
 	int resAndLoadType = resType | loadTypeAsInt;
@@ -642,12 +730,6 @@ int VariantResourceSet::computeResAndLoadType(ResourceDirective* directive) {
 }
 
 string VariantResourceSet::createResTypeList() {
-	ostringstream resultStr;
-	resultStr << ".res\n";
-	addLabelDirective(resultStr, "res-types");
-	resultStr << ".res\n";
-	resultStr << ".bin\n";
-
 	int resTypeListSize = fResTypes.size();
 	char* result = (char*) malloc(resTypeListSize + 2);
 
@@ -662,9 +744,9 @@ string VariantResourceSet::createResTypeList() {
 		writeByte(result, offset, resAndLoadType);
 	}
 
-	ResourceDirective::writeByteDirective(resultStr, result, 0, offset);
+	string resultStr(result, offset);
 	free(result);
-	return resultStr.str();
+	return resultStr;
 }
 
 string VariantResourceSet::createResMap() {
@@ -676,12 +758,6 @@ string VariantResourceSet::createResMap() {
 		return string();
 	}
 
-	ostringstream resultStr;
-	resultStr << ".res\n";
-	addLabelDirective(resultStr, "variant-mapping");
-	resultStr << ".res\n";
-	resultStr << ".bin\n";
-
 	// We malloc enough. We just set max lengths for all variant ids
 	int resMapSize = 3 + numVariants * (2 + 256 + 3 * numVariantResources);
 	char* result = (char*) malloc(resMapSize);
@@ -750,17 +826,9 @@ string VariantResourceSet::createResMap() {
 		writeWord(result, lenOffset, len);
 	}
 
-	// Some debug info
-	resultStr << "/*\n";
-	resultStr << "\t" << numVariants << " variants, " << numVariantResources << " variant resources\n";
-	for (vector<string>::iterator variantIt = variants.begin(); variantIt != variants.end(); ++variantIt) {
-		resultStr << "\t" << getVariantStr(*variantIt) << "\n";
-	}
-	resultStr << "*/\n";
-
-	ResourceDirective::writeByteDirective(resultStr, result, 0, offset);
+	string resultStr(result, offset);
 	free(result);
-	return resultStr.str();
+	return resultStr;
 }
 
 VariantCondition::VariantCondition() {
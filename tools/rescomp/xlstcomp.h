@@ -24,6 +24,7 @@ Software Foundation, 59 Temple Place - Suite 330, Boston, MA
 #include <map>
 
 #include "resdirectives.h"
+#include "reswriter.h"
 
 #define DEFAULT_VARIANT ""
 
@@ -85,8 +86,9 @@ public:
 	ResourceDirective* getDirective(string resId, string variant);
 	void scanForResources(string directoryToScan);
 	void parseLSTX(string inputFile);
-	string parseLST(string lstFile, string outputDir);
-	void writeResources(string lstOutput);
+	void writeResources(ResourceWriter& writer, ostringstream* lstOutput);
+	void writeLST(string lstFile);
+	void compileResources(string outputDir);
 	void setPlatform(string platform);
 };
 
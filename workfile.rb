@@ -102,6 +102,27 @@ end
 
 EXTENSION_INCLUDES = ExtensionIncludeWork.new
 
+# Files needed to build pipe-tool -cpp output into a native module for MoRE -aot.
+class AotIncludeWork < Work
+	def setup
+		aotIncDir = mosyncdir + '/aot-include'
+		@prerequisites = []
+		@prerequisites << DirTask.new(self, aotIncDir)
+		sources = [
+			'runtimes/cpp/core/aotCommon.h',
+			'runtimes/cpp/core/aot/aot_module.cpp',
+			'runtimes/cpp/core/aot/mstypeinfo.h',
+			'runtimes/cpp/core/CoreCommon.h',
+			]
+		sources.each do |src|
+			@prerequisites << CopyFileTask.new(self, "#{aotIncDir}/#{File.basename(src)}",
+				FileTask.new(self, src))
+		end
+	end
+end
+
+AOT_INCLUDES = AotIncludeWork.new
+
 target :base => [SKINS, RULES] do
 	SKINS.invoke
 	RULES.invoke
@@ -109,6 +130,7 @@ target :base => [SKINS, RULES] do
 	#Work.invoke_subdir("tools/WrapperGenerator", "compile")
 	Work.invoke_subdir("tools/idl2", "compile")
 	EXTENSION_INCLUDES.invoke
+	AOT_INCLUDES.invoke
 end
 
 target :default => :base do